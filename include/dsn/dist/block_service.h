@@ -247,11 +247,16 @@ struct download_request
  *    ERR_FILE_OPERATION_FAILED: open output_local_name for write failed.
  *    if try to download a non-exist file and with an invalid output_local_name,
  *    it's up to implementation to return which error.
+ *
+ * file_md5 is the md5sum of the downloaded data, which is calculated while downloading.
+ * It's empty if the implementation doesn't support it, then the user should calculate
+ * it from the local file if needed.
  */
 struct download_response
 {
     dsn::error_code err;
     uint64_t downloaded_size;
+    std::string file_md5;
 };
 typedef std::function<void(const download_response &)> download_callback;
 typedef future_task<download_response> download_future;
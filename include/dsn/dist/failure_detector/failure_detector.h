@@ -66,6 +66,8 @@
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/tool-api/zlocks.h>
 
+#include <map>
+
 namespace dsn {
 namespace fd {
 
@@ -143,7 +145,7 @@ public:
 
     std::string get_allow_list(const std::vector<std::string> &args) const;
 
-    int worker_count() const { return static_cast<int>(_workers.size()); }
+    int worker_count() const;
 
     int master_count() const { return static_cast<int>(_masters.size()); }
 
@@ -161,6 +163,8 @@ private:
     void check_all_records();
 
 private:
+    friend class failure_detector_sim_test;
+
     class master_record
     {
     public:
@@ -187,6 +191,8 @@ private:
         ::dsn::rpc_address node;
         uint64_t last_beacon_recv_time;
         bool is_alive;
+        // the expire slot where the record is checked next, valid if is_alive
+        uint64_t expire_slot;
 
         // workers are always considered *connected* initially which is ok even when workers think
         // master is disconnected
@@ -195,6 +201,7 @@ private:
             this->node = node;
             this->last_beacon_recv_time = last_beacon_recv_time;
             is_alive = true;
+            expire_slot = 0;
         }
     };
 
@@ -205,8 +212,27 @@ private:
     // allow list are set on machine name (port can vary)
     typedef std::unordered_set<::dsn::rpc_address> allow_list;
 
+    // The workers are sharded by address, so that the beacons of the alive workers, which are
+    // the most, only lock their own shard. The connection state of a worker is only changed
+    // with `_lock` held as well, to keep it atomic with the connect/disconnect callbacks.
+    //
+    // The alive workers of a shard are also put in the slot of when they would expire if no
+    // more beacon arrives, with the granularity of the check interval. check_all_records only
+    // visits the due slots, and moves the refreshed workers to their new slots.
+    struct worker_shard
+    {
+        mutable zlock lock;
+        worker_map workers;
+        std::map<uint64_t, std::vector<::dsn::rpc_address>> expire_slots;
+    };
+    static const int kWorkerShards = 16;
+
+    worker_shard &get_worker_shard(::dsn::rpc_address node) const;
+    // called with the lock of `shard` held
+    void schedule_expire(worker_shard &shard, worker_record &record);
+
     master_map _masters;
-    worker_map _workers;
+    mutable worker_shard _worker_shards[kWorkerShards];
 
     uint32_t _check_interval_milliseconds;
     uint32_t _beacon_interval_milliseconds;
@@ -104,6 +104,8 @@ public:
 
     /*
      * submit transaction, it should be all succeeded or all failed
+     * notice: a provider may split a transaction beyond its limit into several parts which
+     *         are submitted in order, then only each part is all succeeded or all failed
      * cb_code: the task code specifies where to execute the callback
      * cb_transaction: callback, ec to indicate success or failure reason
      * tracker: to track (wait/cancel) whether the callback is executed
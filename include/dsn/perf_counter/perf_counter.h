@@ -84,6 +84,10 @@ public:
     virtual int64_t get_integer_value() = 0;
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type) = 0;
 
+    // Returns the value without the side effect of get_value(), which resets the rate and
+    // volatile counters, so that it can be read by others than the periodical collector.
+    virtual double peek_value() { return get_value(); }
+
     typedef std::vector<std::pair<int64_t *, int>> samples_t;
 
     // return actual sample count, must <= required_sample_count
@@ -95,6 +99,12 @@ public:
     // return the latest sample value
     virtual int64_t get_latest_sample() const { return 0; }
 
+    // (inclusive upper bound, count) of the non-empty buckets of the histogram of the values
+    // in the latest window, ordered by the bounds
+    // return false if the counter doesn't keep a histogram
+    typedef std::vector<std::pair<int64_t, uint64_t>> histogram_t;
+    virtual bool get_histogram(/*out*/ histogram_t &buckets) { return false; }
+
     const char *full_name() const { return _full_name.c_str(); }
     const char *app() const { return _app.c_str(); }
     const char *section() const { return _section.c_str(); }
@@ -30,7 +30,9 @@
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 #include <dsn/perf_counter/perf_counter.h>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <queue>
 #include <functional>
@@ -134,6 +136,20 @@ public:
         const std::vector<std::string> &args,
         std::function<bool(const std::string &arg, const counter_snapshot &cs)> filter) const;
 
+    // Appends all the counters to `out` in the OpenMetrics text format.
+    //
+    // Unlike take_snapshot(), the counters are read without being copied into a snapshot, and
+    // their names and labels are rendered only once when they are created. The counters of
+    // the same name are exposed as a metric family labeled by `app`, `section`, and `gpid`
+    // (or `entity`) taken from the part after '@' of the name, e.g.
+    // "replica*app.pegasus*get_qps@1.3" is exposed as
+    // get_qps{app="replica",section="app.pegasus",gpid="1.3"}.
+    //
+    // Unlike take_snapshot(), the rate and volatile counters are peeked without being reset,
+    // so the scrapes don't disturb the values seen by the collector. The rate is the one since
+    // the last collection, and the volatile number is the one accumulated since then.
+    void render_open_metrics(/*out*/ std::string &out) const;
+
 private:
     // full_name = perf_counter::build_full_name(...);
     perf_counter *new_counter(const char *app,
@@ -154,9 +170,31 @@ private:
     {
         perf_counter_ptr counter;
         int user_reference;
+        // the name of the OpenMetrics metric family it belongs to
+        std::string metric_family;
     };
     std::unordered_map<std::string, counter_object> _counters;
 
+    // the counters of the same name exposed to OpenMetrics, protected by `_lock`
+    struct metric_family
+    {
+        // the type of the first counter, the others are all summaries or all gauges
+        dsn_perf_counter_type_t type;
+        // the pre-rendered "# TYPE" and "# HELP" lines
+        std::shared_ptr<const std::string> header;
+        // the pre-rendered name and labels of each counter, without the closing '}'
+        //
+        // the texts are immutable and shared, so that they are rendered out of `_lock`
+        std::map<perf_counter *, std::shared_ptr<const std::string>> samples;
+    };
+    // returns the name of the metric family that `counter` is added to
+    std::string add_to_metric_family(perf_counter *counter);
+    void remove_from_metric_family(perf_counter *counter, const std::string &family);
+
+    std::map<std::string, metric_family> _metric_families;
+    // the size of the last rendered text, to reserve the buffer for the next one
+    mutable std::atomic<size_t> _open_metrics_size_hint;
+
     mutable utils::rw_lock_nr _snapshot_lock;
     std::unordered_map<std::string, counter_snapshot> _snapshots;
 
@@ -148,6 +148,10 @@ public:
     // message_ex(blob bb, bool parse_hdr = true); // read
     DSN_API ~message_ex();
 
+    // message_ex objects are allocated from the block pool
+    DSN_API static void *operator new(size_t size);
+    DSN_API static void operator delete(void *p, size_t size);
+
     //
     // utility routines
     //
@@ -200,6 +204,10 @@ public:
     //
     DSN_API void write_next(void **ptr, size_t *size, size_t min_size);
     DSN_API void write_commit(size_t size);
+    // append `data` to the message body as a new buffer by reference, without copying it.
+    // `data` must hold a reference to its memory (i.e. data.buffer() != nullptr), because the
+    // memory is sent after this call returns.
+    DSN_API void write_append(const blob &data);
     DSN_API bool read_next(void **ptr, size_t *size);
     bool read_next(blob &data);
     DSN_API void read_commit(size_t size);
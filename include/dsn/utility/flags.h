@@ -20,6 +20,7 @@
 #include <string>
 #include <cstdint>
 #include <functional>
+#include "defer.h"
 #include "errors.h"
 #include "enum_helper.h"
 #include "utils.h"
@@ -91,6 +92,14 @@ struct hash<flag_tag>
     COMPILE_ASSERT(sizeof(decltype(FLAGS_##name)), exist_##name##_##tag);                          \
     static dsn::flag_tagger FLAGS_TAGGER_##name##_##tag(#name, flag_tag::tag)
 
+// Restores the flag to its current value once out of the scope, e.g. in the tests changing it:
+//    PRESERVE_FLAG(filename);
+//    FLAGS_filename = "test.txt";
+#define PRESERVE_FLAG(name)                                                                        \
+    const auto PRESERVED_FLAGS_##name = FLAGS_##name;                                              \
+    auto PRESERVED_FLAGS_##name##_cleanup =                                                        \
+        dsn::defer([PRESERVED_FLAGS_##name]() { FLAGS_##name = PRESERVED_FLAGS_##name; })
+
 namespace dsn {
 
 // An utility class that registers a flag upon initialization.
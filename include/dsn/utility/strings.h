@@ -6,6 +6,9 @@
 #include <map>
 #include <unordered_set>
 #include <iostream>
+#include <memory>
+
+struct MD5state_st;
 
 namespace dsn {
 namespace utils {
@@ -55,5 +58,23 @@ char *trim_string(char *s);
 
 // calculate the md5 checksum of buffer
 std::string string_md5(const char *buffer, unsigned int length);
+
+// calculate the md5 checksum of data which is fed piece by piece, e.g. while it is being
+// transferred, so that there is no need to read it once more to checksum it
+class md5_digester
+{
+public:
+    md5_digester();
+    ~md5_digester();
+
+    void update(const char *data, size_t length);
+
+    // return the checksum in the same format as string_md5, the digester can't be updated
+    // any more after that
+    std::string finalize();
+
+private:
+    std::unique_ptr<MD5state_st> _ctx;
+};
 } // namespace utils
 } // namespace dsn
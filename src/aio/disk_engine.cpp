@@ -31,6 +31,7 @@
 #include "disk_engine.h"
 #include "runtime/service_engine.h"
 #include "native_linux_aio_provider.h"
+#include "io_uring_aio_provider.h"
 
 using namespace dsn::utils;
 
@@ -40,6 +41,9 @@ DEFINE_TASK_CODE_AIO(LPC_AIO_BATCH_WRITE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFA
 const char *native_aio_provider = "dsn::tools::native_aio_provider";
 DSN_REGISTER_COMPONENT_PROVIDER(native_linux_aio_provider, native_aio_provider);
 
+const char *io_uring_aio_provider_name = "dsn::tools::io_uring_aio_provider";
+DSN_REGISTER_COMPONENT_PROVIDER(io_uring_aio_provider, io_uring_aio_provider_name);
+
 struct disk_engine_initializer
 {
     disk_engine_initializer() { disk_engine::instance(); }
@@ -151,8 +155,10 @@ aio_task *disk_file::on_write_completed(aio_task *wk, void *ctx, error_code err,
 //----------------- disk_engine ------------------------
 disk_engine::disk_engine()
 {
+    // disk_engine is created before the config is loaded, so the io_uring provider decides
+    // whether to use io_uring or fall back to the native one lazily, see [core] enable_io_uring.
     aio_provider *provider = utils::factory_store<aio_provider>::create(
-        native_aio_provider, dsn::PROVIDER_TYPE_MAIN, this);
+        io_uring_aio_provider_name, dsn::PROVIDER_TYPE_MAIN, this);
     _provider.reset(provider);
 }
 
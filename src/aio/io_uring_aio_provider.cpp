@@ -0,0 +1,410 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "io_uring_aio_provider.h"
+#include "runtime/service_engine.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define DSN_HAS_IO_URING 1
+#endif
+#endif
+
+namespace dsn {
+
+DSN_DEFINE_bool("core",
+                enable_io_uring,
+                false,
+                "whether to submit disk io through io_uring, fall back to the thread-pool based "
+                "aio if the kernel doesn't support it");
+DSN_DEFINE_uint32("core",
+                  io_uring_queue_depth,
+                  1024,
+                  "submission queue depth of io_uring, the excess io falls back to the "
+                  "thread-pool based aio");
+
+io_uring_aio_provider::io_uring_aio_provider(disk_engine *disk)
+    : native_linux_aio_provider(disk),
+      _ring_fd(-1),
+      _sq_ring_ptr(nullptr),
+      _sq_ring_size(0),
+      _sq_head(nullptr),
+      _sq_tail(nullptr),
+      _sq_ring_mask(nullptr),
+      _sq_array(nullptr),
+      _sqes(nullptr),
+      _sqes_size(0),
+      _sq_entries(0),
+      _cq_ring_ptr(nullptr),
+      _cq_ring_size(0),
+      _cq_head(nullptr),
+      _cq_tail(nullptr),
+      _cq_ring_mask(nullptr),
+      _cqes(nullptr),
+      _unsubmitted(0),
+      _submitting(false),
+      _inflight(0),
+      _stopping(false)
+{
+}
+
+io_uring_aio_provider::~io_uring_aio_provider()
+{
+    if (_ring_fd < 0) {
+        return;
+    }
+
+    // wake up the poller by a NOP request
+    _stopping.store(true);
+    while (!submit_request(nullptr)) {
+        flush_submissions();
+    }
+    flush_submissions();
+    _poller.join();
+
+    close_ring();
+}
+
+bool io_uring_aio_provider::ring_enabled()
+{
+    std::call_once(_init_once, [this]() {
+        if (FLAGS_enable_io_uring && setup_ring()) {
+            _poller = std::thread([this]() { poll_completions(); });
+            ddebug_f("io_uring is enabled, queue_depth = {}", _sq_entries);
+        }
+    });
+    return _ring_fd >= 0;
+}
+
+void io_uring_aio_provider::submit_aio_task(aio_task *aio_tsk)
+{
+    if (dsn_unlikely(service_engine::instance().is_simulator()) || !ring_enabled()) {
+        native_linux_aio_provider::submit_aio_task(aio_tsk);
+        return;
+    }
+
+    // keep the in-flight requests no more than the SQ entries, so both SQ and CQ never overflow
+    if (_inflight.fetch_add(1, std::memory_order_relaxed) >= _sq_entries) {
+        _inflight.fetch_sub(1, std::memory_order_relaxed);
+        native_linux_aio_provider::submit_aio_task(aio_tsk);
+        return;
+    }
+
+    aio_context *aio_ctx = aio_tsk->get_aio_context();
+    auto req = new io_request;
+    req->aio = aio_tsk;
+    req->iov.iov_base = aio_ctx->buffer;
+    req->iov.iov_len = aio_ctx->buffer_size;
+    req->processed_bytes = 0;
+
+    bool ok = submit_request(req);
+    dassert_f(ok, "io_uring submission queue overflow, inflight = {}", _inflight.load());
+    flush_submissions();
+}
+
+#ifdef DSN_HAS_IO_URING
+
+bool io_uring_aio_provider::setup_ring()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, FLAGS_io_uring_queue_depth, &p));
+    if (fd < 0) {
+        dwarn_f("io_uring_setup failed, fall back to the thread-pool based aio, err = {}",
+                utils::safe_strerror(errno));
+        return false;
+    }
+
+    _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring_ptr = mmap(nullptr,
+                        _sq_ring_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        fd,
+                        IORING_OFF_SQ_RING);
+    if (_sq_ring_ptr == MAP_FAILED) {
+        _sq_ring_ptr = nullptr;
+        goto failed;
+    }
+
+    if (single_mmap) {
+        _cq_ring_ptr = _sq_ring_ptr;
+    } else {
+        _cq_ring_ptr = mmap(nullptr,
+                            _cq_ring_size,
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE,
+                            fd,
+                            IORING_OFF_CQ_RING);
+        if (_cq_ring_ptr == MAP_FAILED) {
+            _cq_ring_ptr = nullptr;
+            goto failed;
+        }
+    }
+
+    _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = (struct io_uring_sqe *)mmap(nullptr,
+                                        _sqes_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE,
+                                        fd,
+                                        IORING_OFF_SQES);
+    if (_sqes == MAP_FAILED) {
+        _sqes = nullptr;
+        goto failed;
+    }
+
+    {
+        char *sq = (char *)_sq_ring_ptr;
+        _sq_head = (unsigned *)(sq + p.sq_off.head);
+        _sq_tail = (unsigned *)(sq + p.sq_off.tail);
+        _sq_ring_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+        _sq_array = (unsigned *)(sq + p.sq_off.array);
+        _sq_entries = p.sq_entries;
+
+        char *cq = (char *)_cq_ring_ptr;
+        _cq_head = (unsigned *)(cq + p.cq_off.head);
+        _cq_tail = (unsigned *)(cq + p.cq_off.tail);
+        _cq_ring_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+        _cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    }
+
+    _ring_fd = fd;
+    return true;
+
+failed:
+    dwarn_f("mmap io_uring failed, fall back to the thread-pool based aio, err = {}",
+            utils::safe_strerror(errno));
+    _ring_fd = fd;
+    close_ring();
+    return false;
+}
+
+void io_uring_aio_provider::close_ring()
+{
+    if (_sqes != nullptr) {
+        munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_cq_ring_ptr != nullptr && _cq_ring_ptr != _sq_ring_ptr) {
+        munmap(_cq_ring_ptr, _cq_ring_size);
+    }
+    _cq_ring_ptr = nullptr;
+    if (_sq_ring_ptr != nullptr) {
+        munmap(_sq_ring_ptr, _sq_ring_size);
+        _sq_ring_ptr = nullptr;
+    }
+    ::close(_ring_fd);
+    _ring_fd = -1;
+}
+
+bool io_uring_aio_provider::submit_request(io_request *req)
+{
+    std::lock_guard<std::mutex> l(_sq_lock);
+
+    unsigned tail = *_sq_tail;
+    unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= _sq_entries) {
+        return false;
+    }
+
+    unsigned index = tail & *_sq_ring_mask;
+    struct io_uring_sqe *sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    if (req == nullptr) {
+        sqe->opcode = IORING_OP_NOP;
+    } else {
+        aio_context *aio_ctx = req->aio->get_aio_context();
+        sqe->opcode = (aio_ctx->type == AIO_Read) ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd = static_cast<int>((ssize_t)aio_ctx->file);
+        sqe->addr = (uint64_t)(uintptr_t)&req->iov;
+        sqe->len = 1;
+        sqe->off = aio_ctx->file_offset + req->processed_bytes;
+    }
+    sqe->user_data = (uint64_t)(uintptr_t)req;
+    _sq_array[index] = index;
+
+    // make the SQE visible to the kernel before the tail update
+    __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++_unsubmitted;
+    return true;
+}
+
+void io_uring_aio_provider::flush_submissions()
+{
+    // only one thread enters the kernel at a time, and it submits the SQEs
+    // queued by all the other threads in batch
+    {
+        std::lock_guard<std::mutex> l(_sq_lock);
+        if (_submitting || _unsubmitted == 0) {
+            return;
+        }
+        _submitting = true;
+    }
+
+    while (true) {
+        unsigned to_submit;
+        {
+            std::lock_guard<std::mutex> l(_sq_lock);
+            to_submit = _unsubmitted;
+            if (to_submit == 0) {
+                _submitting = false;
+                return;
+            }
+        }
+
+        int ret =
+            static_cast<int>(syscall(__NR_io_uring_enter, _ring_fd, to_submit, 0, 0, nullptr, 0));
+        if (dsn_unlikely(ret < 0)) {
+            dassert_f(errno == EINTR || errno == EAGAIN || errno == EBUSY,
+                      "io_uring_enter failed, err = {}",
+                      utils::safe_strerror(errno));
+            continue;
+        }
+
+        std::lock_guard<std::mutex> l(_sq_lock);
+        _unsubmitted -= static_cast<unsigned>(ret);
+    }
+}
+
+void io_uring_aio_provider::poll_completions()
+{
+    task_worker::set_name("io_uring.poller");
+
+    while (true) {
+        unsigned head = *_cq_head;
+        unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (_stopping.load()) {
+                break;
+            }
+            int ret = static_cast<int>(syscall(
+                __NR_io_uring_enter, _ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (dsn_unlikely(ret < 0 && errno != EINTR)) {
+                derror_f("io_uring_enter for completions failed, err = {}",
+                         utils::safe_strerror(errno));
+            }
+            continue;
+        }
+
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &_cqes[head & *_cq_ring_mask];
+            auto req = (io_request *)(uintptr_t)cqe->user_data;
+            int res = cqe->res;
+
+            // release the CQE to the kernel before handling it
+            __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+            if (req != nullptr) {
+                on_request_completed(req, res);
+            }
+        }
+    }
+}
+
+#else
+
+bool io_uring_aio_provider::setup_ring()
+{
+    dwarn("io_uring is not supported by this build, fall back to the thread-pool based aio");
+    return false;
+}
+
+void io_uring_aio_provider::close_ring() {}
+
+bool io_uring_aio_provider::submit_request(io_request *req) { return false; }
+
+void io_uring_aio_provider::flush_submissions() {}
+
+void io_uring_aio_provider::poll_completions() {}
+
+#endif // DSN_HAS_IO_URING
+
+void io_uring_aio_provider::on_request_completed(io_request *req, int res)
+{
+    aio_context *aio_ctx = req->aio->get_aio_context();
+    error_code err = ERR_OK;
+
+    if (dsn_unlikely(res == -EINTR || res == -EAGAIN)) {
+        dwarn_f("io_uring request failed with err = {}, and will retry it",
+                utils::safe_strerror(-res));
+        submit_request(req);
+        flush_submissions();
+        return;
+    }
+
+    if (dsn_unlikely(res < 0)) {
+        err = ERR_FILE_OPERATION_FAILED;
+        derror_f("io_uring request failed, type = {}, err = {}",
+                 aio_ctx->type == AIO_Read ? "read" : "write",
+                 utils::safe_strerror(-res));
+    } else if (aio_ctx->type == AIO_Read) {
+        req->processed_bytes += static_cast<uint32_t>(res);
+        if (req->processed_bytes == 0) {
+            err = ERR_HANDLE_EOF;
+        }
+    } else {
+        req->processed_bytes += static_cast<uint32_t>(res);
+        if (dsn_unlikely(req->processed_bytes < aio_ctx->buffer_size)) {
+            dwarn_f("write incomplete, request_size={}, total_write_size={}, this_write_size={}, "
+                    "and will retry it.",
+                    aio_ctx->buffer_size,
+                    req->processed_bytes,
+                    res);
+            req->iov.iov_base = (char *)aio_ctx->buffer + req->processed_bytes;
+            req->iov.iov_len = aio_ctx->buffer_size - req->processed_bytes;
+            submit_request(req);
+            flush_submissions();
+            return;
+        }
+    }
+
+    aio_task *aio_tsk = req->aio;
+    uint32_t processed_bytes = req->processed_bytes;
+    delete req;
+
+    // the slot is released before `complete_io`, which may submit the next io
+    _inflight.fetch_sub(1, std::memory_order_relaxed);
+    complete_io(aio_tsk, err, processed_bytes);
+}
+
+} // namespace dsn
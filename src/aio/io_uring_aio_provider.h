@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "native_linux_aio_provider.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace dsn {
+
+// io_uring_aio_provider submits reads/writes to the kernel through an io_uring
+// instance instead of running blocking pread/pwrite on a thread pool. SQEs from
+// concurrent submitters are coalesced into a single io_uring_enter, and completions
+// are reaped by a dedicated poller thread which calls `complete_io` directly.
+//
+// The ring is set up lazily on the first submission (after the config is loaded).
+// If io_uring is disabled by [core] enable_io_uring, or the kernel lacks io_uring,
+// or the ring is saturated, it falls back to native_linux_aio_provider.
+class io_uring_aio_provider : public native_linux_aio_provider
+{
+public:
+    explicit io_uring_aio_provider(disk_engine *disk);
+    ~io_uring_aio_provider() override;
+
+    void submit_aio_task(aio_task *aio) override;
+
+    // whether the io_uring path is actually in use
+    bool ring_enabled();
+
+private:
+    struct io_request
+    {
+        aio_task *aio;
+        struct iovec iov;
+        uint32_t processed_bytes;
+    };
+
+    bool setup_ring();
+    void close_ring();
+
+    // fill one SQE for `req` and flush the submission queue
+    // return false if the submission queue is full
+    bool submit_request(io_request *req);
+    void flush_submissions();
+    void poll_completions();
+    void on_request_completed(io_request *req, int res);
+
+private:
+    std::once_flag _init_once;
+    int _ring_fd;
+
+    // submission queue ring, shared with the kernel
+    void *_sq_ring_ptr;
+    size_t _sq_ring_size;
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned *_sq_ring_mask;
+    unsigned *_sq_array;
+    struct io_uring_sqe *_sqes;
+    size_t _sqes_size;
+    unsigned _sq_entries;
+
+    // completion queue ring, shared with the kernel
+    void *_cq_ring_ptr;
+    size_t _cq_ring_size;
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned *_cq_ring_mask;
+    struct io_uring_cqe *_cqes;
+
+    // protects the SQ tail and `_unsubmitted`/`_submitting`
+    std::mutex _sq_lock;
+    unsigned _unsubmitted;
+    bool _submitting;
+
+    std::atomic<uint32_t> _inflight;
+    std::atomic<bool> _stopping;
+    std::thread _poller;
+};
+
+} // namespace dsn
@@ -30,6 +30,12 @@
 #include <dsn/utility/fail_point.h>
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+#include "aio/disk_engine.h"
+#include "aio/io_uring_aio_provider.h"
 
 using namespace ::dsn;
 
@@ -282,3 +288,109 @@ TEST(core, dsn_file)
     ASSERT_TRUE(utils::filesystem::file_size("copy_dest.txt", fout_size));
     ASSERT_EQ(fin_size, fout_size);
 }
+
+// The concurrent writes of the provider, the io_uring one if [core] enable_io_uring is set and
+// supported, land at their offsets.
+TEST(core, aio_concurrent_writes)
+{
+    const int concurrency = 64;
+    for (uint32_t block_size : {4096u, 1024u * 1024u}) {
+        const int total_count = block_size <= 4096 ? 1024 : 64;
+
+        auto fp = file::open("perf_tmp", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+        ASSERT_NE(nullptr, fp);
+
+        std::vector<std::string> buffers;
+        for (int i = 0; i < total_count; ++i) {
+            buffers.emplace_back(block_size, static_cast<char>('a' + i % 26));
+        }
+        std::atomic<int> completed(0);
+        for (int i = 0; i < total_count; i += concurrency) {
+            std::list<aio_task_ptr> tasks;
+            for (int j = i; j < std::min(total_count, i + concurrency); ++j) {
+                tasks.push_back(::dsn::file::write(fp,
+                                                   buffers[j].data(),
+                                                   block_size,
+                                                   (uint64_t)j * block_size,
+                                                   LPC_AIO_TEST,
+                                                   nullptr,
+                                                   [&completed](error_code, size_t) {
+                                                       ++completed;
+                                                   }));
+            }
+            for (auto &t : tasks) {
+                t->wait();
+                ASSERT_EQ(ERR_OK, t->error());
+                ASSERT_EQ(block_size, t->get_transferred_size());
+            }
+        }
+        ASSERT_EQ(total_count, completed.load());
+
+        std::string block(block_size, '\0');
+        for (int j = 0; j < total_count; ++j) {
+            auto t = ::dsn::file::read(fp,
+                                       &block[0],
+                                       block_size,
+                                       (uint64_t)j * block_size,
+                                       LPC_AIO_TEST,
+                                       nullptr,
+                                       nullptr);
+            t->wait();
+            ASSERT_EQ(ERR_OK, t->error());
+            ASSERT_EQ(buffers[j], block);
+        }
+
+        ASSERT_EQ(ERR_OK, file::close(fp));
+        utils::filesystem::remove_path("perf_tmp");
+    }
+}
+
+// A microbenchmark of the disk write path, run it with --gtest_also_run_disabled_tests and
+// [core] enable_io_uring = true/false to compare the io_uring and the thread-pool based providers.
+TEST(core, DISABLED_aio_write_perf)
+{
+    auto *provider = dynamic_cast<io_uring_aio_provider *>(&disk_engine::provider());
+    const char *provider_name =
+        (provider != nullptr && provider->ring_enabled()) ? "io_uring" : "native";
+
+    const int concurrency = 64;
+    for (uint32_t block_size : {4096u, 1024u * 1024u}) {
+        const int total_count = block_size <= 4096 ? 20000 : 512;
+        std::string buffer(block_size, 'x');
+        std::vector<uint64_t> latencies(total_count);
+
+        auto fp = file::open("perf_tmp", O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+        ASSERT_NE(nullptr, fp);
+
+        uint64_t start = dsn_now_ns();
+        for (int i = 0; i < total_count; i += concurrency) {
+            std::list<aio_task_ptr> tasks;
+            for (int j = i; j < std::min(total_count, i + concurrency); ++j) {
+                uint64_t issue_time = dsn_now_ns();
+                tasks.push_back(::dsn::file::write(
+                    fp,
+                    buffer.data(),
+                    block_size,
+                    (uint64_t)j * block_size,
+                    LPC_AIO_TEST,
+                    nullptr,
+                    [&latencies, j, issue_time](error_code, size_t) {
+                        latencies[j] = dsn_now_ns() - issue_time;
+                    }));
+            }
+            for (auto &t : tasks) {
+                t->wait();
+                ASSERT_EQ(ERR_OK, t->error());
+            }
+        }
+        uint64_t elapsed_ns = std::max<uint64_t>(dsn_now_ns() - start, 1);
+
+        ASSERT_EQ(ERR_OK, file::close(fp));
+        utils::filesystem::remove_path("perf_tmp");
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "provider = " << provider_name << ", block_size = " << block_size
+                  << ", iops = " << total_count * 1000000000.0 / elapsed_ns
+                  << ", p99_us = " << latencies[total_count * 99 / 100] / 1000 << std::endl;
+    }
+}
@@ -47,7 +47,9 @@ public:
     // \return  ERR_FS_INTERNAL: remote file system error
     // \return  ERR_CORRUPTION: file not exist or damaged
     // \return  ERR_PATH_ALREADY_EXIST: local file exist
-    // if download file succeed, download_err = ERR_OK and set download_file_size
+    // if download file succeed, download_err = ERR_OK and set download_file_size and
+    // download_file_md5, the latter is calculated while downloading, and it's empty if the
+    // remote file provider doesn't support that
     //
     // TODO(wutao1): create block_filesystem_wrapper instead.
     // NOTE: This function is not responsible for the correctness of the downloaded file.
@@ -57,7 +59,8 @@ public:
                              const std::string &local_dir,
                              const std::string &file_name,
                              block_filesystem *fs,
-                             /*out*/ uint64_t &download_file_size);
+                             /*out*/ uint64_t &download_file_size,
+                             /*out*/ std::string &download_file_md5);
 
 private:
     block_service_registry &_registry_holder;
@@ -28,9 +28,12 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/flags.h>
 #include <dsn/utility/safe_strerror_posix.h>
+#include <dsn/utility/strings.h>
 #include <dsn/utility/TokenBucket.h>
 #include <dsn/utility/utils.h>
 
+#include "block_service/ranged_download.h"
+
 namespace dsn {
 namespace dist {
 namespace block_service {
@@ -52,6 +55,24 @@ DSN_DEFINE_uint64("replication",
                   "hdfs write batch size, the default value is 64MB");
 DSN_TAG_VARIABLE(hdfs_write_batch_size_bytes, FT_MUTABLE);
 
+DSN_DEFINE_uint32("replication",
+                  hdfs_download_concurrency,
+                  2,
+                  "how many batches of a file are downloaded in parallel from hdfs, each batch is "
+                  "hdfs_read_batch_size_bytes");
+DSN_TAG_VARIABLE(hdfs_download_concurrency, FT_MUTABLE);
+
+DSN_DEFINE_uint64("replication",
+                  hdfs_download_buffer_limit_bytes,
+                  256 << 20,
+                  "the max bytes buffered by the parallel batches of all the downloads from "
+                  "hdfs, the default value is 256MB");
+DSN_TAG_VARIABLE(hdfs_download_buffer_limit_bytes, FT_MUTABLE);
+
+DEFINE_TASK_CODE(LPC_HDFS_SERVICE_DOWNLOAD_RANGE, TASK_PRIORITY_COMMON, THREAD_POOL_BLOCK_SERVICE)
+
+static download_buffer_budget s_download_buffer_budget(FLAGS_hdfs_download_buffer_limit_bytes);
+
 hdfs_service::hdfs_service() { _read_token_bucket.reset(new folly::DynamicTokenBucket()); }
 
 hdfs_service::~hdfs_service()
@@ -293,6 +314,7 @@ error_code hdfs_file_object::write_data_in_batches(const char *data,
     }
     uint64_t cur_pos = 0;
     uint64_t write_len = 0;
+    utils::md5_digester digester;
     while (cur_pos < data_size) {
         write_len = std::min(data_size - cur_pos, FLAGS_hdfs_write_batch_size_bytes);
         tSize num_written_bytes = hdfsWrite(_service->get_fs(),
@@ -306,6 +328,7 @@ error_code hdfs_file_object::write_data_in_batches(const char *data,
             hdfsCloseFile(_service->get_fs(), write_file);
             return ERR_FS_INTERNAL;
         }
+        digester.update(data + cur_pos, num_written_bytes);
         cur_pos += num_written_bytes;
     }
     if (hdfsHFlush(_service->get_fs(), write_file) != 0) {
@@ -322,7 +345,11 @@ error_code hdfs_file_object::write_data_in_batches(const char *data,
     }
 
     ddebug("start to synchronize meta data after successfully wrote data to hdfs");
-    return get_file_meta();
+    error_code err = get_file_meta();
+    if (err == ERR_OK) {
+        _md5sum = digester.finalize();
+    }
+    return err;
 }
 
 dsn::task_ptr hdfs_file_object::write(const write_request &req,
@@ -443,6 +470,46 @@ error_code hdfs_file_object::read_data_in_batches(uint64_t start_pos,
     return ERR_FS_INTERNAL;
 }
 
+error_code hdfs_file_object::read_range(uint64_t pos, uint64_t length, char *buf)
+{
+    hdfsFile read_file = hdfsOpenFile(_service->get_fs(), file_name().c_str(), O_RDONLY, 0, 0, 0);
+    if (!read_file) {
+        derror_f("Failed to open hdfs file {} for reading, error: {}.",
+                 file_name(),
+                 utils::safe_strerror(errno));
+        return ERR_FS_INTERNAL;
+    }
+
+    const uint64_t rate = FLAGS_hdfs_read_limit_rate_megabytes << 20;
+    // burst size should not be less than consume size
+    _service->_read_token_bucket->consumeWithBorrowAndWait(
+        length, rate, std::max(2 * rate, length));
+
+    error_code err = ERR_OK;
+    uint64_t read_size = 0;
+    while (read_size < length) {
+        tSize num_read_bytes = hdfsPread(_service->get_fs(),
+                                         read_file,
+                                         static_cast<tOffset>(pos + read_size),
+                                         (void *)(buf + read_size),
+                                         static_cast<tSize>(length - read_size));
+        if (num_read_bytes <= 0) {
+            derror_f("Failed to read hdfs file {}, error: {}.",
+                     file_name(),
+                     num_read_bytes == 0 ? "unexpected eof" : utils::safe_strerror(errno));
+            err = ERR_FS_INTERNAL;
+            break;
+        }
+        read_size += num_read_bytes;
+    }
+    if (hdfsCloseFile(_service->get_fs(), read_file) != 0) {
+        derror_f(
+            "Failed to close hdfs file {}, error: {}.", file_name(), utils::safe_strerror(errno));
+        return ERR_FS_INTERNAL;
+    }
+    return err;
+}
+
 dsn::task_ptr hdfs_file_object::read(const read_request &req,
                                      dsn::task_code code,
                                      const read_callback &cb,
@@ -481,25 +548,32 @@ dsn::task_ptr hdfs_file_object::download(const download_request &req,
     auto download_background = [this, req, t]() {
         download_response resp;
         resp.downloaded_size = 0;
-        std::string read_buffer;
-        size_t read_length = 0;
-        resp.err =
-            read_data_in_batches(req.remote_pos, req.remote_length, read_buffer, read_length);
+        resp.err = _has_meta_synced ? ERR_OK : get_file_meta();
         if (resp.err == ERR_OK) {
-            std::ofstream out(req.output_local_name,
-                              std::ios::binary | std::ios::out | std::ios::trunc);
-            if (out.is_open()) {
-                out.write(read_buffer.c_str(), read_length);
-                out.close();
-                resp.downloaded_size = read_length;
+            // the batches are read in parallel and written to the local file directly, rather
+            // than reading the whole file into memory first
+            uint64_t start_pos = std::min<uint64_t>(req.remote_pos, _size);
+            uint64_t length = _size - start_pos;
+            if (req.remote_length != -1) {
+                length = std::min<uint64_t>(length, req.remote_length);
+            }
+            resp.err = download_in_ranges(
+                req.output_local_name,
+                start_pos,
+                length,
+                FLAGS_hdfs_read_batch_size_bytes,
+                FLAGS_hdfs_download_concurrency,
+                LPC_HDFS_SERVICE_DOWNLOAD_RANGE,
+                s_download_buffer_budget,
+                [this](uint64_t pos, uint64_t len, char *buf) { return read_range(pos, len, buf); },
+                resp.file_md5);
+            if (resp.err == ERR_OK) {
+                resp.downloaded_size = length;
             } else {
-                derror_f("HDFS download failed: fail to open localfile {} when download {}, "
-                         "error: {}",
-                         req.output_local_name,
+                derror_f("HDFS download failed: fail to download {} to localfile {}, error: {}",
                          file_name(),
-                         utils::safe_strerror(errno));
-                resp.err = ERR_FILE_OPERATION_FAILED;
-                resp.downloaded_size = 0;
+                         req.output_local_name,
+                         resp.err);
             }
         }
         t->enqueue_with(resp);
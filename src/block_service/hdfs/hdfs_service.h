@@ -101,6 +101,8 @@ private:
                                     int64_t length,
                                     std::string &read_buffer,
                                     size_t &read_length);
+    // read exactly `length` bytes at `pos` into `buf`, it's thread safe
+    error_code read_range(uint64_t pos, uint64_t length, char *buf);
 
     hdfs_service *_service;
     std::string _md5sum;
@@ -22,6 +22,7 @@
 #include <dsn/utility/error_code.h>
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/safe_strerror_posix.h>
 #include <dsn/utility/strings.h>
 #include <dsn/utility/utils.h>
@@ -29,6 +30,7 @@
 #include <nlohmann/json.hpp>
 
 #include "local_service.h"
+#include "block_service/ranged_download.h"
 
 static const int max_length = 2048; // max data length read from file each time
 
@@ -38,6 +40,33 @@ namespace block_service {
 
 DEFINE_TASK_CODE(LPC_LOCAL_SERVICE_CALL, TASK_PRIORITY_COMMON, THREAD_POOL_BLOCK_SERVICE)
 
+DSN_DEFINE_uint64("replication",
+                  local_service_download_chunk_size_bytes,
+                  8 << 20,
+                  "the size of the ranges which a file is split into to be downloaded in "
+                  "parallel from local service, the default value is 8MB");
+DSN_TAG_VARIABLE(local_service_download_chunk_size_bytes, FT_MUTABLE);
+
+DSN_DEFINE_uint32("replication",
+                  local_service_download_concurrency,
+                  4,
+                  "how many ranges of a file are downloaded in parallel from local service");
+DSN_TAG_VARIABLE(local_service_download_concurrency, FT_MUTABLE);
+
+DSN_DEFINE_uint64("replication",
+                  local_service_download_buffer_limit_bytes,
+                  64 << 20,
+                  "the max bytes buffered by the parallel ranges of all the downloads from "
+                  "local service, the default value is 64MB");
+DSN_TAG_VARIABLE(local_service_download_buffer_limit_bytes, FT_MUTABLE);
+
+DEFINE_TASK_CODE(LPC_LOCAL_SERVICE_DOWNLOAD_RANGE,
+                 TASK_PRIORITY_COMMON,
+                 THREAD_POOL_BLOCK_SERVICE)
+
+static download_buffer_budget
+    s_download_buffer_budget(FLAGS_local_service_download_buffer_limit_bytes);
+
 struct file_metadata
 {
     uint64_t size;
@@ -444,10 +473,12 @@ dsn::task_ptr local_file_object::upload(const upload_request &req,
                   file_name().c_str());
             int64_t total_sz = 0;
             char buf[max_length] = {'\0'};
+            utils::md5_digester digester;
             while (!fin.eof()) {
                 fin.read(buf, max_length);
                 total_sz += fin.gcount();
                 fout.write(buf, fin.gcount());
+                digester.update(buf, fin.gcount());
             }
             dinfo("finish upload file, file = %s, total_size = %d", file_name().c_str(), total_sz);
             fout.close();
@@ -455,15 +486,11 @@ dsn::task_ptr local_file_object::upload(const upload_request &req,
 
             resp.uploaded_size = static_cast<uint64_t>(total_sz);
 
-            // calc the md5sum by source file for simplicity
+            // calc the md5sum while transferring to avoid reading the source file again
             _size = total_sz;
-            error_code res = utils::filesystem::md5sum(req.input_local_name, _md5_value);
-            if (res == dsn::ERR_OK) {
-                _has_meta_synced = true;
-                store_metadata();
-            } else {
-                resp.err = ERR_FS_INTERNAL;
-            }
+            _md5_value = digester.finalize();
+            _has_meta_synced = true;
+            store_metadata();
         } else {
             if (fin.is_open())
                 fin.close();
@@ -506,51 +533,60 @@ dsn::task_ptr local_file_object::download(const download_request &req,
             }
         }
 
+        int fd = -1;
+        int64_t total_sz = 0;
         if (resp.err == ERR_OK) {
-            std::ifstream fin(file_name(), std::ifstream::in);
-            if (!fin.is_open()) {
+            fd = ::open(file_name().c_str(), O_RDONLY);
+            if (fd < 0 || !utils::filesystem::file_size(file_name(), total_sz)) {
                 derror("open block file(%s) failed, err(%s)",
                        file_name().c_str(),
                        utils::safe_strerror(errno).c_str());
                 resp.err = ERR_FS_INTERNAL;
             }
+        }
 
-            std::ofstream fout(target_file, std::ios_base::out | std::ios_base::trunc);
-            if (!fout.is_open()) {
-                if (fin.is_open())
-                    fin.close();
-                derror("open target file(%s) failed, err(%s)",
-                       target_file.c_str(),
-                       utils::safe_strerror(errno).c_str());
-                resp.err = ERR_FILE_OPERATION_FAILED;
-            }
-
-            if (resp.err == ERR_OK) {
-                dinfo("start to transfer, src_file(%s), des_file(%s)",
-                      file_name().c_str(),
-                      target_file.c_str());
-                int64_t total_sz = 0;
-                char buf[max_length] = {'\0'};
-                while (!fin.eof()) {
-                    fin.read(buf, max_length);
-                    total_sz += fin.gcount();
-                    fout.write(buf, fin.gcount());
+        if (resp.err == ERR_OK) {
+            dinfo("start to transfer, src_file(%s), des_file(%s)",
+                  file_name().c_str(),
+                  target_file.c_str());
+            auto read_range = [this, fd](uint64_t pos, uint64_t len, char *buf) -> error_code {
+                for (uint64_t read_sz = 0; read_sz < len;) {
+                    ssize_t ret = ::pread(fd, buf + read_sz, len - read_sz, pos + read_sz);
+                    if (ret <= 0) {
+                        derror("read block file(%s) failed, err(%s)",
+                               file_name().c_str(),
+                               ret == 0 ? "unexpected eof" : utils::safe_strerror(errno).c_str());
+                        return ERR_FS_INTERNAL;
+                    }
+                    read_sz += ret;
                 }
+                return ERR_OK;
+            };
+            resp.err = download_in_ranges(target_file,
+                                          0,
+                                          static_cast<uint64_t>(total_sz),
+                                          FLAGS_local_service_download_chunk_size_bytes,
+                                          FLAGS_local_service_download_concurrency,
+                                          LPC_LOCAL_SERVICE_DOWNLOAD_RANGE,
+                                          s_download_buffer_budget,
+                                          read_range,
+                                          resp.file_md5);
+            if (resp.err == ERR_OK) {
                 dinfo("finish download file(%s), total_size = %d", target_file.c_str(), total_sz);
-                fout.close();
-                fin.close();
                 resp.downloaded_size = static_cast<uint64_t>(total_sz);
-
                 _size = total_sz;
-                if ((resp.err = utils::filesystem::md5sum(target_file, _md5_value)) != ERR_OK) {
-                    dwarn("download %s failed when calculate the md5sum of %s",
-                          file_name().c_str(),
-                          target_file.c_str());
-                } else {
-                    _has_meta_synced = true;
-                }
+                _md5_value = resp.file_md5;
+                _has_meta_synced = true;
+            } else {
+                dwarn("download %s to %s failed, err(%s)",
+                      file_name().c_str(),
+                      target_file.c_str(),
+                      resp.err.to_string());
             }
         }
+        if (fd >= 0) {
+            ::close(fd);
+        }
 
         tsk->enqueue_with(resp);
         release_ref();
@@ -0,0 +1,234 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/error_code.h>
+#include <dsn/utility/safe_strerror_posix.h>
+#include <dsn/utility/strings.h>
+
+namespace dsn {
+namespace dist {
+namespace block_service {
+
+// Bounds the memory of the chunks buffered by all the downloads of a provider, whose limit
+// is a mutable flag.
+class download_buffer_budget
+{
+public:
+    explicit download_buffer_budget(const uint64_t &limit_bytes) : _limit_bytes(limit_bytes) {}
+
+    bool try_acquire(uint64_t bytes)
+    {
+        uint64_t used = _used_bytes.load();
+        do {
+            if (used + bytes > _limit_bytes) {
+                return false;
+            }
+        } while (!_used_bytes.compare_exchange_weak(used, used + bytes));
+        return true;
+    }
+
+    // the caller of a download always holds a buffer, so that it makes progress even if the
+    // budget is used up by the others
+    void acquire(uint64_t bytes) { _used_bytes.fetch_add(bytes); }
+
+    void release(uint64_t bytes) { _used_bytes.fetch_sub(bytes); }
+
+    uint64_t used_bytes() const { return _used_bytes.load(); }
+
+private:
+    const uint64_t &_limit_bytes;
+    std::atomic<uint64_t> _used_bytes{0};
+};
+
+// `read_range(pos, len, buf)` reads exactly `len` bytes at `pos` of the remote file into
+// `buf`, it must be thread safe.
+typedef std::function<error_code(uint64_t pos, uint64_t len, char *buf)> read_range_function;
+
+namespace detail {
+
+struct ranged_download
+{
+    std::string local_file;
+    int fd;
+    uint64_t start_pos;
+    uint64_t length;
+    uint64_t chunk_size;
+    uint64_t chunk_count;
+    read_range_function read_range;
+    download_buffer_budget *budget;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    uint64_t next_chunk{0};
+    uint64_t next_digested_chunk{0};
+    // the chunks being fetched, the local file can't be closed until there are none
+    uint64_t running_chunks{0};
+    error_code err{ERR_OK};
+    utils::md5_digester digester;
+
+    // Fetches the chunks until there are none left or any fails. The buffer must have been
+    // acquired from `budget`, it's released here.
+    void run()
+    {
+        const uint64_t buf_size = std::min(chunk_size, length);
+        std::unique_ptr<char[]> buf;
+        while (true) {
+            uint64_t chunk;
+            {
+                std::lock_guard<std::mutex> l(lock);
+                if (err != ERR_OK || next_chunk == chunk_count) {
+                    break;
+                }
+                chunk = next_chunk++;
+                running_chunks++;
+            }
+            if (buf == nullptr) {
+                buf.reset(new char[buf_size]);
+            }
+
+            const uint64_t offset = chunk * chunk_size;
+            const uint64_t len = std::min(chunk_size, length - offset);
+            error_code ec = read_range(start_pos + offset, len, buf.get());
+            if (ec == ERR_OK) {
+                for (uint64_t written = 0; written < len;) {
+                    ssize_t ret =
+                        ::pwrite(fd, buf.get() + written, len - written, offset + written);
+                    if (ret < 0) {
+                        derror_f("write local file {} failed, err = {}",
+                                 local_file,
+                                 utils::safe_strerror(errno));
+                        ec = ERR_FILE_OPERATION_FAILED;
+                        break;
+                    }
+                    written += ret;
+                }
+            }
+
+            // the digest must be fed in order, wait for the previous chunks, which are all
+            // being fetched by the running workers
+            bool to_digest = false;
+            {
+                std::unique_lock<std::mutex> l(lock);
+                if (ec != ERR_OK) {
+                    err = ec;
+                } else {
+                    cond.wait(l, [&]() { return err != ERR_OK || next_digested_chunk == chunk; });
+                    to_digest = err == ERR_OK;
+                }
+                if (!to_digest) {
+                    running_chunks--;
+                    cond.notify_all();
+                    break;
+                }
+            }
+            digester.update(buf.get(), len);
+            {
+                std::lock_guard<std::mutex> l(lock);
+                next_digested_chunk++;
+                running_chunks--;
+            }
+            cond.notify_all();
+        }
+        budget->release(buf_size);
+    }
+};
+
+} // namespace detail
+
+// Downloads the range [start_pos, start_pos + length) of a remote file into `local_file`,
+// and calculates the md5 of the downloaded data meanwhile, so that the file needn't be read
+// again to verify it.
+//
+// The range is split into chunks of `chunk_size` bytes. The calling thread fetches them, and
+// up to `concurrency - 1` helper tasks of `helper_code` fetch them in parallel, each with a
+// buffer of one chunk acquired from `budget`; no helper is started if the budget is used up.
+// Each chunk is written to its offset of the local file once it's fetched, and then fed to
+// the digest in order.
+//
+// The download never waits for a helper to be scheduled, so it doesn't stall even if the
+// pool of `helper_code` is busy with the other downloads.
+inline error_code download_in_ranges(const std::string &local_file,
+                                     uint64_t start_pos,
+                                     uint64_t length,
+                                     uint64_t chunk_size,
+                                     uint32_t concurrency,
+                                     task_code helper_code,
+                                     download_buffer_budget &budget,
+                                     const read_range_function &read_range,
+                                     /*out*/ std::string &md5)
+{
+    int fd = ::open(local_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        derror_f("open local file {} failed, err = {}", local_file, utils::safe_strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    auto download = std::make_shared<detail::ranged_download>();
+    download->local_file = local_file;
+    download->fd = fd;
+    download->start_pos = start_pos;
+    download->length = length;
+    download->chunk_size = std::max<uint64_t>(chunk_size, 1);
+    download->chunk_count = (length + download->chunk_size - 1) / download->chunk_size;
+    download->read_range = read_range;
+    download->budget = &budget;
+
+    const uint64_t buf_size = std::min(download->chunk_size, length);
+    for (uint64_t i = 1; i < std::min<uint64_t>(concurrency, download->chunk_count); ++i) {
+        if (!budget.try_acquire(buf_size)) {
+            break;
+        }
+        // a helper scheduled after the download finished finds no chunk to fetch
+        tasking::enqueue(helper_code, nullptr, [download]() { download->run(); });
+    }
+    budget.acquire(buf_size);
+    download->run();
+
+    error_code err;
+    {
+        std::unique_lock<std::mutex> l(download->lock);
+        // all the chunks have been claimed, wait for the helpers fetching them
+        download->cond.wait(l, [&]() { return download->running_chunks == 0; });
+        err = download->err;
+    }
+
+    if (::close(fd) != 0 && err == ERR_OK) {
+        derror_f("close local file {} failed, err = {}", local_file, utils::safe_strerror(errno));
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+    if (err == ERR_OK) {
+        md5 = download->digester.finalize();
+    }
+    return err;
+}
+
+} // namespace block_service
+} // namespace dist
+} // namespace dsn
@@ -42,8 +42,9 @@ public:
 public:
     error_code test_download_file(uint64_t &download_size)
     {
+        std::string download_md5;
         return _block_service_manager.download_file(
-            PROVIDER, LOCAL_DIR, FILE_NAME, _fs.get(), download_size);
+            PROVIDER, LOCAL_DIR, FILE_NAME, _fs.get(), download_size, download_md5);
     }
 
     void create_local_file(const std::string &file_name)
@@ -83,8 +84,9 @@ TEST_F(block_service_manager_test, do_download_remote_file_not_exist)
     auto fs = make_unique<local_service>();
     fs->initialize({LOCAL_DIR});
     uint64_t download_size = 0;
+    std::string download_md5;
     error_code err = _block_service_manager.download_file(
-        PROVIDER, LOCAL_DIR, FILE_NAME, fs.get(), download_size);
+        PROVIDER, LOCAL_DIR, FILE_NAME, fs.get(), download_size, download_md5);
     ASSERT_EQ(err, ERR_CORRUPTION); // file does not exist
 }
 
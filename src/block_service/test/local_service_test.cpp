@@ -17,16 +17,56 @@
  * under the License.
  */
 
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
 #include <boost/filesystem.hpp>
 #include <nlohmann/json.hpp>
 
 #include "block_service/local/local_service.h"
+#include "block_service/ranged_download.h"
 
 namespace dsn {
 namespace dist {
 namespace block_service {
 
+DSN_DECLARE_uint64(local_service_download_chunk_size_bytes);
+DSN_DECLARE_uint32(local_service_download_concurrency);
+
+DEFINE_TASK_CODE(LPC_TEST_DOWNLOAD_RANGE, TASK_PRIORITY_COMMON, THREAD_POOL_BLOCK_SERVICE)
+
+static void create_random_file(const std::string &file_name, size_t size)
+{
+    std::mt19937_64 rng(size);
+    std::string data(size, '\0');
+    for (auto &c : data) {
+        c = static_cast<char>(rng());
+    }
+    std::ofstream ofs(file_name, std::ios::binary | std::ios::trunc);
+    ofs.write(data.data(), data.size());
+}
+
+static download_response download_whole_file(local_file_object &file,
+                                              const std::string &target_file)
+{
+    task_tracker tracker;
+    download_response ret;
+    file.download(download_request{target_file, 0, -1},
+                  TASK_CODE_EXEC_INLINED,
+                  [&ret](const download_response &resp) { ret = resp; },
+                  &tracker);
+    tracker.wait_outstanding_tasks();
+    return ret;
+}
+
 // Simple tests for nlohmann::json serialization, via NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE.
 
 TEST(local_service, store_metadata)
@@ -81,6 +121,127 @@ TEST(local_service, load_metadata)
     }
 }
 
+TEST(local_service, download_in_ranges)
+{
+    const std::string src_file = "download_src.txt";
+    const std::string target_file = "download_target.txt";
+    PRESERVE_FLAG(local_service_download_chunk_size_bytes);
+    PRESERVE_FLAG(local_service_download_concurrency);
+    FLAGS_local_service_download_chunk_size_bytes = 4096;
+
+    // the file sizes are chosen to cover the last range being partial or full
+    for (size_t file_size : {0, 100, 4096, 4096 * 10 + 1}) {
+        for (uint32_t concurrency : {1, 3, 16}) {
+            FLAGS_local_service_download_concurrency = concurrency;
+            create_random_file(src_file, file_size);
+            std::string expected_md5;
+            ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(src_file, expected_md5));
+
+            local_file_object file(src_file);
+            ASSERT_EQ(ERR_OK, file.store_metadata());
+            download_response resp = download_whole_file(file, target_file);
+            ASSERT_EQ(ERR_OK, resp.err);
+            ASSERT_EQ(file_size, resp.downloaded_size);
+            ASSERT_EQ(expected_md5, resp.file_md5);
+            ASSERT_EQ(expected_md5, file.get_md5sum());
+
+            std::string target_md5;
+            ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(target_file, target_md5));
+            ASSERT_EQ(expected_md5, target_md5);
+        }
+    }
+
+    utils::filesystem::remove_path(src_file);
+    utils::filesystem::remove_path(local_service::get_metafile(src_file));
+    utils::filesystem::remove_path(target_file);
+}
+
+TEST(local_service, download_buffer_budget)
+{
+    const std::string target_file = "download_target.txt";
+    const uint64_t chunk_size = 4096;
+    const uint64_t length = chunk_size * 64;
+
+    // the helpers fetch the chunks on the pool, and no more than the budget are buffered
+    for (uint64_t limit_chunks : {0, 1, 3}) {
+        uint64_t limit_bytes = chunk_size * limit_chunks;
+        download_buffer_budget budget(limit_bytes);
+        std::atomic<int> reading(0);
+        std::atomic<int> max_reading(0);
+        std::atomic<int> reads_off_caller(0);
+        const auto caller = std::this_thread::get_id();
+        auto read_range = [&](uint64_t pos, uint64_t len, char *buf) {
+            int r = ++reading;
+            for (int m = max_reading.load(); r > m && !max_reading.compare_exchange_weak(m, r);) {
+            }
+            if (std::this_thread::get_id() != caller) {
+                ++reads_off_caller;
+            }
+            memset(buf, static_cast<int>(pos / chunk_size), len);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            --reading;
+            return ERR_OK;
+        };
+
+        std::string md5;
+        ASSERT_EQ(ERR_OK,
+                  download_in_ranges(target_file,
+                                     0,
+                                     length,
+                                     chunk_size,
+                                     16,
+                                     LPC_TEST_DOWNLOAD_RANGE,
+                                     budget,
+                                     read_range,
+                                     md5));
+        ASSERT_LE(max_reading.load(), limit_chunks + 1);
+        ASSERT_EQ(limit_chunks == 0, reads_off_caller.load() == 0);
+
+        std::string target_md5;
+        ASSERT_EQ(ERR_OK, utils::filesystem::md5sum(target_file, target_md5));
+        ASSERT_EQ(target_md5, md5);
+
+        // the helpers scheduled late find nothing to fetch, and release their buffers
+        for (int i = 0; i < 1000 && budget.used_bytes() != 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(0u, budget.used_bytes());
+    }
+
+    utils::filesystem::remove_path(target_file);
+}
+
+// run it with --gtest_also_run_disabled_tests
+TEST(local_service, DISABLED_download_benchmark)
+{
+    const std::string src_file = "benchmark_src.txt";
+    const std::string target_file = "benchmark_target.txt";
+    const size_t file_size = 256 << 20;
+    PRESERVE_FLAG(local_service_download_concurrency);
+
+    create_random_file(src_file, file_size);
+    local_file_object file(src_file);
+    ASSERT_EQ(ERR_OK, file.store_metadata());
+    for (uint32_t concurrency : {1, 2, 4, 8}) {
+        FLAGS_local_service_download_concurrency = concurrency;
+        utils::filesystem::remove_path(target_file);
+
+        uint64_t start = dsn_now_ns();
+        download_response resp = download_whole_file(file, target_file);
+        uint64_t elapsed_ns = dsn_now_ns() - start;
+        ASSERT_EQ(ERR_OK, resp.err);
+        ASSERT_EQ(file_size, resp.downloaded_size);
+        std::cout << "download " << (file_size >> 20) << "MB with md5, concurrency = "
+                  << concurrency << ", chunk size = "
+                  << (FLAGS_local_service_download_chunk_size_bytes >> 20)
+                  << "MB: " << (file_size >> 20) * 1e9 / elapsed_ns << "MB/s" << std::endl;
+    }
+
+    utils::filesystem::remove_path(src_file);
+    utils::filesystem::remove_path(local_service::get_metafile(src_file));
+    utils::filesystem::remove_path(target_file);
+}
+
 } // namespace block_service
 } // namespace dist
 } // namespace dsn
@@ -158,6 +158,11 @@ struct learn_request
     // be duplicated (ie. max_gced_decree < confirmed_decree), if not,
     // learnee will copy the missing logs.
     7:optional i64        max_gced_decree;
+
+    // The files the learner already has under its data dir, with the paths relative
+    // to the data dir and the sizes (md5 is not set). The learnee uses them to find
+    // the learned files which the learner can reuse instead of copying.
+    8:optional list<metadata.file_meta> local_files;
 }
 
 struct learn_response
@@ -170,6 +175,11 @@ struct learn_response
     6:learn_state           state; // learning data, including memory data and files
     7:dsn.rpc_address       address; // learnee's address
     8:string                base_local_dir; // base dir of files on learnee
+
+    // The files in state.files (key) which probably have the same content as a file the
+    // learner already has (value: the learner's file with the md5 of the learnee's file).
+    // The learner links these files if the md5 matches, rather than copying them.
+    9:optional map<string, metadata.file_meta> reusable_files;
 }
 
 struct learn_notify_response
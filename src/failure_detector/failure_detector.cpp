@@ -35,6 +35,7 @@
 
 #include <dsn/dist/failure_detector.h>
 #include <dsn/tool-api/command_manager.h>
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 
@@ -53,6 +54,8 @@ failure_detector::failure_detector()
         COUNTER_TYPE_VOLATILE_NUMBER,
         "failure detector beacon fail count in the recent period");
 
+    _check_interval_milliseconds = 0;
+    _grace_milliseconds = 0;
     _is_started = false;
 }
 
@@ -116,7 +119,11 @@ void failure_detector::stop()
     }
     _is_started = false;
     _masters.clear();
-    _workers.clear();
+    for (auto &shard : _worker_shards) {
+        zauto_lock sl(shard.lock);
+        shard.workers.clear();
+        shard.expire_slots.clear();
+    }
 }
 
 void failure_detector::register_master(::dsn::rpc_address target)
@@ -277,24 +284,42 @@ void failure_detector::check_all_records()
 
         uint64_t now = dsn_now_ms();
 
-        for (auto itq = _workers.begin(); itq != _workers.end(); itq++) {
-            worker_record &record = itq->second;
-
-            // we should ensure now is greater than record.last_beacon_recv_time to aviod integer
-            // overflow
-            if (record.is_alive && is_time_greater_than(now, record.last_beacon_recv_time) &&
-                now - record.last_beacon_recv_time > _grace_milliseconds) {
-                derror("worker %s disconnected, now=%" PRId64 ", last_beacon_recv_time=%" PRId64
-                       ", now-last_recv=%" PRId64,
-                       record.node.to_string(),
-                       now,
-                       record.last_beacon_recv_time,
-                       now - record.last_beacon_recv_time);
-
-                expire.push_back(record.node);
-                record.is_alive = false;
-
-                report(record.node, false, false);
+        for (auto &shard : _worker_shards) {
+            zauto_lock sl(shard.lock);
+            while (!shard.expire_slots.empty() && shard.expire_slots.begin()->first <= now) {
+                uint64_t slot = shard.expire_slots.begin()->first;
+                std::vector<rpc_address> nodes = std::move(shard.expire_slots.begin()->second);
+                shard.expire_slots.erase(shard.expire_slots.begin());
+
+                for (const rpc_address &node : nodes) {
+                    // skip the workers unregistered, disconnected or moved to another slot
+                    auto itq = shard.workers.find(node);
+                    if (itq == shard.workers.end() || !itq->second.is_alive ||
+                        itq->second.expire_slot != slot) {
+                        continue;
+                    }
+                    worker_record &record = itq->second;
+
+                    // we should ensure now is greater than record.last_beacon_recv_time to aviod
+                    // integer overflow
+                    if (is_time_greater_than(now, record.last_beacon_recv_time) &&
+                        now - record.last_beacon_recv_time > _grace_milliseconds) {
+                        derror("worker %s disconnected, now=%" PRId64
+                               ", last_beacon_recv_time=%" PRId64 ", now-last_recv=%" PRId64,
+                               record.node.to_string(),
+                               now,
+                               record.last_beacon_recv_time,
+                               now - record.last_beacon_recv_time);
+
+                        expire.push_back(record.node);
+                        record.is_alive = false;
+
+                        report(record.node, false, false);
+                    } else {
+                        // refreshed by the beacons since scheduled
+                        schedule_expire(shard, record);
+                    }
+                }
             }
         }
         /*
@@ -306,6 +331,19 @@ void failure_detector::check_all_records()
     }
 }
 
+failure_detector::worker_shard &failure_detector::get_worker_shard(::dsn::rpc_address node) const
+{
+    return _worker_shards[std::hash<::dsn::rpc_address>()(node) % kWorkerShards];
+}
+
+void failure_detector::schedule_expire(worker_shard &shard, worker_record &record)
+{
+    // the first slot after the worker expires, which is always after now for an alive worker
+    uint64_t width = std::max(_check_interval_milliseconds, 1u);
+    record.expire_slot = ((record.last_beacon_recv_time + _grace_milliseconds) / width + 1) * width;
+    shard.expire_slots[record.expire_slot].push_back(record.node);
+}
+
 void failure_detector::add_allow_list(::dsn::rpc_address node)
 {
     zauto_lock l(_lock);
@@ -361,45 +399,71 @@ void failure_detector::on_ping_internal(const beacon_msg &beacon, /*out*/ beacon
     ack.is_master = true;
     ack.allowed = true;
 
-    zauto_lock l(_lock);
-
     uint64_t now = dsn_now_ms();
     auto node = beacon.from_addr;
+    worker_shard &shard = get_worker_shard(node);
 
-    worker_map::iterator itr = _workers.find(node);
-    if (itr == _workers.end()) {
-        // if is a new worker, check allow list first if need
-        if (_use_allow_list && _allow_list.find(node) == _allow_list.end()) {
-            dwarn("new worker[%s] is rejected", node.to_string());
-            ack.allowed = false;
+    // the beacon from an alive worker only refreshes its record, with only its shard locked
+    {
+        zauto_lock sl(shard.lock);
+        worker_map::iterator itr = shard.workers.find(node);
+        if (itr != shard.workers.end() && itr->second.is_alive) {
+            if (is_time_greater_than(now, itr->second.last_beacon_recv_time)) {
+                itr->second.last_beacon_recv_time = now;
+                ddebug("master %s update last_beacon_recv_time=%" PRId64,
+                       itr->second.node.to_string(),
+                       itr->second.last_beacon_recv_time);
+            } else {
+                ddebug("now[%" PRId64 "] <= last_recv_time[%" PRId64 "]",
+                       now,
+                       itr->second.last_beacon_recv_time);
+            }
             return;
         }
+    }
 
-        // create new entry for node
-        worker_record record(node, now);
-        record.is_alive = true;
-        _workers.insert(std::make_pair(node, record));
-
-        report(node, false, true);
-        on_worker_connected(node);
-    } else if (is_time_greater_than(now, itr->second.last_beacon_recv_time)) {
-        // update last_beacon_recv_time
-        itr->second.last_beacon_recv_time = now;
-
-        ddebug("master %s update last_beacon_recv_time=%" PRId64,
-               itr->second.node.to_string(),
-               itr->second.last_beacon_recv_time);
+    zauto_lock l(_lock);
 
-        if (itr->second.is_alive == false) {
-            itr->second.is_alive = true;
+    bool connected = false;
+    {
+        zauto_lock sl(shard.lock);
+        worker_map::iterator itr = shard.workers.find(node);
+        if (itr == shard.workers.end()) {
+            // if is a new worker, check allow list first if need
+            if (_use_allow_list && _allow_list.find(node) == _allow_list.end()) {
+                dwarn("new worker[%s] is rejected", node.to_string());
+                ack.allowed = false;
+                return;
+            }
 
-            report(node, false, true);
-            on_worker_connected(node);
+            // create new entry for node
+            itr = shard.workers.insert(std::make_pair(node, worker_record(node, now))).first;
+            schedule_expire(shard, itr->second);
+            connected = true;
+        } else if (is_time_greater_than(now, itr->second.last_beacon_recv_time)) {
+            // update last_beacon_recv_time
+            itr->second.last_beacon_recv_time = now;
+
+            ddebug("master %s update last_beacon_recv_time=%" PRId64,
+                   itr->second.node.to_string(),
+                   itr->second.last_beacon_recv_time);
+
+            if (itr->second.is_alive == false) {
+                itr->second.is_alive = true;
+                schedule_expire(shard, itr->second);
+                connected = true;
+            }
+        } else {
+            ddebug("now[%" PRId64 "] <= last_recv_time[%" PRId64 "]",
+                   now,
+                   itr->second.last_beacon_recv_time);
         }
-    } else {
-        ddebug("now[%" PRId64 "] <= last_recv_time[%" PRId64 "]",
-               now,
-               itr->second.last_beacon_recv_time);
+    }
+
+    // the callbacks may visit the shard, so they are called with only `_lock` held
+    if (connected) {
+        report(node, false, true);
+        on_worker_connected(node);
     }
 }
 
@@ -528,8 +592,13 @@ void failure_detector::register_worker(::dsn::rpc_address target, bool is_connec
     worker_record record(target, dsn_now_ms());
     record.is_alive = is_connected ? true : false;
 
-    auto ret = _workers.insert(std::make_pair(target, record));
+    worker_shard &shard = get_worker_shard(target);
+    zauto_lock sl(shard.lock);
+    auto ret = shard.workers.insert(std::make_pair(target, record));
     if (ret.second) {
+        if (record.is_alive) {
+            schedule_expire(shard, ret.first->second);
+        }
         dinfo("register worker[%s] successfully", target.to_string());
     } else {
         dinfo("worker[%s] already registered", target.to_string());
@@ -543,7 +612,13 @@ bool failure_detector::unregister_worker(::dsn::rpc_address node)
      */
     bool ret;
 
-    size_t count = _workers.erase(node);
+    // the slot of the worker is skipped once it's unregistered
+    worker_shard &shard = get_worker_shard(node);
+    size_t count;
+    {
+        zauto_lock sl(shard.lock);
+        count = shard.workers.erase(node);
+    }
 
     if (count == 0) {
         ret = false;
@@ -561,19 +636,34 @@ bool failure_detector::unregister_worker(::dsn::rpc_address node)
 void failure_detector::clear_workers()
 {
     zauto_lock l(_lock);
-    _workers.clear();
+    for (auto &shard : _worker_shards) {
+        zauto_lock sl(shard.lock);
+        shard.workers.clear();
+        shard.expire_slots.clear();
+    }
 }
 
 bool failure_detector::is_worker_connected(::dsn::rpc_address node) const
 {
-    zauto_lock l(_lock);
-    auto it = _workers.find(node);
-    if (it != _workers.end())
+    worker_shard &shard = get_worker_shard(node);
+    zauto_lock sl(shard.lock);
+    auto it = shard.workers.find(node);
+    if (it != shard.workers.end())
         return it->second.is_alive;
     else
         return false;
 }
 
+int failure_detector::worker_count() const
+{
+    size_t count = 0;
+    for (auto &shard : _worker_shards) {
+        zauto_lock sl(shard.lock);
+        count += shard.workers.size();
+    }
+    return static_cast<int>(count);
+}
+
 void failure_detector::send_beacon(::dsn::rpc_address target, uint64_t time)
 {
     beacon_msg beacon;
@@ -4,6 +4,9 @@
 
 #include <gtest/gtest.h>
 #include <dsn/service_api_cpp.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
 #include <vector>
 
 using namespace dsn;
@@ -695,3 +698,121 @@ TEST(fd, not_in_whitelist)
 
     ASSERT_TRUE(spin_wait_condition([&wait_count] { return wait_count == 1; }, 20));
 }
+
+namespace dsn {
+namespace fd {
+
+class failure_detector_sim_test : public testing::Test
+{
+public:
+    class sim_failure_detector : public failure_detector
+    {
+    public:
+        void on_master_disconnected(const std::vector<rpc_address> &) override {}
+        void on_master_connected(rpc_address) override {}
+        void on_worker_disconnected(const std::vector<rpc_address> &nodes) override
+        {
+            disconnected_count += nodes.size();
+        }
+        void on_worker_connected(rpc_address) override { ++connected_count; }
+
+        int connected_count = 0;
+        int disconnected_count = 0;
+    };
+
+    void ping(failure_detector &fd, const std::vector<rpc_address> &workers)
+    {
+        for (const rpc_address &worker : workers) {
+            beacon_msg beacon;
+            beacon.time = dsn_now_ms();
+            beacon.from_addr = worker;
+            beacon.to_addr = dsn_primary_address();
+            beacon_ack ack;
+            fd.on_ping_internal(beacon, ack);
+        }
+    }
+
+    void test_sharded_workers()
+    {
+        const int worker_count = 5000;
+        std::vector<rpc_address> even_workers, odd_workers;
+        for (int i = 0; i < worker_count; ++i) {
+            rpc_address worker(0x0a000000 + i, 34801);
+            (i % 2 == 0 ? even_workers : odd_workers).push_back(worker);
+        }
+
+        sim_failure_detector sim;
+        failure_detector &fd = sim;
+        fd._check_interval_milliseconds = 100;
+        fd._grace_milliseconds = 1000;
+        fd._use_allow_list = false;
+        fd._is_started = true;
+
+        // all the workers are connected by their first beacons
+        ping(fd, even_workers);
+        ping(fd, odd_workers);
+        ASSERT_EQ(worker_count, sim.connected_count);
+        ASSERT_EQ(worker_count, fd.worker_count());
+
+        // only the even workers keep sending beacons, the odd ones expire after the grace period
+        for (int round = 0; round < 15; ++round) {
+            ping(fd, even_workers);
+            fd.check_all_records();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        fd.check_all_records();
+        ASSERT_EQ(worker_count / 2, sim.disconnected_count);
+        for (int i = 0; i < worker_count / 2; ++i) {
+            ASSERT_TRUE(fd.is_worker_connected(even_workers[i]));
+            ASSERT_FALSE(fd.is_worker_connected(odd_workers[i]));
+        }
+
+        // the odd workers are connected again by their beacons
+        ping(fd, odd_workers);
+        ASSERT_EQ(worker_count + worker_count / 2, sim.connected_count);
+        fd.check_all_records();
+        ASSERT_EQ(worker_count / 2, sim.disconnected_count);
+    }
+
+    // prints the cost to handle a beacon and to check all the records
+    void bench_sharded_workers()
+    {
+        const int worker_count = 5000;
+        const int rounds = 15;
+        std::vector<rpc_address> workers;
+        for (int i = 0; i < worker_count; ++i) {
+            workers.emplace_back(0x0a000000 + i, 34801);
+        }
+
+        sim_failure_detector sim;
+        failure_detector &fd = sim;
+        fd._check_interval_milliseconds = 100;
+        fd._grace_milliseconds = 1000;
+        fd._use_allow_list = false;
+        fd._is_started = true;
+        ping(fd, workers);
+
+        uint64_t beacon_ns = 0, check_ns = 0;
+        for (int round = 0; round < rounds; ++round) {
+            uint64_t start = dsn_now_ns();
+            ping(fd, workers);
+            beacon_ns += dsn_now_ns() - start;
+
+            start = dsn_now_ns();
+            fd.check_all_records();
+            check_ns += dsn_now_ns() - start;
+        }
+        ASSERT_EQ(0, sim.disconnected_count);
+
+        std::cout << worker_count << " workers: " << beacon_ns / (rounds * worker_count)
+                  << "ns per beacon, " << check_ns / rounds / 1000 << "us per check" << std::endl;
+    }
+};
+
+TEST_F(failure_detector_sim_test, sharded_workers) { test_sharded_workers(); }
+
+// run it with --gtest_also_run_disabled_tests
+TEST_F(failure_detector_sim_test, DISABLED_sharded_workers_benchmark) { bench_sharded_workers(); }
+
+} // namespace fd
+} // namespace dsn
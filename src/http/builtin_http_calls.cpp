@@ -92,6 +92,11 @@ namespace dsn {
         })
         .with_help("Gets the value of a perf counter");
 
+    register_http_call("metrics")
+        .with_callback(
+            [](const http_request &req, http_response &resp) { get_metrics_handler(req, resp); })
+        .with_help("Gets all the perf counters in the OpenMetrics text format");
+
     register_http_call("updateConfig")
         .with_callback(
             [](const http_request &req, http_response &resp) { update_config(req, resp); })
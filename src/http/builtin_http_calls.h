@@ -28,6 +28,10 @@ extern void register_builtin_http_calls();
 
 extern void get_perf_counter_handler(const http_request &req, http_response &resp);
 
+// Get <ipport>/metrics
+// Exposes all the perf counters in the OpenMetrics text format.
+extern void get_metrics_handler(const http_request &req, http_response &resp);
+
 extern void get_help_handler(const http_request &req, http_response &resp);
 
 // Get <meta_server_ipport>/version
@@ -42,6 +42,18 @@ void get_perf_counter_handler(const http_request &req, http_response &resp)
         if (COUNTER_TYPE_NUMBER_PERCENTILES == perf_counter->type()) {
             tp.add_row_name_and_data("p99", perf_counter->get_percentile(COUNTER_PERCENTILE_99));
             tp.add_row_name_and_data("p999", perf_counter->get_percentile(COUNTER_PERCENTILE_999));
+            perf_counter::histogram_t buckets;
+            if (perf_counter->get_histogram(buckets)) {
+                // "<upper bound>:<count>,...", to be merged with the ones of the other nodes
+                std::string buckets_str;
+                for (const auto &b : buckets) {
+                    if (!buckets_str.empty()) {
+                        buckets_str.push_back(',');
+                    }
+                    buckets_str += std::to_string(b.first) + ":" + std::to_string(b.second);
+                }
+                tp.add_row_name_and_data("buckets", buckets_str);
+            }
         } else {
             tp.add_row_name_and_data("value", perf_counter->get_value());
         }
@@ -54,4 +66,16 @@ void get_perf_counter_handler(const http_request &req, http_response &resp)
     resp.body = out.str();
     resp.status_code = http_status_code::ok;
 }
+
+void get_metrics_handler(const http_request &req, http_response &resp)
+{
+    if (!req.query_args.empty()) {
+        resp.status_code = http_status_code::bad_request;
+        return;
+    }
+
+    perf_counters::instance().render_open_metrics(resp.body);
+    resp.content_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    resp.status_code = http_status_code::ok;
+}
 } // namespace dsn
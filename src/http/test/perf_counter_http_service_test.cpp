@@ -15,7 +15,10 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <sstream>
 #include <gtest/gtest.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/perf_counter/perf_counters.h>
 #include <dsn/http/http_server.h>
 
@@ -70,4 +73,68 @@ TEST(perf_counter_http_service_test, get_perf_counter)
         ASSERT_EQ(fake_resp.body, fake_json);
     }
 }
+
+TEST(perf_counter_http_service_test, get_metrics)
+{
+    perf_counter_wrapper number;
+    number.init_global_counter(
+        "replica", "http.metrics", "write.count@1.3", COUNTER_TYPE_NUMBER, "writes");
+    number->set(42);
+    perf_counter_wrapper number2;
+    number2.init_global_counter(
+        "replica", "http.metrics", "write.count@1.4", COUNTER_TYPE_NUMBER, "writes");
+    number2->set(7);
+    perf_counter_wrapper entity;
+    entity.init_global_counter(
+        "replica", "http.metrics", "write.count@temp", COUNTER_TYPE_NUMBER, "writes");
+    perf_counter_wrapper percentile;
+    percentile.init_global_counter("replica",
+                                   "http.metrics",
+                                   "write.latency(ns)",
+                                   COUNTER_TYPE_NUMBER_PERCENTILES,
+                                   "latency \"of\" writes");
+
+    http_request fake_req;
+    http_response fake_resp;
+    get_metrics_handler(fake_req, fake_resp);
+    ASSERT_EQ(http_status_code::ok, fake_resp.status_code);
+    ASSERT_EQ("application/openmetrics-text; version=1.0.0; charset=utf-8",
+              fake_resp.content_type);
+
+    const std::string &body = fake_resp.body;
+    ASSERT_NE(std::string::npos,
+              body.find("# TYPE write_count gauge\n"
+                        "# HELP write_count writes\n"
+                        "write_count{"));
+    ASSERT_NE(std::string::npos,
+              body.find("write_count{app=\"replica\",section=\"http.metrics\",gpid=\"1.3\"} 42\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("write_count{app=\"replica\",section=\"http.metrics\",gpid=\"1.4\"} 7\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("write_count{app=\"replica\",section=\"http.metrics\","
+                        "entity=\"temp\"} 0\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("# TYPE write_latency_ns_ summary\n"
+                        "# HELP write_latency_ns_ latency \"of\" writes\n"));
+    ASSERT_NE(std::string::npos,
+              body.find("write_latency_ns_{app=\"replica\",section=\"http.metrics\","
+                        "quantile=\"0.999\"} 0\n"));
+
+    // the metric families are contiguous
+    std::vector<std::string> families;
+    std::istringstream in(body);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 7, "# TYPE ") == 0) {
+            families.push_back(line.substr(7, line.find(' ', 7) - 7));
+        }
+    }
+    std::sort(families.begin(), families.end());
+    ASSERT_EQ(families.end(), std::adjacent_find(families.begin(), families.end()));
+    ASSERT_EQ("# EOF\n", body.substr(body.size() - 6));
+
+    fake_req.query_args.emplace("name", "write.count");
+    get_metrics_handler(fake_req, fake_resp);
+    ASSERT_EQ(http_status_code::bad_request, fake_resp.status_code);
+}
 } // namespace dsn
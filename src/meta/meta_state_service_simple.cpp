@@ -37,13 +37,26 @@
 #include "meta_state_service_simple.h"
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/utility/crc.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/safe_strerror_posix.h>
 
+#include <cinttypes>
+#include <fcntl.h>
 #include <stack>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utility>
 
 namespace dsn {
 namespace dist {
+DSN_DEFINE_uint64("meta_server",
+                  meta_state_service_simple_log_compaction_threshold_kb,
+                  64 * 1024,
+                  "the log size (KB) of the simple meta state service to write a snapshot and "
+                  "start a new log, 0 means never");
+
 // path: /, /n1/n2, /n1/n2/, /n2/n2/n3
 std::string meta_state_service_simple::normalize_path(const std::string &s)
 {
@@ -82,6 +95,7 @@ void meta_state_service_simple::write_log(blob &&log_blob,
                                           task_ptr task)
 {
     _log_lock.lock();
+    compact_log_if_needed();
     uint64_t log_offset = _offset;
     _offset += log_blob.length();
     auto continuation_task = std::unique_ptr<operation>(new operation(false, [=](bool log_succeed) {
@@ -90,9 +104,10 @@ void meta_state_service_simple::write_log(blob &&log_blob,
     }));
     auto continuation_task_ptr = continuation_task.get();
     _task_queue.emplace(move(continuation_task));
+    disk_file *log = _log;
     _log_lock.unlock();
 
-    file::write(_log,
+    file::write(log,
                 log_blob.data(),
                 log_blob.length(),
                 log_offset,
@@ -110,6 +125,7 @@ void meta_state_service_simple::write_log(blob &&log_blob,
                         _task_queue.front()->cb(true);
                         _task_queue.pop();
                     }
+                    compact_log_if_needed();
                     _log_lock.unlock();
                 });
 }
@@ -230,67 +246,291 @@ error_code meta_state_service_simple::apply_transaction(
     return ERR_OK;
 }
 
-error_code meta_state_service_simple::initialize(const std::vector<std::string> &args)
+std::string meta_state_service_simple::log_path(uint64_t log_id) const
+{
+    std::string path = utils::filesystem::path_combine(_work_dir, "meta_state_service.log");
+    return log_id == 0 ? path : path + "." + std::to_string(log_id);
+}
+
+std::string meta_state_service_simple::snapshot_path() const
+{
+    return utils::filesystem::path_combine(_work_dir, "meta_state_service.snapshot");
+}
+
+error_code meta_state_service_simple::load_snapshot()
 {
-    const char *work_dir =
-        args.empty() ? service_app::current_service_app_info().data_dir.c_str() : args[0].c_str();
+    std::string path = snapshot_path();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        derror("open snapshot %s failed, err = %s",
+               path.c_str(),
+               utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(snapshot_header))) {
+        derror("invalid snapshot %s", path.c_str());
+        ::close(fd);
+        return ERR_FILE_OPERATION_FAILED;
+    }
 
+    // the data of the nodes refer to the mapped snapshot rather than being copied, the mapping
+    // is released once all of them are overwritten or deleted
+    size_t size = st.st_size;
+    void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        derror("mmap snapshot %s failed, err = %s",
+               path.c_str(),
+               utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    std::shared_ptr<char> mapped(static_cast<char *>(addr),
+                                 [size](char *p) { ::munmap(p, size); });
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+
+    const auto *header = reinterpret_cast<const snapshot_header *>(addr);
+    blob body(mapped, sizeof(snapshot_header), size - sizeof(snapshot_header));
+    // the snapshot is renamed into place only after being written completely, so it's
+    // unacceptable to be corrupted, the same as the log
+    dassert(header->magic == snapshot_header::default_magic &&
+                header->body_crc == utils::crc32_calc(body.data(), body.length(), 0),
+            "meta state server snapshot corrupted");
+
+    binary_reader reader(body);
+    for (uint64_t i = 0; i < header->node_count; ++i) {
+        std::string node;
+        blob data;
+        reader.read(node);
+        reader.read(data);
+        if (node == "/") {
+            _root.data = data;
+        } else {
+            error_code err = create_node_internal(node, data);
+            dassert(err == ERR_OK,
+                    "load %s from snapshot failed, err = %s",
+                    node.c_str(),
+                    err.to_string());
+        }
+    }
+    _log_id = header->log_id;
+    ddebug("loaded %" PRIu64 " nodes from snapshot %s, log id = %" PRIu64,
+           header->node_count,
+           path.c_str(),
+           _log_id);
+    return ERR_OK;
+}
+
+void meta_state_service_simple::replay_log(const std::string &log_path)
+{
+    FILE *fd = fopen(log_path.c_str(), "rb");
+    if (fd == nullptr) {
+        return;
+    }
+    for (;;) {
+        log_header header;
+        if (fread(&header, sizeof(log_header), 1, fd) != 1) {
+            break;
+        }
+        if (header.magic != log_header::default_magic) {
+            break;
+        }
+        std::shared_ptr<char> buffer(dsn::utils::make_shared_array<char>(header.size));
+        if (fread(buffer.get(), header.size, 1, fd) != 1) {
+            break;
+        }
+        _offset += sizeof(header) + header.size;
+        binary_reader reader(blob(buffer, (int)header.size));
+        int op_type;
+        reader.read(op_type);
+
+        switch (static_cast<operation_type>(op_type)) {
+        case operation_type::create_node: {
+            std::string node;
+            blob data;
+            create_node_log::parse(reader, node, data);
+            create_node_internal(node, data);
+            break;
+        }
+        case operation_type::delete_node: {
+            std::string node;
+            bool recursively_delete;
+            delete_node_log::parse(reader, node, recursively_delete);
+            delete_node_internal(node, recursively_delete);
+            break;
+        }
+        case operation_type::set_data: {
+            std::string node;
+            blob data;
+            set_data_log::parse(reader, node, data);
+            set_data_internal(node, data);
+            break;
+        }
+        default:
+            // The log is complete but its content is modified by cosmic ray. This is
+            // unacceptable
+            dassert(false, "meta state server log corrupted");
+        }
+    }
+    fclose(fd);
+}
+
+void meta_state_service_simple::remove_obsolete_logs(uint64_t log_id)
+{
+    // each compaction removes the logs before it, so the obsolete logs left by an exit during
+    // compaction are right before `log_id`
+    for (uint64_t id = log_id; id > 0; --id) {
+        std::string path = log_path(id - 1);
+        if (!utils::filesystem::file_exists(path)) {
+            break;
+        }
+        if (!utils::filesystem::remove_path(path)) {
+            dwarn("remove obsolete log %s failed", path.c_str());
+            break;
+        }
+    }
+}
+
+error_code meta_state_service_simple::write_snapshot(uint64_t log_id,
+                                                     const std::vector<snapshot_node> &nodes)
+{
+    snapshot_header header;
+    header.log_id = log_id;
+    header.node_count = nodes.size();
+
+    binary_writer writer;
+    for (const auto &node : nodes) {
+        writer.write(node.first);
+        writer.write(node.second);
+    }
+    blob body = writer.get_buffer();
+    header.body_crc = utils::crc32_calc(body.data(), body.length(), 0);
+
+    std::string path = snapshot_path();
+    std::string tmp_path = path + ".tmp";
+    FILE *fd = fopen(tmp_path.c_str(), "wb");
+    if (fd == nullptr) {
+        derror("create %s failed, err = %s", tmp_path.c_str(), utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fd) == 1 &&
+              (body.length() == 0 || fwrite(body.data(), body.length(), 1, fd) == 1) &&
+              fflush(fd) == 0 && fsync(fileno(fd)) == 0;
+    fclose(fd);
+    if (!ok || !utils::filesystem::rename_path(tmp_path, path)) {
+        derror("write snapshot %s failed", path.c_str());
+        utils::filesystem::remove_path(tmp_path);
+        return ERR_FILE_OPERATION_FAILED;
+    }
+
+    // the rename must be durable before the logs it replaces are removed
+    int dir_fd = ::open(_work_dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0 || ::fsync(dir_fd) != 0) {
+        derror("sync directory %s failed, err = %s",
+               _work_dir.c_str(),
+               utils::safe_strerror(errno).c_str());
+        if (dir_fd >= 0) {
+            ::close(dir_fd);
+        }
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    ::close(dir_fd);
+
+    ddebug("written %" PRIu64 " nodes to snapshot %s, log id = %" PRIu64,
+           header.node_count,
+           path.c_str(),
+           log_id);
+    return ERR_OK;
+}
+
+void meta_state_service_simple::compact_log_if_needed()
+{
+    uint64_t threshold = FLAGS_meta_state_service_simple_log_compaction_threshold_kb * 1024;
+    if (threshold == 0 || _offset < _next_compaction_offset || !_task_queue.empty() ||
+        _compacting.load()) {
+        return;
+    }
+
+    // all the logged operations have been applied to the tree, and no more can be logged
+    // until the new log is opened
+    uint64_t next_log_id = _log_id + 1;
+    std::string path = log_path(next_log_id);
+    disk_file *next_log = file::open(path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+    if (next_log == nullptr) {
+        derror("open file failed: %s", path.c_str());
+        _next_compaction_offset = _offset + threshold;
+        return;
+    }
+
+    // parents are collected before their children, so that they can be created in order.
+    // the data are shared rather than copied, and serialized out of the locks
+    auto nodes = std::make_shared<std::vector<snapshot_node>>();
+    {
+        zauto_lock _(_state_lock);
+        nodes->reserve(_quick_map.size());
+        std::stack<std::pair<std::string, const state_node *>> stack;
+        stack.push({"/", &_root});
+        while (!stack.empty()) {
+            auto top = std::move(stack.top());
+            stack.pop();
+            nodes->emplace_back(top.first, top.second->data);
+            for (const auto &kv : top.second->children) {
+                stack.push({top.first == "/" ? "/" + kv.first : top.first + "/" + kv.first,
+                            kv.second});
+            }
+        }
+    }
+
+    // the new log is replayed after the old ones until the snapshot is written
+    file::close(_log);
+    _log = next_log;
+    _log_id = next_log_id;
     _offset = 0;
-    std::string log_path = dsn::utils::filesystem::path_combine(work_dir, "meta_state_service.log");
-    if (utils::filesystem::file_exists(log_path)) {
-        if (FILE *fd = fopen(log_path.c_str(), "rb")) {
-            for (;;) {
-                log_header header;
-                if (fread(&header, sizeof(log_header), 1, fd) != 1) {
-                    break;
-                }
-                if (header.magic != log_header::default_magic) {
-                    break;
-                }
-                std::shared_ptr<char> buffer(dsn::utils::make_shared_array<char>(header.size));
-                if (fread(buffer.get(), header.size, 1, fd) != 1) {
-                    break;
-                }
-                _offset += sizeof(header) + header.size;
-                binary_reader reader(blob(buffer, (int)header.size));
-                int op_type;
-                reader.read(op_type);
-
-                switch (static_cast<operation_type>(op_type)) {
-                case operation_type::create_node: {
-                    std::string node;
-                    blob data;
-                    create_node_log::parse(reader, node, data);
-                    create_node_internal(node, data);
-                    break;
-                }
-                case operation_type::delete_node: {
-                    std::string node;
-                    bool recursively_delete;
-                    delete_node_log::parse(reader, node, recursively_delete);
-                    delete_node_internal(node, recursively_delete);
-                    break;
-                }
-                case operation_type::set_data: {
-                    std::string node;
-                    blob data;
-                    set_data_log::parse(reader, node, data);
-                    set_data_internal(node, data);
-                    break;
-                }
-                default:
-                    // The log is complete but its content is modified by cosmic ray. This is
-                    // unacceptable
-                    dassert(false, "meta state server log corrupted");
-                }
+    _next_compaction_offset = threshold;
+
+    _compacting.store(true);
+    tasking::enqueue(
+        LPC_META_STATE_SERVICE_SIMPLE_INTERNAL, &_tracker, [this, next_log_id, nodes]() {
+            // the old logs are kept if the snapshot fails, they are replayed on restart
+            if (write_snapshot(next_log_id, *nodes) == ERR_OK) {
+                remove_obsolete_logs(next_log_id);
             }
-            fclose(fd);
+            _compacting.store(false);
+        });
+}
+
+error_code meta_state_service_simple::initialize(const std::vector<std::string> &args)
+{
+    _work_dir = args.empty() ? service_app::current_service_app_info().data_dir : args[0];
+
+    _log_id = 0;
+    _offset = 0;
+    if (utils::filesystem::file_exists(snapshot_path())) {
+        error_code err = load_snapshot();
+        if (err != ERR_OK) {
+            return err;
         }
     }
+    remove_obsolete_logs(_log_id);
+    utils::filesystem::remove_path(snapshot_path() + ".tmp");
+
+    // the logs after the one the snapshot is checkpointed at are left by an exit before the
+    // snapshot of a compaction is written
+    std::string path = log_path(_log_id);
+    if (utils::filesystem::file_exists(path)) {
+        replay_log(path);
+    }
+    while (utils::filesystem::file_exists(log_path(_log_id + 1))) {
+        ++_log_id;
+        _offset = 0;
+        path = log_path(_log_id);
+        replay_log(path);
+    }
+    _next_compaction_offset = FLAGS_meta_state_service_simple_log_compaction_threshold_kb * 1024;
 
-    _log = file::open(log_path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+    _log = file::open(path.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
     if (!_log) {
-        derror("open file failed: %s", log_path.c_str());
+        derror("open file failed: %s", path.c_str());
         return ERR_FILE_OPERATION_FAILED;
     }
     return ERR_OK;
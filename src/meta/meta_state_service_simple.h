@@ -33,17 +33,26 @@
  *     2015-11-11, Tianyi WANG, first version done
  */
 
+#include <atomic>
 #include <queue>
+#include <vector>
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/dist/meta_state_service.h>
+#include <dsn/utility/flags.h>
 #include "common/replication_common.h"
 
 namespace dsn {
 namespace dist {
+DSN_DECLARE_uint64(meta_state_service_simple_log_compaction_threshold_kb);
+
 DEFINE_TASK_CODE_AIO(LPC_META_STATE_SERVICE_SIMPLE_INTERNAL,
                      TASK_PRIORITY_HIGH,
                      THREAD_POOL_DEFAULT);
 
+// All the operations are appended to a log, which is replayed on restart. Once the log grows
+// beyond `meta_state_service_simple_log_compaction_threshold_kb`, the whole tree is written
+// to a snapshot which is checkpointed at a new log, then the old logs are removed. Thus the
+// restart only loads the snapshot (by mmap) and replays the logs written after it.
 class meta_state_service_simple : public meta_state_service
 {
 public:
@@ -52,7 +61,10 @@ public:
           _quick_map({std::make_pair("/", &_root)}),
           _log_lock(true),
           _log(nullptr),
-          _offset(0)
+          _log_id(0),
+          _offset(0),
+          _next_compaction_offset(0),
+          _compacting(false)
     {
     }
 
@@ -119,6 +131,16 @@ private:
         static const int default_magic = 0xdeadbeef;
         log_header() : magic(default_magic), size(0) {}
     };
+    struct snapshot_header
+    {
+        int magic;
+        uint32_t body_crc;
+        // the snapshot contains all the operations in the logs before `log_id`
+        uint64_t log_id;
+        uint64_t node_count;
+        static const int default_magic = 0x534e4150;
+        snapshot_header() : magic(default_magic), body_crc(0), log_id(0), node_count(0) {}
+    };
 #pragma pack(pop)
 
     struct state_node
@@ -245,6 +267,23 @@ private:
     void
     write_log(blob &&log_blob, std::function<error_code(void)> internal_operation, task_ptr task);
 
+    // the log with id 0 has no suffix, to be compatible with the logs without snapshot
+    std::string log_path(uint64_t log_id) const;
+    std::string snapshot_path() const;
+
+    error_code load_snapshot();
+    void replay_log(const std::string &log_path);
+    // removes the logs before `log_id`
+    void remove_obsolete_logs(uint64_t log_id);
+
+    // called with `_log_lock` held, the log is compacted only when no operation is in flight.
+    // the tree is collected and the new log is opened under the lock, while the snapshot is
+    // written in the background
+    void compact_log_if_needed();
+    // <path, data>
+    typedef std::pair<std::string, blob> snapshot_node;
+    error_code write_snapshot(uint64_t log_id, const std::vector<snapshot_node> &nodes);
+
     error_code create_node_internal(const std::string &node, const blob &blob);
     error_code delete_node_internal(const std::string &node, bool recursive);
     error_code set_data_internal(const std::string &node, const blob &blob);
@@ -260,9 +299,15 @@ private:
     state_node _root;     // tree
     quick_map _quick_map; // <path, node*>
 
+    std::string _work_dir;
+
     zlock _log_lock;
     disk_file *_log;
+    uint64_t _log_id;
     uint64_t _offset;
+    uint64_t _next_compaction_offset;
+    // whether a snapshot is being written
+    std::atomic<bool> _compacting;
 
     dsn::task_tracker _tracker;
 };
@@ -33,6 +33,7 @@
  */
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/dist/replication/replication.codes.h>
+#include <dsn/utility/flags.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -45,6 +46,20 @@
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_uint32("zookeeper",
+                  zookeeper_max_ops_per_multi,
+                  256,
+                  "the max count of ops in one zookeeper multi-op, a larger transaction is "
+                  "split into several multi-ops");
+DSN_DEFINE_uint32("zookeeper",
+                  zookeeper_max_bytes_per_multi,
+                  512 * 1024,
+                  "the max bytes of the paths and data in one zookeeper multi-op, which should "
+                  "be less than the jute.maxbuffer of zookeeper (1MB by default)");
+
+// approximate bytes of an op in a multi-op besides its path and data
+static const size_t kMultiOpOverheadBytes = 32;
+
 class zoo_transaction : public meta_state_service::transaction_entries
 {
 public:
@@ -215,6 +230,42 @@ task_ptr meta_state_service_zookeeper::create_node(const std::string &node,
     return tsk;
 }
 
+// Submits the ops of `pkt` from `offset` in one multi-op, as many as allowed by the limits,
+// then the rest after it succeeds. The ops not executed are left ZRUNTIMEINCONSISTENCY.
+static void submit_multi(zookeeper_session *session,
+                         ref_ptr<meta_state_service_zookeeper> owner,
+                         std::shared_ptr<zookeeper_session::zoo_atomic_packet> pkt,
+                         unsigned int offset,
+                         error_code_future_ptr tsk)
+{
+    unsigned int end = offset;
+    size_t bytes = 0;
+    while (end < pkt->_count && end - offset < FLAGS_zookeeper_max_ops_per_multi) {
+        size_t op_bytes =
+            pkt->_paths[end].size() + pkt->_datas[end].length() + kMultiOpOverheadBytes;
+        if (end > offset && bytes + op_bytes > FLAGS_zookeeper_max_bytes_per_multi) {
+            break;
+        }
+        bytes += op_bytes;
+        ++end;
+    }
+
+    zookeeper_session::zoo_opcontext *op = zookeeper_session::create_context();
+    op->_optype = zookeeper_session::ZOO_OPERATION::ZOO_TRANSACTION;
+    op->_input._pkt = pkt;
+    op->_input._pkt_offset = offset;
+    op->_input._pkt_count = end - offset;
+    op->_callback_function = [session, owner, pkt, end, tsk](
+        zookeeper_session::zoo_opcontext *op) {
+        if (op->_output.error == ZOK && end < pkt->_count) {
+            submit_multi(session, owner, pkt, end, tsk);
+        } else {
+            tsk->enqueue_with(from_zerror(op->_output.error));
+        }
+    };
+    session->visit(op);
+}
+
 task_ptr meta_state_service_zookeeper::submit_transaction(
     const std::shared_ptr<transaction_entries> &entries,
     task_code cb_code,
@@ -224,18 +275,16 @@ task_ptr meta_state_service_zookeeper::submit_transaction(
     error_code_future_ptr tsk(new error_code_future(cb_code, cb_transaction, 0));
     tsk->set_tracker(tracker);
     dinfo("call submit batch");
-    zookeeper_session::zoo_opcontext *op = zookeeper_session::create_context();
-    zookeeper_session::zoo_input *input = &op->_input;
-    op->_callback_function = std::bind(&meta_state_service_zookeeper::visit_zookeeper_internal,
-                                       ref_this(this),
-                                       tsk,
-                                       std::placeholders::_1);
-    op->_optype = zookeeper_session::ZOO_OPERATION::ZOO_TRANSACTION;
 
+    // a transaction beyond the limits of one multi-op is split into several, which are atomic
+    // respectively and submitted in order, so that the large transactions (e.g. creating all
+    // the partitions of a table) cost a few round trips rather than one for each op
     zoo_transaction *t = dynamic_cast<zoo_transaction *>(entries.get());
-    input->_pkt = t->packet();
-
-    _session->visit(op);
+    auto pkt = t->packet();
+    for (unsigned int i = 0; i < pkt->_count; ++i) {
+        pkt->_results[i].err = ZRUNTIMEINCONSISTENCY;
+    }
+    submit_multi(_session, ref_this(this), pkt, 0, tsk);
     return tsk;
 }
 
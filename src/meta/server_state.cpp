@@ -1025,14 +1025,49 @@ void server_state::init_app_partition_node(std::shared_ptr<app_state> &app,
         app_partition_path, LPC_META_STATE_HIGH, on_create_app_partition, value);
 }
 
+void server_state::init_app_partition_nodes(std::shared_ptr<app_state> &app)
+{
+    // the partition nodes are created in a transaction, which is submitted as a few batched
+    // multi-ops by zookeeper. If it fails, e.g. some nodes are left by the last attempt, they
+    // are created one by one, which tolerates the existing nodes and retries on timeout
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    auto entries = storage->new_transaction_entries(app->partition_count);
+    for (int i = 0; i != app->partition_count; ++i) {
+        entries->create_node(
+            get_partition_path(*app, i),
+            dsn::json::json_forwarder<partition_configuration>::encode(app->partitions[i]));
+    }
+
+    uint64_t start_ms = dsn_now_ms();
+    auto on_create_app_partitions = [this, app, start_ms](error_code ec) mutable {
+        if (ERR_OK == ec) {
+            ddebug("create %d partition nodes of app(%s) ok, elapsed %" PRIu64 "ms",
+                   app->partition_count,
+                   app->get_logname(),
+                   dsn_now_ms() - start_ms);
+            zauto_write_lock l(_lock);
+            for (int i = 0; i != app->partition_count; ++i) {
+                process_one_partition(app);
+            }
+        } else {
+            dwarn("create partition nodes of app(%s) in batch failed, err(%s), create them one "
+                  "by one",
+                  app->get_logname(),
+                  ec.to_string());
+            for (int i = 0; i != app->partition_count; ++i) {
+                init_app_partition_node(app, i, nullptr);
+            }
+        }
+    };
+    storage->submit_transaction(entries, LPC_META_STATE_HIGH, on_create_app_partitions);
+}
+
 void server_state::do_app_create(std::shared_ptr<app_state> &app)
 {
     auto on_create_app_root = [this, app](error_code ec) mutable {
         if (ERR_OK == ec || ERR_NODE_ALREADY_EXIST == ec) {
             dinfo("create app(%s) on storage service ok", app->get_logname());
-            for (unsigned int i = 0; i != app->partition_count; ++i) {
-                init_app_partition_node(app, i, nullptr);
-            }
+            init_app_partition_nodes(app);
         } else if (ERR_TIMEOUT == ec) {
             dwarn("the storage service is not available currently, continue to create later");
             tasking::enqueue(LPC_META_STATE_HIGH,
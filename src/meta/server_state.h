@@ -230,6 +230,7 @@ private:
     void do_app_drop(std::shared_ptr<app_state> &app);
     void do_app_recall(std::shared_ptr<app_state> &app);
     void init_app_partition_node(std::shared_ptr<app_state> &app, int pidx, task_ptr callback);
+    void init_app_partition_nodes(std::shared_ptr<app_state> &app);
     // do_update_app_info()
     //  -- ensure update app_info to remote storage succeed, if timeout, it will retry autoly
     void do_update_app_info(const std::string &app_path,
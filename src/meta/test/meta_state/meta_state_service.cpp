@@ -1,4 +1,5 @@
 #include <dsn/dist/meta_state_service.h>
+#include <dsn/utility/filesystem.h>
 #include <boost/lexical_cast.hpp>
 
 #include <gtest/gtest.h>
@@ -245,6 +246,152 @@ void provider_recursively_create_delete_test(const service_creator_func &creator
     deleter(service);
 }
 
+void provider_large_transaction_test(const service_creator_func &creator,
+                                     const service_deleter_func &deleter)
+{
+    const int count = 1024;
+    meta_state_service *service = creator();
+    binary_writer writer;
+    writer.write(std::string(1024, 'x'));
+    blob value = writer.get_buffer();
+
+    // like creating the partition nodes of a large table
+    auto create_in_transaction = [&](const std::string &root) {
+        service->delete_node(root, true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, [](error_code) {})
+            ->wait();
+        service->create_node(root, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+        auto entries = service->new_transaction_entries(count);
+        for (int i = 0; i < count; ++i) {
+            entries->create_node(root + "/" + std::to_string(i), value);
+        }
+        service->submit_transaction(entries, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+            ->wait();
+        for (int i = 0; i < count; ++i) {
+            EXPECT_EQ(ERR_OK, entries->get_result(i));
+        }
+    };
+    auto create_one_by_one = [&](const std::string &root) {
+        service->delete_node(root, true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, [](error_code) {})
+            ->wait();
+        service->create_node(root, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+        dsn::task_tracker tracker;
+        for (int i = 0; i < count; ++i) {
+            service->create_node(root + "/" + std::to_string(i),
+                                 META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                                 expect_ok,
+                                 value,
+                                 &tracker);
+        }
+        tracker.wait_outstanding_tasks();
+    };
+    auto check_children = [&](const std::string &root) {
+        service
+            ->get_children(root,
+                           META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                           [count](error_code ec, const std::vector<std::string> &children) {
+                               ASSERT_EQ(ERR_OK, ec);
+                               ASSERT_EQ(static_cast<size_t>(count), children.size());
+                           })
+            ->wait();
+    };
+
+    create_in_transaction("/large_transaction");
+    check_children("/large_transaction");
+    create_one_by_one("/large_transaction");
+    check_children("/large_transaction");
+    service
+        ->delete_node(
+            "/large_transaction", true, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    deleter(service);
+}
+
+void simple_log_compaction_test()
+{
+    const std::string work_dir = "./meta_state_service_simple_compaction";
+    utils::filesystem::remove_path(work_dir);
+    utils::filesystem::create_directory(work_dir);
+    auto creator = [&work_dir] {
+        meta_state_service_simple *svc = new meta_state_service_simple();
+        EXPECT_EQ(ERR_OK, svc->initialize({work_dir}));
+        return svc;
+    };
+    auto check_data = [](meta_state_service *service, const std::string &node, int expected) {
+        service
+            ->get_data(node,
+                       META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                       [expected](error_code ec, const blob &value) {
+                           ASSERT_EQ(ERR_OK, ec);
+                           binary_reader reader(value);
+                           int content_value;
+                           reader.read(content_value);
+                           ASSERT_EQ(expected, content_value);
+                       })
+            ->wait();
+    };
+    auto value_of = [](int i) {
+        binary_writer writer;
+        writer.write(i);
+        writer.write(std::string(200, 'x'));
+        return writer.get_buffer();
+    };
+
+    PRESERVE_FLAG(meta_state_service_simple_log_compaction_threshold_kb);
+    FLAGS_meta_state_service_simple_log_compaction_threshold_kb = 4;
+
+    // the log is compacted several times
+    meta_state_service *service = creator();
+    service->create_node("/c", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)->wait();
+    for (int i = 0; i < 100; ++i) {
+        service
+            ->create_node("/c/" + std::to_string(i),
+                          META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                          expect_ok,
+                          value_of(i))
+            ->wait();
+    }
+    service->delete_node("/c/0", false, META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+        ->wait();
+    // the snapshot is written in the background, and the old logs are removed after it
+    std::vector<std::string> files;
+    for (int i = 0; i < 1000; ++i) {
+        files.clear();
+        ASSERT_TRUE(utils::filesystem::get_subfiles(work_dir, files, false));
+        if (files.size() == 2u &&
+            utils::filesystem::file_exists(work_dir + "/meta_state_service.snapshot")) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(utils::filesystem::file_exists(work_dir + "/meta_state_service.snapshot"));
+    ASSERT_FALSE(utils::filesystem::file_exists(work_dir + "/meta_state_service.log"));
+    ASSERT_EQ(2u, files.size());
+
+    // restart from the snapshot and the log after it, twice
+    for (int round = 0; round < 2; ++round) {
+        delete service;
+        service = creator();
+        service
+            ->get_children("/c",
+                           META_STATE_SERVICE_SIMPLE_TEST_CALLBACK,
+                           [](error_code ec, const std::vector<std::string> &children) {
+                               ASSERT_EQ(ERR_OK, ec);
+                               ASSERT_EQ(99u, children.size());
+                           })
+            ->wait();
+        service->node_exist("/c/0", META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_err)->wait();
+        check_data(service, "/c/1", 1);
+        check_data(service, "/c/99", round == 0 ? 99 : -1);
+        service
+            ->set_data(
+                "/c/99", value_of(-1), META_STATE_SERVICE_SIMPLE_TEST_CALLBACK, expect_ok)
+            ->wait();
+    }
+    delete service;
+
+    utils::filesystem::remove_path(work_dir);
+}
+
 #undef expect_ok
 #undef expect_err
 
@@ -259,8 +406,11 @@ TEST(meta_state_service, simple)
 
     provider_basic_test(simple_service_creator, simple_service_deleter);
     provider_recursively_create_delete_test(simple_service_creator, simple_service_deleter);
+    provider_large_transaction_test(simple_service_creator, simple_service_deleter);
 }
 
+TEST(meta_state_service, simple_log_compaction) { simple_log_compaction_test(); }
+
 TEST(meta_state_service, zookeeper)
 {
     auto zookeeper_service_creator = [] {
@@ -274,4 +424,5 @@ TEST(meta_state_service, zookeeper)
 
     provider_basic_test(zookeeper_service_creator, zookeeper_service_deleter);
     provider_recursively_create_delete_test(zookeeper_service_creator, zookeeper_service_deleter);
+    provider_large_transaction_test(zookeeper_service_creator, zookeeper_service_deleter);
 }
@@ -36,4 +36,9 @@ struct get_file_size_response
     1: i32 error;
     2: list<string> file_list;
     3: list<i64> size_list;
+    // address of the bulk transfer server, unset if not enabled
+    4: optional dsn.rpc_address bulk_address;
+    // one-time tickets to fetch the files by bulk transfer, in the order of file_list, 0 if
+    // the file should be copied by rpc
+    5: optional list<i64> bulk_tickets;
 }
@@ -0,0 +1,879 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "nfs_bulk_transfer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/network.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/defer.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
+namespace dsn {
+namespace service {
+
+DSN_DEFINE_bool("nfs",
+                enable_bulk_transfer,
+                false,
+                "whether to copy files with sendfile/splice over dedicated connections instead "
+                "of rpc messages, both the server and the client should enable it");
+DSN_DEFINE_uint32("nfs",
+                  bulk_transfer_port,
+                  0,
+                  "the port of the nfs bulk transfer server, 0 means chosen by the kernel");
+DSN_DEFINE_uint32("nfs",
+                  bulk_transfer_threads,
+                  4,
+                  "the thread count of the nfs bulk transfer server, and of the client");
+
+DSN_DECLARE_int32(rpc_timeout_ms);
+DSN_DECLARE_int32(file_close_expire_time_ms);
+DSN_DECLARE_uint32(nfs_copy_block_bytes);
+
+namespace {
+
+const uint32_t kBulkMagic = 0x4e465342; // "NFSB"
+const size_t kMaxConns = 1024;
+const size_t kMaxTickets = 65536;
+const int kMaxEvents = 64;
+const int kPollIntervalMs = 1000;
+const int kPipeSize = 1 << 20;
+
+enum bulk_status : uint32_t
+{
+    BULK_OK = 0,
+    BULK_NOT_FOUND = 1,
+    BULK_DENIED = 2,
+    BULK_INVALID_REQUEST = 3,
+};
+
+// all fields are in network byte order
+
+// sent once before the first request of a connection
+struct bulk_hello
+{
+    uint32_t magic;
+    uint64_t ticket;
+} __attribute__((packed));
+
+struct bulk_request_header
+{
+    uint64_t offset;
+    uint32_t size;
+} __attribute__((packed));
+
+struct bulk_response_header
+{
+    uint32_t status;
+    uint32_t size;
+} __attribute__((packed));
+
+uint64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+error_code to_error_code(uint32_t status)
+{
+    switch (status) {
+    case BULK_OK:
+        return ERR_OK;
+    case BULK_NOT_FOUND:
+        return ERR_OBJECT_NOT_FOUND;
+    case BULK_DENIED:
+        return ERR_ACL_DENY;
+    case BULK_INVALID_REQUEST:
+        return ERR_INVALID_PARAMETERS;
+    default:
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+void set_timeout(int sock)
+{
+    int32_t timeout_ms = FLAGS_rpc_timeout_ms > 0 ? FLAGS_rpc_timeout_ms : 10000;
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+bool send_all(int sock, const void *buf, size_t len, int flags)
+{
+    auto p = static_cast<const char *>(buf);
+    while (len > 0) {
+        ssize_t n = ::send(sock, p, len, flags | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool recv_all(int sock, void *buf, size_t len)
+{
+    auto p = static_cast<char *>(buf);
+    while (len > 0) {
+        ssize_t n = ::recv(sock, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+void reply_status(int sock, bulk_status status)
+{
+    bulk_response_header resp;
+    resp.status = htobe32(status);
+    resp.size = 0;
+    send_all(sock, &resp, sizeof(resp), 0);
+}
+
+error_code pwrite_all(int fd, const char *buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ERR_FILE_OPERATION_FAILED;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return ERR_OK;
+}
+
+// Moves `size` bytes from `sock` into `fd` at `offset`, through a pipe with splice(2). Falls
+// back to recv(2) and pwrite(2) if the file system doesn't support splicing.
+error_code receive_block(int sock, int fd, uint64_t offset, uint32_t size)
+{
+    int pipefd[2] = {-1, -1};
+    bool zero_copy = ::pipe2(pipefd, O_CLOEXEC) == 0;
+    size_t pipe_size = 64 << 10;
+    if (zero_copy) {
+        int ret = ::fcntl(pipefd[1], F_SETPIPE_SZ, kPipeSize);
+        if (ret > 0) {
+            pipe_size = ret;
+        }
+    }
+    auto close_pipe = defer([&pipefd]() {
+        if (pipefd[0] >= 0) {
+            ::close(pipefd[0]);
+            ::close(pipefd[1]);
+        }
+    });
+
+    std::unique_ptr<char[]> buf;
+    loff_t off = offset;
+    uint32_t remaining = size;
+    while (remaining > 0) {
+        if (!zero_copy) {
+            if (buf == nullptr) {
+                buf.reset(new char[pipe_size]);
+            }
+            ssize_t n = ::recv(sock, buf.get(), std::min<size_t>(remaining, pipe_size), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return (n < 0 && errno == EAGAIN) ? ERR_TIMEOUT : ERR_NETWORK_FAILURE;
+            }
+            error_code err = pwrite_all(fd, buf.get(), n, off);
+            if (err != ERR_OK) {
+                return err;
+            }
+            off += n;
+            remaining -= n;
+            continue;
+        }
+
+        ssize_t n = ::splice(sock,
+                             nullptr,
+                             pipefd[1],
+                             nullptr,
+                             std::min<size_t>(remaining, pipe_size),
+                             SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n < 0 && errno == EAGAIN) ? ERR_TIMEOUT : ERR_NETWORK_FAILURE;
+        }
+
+        // drain the pipe into the file
+        while (n > 0) {
+            ssize_t m = zero_copy ? ::splice(pipefd[0], nullptr, fd, &off, n, SPLICE_F_MOVE) : 0;
+            if (m < 0 && errno == EINTR) {
+                continue;
+            }
+            if (m < 0 && errno == EINVAL) {
+                zero_copy = false;
+            } else if (m < 0) {
+                return ERR_FILE_OPERATION_FAILED;
+            }
+            if (!zero_copy) {
+                // the file system doesn't support splice, copy the pipe out
+                if (buf == nullptr) {
+                    buf.reset(new char[pipe_size]);
+                }
+                m = ::read(pipefd[0], buf.get(), n);
+                if (m < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (m <= 0 || pwrite_all(fd, buf.get(), m, off) != ERR_OK) {
+                    return ERR_FILE_OPERATION_FAILED;
+                }
+                off += m;
+            }
+            n -= m;
+            remaining -= m;
+        }
+    }
+    return ERR_OK;
+}
+
+} // anonymous namespace
+
+nfs_bulk_server::nfs_bulk_server(perf_counter_wrapper &copy_data_size,
+                                 perf_counter_wrapper &copy_fail_count)
+    : _copy_data_size(copy_data_size),
+      _copy_fail_count(copy_fail_count),
+      _listen_fd(-1),
+      _epoll_fd(-1),
+      _stop_fd(-1),
+      _stopped(false)
+{
+}
+
+nfs_bulk_server::~nfs_bulk_server()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopped = true;
+        // wake up the serving threads blocked on the connections
+        for (const auto &kv : _conns) {
+            if (kv.second->busy) {
+                ::shutdown(kv.first, SHUT_RDWR);
+            }
+        }
+    }
+    _cond.notify_all();
+
+    if (_stop_fd >= 0) {
+        ::eventfd_write(_stop_fd, 1);
+    }
+    if (_poller.joinable()) {
+        _poller.join();
+    }
+    for (auto &t : _workers) {
+        t.join();
+    }
+
+    while (!_conns.empty()) {
+        close_connection(_conns.begin()->second.get());
+    }
+    for (int fd : {_listen_fd, _epoll_fd, _stop_fd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+error_code nfs_bulk_server::start()
+{
+    _listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    _epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    _stop_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_listen_fd < 0 || _epoll_fd < 0 || _stop_fd < 0) {
+        derror_f("create nfs bulk transfer socket failed, err = {}", utils::safe_strerror(errno));
+        return ERR_NETWORK_INIT_FAILED;
+    }
+
+    int reuse = 1;
+    ::setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // only on the configured interface, the same as the rpc address of this node
+    const uint32_t ip = network::get_local_ipv4();
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(ip);
+    addr.sin_port = htons(static_cast<uint16_t>(FLAGS_bulk_transfer_port));
+    socklen_t addr_len = sizeof(addr);
+    if (::bind(_listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(_listen_fd, 128) != 0 ||
+        ::getsockname(_listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len) != 0) {
+        derror_f("listen on nfs bulk transfer address {} failed, err = {}",
+                 rpc_address(ip, static_cast<uint16_t>(FLAGS_bulk_transfer_port)).to_string(),
+                 utils::safe_strerror(errno));
+        return ERR_NETWORK_INIT_FAILED;
+    }
+
+    for (int fd : {_listen_fd, _stop_fd}) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            derror_f("poll nfs bulk transfer socket failed, err = {}",
+                     utils::safe_strerror(errno));
+            return ERR_NETWORK_INIT_FAILED;
+        }
+    }
+    _address.assign_ipv4(ip, ntohs(addr.sin_port));
+
+    uint32_t thread_count = std::max<uint32_t>(FLAGS_bulk_transfer_threads, 1);
+    for (size_t i = 0; i < thread_count; ++i) {
+        _workers.emplace_back([this]() {
+            task_worker::set_name("nfs.bulk.server");
+            // a client may close the connection at any time, which mustn't kill the process
+            sigset_t set;
+            sigemptyset(&set);
+            sigaddset(&set, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &set, nullptr);
+            serve_loop();
+        });
+    }
+    _poller = std::thread([this]() {
+        task_worker::set_name("nfs.bulk.poll");
+        poll_loop();
+    });
+
+    ddebug_f("nfs bulk transfer server started on {}", _address.to_string());
+    return ERR_OK;
+}
+
+uint64_t nfs_bulk_server::issue_ticket(const std::string &source_dir, const std::string &file_name)
+{
+    // resolve the symbolic links and "..", so that the file can't escape from the directory
+    const std::string file_path = utils::filesystem::path_combine(source_dir, file_name);
+    char resolved_dir[PATH_MAX];
+    char resolved_file[PATH_MAX];
+    struct stat st;
+    if (::realpath(source_dir.c_str(), resolved_dir) == nullptr ||
+        ::realpath(file_path.c_str(), resolved_file) == nullptr ||
+        ::stat(resolved_file, &st) != 0 || !S_ISREG(st.st_mode)) {
+        dwarn_f("nfs: no bulk transfer ticket for {}, which isn't a regular file", file_path);
+        return 0;
+    }
+    std::string dir_prefix(resolved_dir);
+    if (dir_prefix.back() != '/') {
+        dir_prefix.push_back('/');
+    }
+    if (strncmp(resolved_file, dir_prefix.c_str(), dir_prefix.size()) != 0) {
+        dwarn_f("nfs: no bulk transfer ticket for {}, which is outside of {}",
+                file_path,
+                source_dir);
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    if (_tickets.size() >= kMaxTickets) {
+        dwarn_f("nfs: no bulk transfer ticket for {}, too many tickets issued", file_path);
+        return 0;
+    }
+    uint64_t id;
+    do {
+        id = (static_cast<uint64_t>(_random()) << 32) | _random();
+    } while (id == 0 || _tickets.count(id) != 0);
+    _tickets.emplace(id,
+                     ticket{resolved_file,
+                            now_ms() + static_cast<uint64_t>(FLAGS_file_close_expire_time_ms)});
+    return id;
+}
+
+bool nfs_bulk_server::redeem_ticket(uint64_t id, std::string &file_path)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    auto it = _tickets.find(id);
+    if (it == _tickets.end()) {
+        return false;
+    }
+    bool valid = it->second.expire_ms >= now_ms();
+    file_path = std::move(it->second.file_path);
+    _tickets.erase(it);
+    return valid;
+}
+
+void nfs_bulk_server::poll_loop()
+{
+    struct epoll_event events[kMaxEvents];
+    uint64_t next_expire_ms = now_ms() + kPollIntervalMs;
+    while (true) {
+        int n = ::epoll_wait(_epoll_fd, events, kMaxEvents, kPollIntervalMs);
+        if (n < 0 && errno != EINTR) {
+            dwarn_f("poll nfs bulk transfer connections failed, err = {}",
+                    utils::safe_strerror(errno));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::lock_guard<std::mutex> l(_lock);
+        if (_stopped) {
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == _listen_fd) {
+                accept_connections();
+                continue;
+            }
+            auto it = _conns.find(events[i].data.fd);
+            if (it == _conns.end()) {
+                continue;
+            }
+            // a request arrives, or the connection is closed by the client
+            it->second->busy = true;
+            _ready_conns.push_back(it->second.get());
+            _cond.notify_one();
+        }
+
+        uint64_t now = now_ms();
+        if (now >= next_expire_ms) {
+            close_expired(now);
+            next_expire_ms = now + kPollIntervalMs;
+        }
+    }
+}
+
+void nfs_bulk_server::accept_connections()
+{
+    while (true) {
+        int sock = ::accept4(_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                dwarn_f("accept nfs bulk transfer connection failed, err = {}",
+                        utils::safe_strerror(errno));
+            }
+            return;
+        }
+        if (_conns.size() >= kMaxConns) {
+            // the client will copy by rpc instead
+            dwarn_f("too many nfs bulk transfer connections, reject the new one");
+            ::close(sock);
+            continue;
+        }
+
+        set_timeout(sock);
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.fd = sock;
+        if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, sock, &ev) != 0) {
+            dwarn_f("poll nfs bulk transfer connection failed, err = {}",
+                    utils::safe_strerror(errno));
+            ::close(sock);
+            continue;
+        }
+        _conns.emplace(sock,
+                       std::unique_ptr<connection>(
+                           new connection{sock, -1, std::string(), 0, now_ms(), false}));
+    }
+}
+
+void nfs_bulk_server::close_connection(connection *conn)
+{
+    ::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->sock, nullptr);
+    ::close(conn->sock);
+    if (conn->fd >= 0) {
+        ::close(conn->fd);
+    }
+    _conns.erase(conn->sock);
+}
+
+void nfs_bulk_server::close_expired(uint64_t now)
+{
+    for (auto it = _conns.begin(); it != _conns.end();) {
+        connection *conn = (it++)->second.get();
+        if (!conn->busy &&
+            now - conn->last_active_ms > static_cast<uint64_t>(FLAGS_file_close_expire_time_ms)) {
+            close_connection(conn);
+        }
+    }
+    for (auto it = _tickets.begin(); it != _tickets.end();) {
+        if (it->second.expire_ms < now) {
+            it = _tickets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void nfs_bulk_server::serve_loop()
+{
+    while (true) {
+        connection *conn;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _cond.wait(l, [this]() { return _stopped || !_ready_conns.empty(); });
+            if (_stopped) {
+                return;
+            }
+            conn = _ready_conns.front();
+            _ready_conns.pop_front();
+        }
+
+        bool keep = serve(*conn);
+
+        std::lock_guard<std::mutex> l(_lock);
+        if (_stopped) {
+            // closed by the destructor
+            return;
+        }
+        if (keep) {
+            conn->busy = false;
+            conn->last_active_ms = now_ms();
+            struct epoll_event ev;
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ev.data.fd = conn->sock;
+            if (::epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, conn->sock, &ev) == 0) {
+                continue;
+            }
+        }
+        close_connection(conn);
+    }
+}
+
+bool nfs_bulk_server::serve(connection &conn)
+{
+    if (conn.fd < 0) {
+        bulk_hello hello;
+        if (!recv_all(conn.sock, &hello, sizeof(hello)) || be32toh(hello.magic) != kBulkMagic) {
+            dwarn_f("receive nfs bulk transfer hello failed");
+            _copy_fail_count->increment();
+            return false;
+        }
+        if (!redeem_ticket(be64toh(hello.ticket), conn.file_path)) {
+            dwarn_f("nfs: reject bulk transfer connection with an invalid or expired ticket");
+            reply_status(conn.sock, BULK_DENIED);
+            _copy_fail_count->increment();
+            return false;
+        }
+
+        conn.fd = ::open(conn.file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        struct stat st;
+        if (conn.fd < 0 || ::fstat(conn.fd, &st) != 0) {
+            derror_f("nfs: open file {} failed, err = {}",
+                     conn.file_path,
+                     utils::safe_strerror(errno));
+            reply_status(conn.sock, BULK_NOT_FOUND);
+            _copy_fail_count->increment();
+            return false;
+        }
+        conn.file_size = st.st_size;
+    } else {
+        // the client closes the connection once it has fetched the whole file
+        char c;
+        if (::recv(conn.sock, &c, 1, MSG_PEEK) == 0) {
+            return false;
+        }
+    }
+
+    bulk_request_header req;
+    if (!recv_all(conn.sock, &req, sizeof(req))) {
+        dwarn_f("receive nfs bulk transfer request failed");
+        _copy_fail_count->increment();
+        return false;
+    }
+    const uint64_t offset = be64toh(req.offset);
+    const uint32_t size = be32toh(req.size);
+    if (size > FLAGS_nfs_copy_block_bytes || offset > conn.file_size ||
+        size > conn.file_size - offset) {
+        derror_f("nfs: invalid bulk copy [{}, {}) of file {}, whose size is {}",
+                 offset,
+                 offset + size,
+                 conn.file_path,
+                 conn.file_size);
+        reply_status(conn.sock, BULK_INVALID_REQUEST);
+        _copy_fail_count->increment();
+        return false;
+    }
+
+    dinfo_f("nfs: bulk copy file {} [{}, {})", conn.file_path, offset, offset + size);
+
+    bulk_response_header resp;
+    resp.status = htobe32(BULK_OK);
+    resp.size = htobe32(size);
+    if (!send_all(conn.sock, &resp, sizeof(resp), MSG_MORE)) {
+        _copy_fail_count->increment();
+        return false;
+    }
+    off_t off = offset;
+    uint32_t remaining = size;
+    while (remaining > 0) {
+        ssize_t n = ::sendfile(conn.sock, conn.fd, &off, remaining);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            derror_f("nfs: send file {} failed, err = {}",
+                     conn.file_path,
+                     n < 0 ? utils::safe_strerror(errno) : "unexpected end of file");
+            if (n < 0 && errno == EPIPE) {
+                // consume the SIGPIPE pending on this thread
+                sigset_t set;
+                sigemptyset(&set);
+                sigaddset(&set, SIGPIPE);
+                struct timespec zero = {0, 0};
+                sigtimedwait(&set, nullptr, &zero);
+            }
+            _copy_fail_count->increment();
+            return false;
+        }
+        remaining -= n;
+    }
+    _copy_data_size->add(size);
+    return true;
+}
+
+nfs_bulk_fetcher::nfs_bulk_fetcher() : _stopped(false)
+{
+    uint32_t thread_count = std::max<uint32_t>(FLAGS_bulk_transfer_threads, 1);
+    for (size_t i = 0; i < thread_count; ++i) {
+        _workers.emplace_back([this]() {
+            task_worker::set_name("nfs.bulk.fetch");
+            run();
+        });
+    }
+}
+
+nfs_bulk_fetcher::~nfs_bulk_fetcher()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopped = true;
+    }
+    _cond.notify_all();
+    for (auto &t : _workers) {
+        t.join();
+    }
+}
+
+void nfs_bulk_fetcher::fetch(rpc_address server,
+                             uint64_t ticket,
+                             uint64_t file_size,
+                             uint64_t offset,
+                             uint32_t size,
+                             const std::string &local_file,
+                             callback cb)
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        auto &s = _streams[ticket];
+        if (s == nullptr) {
+            s = std::make_shared<file_stream>();
+            s->server = server;
+            s->ticket = ticket;
+            s->file_size = file_size;
+            s->local_file = local_file;
+        }
+        s->blocks.push_back({offset, size, std::move(cb)});
+        if (s->busy) {
+            return;
+        }
+        s->busy = true;
+        _ready_streams.push_back(s);
+    }
+    _cond.notify_one();
+}
+
+void nfs_bulk_fetcher::release(uint64_t ticket)
+{
+    std::shared_ptr<file_stream> s;
+    std::lock_guard<std::mutex> l(_lock);
+    auto it = _streams.find(ticket);
+    if (it == _streams.end()) {
+        return;
+    }
+    // a busy stream is closed by the fetcher thread holding it, otherwise here
+    s = std::move(it->second);
+    s->failed = true;
+    _streams.erase(it);
+}
+
+void nfs_bulk_fetcher::run()
+{
+    while (true) {
+        std::shared_ptr<file_stream> s;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _cond.wait(l, [this]() { return _stopped || !_ready_streams.empty(); });
+            if (_stopped) {
+                return;
+            }
+            s = std::move(_ready_streams.front());
+            _ready_streams.pop_front();
+        }
+
+        // only the thread holding the busy stream touches its connection and file
+        while (true) {
+            block b;
+            bool failed;
+            {
+                std::lock_guard<std::mutex> l(_lock);
+                if (_stopped || s->blocks.empty()) {
+                    s->busy = false;
+                    break;
+                }
+                b = std::move(s->blocks.front());
+                s->blocks.pop_front();
+                failed = s->failed;
+            }
+
+            // the ticket is used up once the connection fails
+            error_code err = failed ? ERR_NETWORK_FAILURE : s->fetch_block(b);
+            if (err == ERR_OK) {
+                s->fetched_size += b.size;
+                if (s->fetched_size >= s->file_size) {
+                    err = s->close();
+                }
+            }
+            if (err != ERR_OK) {
+                s->close();
+                std::lock_guard<std::mutex> l(_lock);
+                s->failed = true;
+            }
+            b.cb(err);
+        }
+    }
+}
+
+nfs_bulk_fetcher::file_stream::~file_stream() { close(); }
+
+error_code nfs_bulk_fetcher::file_stream::close()
+{
+    error_code err = ERR_OK;
+    if (sock >= 0) {
+        ::close(sock);
+        sock = -1;
+    }
+    if (fd >= 0) {
+        if (::close(fd) != 0) {
+            derror_f("close file {} failed, err = {}", local_file, utils::safe_strerror(errno));
+            err = ERR_FILE_OPERATION_FAILED;
+        }
+        fd = -1;
+    }
+    return err;
+}
+
+error_code nfs_bulk_fetcher::file_stream::fetch_block(const block &b)
+{
+    if (sock < 0) {
+        sock = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            derror_f("create nfs bulk transfer socket failed, err = {}",
+                     utils::safe_strerror(errno));
+            return ERR_NETWORK_FAILURE;
+        }
+        set_timeout(sock);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(server.ip());
+        addr.sin_port = htons(server.port());
+        bulk_hello hello;
+        hello.magic = htobe32(kBulkMagic);
+        hello.ticket = htobe64(ticket);
+        if (::connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            !send_all(sock, &hello, sizeof(hello), MSG_MORE)) {
+            derror_f("connect to nfs bulk transfer server {} failed, err = {}",
+                     server.to_string(),
+                     utils::safe_strerror(errno));
+            return ERR_NETWORK_FAILURE;
+        }
+    }
+
+    bulk_request_header req;
+    req.offset = htobe64(b.offset);
+    req.size = htobe32(b.size);
+    bulk_response_header resp;
+    if (!send_all(sock, &req, sizeof(req), 0) || !recv_all(sock, &resp, sizeof(resp))) {
+        derror_f("request nfs bulk transfer server {} failed, err = {}",
+                 server.to_string(),
+                 utils::safe_strerror(errno));
+        return ERR_NETWORK_FAILURE;
+    }
+    error_code err = to_error_code(be32toh(resp.status));
+    if (err != ERR_OK) {
+        derror_f("nfs bulk transfer server {} rejected [{}, {}) of {}, err = {}",
+                 server.to_string(),
+                 b.offset,
+                 b.offset + b.size,
+                 local_file,
+                 err.to_string());
+        return err;
+    }
+    if (be32toh(resp.size) != b.size) {
+        return ERR_INVALID_DATA;
+    }
+
+    if (fd < 0) {
+        fd = ::open(local_file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            derror_f("open file {} failed, err = {}", local_file, utils::safe_strerror(errno));
+            return ERR_FILE_OPERATION_FAILED;
+        }
+    }
+    err = receive_block(sock, fd, b.offset, b.size);
+    if (err != ERR_OK) {
+        derror_f("receive [{}, {}) of {} from {} failed, err = {}",
+                 b.offset,
+                 b.offset + b.size,
+                 local_file,
+                 server.to_string(),
+                 err.to_string());
+    }
+    return err;
+}
+
+} // namespace service
+} // namespace dsn
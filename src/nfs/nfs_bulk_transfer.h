@@ -0,0 +1,191 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/rpc_address.h>
+#include <dsn/utility/error_code.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace service {
+
+DSN_DECLARE_bool(enable_bulk_transfer);
+
+// The bulk transfer is an alternative data path of RPC_NFS_COPY for large copies. Instead of
+// reading each block into a buffer and replying it in an rpc message, the server streams the
+// block from the page cache onto a dedicated tcp connection with sendfile(2), and the client
+// moves it from the socket into the destination file with splice(2), so the data is never
+// copied into user space on either side.
+//
+// RPC_NFS_GET_FILE_SIZE hands out a one-time ticket for each file, and a connection carries
+// the blocks of one file: the client opens it with the ticket, then sends the offset and size
+// of each block, and the server replies a status followed by exactly `size` bytes of the file.
+
+// nfs_bulk_server accepts bulk connections on `bulk_transfer_port` of the configured interface,
+// and serves them with `bulk_transfer_threads` threads. The idle connections are polled by a
+// separate thread, so they don't hold the serving threads.
+class nfs_bulk_server
+{
+public:
+    nfs_bulk_server(perf_counter_wrapper &copy_data_size, perf_counter_wrapper &copy_fail_count);
+    ~nfs_bulk_server();
+
+    // Starts listening on the address of network::get_local_ipv4(), the port is chosen by the
+    // kernel if `bulk_transfer_port` is 0.
+    error_code start();
+
+    // The address actually listened on, invalid if not started.
+    rpc_address address() const { return _address; }
+
+    // Issues a ticket to fetch `file_name` in `source_dir`, which is redeemed by the first
+    // connection presenting it, and expires after `file_close_expire_time_ms` if not. Returns 0
+    // if the file doesn't resolve to a regular file inside `source_dir`.
+    // thread safe
+    uint64_t issue_ticket(const std::string &source_dir, const std::string &file_name);
+
+private:
+    struct connection
+    {
+        int sock;
+        int fd; // the file of the ticket, -1 until the ticket is redeemed
+        std::string file_path;
+        uint64_t file_size;
+        uint64_t last_active_ms;
+        bool busy; // being served, or waiting for a serving thread
+    };
+
+    struct ticket
+    {
+        std::string file_path;
+        uint64_t expire_ms;
+    };
+
+    void poll_loop();
+    void serve_loop();
+    // Serves a request of `conn`, returns false if the connection should be closed.
+    bool serve(connection &conn);
+    // Returns false if `id` isn't a valid ticket.
+    bool redeem_ticket(uint64_t id, std::string &file_path);
+
+    // The following are called with `_lock` held.
+    void accept_connections();
+    void close_connection(connection *conn);
+    void close_expired(uint64_t now);
+
+private:
+    perf_counter_wrapper &_copy_data_size;
+    perf_counter_wrapper &_copy_fail_count;
+
+    int _listen_fd;
+    int _epoll_fd;
+    int _stop_fd; // an eventfd to wake up the poller
+    rpc_address _address;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::unordered_map<int, std::unique_ptr<connection>> _conns; // by socket
+    std::deque<connection *> _ready_conns;
+    std::unordered_map<uint64_t, ticket> _tickets;
+    std::random_device _random;
+    bool _stopped;
+
+    std::thread _poller;
+    std::vector<std::thread> _workers;
+};
+
+// nfs_bulk_fetcher runs the blocking bulk fetches on `bulk_transfer_threads` threads. The blocks
+// of a file are fetched one by one over the connection of its ticket, which is closed once the
+// whole file is fetched.
+class nfs_bulk_fetcher
+{
+public:
+    typedef std::function<void(error_code)> callback;
+
+    nfs_bulk_fetcher();
+    ~nfs_bulk_fetcher();
+
+    // Fetches [offset, offset + size) of the file of `ticket`, whose size is `file_size`, from
+    // the bulk server at `server`, and writes it at the same offset of `local_file`, which is
+    // created if not exists. `cb` is called on the fetcher thread once it's done. After a block
+    // fails, the following blocks of the file fail as well, since the ticket is used up.
+    // thread safe
+    void fetch(rpc_address server,
+               uint64_t ticket,
+               uint64_t file_size,
+               uint64_t offset,
+               uint32_t size,
+               const std::string &local_file,
+               callback cb);
+
+    // Drops the connection of `ticket`, and fails its pending blocks.
+    // thread safe
+    void release(uint64_t ticket);
+
+private:
+    struct block
+    {
+        uint64_t offset;
+        uint32_t size;
+        callback cb;
+    };
+
+    struct file_stream
+    {
+        rpc_address server;
+        uint64_t ticket;
+        uint64_t file_size;
+        std::string local_file;
+        int sock = -1;
+        int fd = -1;
+        uint64_t fetched_size = 0;
+        bool busy = false;   // being fetched, or waiting for a fetcher thread
+        bool failed = false; // or released
+        std::deque<block> blocks;
+
+        ~file_stream();
+        error_code fetch_block(const block &b);
+        // Closes the connection and the local file.
+        error_code close();
+    };
+
+    void run();
+
+private:
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::unordered_map<uint64_t, std::shared_ptr<file_stream>> _streams; // by ticket
+    std::deque<std::shared_ptr<file_stream>> _ready_streams;
+    bool _stopped;
+
+    std::vector<std::thread> _workers;
+};
+
+} // namespace service
+} // namespace dsn
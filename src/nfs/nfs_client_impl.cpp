@@ -32,9 +32,11 @@
  *     xxxx-xx-xx, author, first version
  *     xxxx-xx-xx, author, fix bug about xxx
  */
+#include <cstring>
 #include <dsn/utility/filesystem.h>
 #include <queue>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/perf_counter/perf_counters.h>
 #include "nfs_client_impl.h"
 
 namespace dsn {
@@ -110,14 +112,34 @@ nfs_client_impl::nfs_client_impl()
     // size once
     dassert(max_copy_rate_bytes > FLAGS_nfs_copy_block_bytes,
             "max_copy_rate_bytes should be greater than nfs_copy_block_bytes");
-    _copy_token_bucket.reset(new TokenBucket(max_copy_rate_bytes, 1.5 * max_copy_rate_bytes));
+    _copy_token_bucket.reset(new folly::DynamicTokenBucket());
+    _max_copy_rate_bytes.store(max_copy_rate_bytes);
     current_max_copy_rate_megabytes = FLAGS_max_copy_rate_megabytes;
 
+    if (FLAGS_enable_adaptive_copy) {
+        // the token bucket should hold a block at least
+        _copy_scheduler.reset(new nfs_copy_scheduler(FLAGS_max_concurrent_remote_copy_requests,
+                                                     FLAGS_max_concurrent_local_writes,
+                                                     max_copy_rate_bytes,
+                                                     2 * FLAGS_nfs_copy_block_bytes));
+        _adjust_copy_limits_timer = tasking::enqueue_timer(
+            LPC_NFS_ADJUST_COPY_LIMITS_TIMER,
+            &_tracker,
+            [this]() { adjust_copy_limits(); },
+            std::chrono::milliseconds(FLAGS_adaptive_copy_interval_ms));
+    }
+
+    if (FLAGS_enable_bulk_transfer) {
+        _bulk_fetcher.reset(new nfs_bulk_fetcher());
+    }
+
     register_cli_commands();
 }
 
 nfs_client_impl::~nfs_client_impl()
 {
+    // stop the bulk fetches before cancelling, they may enqueue tasks
+    _bulk_fetcher.reset();
     _tracker.cancel_outstanding_tasks();
     UNREGISTER_VALID_HANDLER(_nfs_max_copy_rate_megabytes_cmd);
 }
@@ -166,11 +188,20 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
         return;
     }
 
+    if (_bulk_fetcher != nullptr && resp.__isset.bulk_address && resp.__isset.bulk_tickets &&
+        resp.bulk_tickets.size() == resp.file_list.size()) {
+        ureq->bulk_address = resp.bulk_address;
+        ureq->use_bulk = true;
+    }
+
     std::deque<copy_request_ex_ptr> copy_requests;
     ureq->file_contexts.resize(resp.size_list.size());
     for (size_t i = 0; i < resp.size_list.size(); i++) // file list
     {
         file_context_ptr filec(new file_context(ureq, resp.file_list[i], resp.size_list[i]));
+        if (ureq->use_bulk) {
+            filec->bulk_ticket = static_cast<uint64_t>(resp.bulk_tickets[i]);
+        }
         ureq->file_contexts[i] = filec;
 
         // init copy requests
@@ -224,7 +255,7 @@ void nfs_client_impl::continue_copy()
         return;
     }
 
-    if (++_concurrent_copy_request_count > FLAGS_max_concurrent_remote_copy_requests) {
+    if (++_concurrent_copy_request_count > max_concurrent_copy_requests()) {
         // exceed max_concurrent_remote_copy_requests limit, pause.
         // the copy task will be triggered by continue_copy() invoked in end_copy().
         --_concurrent_copy_request_count;
@@ -270,38 +301,44 @@ void nfs_client_impl::continue_copy()
             const user_request_ptr &ureq = req->file_ctx->user_req;
             if (req->is_valid) {
                 // todo(jiashuo1) use non-block api `consumeWithBorrowNonBlocking` or `consume`
-                _copy_token_bucket->consumeWithBorrowAndWait(req->size);
-
-                copy_request copy_req;
-                copy_req.source = ureq->file_size_req.source;
-                copy_req.file_name = req->file_ctx->file_name;
-                copy_req.offset = req->offset;
-                copy_req.size = req->size;
-                copy_req.dst_dir = ureq->file_size_req.dst_dir;
-                copy_req.source_dir = ureq->file_size_req.source_dir;
-                copy_req.overwrite = ureq->file_size_req.overwrite;
-                copy_req.is_last = req->is_last;
-                req->remote_copy_task =
-                    async_nfs_copy(copy_req,
-                                   [=](error_code err, copy_response &&resp) {
-                                       end_copy(err, std::move(resp), req);
-                                       // reset task to release memory quickly.
-                                       // should do this after end_copy() done.
-                                       if (req->is_ready_for_write) {
-                                           ::dsn::task_ptr tsk;
-                                           zauto_lock l(req->lock);
-                                           tsk = std::move(req->remote_copy_task);
-                                       }
-                                   },
-                                   std::chrono::milliseconds(FLAGS_rpc_timeout_ms),
-                                   req->file_ctx->user_req->file_size_req.source);
+                const uint64_t rate = copy_rate_bytes();
+                _copy_token_bucket->consumeWithBorrowAndWait(req->size, rate, 1.5 * rate);
+                req->copy_start_ns = dsn_now_ns();
+
+                if (ureq->use_bulk && req->file_ctx->bulk_ticket != 0) {
+                    bulk_copy(req);
+                } else {
+                    copy_request copy_req;
+                    copy_req.source = ureq->file_size_req.source;
+                    copy_req.file_name = req->file_ctx->file_name;
+                    copy_req.offset = req->offset;
+                    copy_req.size = req->size;
+                    copy_req.dst_dir = ureq->file_size_req.dst_dir;
+                    copy_req.source_dir = ureq->file_size_req.source_dir;
+                    copy_req.overwrite = ureq->file_size_req.overwrite;
+                    copy_req.is_last = req->is_last;
+                    req->remote_copy_task =
+                        async_nfs_copy(copy_req,
+                                       [=](error_code err, copy_response &&resp) {
+                                           end_copy(err, std::move(resp), req);
+                                           // reset task to release memory quickly.
+                                           // should do this after end_copy() done.
+                                           if (req->is_ready_for_write) {
+                                               ::dsn::task_ptr tsk;
+                                               zauto_lock l(req->lock);
+                                               tsk = std::move(req->remote_copy_task);
+                                           }
+                                       },
+                                       std::chrono::milliseconds(FLAGS_rpc_timeout_ms),
+                                       req->file_ctx->user_req->file_size_req.source);
+                }
             } else {
                 --ureq->concurrent_copy_count;
                 --_concurrent_copy_request_count;
             }
         }
 
-        if (++_concurrent_copy_request_count > FLAGS_max_concurrent_remote_copy_requests) {
+        if (++_concurrent_copy_request_count > max_concurrent_copy_requests()) {
             // exceed max_concurrent_remote_copy_requests limit, pause.
             // the copy task will be triggered by continue_copy() invoked in end_copy().
             --_concurrent_copy_request_count;
@@ -317,86 +354,154 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
     --_concurrent_copy_request_count;
     --reqc->file_ctx->user_req->concurrent_copy_count;
 
-    const file_context_ptr &fc = reqc->file_ctx;
-
     if (err == ERR_OK) {
         err = resp.error;
     }
 
     if (err != ::dsn::ERR_OK) {
-        _recent_copy_fail_count->increment();
-
-        if (!fc->user_req->is_finished) {
-            if (reqc->retry_count > 0) {
-                dwarn("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
-                      "err = %s, retry_count = %d",
-                      fc->user_req->file_size_req.source.to_string(),
-                      fc->user_req->file_size_req.source_dir.c_str(),
-                      fc->file_name.c_str(),
-                      err.to_string(),
-                      reqc->retry_count);
-
-                // retry copy
-                reqc->retry_count--;
-
-                // put back into copy request queue
-                zauto_lock l(_copy_requests_lock);
-                if (fc->user_req->high_priority)
-                    _copy_requests_high.push_front(reqc);
-                else
-                    _copy_requests_low.push_retry(reqc);
-            } else {
-                derror("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
-                       "err = %s, retry_count = %d",
-                       fc->user_req->file_size_req.source.to_string(),
-                       fc->user_req->file_size_req.source_dir.c_str(),
-                       fc->file_name.c_str(),
-                       err.to_string(),
-                       reqc->retry_count);
-
-                handle_completion(fc->user_req, err);
-            }
+        handle_copy_failure(err, reqc);
+    } else {
+        _recent_copy_data_size->add(resp.size);
+        if (_copy_scheduler != nullptr &&
+            static_cast<uint32_t>(resp.size) == FLAGS_nfs_copy_block_bytes) {
+            _copy_scheduler->on_remote_copy(dsn_now_ns() - reqc->copy_start_ns);
         }
+
+        reqc->response = resp;
+        reqc->is_ready_for_write = true;
+        prepare_writes(reqc);
     }
 
-    else {
-        _recent_copy_data_size->add(resp.size);
+    continue_copy();
+    continue_write();
+}
 
-        reqc->response = resp;
+void nfs_client_impl::bulk_copy(const copy_request_ex_ptr &reqc)
+{
+    const file_context_ptr &fc = reqc->file_ctx;
+    const user_request_ptr &ureq = fc->user_req;
+    std::string file_path =
+        dsn::utils::filesystem::path_combine(ureq->file_size_req.dst_dir, fc->file_name);
+    std::string path = dsn::utils::filesystem::remove_file_name(file_path.c_str());
+    if (!dsn::utils::filesystem::create_directory(path)) {
+        dassert(false, "create directory %s failed", path.c_str());
+    }
+
+    // the fetcher threads can't create tasks, so create the callback here
+    auto result = std::make_shared<error_code>(ERR_OK);
+    task_ptr callback = tasking::create_task(
+        LPC_NFS_COPY_FILE, &_tracker, [this, reqc, result]() { end_bulk_copy(*result, reqc); });
+    _bulk_fetcher->fetch(ureq->bulk_address,
+                         fc->bulk_ticket,
+                         fc->file_size,
+                         reqc->offset,
+                         reqc->size,
+                         file_path,
+                         [result, callback](error_code err) {
+                             *result = err;
+                             callback->enqueue();
+                         });
+}
+
+void nfs_client_impl::end_bulk_copy(error_code err, const copy_request_ex_ptr &reqc)
+{
+    --_concurrent_copy_request_count;
+    --reqc->file_ctx->user_req->concurrent_copy_count;
+
+    if (err != ERR_OK) {
+        // copy the rest of the user request by rpc
+        reqc->file_ctx->user_req->use_bulk = false;
+        handle_copy_failure(err, reqc);
+    } else {
+        _recent_copy_data_size->add(reqc->size);
+        if (_copy_scheduler != nullptr && reqc->size == FLAGS_nfs_copy_block_bytes) {
+            // includes writing the block, which is done by the bulk transfer
+            _copy_scheduler->on_remote_copy(dsn_now_ns() - reqc->copy_start_ns);
+        }
+
+        reqc->is_written = true;
         reqc->is_ready_for_write = true;
+        prepare_writes(reqc);
+        on_block_written(ERR_OK, reqc->size, reqc);
+    }
 
-        // prepare write requests
-        std::deque<copy_request_ex_ptr> new_writes;
-        {
-            zauto_lock l(fc->user_req->user_req_lock);
-            if (!fc->user_req->is_finished && fc->current_write_index == reqc->index - 1) {
-                for (int i = reqc->index; i < (int)(fc->copy_requests.size()); i++) {
-                    if (fc->copy_requests[i]->is_ready_for_write) {
-                        fc->current_write_index++;
+    continue_copy();
+    continue_write();
+}
+
+void nfs_client_impl::handle_copy_failure(error_code err, const copy_request_ex_ptr &reqc)
+{
+    const file_context_ptr &fc = reqc->file_ctx;
+
+    _recent_copy_fail_count->increment();
+
+    if (!fc->user_req->is_finished) {
+        if (reqc->retry_count > 0) {
+            dwarn("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
+                  "err = %s, retry_count = %d",
+                  fc->user_req->file_size_req.source.to_string(),
+                  fc->user_req->file_size_req.source_dir.c_str(),
+                  fc->file_name.c_str(),
+                  err.to_string(),
+                  reqc->retry_count);
+
+            // retry copy
+            reqc->retry_count--;
+
+            // put back into copy request queue
+            zauto_lock l(_copy_requests_lock);
+            if (fc->user_req->high_priority)
+                _copy_requests_high.push_front(reqc);
+            else
+                _copy_requests_low.push_retry(reqc);
+        } else {
+            derror("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
+                   "err = %s, retry_count = %d",
+                   fc->user_req->file_size_req.source.to_string(),
+                   fc->user_req->file_size_req.source_dir.c_str(),
+                   fc->file_name.c_str(),
+                   err.to_string(),
+                   reqc->retry_count);
+
+            handle_completion(fc->user_req, err);
+        }
+    }
+}
+
+void nfs_client_impl::prepare_writes(const copy_request_ex_ptr &reqc)
+{
+    const file_context_ptr &fc = reqc->file_ctx;
+
+    // prepare write requests
+    std::deque<copy_request_ex_ptr> new_writes;
+    {
+        zauto_lock l(fc->user_req->user_req_lock);
+        if (!fc->user_req->is_finished && fc->current_write_index == reqc->index - 1) {
+            for (int i = reqc->index; i < (int)(fc->copy_requests.size()); i++) {
+                if (fc->copy_requests[i]->is_ready_for_write) {
+                    fc->current_write_index++;
+                    if (!fc->copy_requests[i]->is_written) {
                         new_writes.push_back(fc->copy_requests[i]);
-                    } else {
-                        break;
                     }
+                } else {
+                    break;
                 }
             }
         }
-
-        // put write requests into queue
-        if (!new_writes.empty()) {
-            zauto_lock l(_local_writes_lock);
-            _local_writes.insert(_local_writes.end(), new_writes.begin(), new_writes.end());
-            _buffered_local_write_count += new_writes.size();
-        }
     }
 
-    continue_copy();
-    continue_write();
+    // put write requests into queue
+    if (!new_writes.empty()) {
+        zauto_lock l(_local_writes_lock);
+        _local_writes.insert(_local_writes.end(), new_writes.begin(), new_writes.end());
+        _buffered_local_write_count += new_writes.size();
+    }
 }
 
 void nfs_client_impl::continue_write()
 {
     // check write quota
-    if (++_concurrent_local_write_count > FLAGS_max_concurrent_local_writes) {
+    if (++_concurrent_local_write_count > max_concurrent_local_writes()) {
         // exceed max_concurrent_local_writes limit, pause.
         // the copy task will be triggered by continue_write() invoked in
         // local_write_callback().
@@ -459,6 +564,7 @@ void nfs_client_impl::continue_write()
     } else {
         zauto_lock l(reqc->lock);
         if (reqc->is_valid) {
+            reqc->write_start_ns = dsn_now_ns();
             reqc->local_write_task = file::write(fc->file_holder->file_handle,
                                                  reqc->response.file_content.data(),
                                                  reqc->response.size,
@@ -489,6 +595,18 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
     // clear content to release memory quickly
     reqc->response.file_content = blob();
 
+    if (_copy_scheduler != nullptr && err == ERR_OK && sz == FLAGS_nfs_copy_block_bytes) {
+        _copy_scheduler->on_local_write(dsn_now_ns() - reqc->write_start_ns);
+    }
+
+    on_block_written(err, sz, reqc);
+
+    continue_write();
+    continue_copy();
+}
+
+void nfs_client_impl::on_block_written(error_code err, size_t sz, const copy_request_ex_ptr &reqc)
+{
     const file_context_ptr &fc = reqc->file_ctx;
 
     bool completed = false;
@@ -520,9 +638,6 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
     if (completed) {
         handle_completion(fc->user_req, err);
     }
-
-    continue_write();
-    continue_copy();
 }
 
 void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code err)
@@ -547,6 +662,9 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
         }
         // clear copy_requests to break circle reference
         fc->copy_requests.clear();
+        if (fc->bulk_ticket != 0) {
+            _bulk_fetcher->release(fc->bulk_ticket);
+        }
     }
 
     // clear file_contexts to break circle reference
@@ -556,6 +674,56 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
     req->nfs_task->enqueue(err, err == ERR_OK ? total_size : 0);
 }
 
+int32_t nfs_client_impl::max_concurrent_copy_requests() const
+{
+    return _copy_scheduler != nullptr ? _copy_scheduler->max_copy_requests()
+                                      : FLAGS_max_concurrent_remote_copy_requests;
+}
+
+uint64_t nfs_client_impl::copy_rate_bytes() const
+{
+    return _copy_scheduler != nullptr ? _copy_scheduler->copy_rate_bytes()
+                                      : _max_copy_rate_bytes.load();
+}
+
+int32_t nfs_client_impl::max_concurrent_local_writes() const
+{
+    return _copy_scheduler != nullptr ? _copy_scheduler->max_local_writes()
+                                      : FLAGS_max_concurrent_local_writes;
+}
+
+void nfs_client_impl::adjust_copy_limits()
+{
+    uint64_t foreground_latency_ns = 0;
+    if (strlen(FLAGS_adaptive_copy_foreground_latency_counter) > 0) {
+        // the counter may be created after nfs, look it up every time
+        perf_counter_ptr counter =
+            perf_counters::instance().get_counter(FLAGS_adaptive_copy_foreground_latency_counter);
+        if (counter != nullptr) {
+            foreground_latency_ns = counter->type() == COUNTER_TYPE_NUMBER_PERCENTILES
+                                        ? counter->get_percentile(COUNTER_PERCENTILE_99)
+                                        : counter->peek_value();
+        }
+    }
+
+    // the new copy rate is applied on the next consume of the token bucket
+    _copy_scheduler->adjust(foreground_latency_ns);
+
+    // the limits may be raised
+    continue_copy();
+    continue_write();
+}
+
+void nfs_client_impl::reset_copy_rate(uint32_t max_copy_rate_bytes)
+{
+    if (_copy_scheduler != nullptr) {
+        // scaled and applied on the next adjustment
+        _copy_scheduler->set_max_copy_rate_bytes(max_copy_rate_bytes);
+        return;
+    }
+    _max_copy_rate_bytes.store(max_copy_rate_bytes);
+}
+
 void nfs_client_impl::register_cli_commands()
 {
 
@@ -574,7 +742,7 @@ void nfs_client_impl::register_cli_commands()
 
                 if (args[0] == "DEFAULT") {
                     uint32_t max_copy_rate_bytes = FLAGS_max_copy_rate_megabytes << 20;
-                    _copy_token_bucket->reset(max_copy_rate_bytes, 1.5 * max_copy_rate_bytes);
+                    reset_copy_rate(max_copy_rate_bytes);
                     current_max_copy_rate_megabytes = FLAGS_max_copy_rate_megabytes;
                     return result;
                 }
@@ -592,7 +760,7 @@ void nfs_client_impl::register_cli_commands()
                                  .append(std::to_string(FLAGS_nfs_copy_block_bytes));
                     return result;
                 }
-                _copy_token_bucket->reset(max_copy_rate_bytes, 1.5 * max_copy_rate_bytes);
+                reset_copy_rate(max_copy_rate_bytes);
                 current_max_copy_rate_megabytes = max_copy_rate_megabytes;
                 return result;
             });
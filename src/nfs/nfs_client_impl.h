@@ -40,12 +40,12 @@
 
 #include "nfs_types.h"
 #include "nfs_code_definition.h"
+#include "nfs_bulk_transfer.h"
+#include "nfs_copy_scheduler.h"
 
 namespace dsn {
 namespace service {
 
-using TokenBucket = folly::BasicTokenBucket<std::chrono::steady_clock>;
-
 template <typename TCallback>
 task_ptr async_nfs_get_file_size(const get_file_size_request &request,
                                  TCallback &&callback,
@@ -108,8 +108,11 @@ public:
         ::dsn::task_ptr remote_copy_task;
         ::dsn::task_ptr local_write_task;
         bool is_ready_for_write;
+        bool is_written; // written into the file by bulk transfer already
         bool is_valid;
         int retry_count;
+        uint64_t copy_start_ns;
+        uint64_t write_start_ns;
         zlock lock; // to protect is_valid
 
         copy_request_ex(const file_context_ptr &file, int idx, int try_count)
@@ -120,8 +123,11 @@ public:
             size = 0;
             is_last = false;
             is_ready_for_write = false;
+            is_written = false;
             is_valid = true;
             retry_count = try_count;
+            copy_start_ns = 0;
+            write_start_ns = 0;
         }
     };
 
@@ -131,6 +137,7 @@ public:
 
         std::string file_name;
         uint64_t file_size;
+        uint64_t bulk_ticket; // 0 if copied by rpc
 
         file_wrapper_ptr file_holder;
         int current_write_index;
@@ -142,6 +149,7 @@ public:
             user_req = req;
             file_name = file_nm;
             file_size = sz;
+            bulk_ticket = 0;
             file_holder = new file_wrapper();
             current_write_index = -1;
             finished_segments = 0;
@@ -158,6 +166,8 @@ public:
         ::dsn::ref_ptr<aio_task> nfs_task;
         std::atomic<int> finished_files;
         std::atomic<int> concurrent_copy_count;
+        std::atomic<bool> use_bulk; // whether to copy by bulk transfer
+        rpc_address bulk_address;
         bool is_finished;
 
         std::vector<file_context_ptr> file_contexts;
@@ -168,6 +178,7 @@ public:
             low_queue_index = -1;
             finished_files = 0;
             concurrent_copy_count = 0;
+            use_bulk = false;
             is_finished = false;
         }
     };
@@ -266,16 +277,42 @@ private:
     void
     end_copy(::dsn::error_code err, const copy_response &resp, const copy_request_ex_ptr &reqc);
 
+    // copy the block by bulk transfer, which writes it into the file directly
+    void bulk_copy(const copy_request_ex_ptr &reqc);
+
+    void end_bulk_copy(error_code err, const copy_request_ex_ptr &reqc);
+
+    // retry the copy request, or fail the user request if no retry left
+    void handle_copy_failure(error_code err, const copy_request_ex_ptr &reqc);
+
+    // queue the blocks of the file ready to be written in order, starting from `reqc`
+    void prepare_writes(const copy_request_ex_ptr &reqc);
+
     void continue_write();
 
     void end_write(error_code err, size_t sz, const copy_request_ex_ptr &reqc);
 
+    void on_block_written(error_code err, size_t sz, const copy_request_ex_ptr &reqc);
+
     void handle_completion(const user_request_ptr &req, error_code err);
 
+    int32_t max_concurrent_copy_requests() const;
+
+    int32_t max_concurrent_local_writes() const;
+
+    uint64_t copy_rate_bytes() const;
+
+    void adjust_copy_limits();
+
+    void reset_copy_rate(uint32_t max_copy_rate_bytes);
+
     void register_cli_commands();
 
 private:
-    std::unique_ptr<folly::TokenBucket> _copy_token_bucket; // rate limiter of copy from remote
+    // rate limiter of copy from remote, the rate is passed on each consume so that it can be
+    // changed while the copies are waiting on it
+    std::unique_ptr<folly::DynamicTokenBucket> _copy_token_bucket;
+    std::atomic<uint64_t> _max_copy_rate_bytes; // used if the adaptive copy is not enabled
 
     std::atomic<int> _concurrent_copy_request_count; // record concurrent request count, limited
                                                      // by max_concurrent_remote_copy_requests.
@@ -297,9 +334,16 @@ private:
     perf_counter_wrapper _recent_write_data_size;
     perf_counter_wrapper _recent_write_fail_count;
 
+    // adapts the copy limits, nullptr if not enabled
+    std::unique_ptr<nfs_copy_scheduler> _copy_scheduler;
+    ::dsn::task_ptr _adjust_copy_limits_timer;
+
     dsn_handle_t _nfs_max_copy_rate_megabytes_cmd;
 
     dsn::task_tracker _tracker;
+
+    // declared after `_tracker`, since its threads enqueue tasks tracked by `_tracker`
+    std::unique_ptr<nfs_bulk_fetcher> _bulk_fetcher;
 };
 } // namespace service
 } // namespace dsn
@@ -48,5 +48,7 @@ DEFINE_TASK_CODE(LPC_NFS_FILE_CLOSE_TIMER, TASK_PRIORITY_COMMON, THREAD_POOL_DEF
 DEFINE_TASK_CODE_AIO(LPC_NFS_WRITE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
 DEFINE_TASK_CODE_AIO(LPC_NFS_COPY_FILE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+DEFINE_TASK_CODE(LPC_NFS_ADJUST_COPY_LIMITS_TIMER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 }
 }
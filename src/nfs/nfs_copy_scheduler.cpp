@@ -0,0 +1,203 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "nfs_copy_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <dsn/dist/fmt_logging.h>
+
+namespace dsn {
+namespace service {
+
+DSN_DEFINE_bool("nfs",
+                enable_adaptive_copy,
+                false,
+                "whether to adapt the concurrency and the rate of the nfs client copies to the "
+                "observed latencies, the configured limits are used as the upper bounds");
+DSN_DEFINE_uint32("nfs",
+                  adaptive_copy_interval_ms,
+                  1000,
+                  "the interval to adjust the limits of the nfs client copies");
+DSN_DEFINE_string("nfs",
+                  adaptive_copy_foreground_latency_counter,
+                  "",
+                  "full name of the perf counter of the foreground latency in nanoseconds, "
+                  "the p99 is used for percentile counters, empty means not used");
+DSN_DEFINE_uint64("nfs",
+                  adaptive_copy_foreground_latency_threshold_ns,
+                  100 * 1000 * 1000,
+                  "the nfs client copies back off if the foreground latency exceeds it");
+DSN_TAG_VARIABLE(adaptive_copy_foreground_latency_threshold_ns, FT_MUTABLE);
+DSN_DEFINE_double("nfs",
+                  adaptive_copy_latency_inflation_ratio,
+                  3.0,
+                  "the nfs client copies back off if the latency of the local writes or of the "
+                  "remote copies exceeds this ratio of the lowest latency observed recently");
+DSN_TAG_VARIABLE(adaptive_copy_latency_inflation_ratio, FT_MUTABLE);
+DSN_DEFINE_double("nfs",
+                  adaptive_copy_level_step,
+                  0.0625,
+                  "the fraction of the configured limits the nfs client copies speed up by "
+                  "in each interval when not congested");
+DSN_TAG_VARIABLE(adaptive_copy_level_step, FT_MUTABLE);
+
+// the copies never slow down below this fraction of the configured limits
+static const double kMinLevel = 1.0 / 32;
+// the baseline rises by this ratio in each interval, so that it follows a permanent slowdown
+static const double kBaselineRiseRatio = 1.01;
+
+void nfs_copy_scheduler::latency_stat::add(uint64_t latency_ns)
+{
+    sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t nfs_copy_scheduler::latency_stat::take(/*out*/ bool &inflated)
+{
+    inflated = false;
+    uint64_t n = count.exchange(0, std::memory_order_relaxed);
+    uint64_t sum = sum_ns.exchange(0, std::memory_order_relaxed);
+    if (n == 0) {
+        return 0;
+    }
+
+    uint64_t avg = sum / n;
+    if (baseline_ns == 0) {
+        baseline_ns = avg;
+    } else {
+        inflated = avg > baseline_ns * FLAGS_adaptive_copy_latency_inflation_ratio;
+        baseline_ns = std::min<uint64_t>(avg, baseline_ns * kBaselineRiseRatio + 1);
+    }
+    return avg;
+}
+
+nfs_copy_scheduler::nfs_copy_scheduler(int32_t max_copy_requests,
+                                       int32_t max_local_writes,
+                                       uint64_t max_copy_rate_bytes,
+                                       uint64_t min_copy_rate_bytes)
+    : _max_copy_requests_limit(max_copy_requests),
+      _max_local_writes_limit(max_local_writes),
+      _max_copy_rate_bytes_limit(max_copy_rate_bytes),
+      _min_copy_rate_bytes(min_copy_rate_bytes),
+      // start from the middle, and find the proper level quickly in both directions
+      _level(0.5),
+      _congested_level(1.0)
+{
+    _level_counter.init_app_counter("eon.nfs_client",
+                                    "adaptive_copy_level_percent",
+                                    COUNTER_TYPE_NUMBER,
+                                    "the percent of the configured limits the copies run at");
+    _max_copy_requests_counter.init_app_counter("eon.nfs_client",
+                                                "adaptive_max_concurrent_copy_requests",
+                                                COUNTER_TYPE_NUMBER,
+                                                "the adapted max concurrent remote copies");
+    _max_local_writes_counter.init_app_counter("eon.nfs_client",
+                                               "adaptive_max_concurrent_local_writes",
+                                               COUNTER_TYPE_NUMBER,
+                                               "the adapted max concurrent local writes");
+    _copy_rate_counter.init_app_counter("eon.nfs_client",
+                                        "adaptive_copy_rate_megabytes",
+                                        COUNTER_TYPE_NUMBER,
+                                        "the adapted max rate(MB/s) of copying");
+    _remote_copy_latency_counter.init_app_counter(
+        "eon.nfs_client",
+        "remote_copy_latency_ns",
+        COUNTER_TYPE_NUMBER,
+        "the average latency of copying a block from remote in the last interval");
+    _local_write_latency_counter.init_app_counter(
+        "eon.nfs_client",
+        "local_write_latency_ns",
+        COUNTER_TYPE_NUMBER,
+        "the average latency of writing a block locally in the last interval");
+    _backoff_count.init_app_counter("eon.nfs_client",
+                                    "adaptive_copy_backoff_count",
+                                    COUNTER_TYPE_VOLATILE_NUMBER,
+                                    "the times the copies slowed down for congestion");
+
+    apply();
+}
+
+void nfs_copy_scheduler::on_remote_copy(uint64_t latency_ns)
+{
+    _remote_copy_latency.add(latency_ns);
+}
+
+void nfs_copy_scheduler::on_local_write(uint64_t latency_ns)
+{
+    _local_write_latency.add(latency_ns);
+}
+
+void nfs_copy_scheduler::adjust(uint64_t foreground_latency_ns)
+{
+    bool remote_copy_inflated;
+    bool local_write_inflated;
+    uint64_t remote_copy_ns = _remote_copy_latency.take(remote_copy_inflated);
+    uint64_t local_write_ns = _local_write_latency.take(local_write_inflated);
+    _remote_copy_latency_counter->set(remote_copy_ns);
+    _local_write_latency_counter->set(local_write_ns);
+
+    bool foreground_slow =
+        foreground_latency_ns > FLAGS_adaptive_copy_foreground_latency_threshold_ns;
+    if (remote_copy_ns == 0 && local_write_ns == 0) {
+        // no copy is running, nothing to adjust
+    } else if (foreground_slow || remote_copy_inflated || local_write_inflated) {
+        _congested_level = _level;
+        _level = std::max(_level / 2, kMinLevel);
+        _backoff_count->increment();
+        ddebug_f("nfs copies back off to level {}: foreground_latency_ns = {}, "
+                 "remote_copy_latency_ns = {}, local_write_latency_ns = {}",
+                 _level,
+                 foreground_latency_ns,
+                 remote_copy_ns,
+                 local_write_ns);
+    } else {
+        double step = FLAGS_adaptive_copy_level_step;
+        if (_level < _congested_level && _level + step >= _congested_level) {
+            // approach the level congested last time carefully
+            step /= 4;
+        }
+        _level = std::min(_level + step, 1.0);
+    }
+    apply();
+}
+
+void nfs_copy_scheduler::set_max_copy_rate_bytes(uint64_t max_copy_rate_bytes)
+{
+    _max_copy_rate_bytes_limit.store(max_copy_rate_bytes);
+}
+
+void nfs_copy_scheduler::apply()
+{
+    _max_copy_requests.store(
+        std::max<int32_t>(static_cast<int32_t>(std::lround(_max_copy_requests_limit * _level)), 1));
+    _max_local_writes.store(
+        std::max<int32_t>(static_cast<int32_t>(std::lround(_max_local_writes_limit * _level)), 1));
+    // the lower bound never exceeds the upper bound, which may be lowered at runtime
+    const uint64_t max_copy_rate_bytes = _max_copy_rate_bytes_limit.load();
+    _copy_rate_bytes.store(std::max<uint64_t>(
+        max_copy_rate_bytes * _level, std::min(_min_copy_rate_bytes, max_copy_rate_bytes)));
+
+    _level_counter->set(std::lround(_level * 100));
+    _max_copy_requests_counter->set(_max_copy_requests.load());
+    _max_local_writes_counter->set(_max_local_writes.load());
+    _copy_rate_counter->set(_copy_rate_bytes.load() >> 20);
+}
+
+} // namespace service
+} // namespace dsn
@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace service {
+
+DSN_DECLARE_bool(enable_adaptive_copy);
+DSN_DECLARE_uint32(adaptive_copy_interval_ms);
+DSN_DECLARE_string(adaptive_copy_foreground_latency_counter);
+
+// nfs_copy_scheduler adapts the limits of the nfs client copies to the load they put on the
+// disks and the network, instead of copying at the configured limits all the time.
+//
+// The copies run at a `level` in (0, 1] of the configured limits: the max concurrent remote
+// copy requests, the max concurrent local writes and the max copy rate are all scaled by it.
+// Every `adaptive_copy_interval_ms` the level is adjusted in the AIMD way:
+//  - it's halved if the copies are congested, i.e. the foreground latency exceeds
+//    `adaptive_copy_foreground_latency_threshold_ns`, or the latency of the local writes or
+//    of the remote copies is inflated `adaptive_copy_latency_inflation_ratio` times over its
+//    baseline, which is the lowest latency observed recently.
+//  - otherwise it's increased by `adaptive_copy_level_step`, or by a quarter of it when it's
+//    about to reach the level congested last time.
+// The level is kept if no copy ran in the interval.
+class nfs_copy_scheduler
+{
+public:
+    nfs_copy_scheduler(int32_t max_copy_requests,
+                       int32_t max_local_writes,
+                       uint64_t max_copy_rate_bytes,
+                       uint64_t min_copy_rate_bytes);
+
+    // Records the latency of a remote copy or a local write of a full block.
+    // thread safe
+    void on_remote_copy(uint64_t latency_ns);
+    void on_local_write(uint64_t latency_ns);
+
+    // Adjusts the level with the samples recorded since the last adjustment.
+    // `foreground_latency_ns` is 0 if unknown.
+    void adjust(uint64_t foreground_latency_ns);
+
+    // Changes the upper bound of the copy rate, which is applied on the next adjustment.
+    // thread safe
+    void set_max_copy_rate_bytes(uint64_t max_copy_rate_bytes);
+
+    double level() const { return _level; }
+    int32_t max_copy_requests() const { return _max_copy_requests.load(); }
+    int32_t max_local_writes() const { return _max_local_writes.load(); }
+    uint64_t copy_rate_bytes() const { return _copy_rate_bytes.load(); }
+
+private:
+    struct latency_stat
+    {
+        std::atomic<uint64_t> sum_ns{0};
+        std::atomic<uint64_t> count{0};
+        uint64_t baseline_ns{0};
+
+        void add(uint64_t latency_ns);
+
+        // Returns the average latency since the last call, 0 if no sample, and whether it's
+        // inflated over the baseline.
+        uint64_t take(/*out*/ bool &inflated);
+    };
+
+    void apply();
+
+private:
+    const int32_t _max_copy_requests_limit;
+    const int32_t _max_local_writes_limit;
+    std::atomic<uint64_t> _max_copy_rate_bytes_limit;
+    const uint64_t _min_copy_rate_bytes;
+
+    latency_stat _remote_copy_latency;
+    latency_stat _local_write_latency;
+
+    // only accessed by adjust()
+    double _level;
+    double _congested_level; // the level when congested last time
+
+    std::atomic<int32_t> _max_copy_requests;
+    std::atomic<int32_t> _max_local_writes;
+    std::atomic<uint64_t> _copy_rate_bytes;
+
+    perf_counter_wrapper _level_counter;
+    perf_counter_wrapper _max_copy_requests_counter;
+    perf_counter_wrapper _max_local_writes_counter;
+    perf_counter_wrapper _copy_rate_counter;
+    perf_counter_wrapper _remote_copy_latency_counter;
+    perf_counter_wrapper _local_write_latency_counter;
+    perf_counter_wrapper _backoff_count;
+};
+
+} // namespace service
+} // namespace dsn
@@ -64,8 +64,12 @@ error_code nfs_node_simple::start()
 
 error_code nfs_node_simple::stop()
 {
-    delete _server;
-    _server = nullptr;
+    if (_server != nullptr) {
+        // unregister the handlers, so that the node can be started again
+        _server->close_service();
+        delete _server;
+        _server = nullptr;
+    }
 
     delete _client;
     _client = nullptr;
@@ -62,6 +62,14 @@ nfs_service_impl::nfs_service_impl() : ::dsn::serverlet<nfs_service_impl>("nfs")
         "recent_copy_fail_count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "nfs server copy fail count count in the recent period");
+
+    if (FLAGS_enable_bulk_transfer) {
+        _bulk_server.reset(new nfs_bulk_server(_recent_copy_data_size, _recent_copy_fail_count));
+        if (_bulk_server->start() != ERR_OK) {
+            dwarn("{nfs_service} start bulk transfer server failed, copy files by rpc only");
+            _bulk_server.reset();
+        }
+    }
 }
 
 void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
@@ -222,6 +230,16 @@ void nfs_service_impl::on_get_file_size(
     }
 
     resp.error = err;
+    if (_bulk_server != nullptr && err == ERR_OK) {
+        std::vector<int64_t> tickets;
+        tickets.reserve(resp.file_list.size());
+        for (const auto &file_name : resp.file_list) {
+            tickets.push_back(
+                static_cast<int64_t>(_bulk_server->issue_ticket(request.source_dir, file_name)));
+        }
+        resp.__set_bulk_address(_bulk_server->address());
+        resp.__set_bulk_tickets(std::move(tickets));
+    }
     reply(resp);
 }
 
@@ -34,6 +34,7 @@
 #include "nfs_code_definition.h"
 #include "nfs_types.h"
 #include "nfs_client_impl.h"
+#include "nfs_bulk_transfer.h"
 
 namespace dsn {
 namespace service {
@@ -125,6 +126,9 @@ private:
     perf_counter_wrapper _recent_copy_data_size;
     perf_counter_wrapper _recent_copy_fail_count;
 
+    // serves the copies by bulk transfer, nullptr if not enabled
+    std::unique_ptr<nfs_bulk_server> _bulk_server;
+
     dsn::task_tracker _tracker;
 };
 } // namespace service
@@ -1,3 +1,3 @@
 #!/bin/sh
 
-rm -rf data nfs_test_dir nfs_test_dir_copy dsn_nfs_test.xml
+rm -rf data nfs_test_dir nfs_test_dir_copy nfs_bulk_test_dir nfs_bulk_ticket_dir nfs_benchmark_dir dsn_nfs_test.xml
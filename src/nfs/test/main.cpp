@@ -1,10 +1,26 @@
 #include <gtest/gtest.h>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include <dsn/service_api_c.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/dist/nfs_node.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/rand.h>
+
+#include "nfs/nfs_bulk_transfer.h"
+
+namespace dsn {
+namespace service {
+DSN_DECLARE_bool(enable_bulk_transfer);
+DSN_DECLARE_int32(max_copy_rate_megabytes);
+} // namespace service
+} // namespace dsn
 
 using namespace dsn;
 
@@ -144,6 +160,186 @@ TEST(nfs, basic)
     nfs->stop();
 }
 
+static void generate_file(const std::string &file_path, size_t size)
+{
+    std::string block(1 << 20, '\0');
+    for (auto &c : block) {
+        c = static_cast<char>(rand::next_u32());
+    }
+    std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+    for (size_t written = 0; written < size; written += block.size()) {
+        out.write(block.data(), std::min(block.size(), size - written));
+        // make the blocks differ from each other
+        block[0]++;
+    }
+}
+
+static std::string read_file(const std::string &file_path)
+{
+    std::ifstream in(file_path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static aio_result copy_files(dsn::nfs_node *nfs,
+                             const std::string &source_dir,
+                             const std::vector<std::string> &files,
+                             const std::string &dest_dir)
+{
+    aio_result r;
+    dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                 source_dir,
+                                                 files,
+                                                 dest_dir,
+                                                 true,
+                                                 false,
+                                                 LPC_AIO_TEST_NFS,
+                                                 nullptr,
+                                                 [&r](dsn::error_code err, size_t sz) {
+                                                     r.err = err;
+                                                     r.sz = sz;
+                                                 },
+                                                 0);
+    if (!t->wait(60000)) {
+        r.err = ERR_TIMEOUT;
+    }
+    return r;
+}
+
+TEST(nfs, bulk_transfer)
+{
+    using service::FLAGS_enable_bulk_transfer;
+    PRESERVE_FLAG(enable_bulk_transfer);
+    FLAGS_enable_bulk_transfer = true;
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    utils::filesystem::remove_path("nfs_bulk_test_dir");
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_bulk_test_dir/src"));
+    // not aligned to nfs_copy_block_bytes
+    const size_t file_size = (10 << 20) + 123;
+    generate_file("nfs_bulk_test_dir/src/file1", file_size);
+    generate_file("nfs_bulk_test_dir/src/file2", 0);
+
+    aio_result r = copy_files(
+        nfs.get(), "nfs_bulk_test_dir/src", {"file1", "file2"}, "nfs_bulk_test_dir/dst");
+    ASSERT_EQ(ERR_OK, r.err);
+    ASSERT_EQ(file_size, r.sz);
+    ASSERT_EQ(read_file("nfs_bulk_test_dir/src/file1"), read_file("nfs_bulk_test_dir/dst/file1"));
+    ASSERT_TRUE(utils::filesystem::file_exists("nfs_bulk_test_dir/dst/file2"));
+
+    nfs->stop();
+    utils::filesystem::remove_path("nfs_bulk_test_dir");
+}
+
+static error_code bulk_fetch(service::nfs_bulk_fetcher &fetcher,
+                             rpc_address server,
+                             uint64_t ticket,
+                             uint64_t file_size,
+                             const std::string &local_file)
+{
+    std::promise<error_code> result;
+    fetcher.fetch(server, ticket, file_size, 0, file_size, local_file, [&result](error_code err) {
+        result.set_value(err);
+    });
+    return result.get_future().get();
+}
+
+TEST(nfs, bulk_transfer_ticket)
+{
+    perf_counter_wrapper copy_data_size;
+    perf_counter_wrapper copy_fail_count;
+    copy_data_size.init_global_counter(
+        "test", "nfs", "bulk_copy_data_size", COUNTER_TYPE_NUMBER, "bulk copy data size");
+    copy_fail_count.init_global_counter(
+        "test", "nfs", "bulk_copy_fail_count", COUNTER_TYPE_NUMBER, "bulk copy fail count");
+    service::nfs_bulk_server server(copy_data_size, copy_fail_count);
+    ASSERT_EQ(ERR_OK, server.start());
+    service::nfs_bulk_fetcher fetcher;
+
+    utils::filesystem::remove_path("nfs_bulk_ticket_dir");
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_bulk_ticket_dir/src/sub"));
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_bulk_ticket_dir/src2"));
+    generate_file("nfs_bulk_ticket_dir/src/sub/file", 100);
+    generate_file("nfs_bulk_ticket_dir/src2/file", 100);
+    ASSERT_EQ(0, ::symlink("../src2/file", "nfs_bulk_ticket_dir/src/link"));
+
+    // only the regular files inside the source dir are served
+    const std::string source_dir = "nfs_bulk_ticket_dir/src";
+    ASSERT_EQ(0, server.issue_ticket(source_dir, "../src2/file"));
+    ASSERT_EQ(0, server.issue_ticket(source_dir, "link"));
+    ASSERT_EQ(0, server.issue_ticket(source_dir, "sub"));
+    ASSERT_EQ(0, server.issue_ticket(source_dir, "not_exist"));
+    uint64_t ticket = server.issue_ticket(source_dir, "/sub/file");
+    ASSERT_NE(0, ticket);
+
+    // a forged ticket is denied
+    ASSERT_EQ(ERR_ACL_DENY,
+              bulk_fetch(fetcher, server.address(), ticket + 1, 100, "nfs_bulk_ticket_dir/dst1"));
+    fetcher.release(ticket + 1);
+    ASSERT_FALSE(utils::filesystem::file_exists("nfs_bulk_ticket_dir/dst1"));
+
+    ASSERT_EQ(ERR_OK,
+              bulk_fetch(fetcher, server.address(), ticket, 100, "nfs_bulk_ticket_dir/dst2"));
+    fetcher.release(ticket);
+    ASSERT_EQ(read_file("nfs_bulk_ticket_dir/src/sub/file"),
+              read_file("nfs_bulk_ticket_dir/dst2"));
+
+    // a ticket is used only once
+    ASSERT_EQ(ERR_ACL_DENY,
+              bulk_fetch(fetcher, server.address(), ticket, 100, "nfs_bulk_ticket_dir/dst3"));
+    fetcher.release(ticket);
+
+    utils::filesystem::remove_path("nfs_bulk_ticket_dir");
+}
+
+// Compares the throughput and cpu cost of copying by rpc and by bulk transfer, run it with
+// --gtest_also_run_disabled_tests. The client and the server run in the same process, so the
+// cpu time covers both sides.
+TEST(nfs, DISABLED_copy_benchmark)
+{
+    using service::FLAGS_enable_bulk_transfer;
+    using service::FLAGS_max_copy_rate_megabytes;
+    PRESERVE_FLAG(enable_bulk_transfer);
+    PRESERVE_FLAG(max_copy_rate_megabytes);
+
+    const size_t file_size = 256 << 20;
+    utils::filesystem::remove_path("nfs_benchmark_dir");
+    ASSERT_TRUE(utils::filesystem::create_directory("nfs_benchmark_dir/src"));
+    generate_file("nfs_benchmark_dir/src/file", file_size);
+
+    // don't throttle the copy
+    FLAGS_max_copy_rate_megabytes = 100000;
+    for (bool bulk_transfer : {false, true}) {
+        FLAGS_enable_bulk_transfer = bulk_transfer;
+        std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+        nfs->start();
+
+        struct rusage start_usage, end_usage;
+        ASSERT_EQ(0, getrusage(RUSAGE_SELF, &start_usage));
+        uint64_t start = dsn_now_ns();
+        aio_result r =
+            copy_files(nfs.get(), "nfs_benchmark_dir/src", {"file"}, "nfs_benchmark_dir/dst");
+        uint64_t elapsed_ns = dsn_now_ns() - start;
+        ASSERT_EQ(0, getrusage(RUSAGE_SELF, &end_usage));
+        ASSERT_EQ(ERR_OK, r.err);
+        ASSERT_EQ(file_size, r.sz);
+
+        auto cpu_us = [](const struct rusage &u) {
+            return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1000000L + u.ru_utime.tv_usec +
+                   u.ru_stime.tv_usec;
+        };
+        double cpu_seconds = (cpu_us(end_usage) - cpu_us(start_usage)) / 1e6;
+        std::cout << (bulk_transfer ? "bulk transfer" : "rpc") << ": "
+                  << (file_size >> 20) * 1e9 / elapsed_ns << " MB/s, "
+                  << cpu_seconds * (1 << 30) / file_size << " cpu seconds per GB" << std::endl;
+
+        nfs->stop();
+        utils::filesystem::remove_path("nfs_benchmark_dir/dst");
+    }
+
+    utils::filesystem::remove_path("nfs_benchmark_dir");
+}
+
 int g_test_ret = 0;
 GTEST_API_ int main(int argc, char **argv)
 {
@@ -0,0 +1,216 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+
+#include "nfs/nfs_copy_scheduler.h"
+
+namespace dsn {
+namespace service {
+
+DSN_DECLARE_uint64(adaptive_copy_foreground_latency_threshold_ns);
+
+// A disk shared by the foreground requests and the copies of a recovery, modeled as a queue
+// whose latencies grow with 1 / (1 - utilization).
+struct simulated_disk
+{
+    const double capacity_mb = 400;
+    const double max_utilization = 0.98;
+    const uint64_t foreground_latency_ns = 2000000;  // p99 of an idle disk
+    const uint64_t block_write_latency_ns = 10000000; // of an idle disk
+    // each copy stream is limited by the network and the remote server
+    const double stream_mb = 20;
+    const uint64_t remote_copy_latency_ns = 200000000;
+
+    double utilization = 0;
+    double copy_mb = 0;
+
+    // Runs the disk for one interval with the limits of `scheduler`, feeds it with the
+    // samples of the copies, and returns the foreground p99 latency.
+    uint64_t run(nfs_copy_scheduler &scheduler, double foreground_mb)
+    {
+        copy_mb = std::min<double>(scheduler.copy_rate_bytes() >> 20,
+                                   scheduler.max_copy_requests() * stream_mb);
+        utilization = std::min((foreground_mb + copy_mb) / capacity_mb, max_utilization);
+
+        const auto write_latency_ns =
+            static_cast<uint64_t>(block_write_latency_ns / (1 - utilization));
+        for (int i = 0; i < std::max(1, static_cast<int>(copy_mb / 4)); ++i) {
+            scheduler.on_local_write(write_latency_ns);
+            scheduler.on_remote_copy(remote_copy_latency_ns);
+        }
+        if (foreground_mb == 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(foreground_latency_ns / (1 - utilization));
+    }
+};
+
+TEST(nfs_copy_scheduler, limits)
+{
+    nfs_copy_scheduler scheduler(50, 40, 500 << 20, 8 << 20);
+    ASSERT_EQ(0.5, scheduler.level());
+    ASSERT_EQ(25, scheduler.max_copy_requests());
+    ASSERT_EQ(20, scheduler.max_local_writes());
+    ASSERT_EQ(250u << 20, scheduler.copy_rate_bytes());
+
+    // no copy is running
+    scheduler.adjust(UINT64_MAX);
+    ASSERT_EQ(0.5, scheduler.level());
+
+    // not congested
+    for (int i = 0; i < 20; ++i) {
+        scheduler.on_local_write(1000);
+        scheduler.on_remote_copy(1000);
+        scheduler.adjust(0);
+    }
+    ASSERT_EQ(1.0, scheduler.level());
+    ASSERT_EQ(50, scheduler.max_copy_requests());
+    ASSERT_EQ(40, scheduler.max_local_writes());
+    ASSERT_EQ(500u << 20, scheduler.copy_rate_bytes());
+
+    // the local writes are slow
+    scheduler.on_local_write(10000);
+    scheduler.adjust(0);
+    ASSERT_EQ(0.5, scheduler.level());
+
+    // the remote copies are slow
+    scheduler.on_remote_copy(10000);
+    scheduler.adjust(0);
+    ASSERT_EQ(0.25, scheduler.level());
+
+    // the foreground is slow
+    for (int i = 0; i < 10; ++i) {
+        scheduler.on_local_write(1000);
+        scheduler.adjust(FLAGS_adaptive_copy_foreground_latency_threshold_ns + 1);
+    }
+    ASSERT_EQ(1.0 / 32, scheduler.level());
+    ASSERT_EQ(2, scheduler.max_copy_requests());
+    ASSERT_EQ(1, scheduler.max_local_writes());
+    ASSERT_EQ((500u << 20) / 32, scheduler.copy_rate_bytes());
+
+    scheduler.set_max_copy_rate_bytes(1000 << 20);
+    scheduler.on_local_write(1000);
+    scheduler.adjust(0);
+    ASSERT_EQ((1000u << 20) * 3 / 32, scheduler.copy_rate_bytes());
+
+    // the min copy rate is clamped to the max one
+    scheduler.set_max_copy_rate_bytes(4 << 20);
+    scheduler.adjust(0);
+    ASSERT_EQ(4u << 20, scheduler.copy_rate_bytes());
+    nfs_copy_scheduler small_scheduler(50, 40, 4 << 20, 8 << 20);
+    ASSERT_EQ(4u << 20, small_scheduler.copy_rate_bytes());
+}
+
+struct recovery_result
+{
+    double busy_copy_mb = 0;
+    double idle_copy_mb = 0;
+    uint64_t p80_foreground_latency_ns = 0;
+    uint64_t max_foreground_latency_ns = 0;
+};
+
+// A recovery copies while the foreground is busy, and then while it's idle.
+static recovery_result simulate_recovery(double busy_foreground_mb)
+{
+    const int intervals = 120;
+    recovery_result r;
+
+    simulated_disk disk;
+    nfs_copy_scheduler scheduler(50, 50, 500 << 20, 8 << 20);
+    std::vector<uint64_t> foreground_latencies;
+    for (int i = 0; i < intervals; ++i) {
+        uint64_t latency_ns = disk.run(scheduler, busy_foreground_mb);
+        scheduler.adjust(latency_ns);
+        // skip the first intervals to find the proper level
+        if (i >= 10) {
+            foreground_latencies.push_back(latency_ns);
+            r.busy_copy_mb += disk.copy_mb;
+        }
+    }
+    r.busy_copy_mb /= foreground_latencies.size();
+
+    for (int i = 0; i < intervals; ++i) {
+        scheduler.adjust(disk.run(scheduler, 0));
+        if (i >= 10) {
+            r.idle_copy_mb += disk.copy_mb;
+        }
+    }
+    r.idle_copy_mb /= intervals - 10;
+
+    std::sort(foreground_latencies.begin(), foreground_latencies.end());
+    r.p80_foreground_latency_ns = foreground_latencies[foreground_latencies.size() * 8 / 10];
+    r.max_foreground_latency_ns = foreground_latencies.back();
+    return r;
+}
+
+TEST(nfs_copy_scheduler, simulated_recovery)
+{
+    PRESERVE_FLAG(adaptive_copy_foreground_latency_threshold_ns);
+    FLAGS_adaptive_copy_foreground_latency_threshold_ns = 20000000;
+
+    const double busy_foreground_mb = 200;
+
+    // copying at the configured limits saturates the disk
+    {
+        simulated_disk disk;
+        nfs_copy_scheduler scheduler(50, 50, 500 << 20, 8 << 20);
+        for (int i = 0; i < 20; ++i) {
+            scheduler.on_local_write(1);
+            scheduler.adjust(0);
+        }
+        ASSERT_EQ(1.0, scheduler.level());
+        ASSERT_GT(disk.run(scheduler, busy_foreground_mb),
+                  4 * FLAGS_adaptive_copy_foreground_latency_threshold_ns);
+    }
+
+    recovery_result r = simulate_recovery(busy_foreground_mb);
+
+    // the foreground latency overshoots the threshold only slightly and briefly, before the
+    // copies back off
+    ASSERT_LE(r.p80_foreground_latency_ns, FLAGS_adaptive_copy_foreground_latency_threshold_ns);
+    ASSERT_LE(r.max_foreground_latency_ns,
+              FLAGS_adaptive_copy_foreground_latency_threshold_ns * 3 / 2);
+
+    // the recovery keeps making progress while the foreground is busy, and speeds up once
+    // the disk is idle
+    ASSERT_GT(r.busy_copy_mb, 0);
+    ASSERT_GT(r.idle_copy_mb, 1.5 * r.busy_copy_mb);
+}
+
+// prints the copy rates and the foreground latencies of the simulated recovery under several
+// foreground loads, run it with --gtest_also_run_disabled_tests
+TEST(nfs_copy_scheduler, DISABLED_simulated_recovery_report)
+{
+    PRESERVE_FLAG(adaptive_copy_foreground_latency_threshold_ns);
+    FLAGS_adaptive_copy_foreground_latency_threshold_ns = 20000000;
+
+    for (double busy_foreground_mb : {100, 200, 300}) {
+        recovery_result r = simulate_recovery(busy_foreground_mb);
+        std::cout << "foreground " << busy_foreground_mb << " MB/s, busy: copy " << r.busy_copy_mb
+                  << " MB/s, foreground latency p80 " << r.p80_foreground_latency_ns
+                  << " ns, max " << r.max_foreground_latency_ns << " ns; idle: copy "
+                  << r.idle_copy_mb << " MB/s" << std::endl;
+    }
+}
+
+} // namespace service
+} // namespace dsn
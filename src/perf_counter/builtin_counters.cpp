@@ -18,10 +18,15 @@
 #include <dsn/utility/utils.h>
 #include <dsn/c/api_utilities.h>
 #include "builtin_counters.h"
+#include "utils/async_logger.h"
+#include "utils/block_pool.h"
 
 namespace dsn {
 
 builtin_counters::builtin_counters()
+    : _last_block_pool_hit_count(0),
+      _last_block_pool_miss_count(0),
+      _last_logging_dropped_count(0)
 {
     _memused_virt.init_global_counter("replica",
                                       "server",
@@ -33,6 +38,26 @@ builtin_counters::builtin_counters()
                                      "memused.res(MB)",
                                      COUNTER_TYPE_NUMBER,
                                      "physically memory usages in MB");
+    _block_pool_hit_count.init_global_counter("replica",
+                                              "server",
+                                              "block.pool.hit.count",
+                                              COUNTER_TYPE_RATE,
+                                              "allocations served by the rpc block pool");
+    _block_pool_miss_count.init_global_counter("replica",
+                                               "server",
+                                               "block.pool.miss.count",
+                                               COUNTER_TYPE_RATE,
+                                               "allocations of the rpc block pool from system");
+    _block_pool_retained_bytes.init_global_counter("replica",
+                                                   "server",
+                                                   "block.pool.retained.bytes",
+                                                   COUNTER_TYPE_NUMBER,
+                                                   "bytes of free blocks cached by the pool");
+    _logging_dropped_count.init_global_counter("replica",
+                                               "server",
+                                               "logging.dropped.count",
+                                               COUNTER_TYPE_RATE,
+                                               "log records dropped by the async logger");
 }
 
 builtin_counters::~builtin_counters() {}
@@ -46,6 +71,18 @@ void builtin_counters::update_counters()
     uint64_t memused_res = (uint64_t)resident_set / 1024;
     _memused_virt->set(memused_virt);
     _memused_res->set(memused_res);
+
+    utils::block_pool::stats s = utils::block_pool::get_stats();
+    _block_pool_hit_count->add(s.hit_count - _last_block_pool_hit_count);
+    _block_pool_miss_count->add(s.miss_count - _last_block_pool_miss_count);
+    _block_pool_retained_bytes->set(s.retained_bytes);
+    _last_block_pool_hit_count = s.hit_count;
+    _last_block_pool_miss_count = s.miss_count;
+
+    uint64_t logging_dropped_count = tools::async_logger::dropped_records();
+    _logging_dropped_count->add(logging_dropped_count - _last_logging_dropped_count);
+    _last_logging_dropped_count = logging_dropped_count;
+
     ddebug("memused_virt = %" PRIu64 " MB, memused_res = %" PRIu64 "MB", memused_virt, memused_res);
 }
 }
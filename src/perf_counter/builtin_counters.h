@@ -28,5 +28,14 @@ public:
 private:
     dsn::perf_counter_wrapper _memused_virt;
     dsn::perf_counter_wrapper _memused_res;
+
+    uint64_t _last_block_pool_hit_count;
+    uint64_t _last_block_pool_miss_count;
+    dsn::perf_counter_wrapper _block_pool_hit_count;
+    dsn::perf_counter_wrapper _block_pool_miss_count;
+    dsn::perf_counter_wrapper _block_pool_retained_bytes;
+
+    uint64_t _last_logging_dropped_count;
+    dsn::perf_counter_wrapper _logging_dropped_count;
 };
 }
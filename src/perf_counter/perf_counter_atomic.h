@@ -116,6 +116,8 @@ public:
         }
         return val;
     }
+    // the value accumulated since the last get_value()
+    virtual double peek_value() { return perf_counter_number_atomic::get_value(); }
 };
 
 // -----------   RATE perf counter ---------------------------------
@@ -170,6 +172,20 @@ public:
         return _rate;
     }
     virtual int64_t get_integer_value() { return (int64_t)get_value(); }
+    // the rate since the last get_value()
+    virtual double peek_value()
+    {
+        uint64_t now = utils::get_current_physical_time_ns();
+        double interval = (now - _last_time) / 1e9;
+        if (interval <= 0.1)
+            return _rate;
+
+        double val = 0;
+        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
+            val += _val[i].load(std::memory_order_relaxed);
+        }
+        return val / interval;
+    }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
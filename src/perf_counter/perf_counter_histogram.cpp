@@ -0,0 +1,217 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "perf_counter_histogram.h"
+
+#include <algorithm>
+
+#include <dsn/c/api_layer1.h>
+#include <dsn/c/api_utilities.h>
+#include <dsn/utility/process_utils.h>
+
+namespace dsn {
+
+DSN_DEFINE_bool("components.pegasus_perf_counter_number_percentile_atomic",
+                enable_histogram_percentile_counter,
+                false,
+                "whether the percentile counters compute the percentiles of all the values in a "
+                "window by log-linear histograms, instead of selecting from the latest samples");
+DSN_DEFINE_uint32("components.pegasus_perf_counter_number_percentile_atomic",
+                  histogram_percentile_window_seconds,
+                  10,
+                  "the window (seconds) of the values whose percentiles are computed, if "
+                  "enable_histogram_percentile_counter is true");
+
+/*static*/ int log_linear_histogram::bucket_index(int64_t value)
+{
+    if (value < kSubBuckets) {
+        return value < 0 ? 0 : static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    int shift = exponent - kSubBucketBits;
+    return kSubBuckets + shift * kSubBuckets + static_cast<int>(value >> shift) - kSubBuckets;
+}
+
+/*static*/ int64_t log_linear_histogram::bucket_lower_bound(int index)
+{
+    if (index < kSubBuckets) {
+        return index;
+    }
+    int shift = (index - kSubBuckets) / kSubBuckets;
+    int sub = (index - kSubBuckets) % kSubBuckets;
+    return static_cast<int64_t>(kSubBuckets + sub) << shift;
+}
+
+/*static*/ int64_t log_linear_histogram::bucket_upper_bound(int index)
+{
+    if (index < kSubBuckets) {
+        return index;
+    }
+    int shift = (index - kSubBuckets) / kSubBuckets;
+    return bucket_lower_bound(index) + (int64_t(1) << shift) - 1;
+}
+
+void log_linear_histogram::clear() { _counts.fill(0); }
+
+void log_linear_histogram::merge(const log_linear_histogram &other)
+{
+    for (int i = 0; i < kBucketCount; ++i) {
+        _counts[i] += other._counts[i];
+    }
+}
+
+uint64_t log_linear_histogram::total_count() const
+{
+    uint64_t total = 0;
+    for (uint64_t c : _counts) {
+        total += c;
+    }
+    return total;
+}
+
+int64_t log_linear_histogram::percentile(double p) const
+{
+    uint64_t total = total_count();
+    if (total == 0) {
+        return 0;
+    }
+    // the same rank as the sample-and-select counter
+    auto rank = std::min(static_cast<uint64_t>(total * p) + 1, total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += _counts[i];
+        if (seen >= rank) {
+            return bucket_lower_bound(i) + (bucket_upper_bound(i) - bucket_lower_bound(i)) / 2;
+        }
+    }
+    return bucket_upper_bound(kBucketCount - 1);
+}
+
+perf_counter_number_histogram_atomic::perf_counter_number_histogram_atomic(
+    const char *app,
+    const char *section,
+    const char *name,
+    dsn_perf_counter_type_t type,
+    const char *dsptr)
+    : perf_counter_number_histogram_atomic(
+          app, section, name, type, dsptr, FLAGS_histogram_percentile_window_seconds)
+{
+}
+
+perf_counter_number_histogram_atomic::perf_counter_number_histogram_atomic(
+    const char *app,
+    const char *section,
+    const char *name,
+    dsn_perf_counter_type_t type,
+    const char *dsptr,
+    uint32_t window_seconds)
+    : perf_counter(app, section, name, type, dsptr),
+      _window_ns(window_seconds * 1000000000ULL),
+      _latest(0),
+      _window_start_ns(dsn_now_ns())
+{
+    for (auto &s : _shards) {
+        for (auto &c : s.counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+    for (auto &r : _results) {
+        r = 0;
+    }
+}
+
+void perf_counter_number_histogram_atomic::increment() { dassert(false, "invalid execution flow"); }
+
+void perf_counter_number_histogram_atomic::decrement() { dassert(false, "invalid execution flow"); }
+
+void perf_counter_number_histogram_atomic::add(int64_t val)
+{
+    dassert(false, "invalid execution flow");
+}
+
+void perf_counter_number_histogram_atomic::set(int64_t val)
+{
+    shard &s = _shards[utils::get_current_tid() % kShards];
+    s.counts[log_linear_histogram::bucket_index(val)].fetch_add(1, std::memory_order_relaxed);
+    _latest.store(val, std::memory_order_relaxed);
+}
+
+double perf_counter_number_histogram_atomic::get_value()
+{
+    dassert(false, "invalid execution flow");
+    return 0.0;
+}
+
+double perf_counter_number_histogram_atomic::get_percentile(dsn_perf_counter_percentile_type_t type)
+{
+    if ((type < 0) || (type >= COUNTER_PERCENTILE_COUNT)) {
+        dassert(false, "send a wrong counter percentile type");
+        return 0.0;
+    }
+
+    std::lock_guard<std::mutex> l(_lock);
+    rotate_if_needed();
+    return (double)_results[type];
+}
+
+bool perf_counter_number_histogram_atomic::get_histogram(histogram_t &buckets)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    rotate_if_needed();
+    buckets.clear();
+    for (int i = 0; i < log_linear_histogram::kBucketCount; ++i) {
+        if (_last_window.count(i) > 0) {
+            buckets.emplace_back(log_linear_histogram::bucket_upper_bound(i),
+                                 _last_window.count(i));
+        }
+    }
+    return true;
+}
+
+void perf_counter_number_histogram_atomic::rotate_if_needed()
+{
+    uint64_t now = dsn_now_ns();
+    if (now - _window_start_ns < _window_ns) {
+        return;
+    }
+    _window_start_ns = now;
+
+    // the values set concurrently are counted in either this window or the next one
+    log_linear_histogram window;
+    for (auto &s : _shards) {
+        for (int i = 0; i < log_linear_histogram::kBucketCount; ++i) {
+            if (s.counts[i].load(std::memory_order_relaxed) != 0) {
+                window.add(i, s.counts[i].exchange(0, std::memory_order_relaxed));
+            }
+        }
+    }
+    if (window.total_count() == 0) {
+        return;
+    }
+
+    _last_window = window;
+    _results[COUNTER_PERCENTILE_50] = window.percentile(0.5);
+    _results[COUNTER_PERCENTILE_90] = window.percentile(0.9);
+    _results[COUNTER_PERCENTILE_95] = window.percentile(0.95);
+    _results[COUNTER_PERCENTILE_99] = window.percentile(0.99);
+    _results[COUNTER_PERCENTILE_999] = window.percentile(0.999);
+}
+
+} // namespace dsn
@@ -0,0 +1,122 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include <dsn/perf_counter/perf_counter.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+
+DSN_DECLARE_bool(enable_histogram_percentile_counter);
+
+// A log-linear histogram of non-negative values. The values below 2^kSubBucketBits are
+// counted exactly, and the values in each [2^k, 2^(k+1)) above are counted in 2^kSubBucketBits
+// linear sub-buckets, so any percentile is reported with a relative error of less than
+// 2^-(kSubBucketBits+1). The values no less than 2^kMaxExponent are counted in the last bucket.
+//
+// Histograms of the same layout are merged by adding up the counts, e.g. across nodes.
+class log_linear_histogram
+{
+public:
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxExponent = 44;
+    static const int kBucketCount = kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+    static int bucket_index(int64_t value);
+    // the values in bucket `index` are in [lower_bound, upper_bound]
+    static int64_t bucket_lower_bound(int index);
+    static int64_t bucket_upper_bound(int index);
+
+    log_linear_histogram() { clear(); }
+
+    void clear();
+    void add(int index, uint64_t count) { _counts[index] += count; }
+    void merge(const log_linear_histogram &other);
+
+    uint64_t total_count() const;
+    uint64_t count(int index) const { return _counts[index]; }
+
+    // returns the middle of the bucket where the value of percentile `p` (in [0, 1]) falls,
+    // 0 if empty
+    int64_t percentile(double p) const;
+
+private:
+    std::array<uint64_t, kBucketCount> _counts;
+};
+
+// perf_counter_number_histogram_atomic is a COUNTER_TYPE_NUMBER_PERCENTILES counter computing
+// the percentiles of all the values set in a window, rather than of the latest samples.
+//
+// The values are counted in several log-linear histograms sharded by thread, which are
+// lock-free to update. The first read after the window ends merges and resets the shards, then
+// computes the percentiles of the window; the reads in the meantime return the percentiles of
+// the last window. If no value is set in a window, the percentiles of the previous one are kept.
+class perf_counter_number_histogram_atomic : public perf_counter
+{
+public:
+    perf_counter_number_histogram_atomic(const char *app,
+                                         const char *section,
+                                         const char *name,
+                                         dsn_perf_counter_type_t type,
+                                         const char *dsptr);
+    perf_counter_number_histogram_atomic(const char *app,
+                                         const char *section,
+                                         const char *name,
+                                         dsn_perf_counter_type_t type,
+                                         const char *dsptr,
+                                         uint32_t window_seconds);
+
+    void increment() override;
+    void decrement() override;
+    void add(int64_t val) override;
+    void set(int64_t val) override;
+
+    double get_value() override;
+    int64_t get_integer_value() override { return (int64_t)get_value(); }
+    double get_percentile(dsn_perf_counter_percentile_type_t type) override;
+
+    int64_t get_latest_sample() const override { return _latest.load(std::memory_order_relaxed); }
+
+    bool get_histogram(/*out*/ histogram_t &buckets) override;
+
+private:
+    // merges the shards into `_last_window` if the current window has ended
+    void rotate_if_needed();
+
+    static const int kShards = 4;
+    struct shard
+    {
+        std::atomic<uint64_t> counts[log_linear_histogram::kBucketCount];
+    };
+
+    const uint64_t _window_ns;
+    shard _shards[kShards];
+    std::atomic<int64_t> _latest;
+
+    std::mutex _lock; // protects the followings
+    uint64_t _window_start_ns;
+    log_linear_histogram _last_window;
+    int64_t _results[COUNTER_PERCENTILE_COUNT];
+};
+
+} // namespace dsn
@@ -24,6 +24,7 @@
  * THE SOFTWARE.
  */
 
+#include <cctype>
 #include <regex>
 
 #include <dsn/perf_counter/perf_counter.h>
@@ -37,14 +38,16 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/utility/string_view.h>
 #include <dsn/utils/time_utils.h>
+#include <fmt/format.h>
 
 #include "perf_counter_atomic.h"
+#include "perf_counter_histogram.h"
 #include "builtin_counters.h"
 #include "runtime/service_engine.h"
 
 namespace dsn {
 
-perf_counters::perf_counters()
+perf_counters::perf_counters() : _open_metrics_size_hint(0)
 {
     // make shared_io_service destructed after perf_counters,
     // because shared_io_service will destruct the timer created by perf_counters
@@ -98,6 +101,7 @@ perf_counters::perf_counters()
 perf_counters::~perf_counters()
 {
     _counters.clear();
+    _metric_families.clear();
     UNREGISTER_VALID_HANDLER(_perf_counters_cmd);
     UNREGISTER_VALID_HANDLER(_perf_counters_by_substr_cmd);
     UNREGISTER_VALID_HANDLER(_perf_counters_by_prefix_cmd);
@@ -130,7 +134,8 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
         auto it = _counters.find(full_name);
         if (it == _counters.end()) {
             perf_counter_ptr counter = new_counter(app, section, name, flags, dsptr);
-            _counters.emplace(full_name, counter_object{counter, 1});
+            _counters.emplace(full_name,
+                              counter_object{counter, 1, add_to_metric_family(counter.get())});
             return counter;
         } else {
             dassert(it->second.counter->type() == flags,
@@ -164,6 +169,7 @@ bool perf_counters::remove_counter(const char *full_name)
             counter_object &c = it->second;
             remain_ref = (--c.user_reference);
             if (remain_ref == 0) {
+                remove_from_metric_family(c.counter.get(), c.metric_family);
                 _counters.erase(it);
             }
         }
@@ -183,6 +189,187 @@ perf_counter_ptr perf_counters::get_counter(const std::string &full_name)
     return nullptr;
 }
 
+// replaces the characters invalid in the OpenMetrics names with '_'
+static void append_open_metrics_name(string_view name, std::string &out)
+{
+    if (name.empty() || isdigit(name[0])) {
+        out.push_back('_');
+    }
+    for (char c : name) {
+        out.push_back((isalnum(c) || c == '_' || c == ':') ? c : '_');
+    }
+}
+
+static void append_open_metrics_label(const char *label, string_view value, std::string &out)
+{
+    out.append(label);
+    out.append("=\"");
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out.append("\\n");
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+static bool is_gpid(string_view s)
+{
+    size_t dot = s.find('.');
+    if (dot == string_view::npos || dot == 0 || dot == s.length() - 1) {
+        return false;
+    }
+    for (size_t i = 0; i < s.length(); ++i) {
+        if (i != dot && !isdigit(s[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *open_metrics_type(dsn_perf_counter_type_t type)
+{
+    switch (type) {
+    case COUNTER_TYPE_NUMBER_PERCENTILES:
+        return "summary";
+    default:
+        return "gauge";
+    }
+}
+
+std::string perf_counters::add_to_metric_family(perf_counter *counter)
+{
+    string_view name(counter->name());
+    string_view entity;
+    size_t at = name.find('@');
+    if (at != string_view::npos) {
+        entity = name.substr(at + 1);
+        name = name.substr(0, at);
+    }
+
+    std::string family;
+    append_open_metrics_name(name, family);
+    auto it = _metric_families.find(family);
+    if (it != _metric_families.end() &&
+        (it->second.type == COUNTER_TYPE_NUMBER_PERCENTILES) !=
+            (counter->type() == COUNTER_TYPE_NUMBER_PERCENTILES)) {
+        // a metric family has only one type
+        family.push_back('_');
+        append_open_metrics_name(dsn_counter_type_to_string(counter->type()), family);
+        it = _metric_families.find(family);
+    }
+    if (it == _metric_families.end()) {
+        it = _metric_families.emplace(family, metric_family()).first;
+        metric_family &f = it->second;
+        f.type = counter->type();
+        std::string header = fmt::format("# TYPE {} {}\n", family, open_metrics_type(f.type));
+        if (counter->dsptr()[0] != '\0') {
+            header.append("# HELP ").append(family).push_back(' ');
+            for (const char *p = counter->dsptr(); *p != '\0'; ++p) {
+                if (*p == '\\') {
+                    header.append("\\\\");
+                } else if (*p == '\n') {
+                    header.append("\\n");
+                } else {
+                    header.push_back(*p);
+                }
+            }
+            header.push_back('\n');
+        }
+        f.header = std::make_shared<const std::string>(std::move(header));
+    }
+
+    std::string sample = family;
+    sample.push_back('{');
+    append_open_metrics_label("app", counter->app(), sample);
+    sample.push_back(',');
+    append_open_metrics_label("section", counter->section(), sample);
+    if (!entity.empty()) {
+        sample.push_back(',');
+        append_open_metrics_label(is_gpid(entity) ? "gpid" : "entity", entity, sample);
+    }
+    it->second.samples.emplace(counter, std::make_shared<const std::string>(std::move(sample)));
+    return family;
+}
+
+void perf_counters::remove_from_metric_family(perf_counter *counter, const std::string &family)
+{
+    auto it = _metric_families.find(family);
+    if (it == _metric_families.end()) {
+        return;
+    }
+    it->second.samples.erase(counter);
+    if (it->second.samples.empty()) {
+        _metric_families.erase(it);
+    }
+}
+
+void perf_counters::render_open_metrics(std::string &out) const
+{
+    static const struct
+    {
+        dsn_perf_counter_percentile_type_t type;
+        const char *label;
+    } kQuantiles[] = {{COUNTER_PERCENTILE_50, ",quantile=\"0.5\"} "},
+                      {COUNTER_PERCENTILE_90, ",quantile=\"0.9\"} "},
+                      {COUNTER_PERCENTILE_95, ",quantile=\"0.95\"} "},
+                      {COUNTER_PERCENTILE_99, ",quantile=\"0.99\"} "},
+                      {COUNTER_PERCENTILE_999, ",quantile=\"0.999\"} "}};
+
+    out.reserve(out.size() + _open_metrics_size_hint.load(std::memory_order_relaxed));
+    size_t start = out.size();
+
+    builtin_counters::instance().update_counters();
+
+    // the headers of the families, each followed by the samples of the family
+    std::vector<std::pair<std::shared_ptr<const std::string>, perf_counter_ptr>> lines;
+    {
+        utils::auto_read_lock l(_lock);
+        lines.reserve(_metric_families.size() + _counters.size());
+        for (const auto &f : _metric_families) {
+            lines.emplace_back(f.second.header, nullptr);
+            for (const auto &s : f.second.samples) {
+                lines.emplace_back(s.second, s.first);
+            }
+        }
+    }
+
+    for (const auto &line : lines) {
+        perf_counter *c = line.second.get();
+        if (c == nullptr) {
+            out.append(*line.first);
+            continue;
+        }
+        switch (c->type()) {
+        case COUNTER_TYPE_NUMBER_PERCENTILES:
+            for (const auto &q : kQuantiles) {
+                out.append(*line.first).append(q.label);
+                out.append(
+                    fmt::format_int(static_cast<int64_t>(c->get_percentile(q.type))).c_str());
+                out.push_back('\n');
+            }
+            break;
+        case COUNTER_TYPE_RATE:
+            out.append(*line.first).append("} ");
+            fmt::format_to(std::back_inserter(out), "{}", c->peek_value());
+            out.push_back('\n');
+            break;
+        default:
+            out.append(*line.first).append("} ");
+            out.append(fmt::format_int(static_cast<int64_t>(c->peek_value())).c_str());
+            out.push_back('\n');
+            break;
+        }
+    }
+    out.append("# EOF\n");
+
+    _open_metrics_size_hint.store(out.size() - start, std::memory_order_relaxed);
+}
+
 perf_counter *perf_counters::new_counter(const char *app,
                                          const char *section,
                                          const char *name,
@@ -195,9 +382,12 @@ perf_counter *perf_counters::new_counter(const char *app,
         return new perf_counter_volatile_number_atomic(app, section, name, type, dsptr);
     else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_RATE)
         return new perf_counter_rate_atomic(app, section, name, type, dsptr);
-    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES)
+    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES) {
+        if (FLAGS_enable_histogram_percentile_counter) {
+            return new perf_counter_number_histogram_atomic(app, section, name, type, dsptr);
+        }
         return new perf_counter_number_percentile_atomic(app, section, name, type, dsptr);
-    else {
+    } else {
         dassert(false, "invalid type(%d)", type);
         return nullptr;
     }
@@ -35,11 +35,16 @@
 
 #include <dsn/tool_api.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
 #include <thread>
 #include <cmath>
 #include <vector>
 
 #include "perf_counter/perf_counter_atomic.h"
+#include "perf_counter/perf_counter_histogram.h"
 
 using namespace dsn;
 using namespace dsn::tools;
@@ -169,3 +174,174 @@ TEST(perf_counter, print_type)
         dsn_percentile_type_from_string(dsn_percentile_type_to_string(COUNTER_PERCENTILE_999)));
     ASSERT_EQ(COUNTER_PERCENTILE_INVALID, dsn_percentile_type_from_string("afafda"));
 }
+
+TEST(perf_counter, log_linear_histogram)
+{
+    // every value is in the bucket it's mapped to, and the buckets are contiguous
+    ASSERT_EQ(0, log_linear_histogram::bucket_index(-1));
+    for (int i = 0; i < log_linear_histogram::kBucketCount; ++i) {
+        int64_t lower = log_linear_histogram::bucket_lower_bound(i);
+        int64_t upper = log_linear_histogram::bucket_upper_bound(i);
+        ASSERT_EQ(i, log_linear_histogram::bucket_index(lower));
+        ASSERT_EQ(i, log_linear_histogram::bucket_index(upper));
+        if (i > 0) {
+            ASSERT_EQ(log_linear_histogram::bucket_upper_bound(i - 1) + 1, lower);
+        }
+        // the middle of the bucket is close enough to any value in it
+        ASSERT_LE((upper - lower) / 2, lower / (2 * log_linear_histogram::kSubBuckets));
+    }
+    ASSERT_EQ(log_linear_histogram::kBucketCount - 1,
+              log_linear_histogram::bucket_index(std::numeric_limits<int64_t>::max()));
+
+    log_linear_histogram h1, h2;
+    for (int64_t v = 1; v <= 1000; ++v) {
+        h1.add(log_linear_histogram::bucket_index(v), 1);
+        h2.add(log_linear_histogram::bucket_index(v * 1000), 1);
+    }
+    ASSERT_NEAR(500, h1.percentile(0.5), 500 / log_linear_histogram::kSubBuckets);
+    h1.merge(h2);
+    ASSERT_EQ(2000, h1.total_count());
+    ASSERT_NEAR(1000, h1.percentile(0.5), 1000 / log_linear_histogram::kSubBuckets);
+    ASSERT_NEAR(990000, h1.percentile(0.99), 990000 / log_linear_histogram::kSubBuckets);
+}
+
+// latencies of a lognormal distribution, and the latest 10% of them are 10 times slower
+static std::vector<int64_t> skewed_latencies(int count)
+{
+    std::mt19937_64 rng(0);
+    std::lognormal_distribution<double> dist(std::log(100000.0), 1.0);
+    std::vector<int64_t> values(count);
+    for (int i = 0; i < count; ++i) {
+        values[i] = static_cast<int64_t>(dist(rng)) * (i >= count * 9 / 10 ? 10 : 1);
+    }
+    return values;
+}
+
+static const struct
+{
+    dsn_perf_counter_percentile_type_t type;
+    double p;
+} kCheckedPercentiles[] = {
+    {COUNTER_PERCENTILE_50, 0.5}, {COUNTER_PERCENTILE_99, 0.99}, {COUNTER_PERCENTILE_999, 0.999}};
+
+TEST(perf_counter, histogram_percentile_accuracy)
+{
+    const int count = 500000;
+    std::vector<int64_t> values = skewed_latencies(count);
+
+    perf_counter_ptr counter = new perf_counter_number_histogram_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "", 0);
+    for (int64_t v : values) {
+        counter->set(v);
+    }
+
+    std::sort(values.begin(), values.end());
+
+    for (const auto &p : kCheckedPercentiles) {
+        auto exact = static_cast<double>(values[static_cast<size_t>(count * p.p)]);
+        double histogram_error = std::abs(counter->get_percentile(p.type) - exact) / exact;
+        ASSERT_LT(histogram_error, 1.0 / log_linear_histogram::kSubBuckets);
+    }
+
+    perf_counter::histogram_t buckets;
+    ASSERT_TRUE(counter->get_histogram(buckets));
+    uint64_t total = 0;
+    for (const auto &b : buckets) {
+        total += b.second;
+    }
+    ASSERT_EQ(static_cast<uint64_t>(count), total);
+}
+
+TEST(perf_counter, histogram_concurrent_set)
+{
+    const int threads = 4;
+    const int count = 100000;
+    perf_counter_ptr counter = new perf_counter_number_histogram_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "", 0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([counter, t]() {
+            for (int i = 0; i < count; ++i) {
+                counter->set((i * 7919 + t) % 1000000);
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    // no value set concurrently is lost
+    perf_counter::histogram_t buckets;
+    ASSERT_TRUE(counter->get_histogram(buckets));
+    uint64_t total = 0;
+    for (const auto &b : buckets) {
+        total += b.second;
+    }
+    ASSERT_EQ(static_cast<uint64_t>(threads * count), total);
+    ASSERT_NEAR(500000, counter->get_percentile(COUNTER_PERCENTILE_50), 500000 / 8);
+}
+
+// compares the error of the histogram with the one of the sample-and-select counter, which only
+// sees the latest 5000 values at best, run it with --gtest_also_run_disabled_tests
+TEST(perf_counter, DISABLED_histogram_percentile_accuracy_vs_latest_samples)
+{
+    const int count = 500000;
+    std::vector<int64_t> values = skewed_latencies(count);
+
+    perf_counter_ptr counter = new perf_counter_number_histogram_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "", 0);
+    for (int64_t v : values) {
+        counter->set(v);
+    }
+
+    std::vector<int64_t> latest(values.end() - MAX_QUEUE_LENGTH, values.end());
+    std::sort(latest.begin(), latest.end());
+    std::sort(values.begin(), values.end());
+
+    for (const auto &p : kCheckedPercentiles) {
+        auto exact = static_cast<double>(values[static_cast<size_t>(count * p.p)]);
+        double histogram_error = std::abs(counter->get_percentile(p.type) - exact) / exact;
+        double latest_error =
+            std::abs(latest[static_cast<size_t>(MAX_QUEUE_LENGTH * p.p)] - exact) / exact;
+        std::cout << dsn_percentile_type_to_string(p.type) << ": exact = " << exact
+                  << ", histogram error = " << histogram_error * 100
+                  << "%, latest samples error = " << latest_error * 100 << "%" << std::endl;
+    }
+}
+
+// compares the cost of the sample-and-select and the histogram counters, run it with
+// --gtest_also_run_disabled_tests
+TEST(perf_counter, DISABLED_histogram_percentile_overhead)
+{
+    const int threads = 4;
+    const int count = 1000000;
+    auto bench = [&](perf_counter_ptr counter) {
+        uint64_t start = dsn_now_ns();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([counter, t]() {
+                for (int i = 0; i < count; ++i) {
+                    counter->set((i * 7919 + t) % 1000000);
+                }
+            });
+        }
+        for (auto &w : workers) {
+            w.join();
+        }
+        double set_ns = double(dsn_now_ns() - start) / (threads * count);
+
+        start = dsn_now_ns();
+        for (int i = 0; i != COUNTER_PERCENTILE_COUNT; ++i) {
+            counter->get_percentile((dsn_perf_counter_percentile_type_t)i);
+        }
+        return std::make_pair(set_ns, (dsn_now_ns() - start) / 1000.0);
+    };
+
+    auto select = bench(new perf_counter_number_percentile_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, ""));
+    auto histogram = bench(new perf_counter_number_histogram_atomic(
+        "", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "", 0));
+    std::cout << "sample-and-select: " << select.first << "ns per set, " << select.second
+              << "us to read; histogram: " << histogram.first << "ns per set, "
+              << histogram.second << "us to read (including the merge)" << std::endl;
+}
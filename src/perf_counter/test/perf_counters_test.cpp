@@ -33,6 +33,10 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <ctime>
+#include <iostream>
+
+#include <dsn/c/api_layer1.h>
 #include <dsn/perf_counter/perf_counters.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/perf_counter/perf_counter_utils.h>
@@ -347,3 +351,129 @@ TEST(perf_counters_test, get_by_fullname)
         }
     }
 }
+
+TEST(perf_counters_test, open_metrics_not_resetting)
+{
+    perf_counter_ptr volatile_counter = perf_counters::instance().get_global_counter(
+        "replica", "eon", "om.volatile@1.0", COUNTER_TYPE_VOLATILE_NUMBER, "volatile", true);
+    perf_counter_ptr rate_counter = perf_counters::instance().get_global_counter(
+        "replica", "eon", "om.rate@1.0", COUNTER_TYPE_RATE, "rate", true);
+    volatile_counter->add(7);
+    rate_counter->add(1000);
+
+    for (int i = 0; i < 2; ++i) {
+        std::string text;
+        perf_counters::instance().render_open_metrics(text);
+        ASSERT_NE(std::string::npos,
+                  text.find("om_volatile{app=\"replica\",section=\"eon\",gpid=\"1.0\"} 7\n"));
+        ASSERT_NE(std::string::npos,
+                  text.find("om_rate{app=\"replica\",section=\"eon\",gpid=\"1.0\"} "));
+    }
+
+    // the collector still sees the values accumulated since its last read
+    ASSERT_EQ(7, volatile_counter->get_integer_value());
+    ASSERT_EQ(0, volatile_counter->peek_value());
+
+    ASSERT_TRUE(perf_counters::instance().remove_counter(volatile_counter->full_name()));
+    ASSERT_TRUE(perf_counters::instance().remove_counter(rate_counter->full_name()));
+}
+
+TEST(perf_counters_test, open_metrics_families)
+{
+    // 10 kinds of counters of 1024 partitions
+    const int kinds = 10;
+    const int partitions = 1024;
+    std::vector<perf_counter_ptr> counters;
+    counters.reserve(kinds * partitions);
+    for (int k = 0; k < kinds; ++k) {
+        for (int p = 0; p < partitions; ++p) {
+            std::string name = "bench.counter" + std::to_string(k) + "@1." + std::to_string(p);
+            counters.push_back(perf_counters::instance().get_global_counter(
+                "replica", "bench", name.c_str(), COUNTER_TYPE_NUMBER, "bench", true));
+            counters.back()->set(p);
+        }
+    }
+
+    std::string text;
+    perf_counters::instance().render_open_metrics(text);
+    ASSERT_NE(std::string::npos,
+              text.find("bench_counter9{app=\"replica\",section=\"bench\","
+                        "gpid=\"1.1023\"} 1023\n"));
+    int families = 0;
+    for (size_t pos = text.find("# TYPE bench_counter"); pos != std::string::npos;
+         pos = text.find("# TYPE bench_counter", pos + 1)) {
+        ++families;
+    }
+    ASSERT_EQ(kinds, families);
+
+    for (const auto &c : counters) {
+        ASSERT_TRUE(perf_counters::instance().remove_counter(c->full_name()));
+    }
+    text.clear();
+    perf_counters::instance().render_open_metrics(text);
+    ASSERT_EQ(std::string::npos, text.find("bench_counter"));
+}
+
+// compares the scrape through the snapshot and the JSON with the open metrics one, run it with
+// --gtest_also_run_disabled_tests
+TEST(perf_counters_test, DISABLED_open_metrics_scrape_benchmark)
+{
+    // 100 kinds of counters of 1024 partitions
+    const int kinds = 100;
+    const int partitions = 1024;
+    std::vector<perf_counter_ptr> counters;
+    counters.reserve(kinds * partitions);
+    for (int k = 0; k < kinds; ++k) {
+        for (int p = 0; p < partitions; ++p) {
+            std::string name = "bench.counter" + std::to_string(k) + "@1." + std::to_string(p);
+            counters.push_back(perf_counters::instance().get_global_counter(
+                "replica", "bench", name.c_str(), COUNTER_TYPE_NUMBER, "bench", true));
+            counters.back()->set(p);
+        }
+    }
+
+    auto cpu_ms = []() { return clock() * 1000.0 / CLOCKS_PER_SEC; };
+    const int rounds = 5;
+
+    // the scrape through the snapshot and the JSON
+    uint64_t start_ns = dsn_now_ns();
+    double start_cpu_ms = cpu_ms();
+    size_t json_size = 0;
+    for (int i = 0; i < rounds; ++i) {
+        json_size = perf_counters::instance().list_snapshot_by_regexp({"bench"}).size();
+    }
+    double snapshot_ms = (dsn_now_ns() - start_ns) / 1e6 / rounds;
+    double snapshot_cpu_ms = (cpu_ms() - start_cpu_ms) / rounds;
+
+    start_ns = dsn_now_ns();
+    start_cpu_ms = cpu_ms();
+    std::string text;
+    for (int i = 0; i < rounds; ++i) {
+        text.clear();
+        perf_counters::instance().render_open_metrics(text);
+    }
+    double open_metrics_ms = (dsn_now_ns() - start_ns) / 1e6 / rounds;
+    double open_metrics_cpu_ms = (cpu_ms() - start_cpu_ms) / rounds;
+
+    std::cout << "scrape " << counters.size() << " counters: snapshot and json took "
+              << snapshot_ms << "ms (cpu " << snapshot_cpu_ms << "ms, " << json_size
+              << " bytes), open metrics took " << open_metrics_ms << "ms (cpu "
+              << open_metrics_cpu_ms << "ms, " << text.size() << " bytes)" << std::endl;
+
+    ASSERT_NE(std::string::npos,
+              text.find("bench_counter99{app=\"replica\",section=\"bench\","
+                        "gpid=\"1.1023\"} 1023\n"));
+    int families = 0;
+    for (size_t pos = text.find("# TYPE bench_counter"); pos != std::string::npos;
+         pos = text.find("# TYPE bench_counter", pos + 1)) {
+        ++families;
+    }
+    ASSERT_EQ(kinds, families);
+
+    for (const auto &c : counters) {
+        ASSERT_TRUE(perf_counters::instance().remove_counter(c->full_name()));
+    }
+    text.clear();
+    perf_counters::instance().render_open_metrics(text);
+    ASSERT_EQ(std::string::npos, text.find("bench_counter"));
+}
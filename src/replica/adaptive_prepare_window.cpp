@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "adaptive_prepare_window.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                enable_adaptive_prepare_window,
+                false,
+                "whether to size the count of in-flight 2PC rounds by the measured prepare "
+                "round trip time and local log latency, instead of always staleness_for_commit. "
+                "Don't enable it until all the replica servers run a version supporting it, "
+                "since the older secondaries abort on the prepares beyond staleness_for_commit");
+DSN_DEFINE_uint32("replication",
+                  adaptive_prepare_window_min,
+                  2,
+                  "the min count of in-flight 2PC rounds when the adaptive prepare window is "
+                  "enabled");
+DSN_DEFINE_uint32("replication",
+                  adaptive_prepare_window_max,
+                  40,
+                  "the max count of in-flight 2PC rounds when the adaptive prepare window is "
+                  "enabled, which is bounded by max_mutation_count_in_prepare_list, and should be "
+                  "the same on all the replica servers, since a secondary asks the primary to "
+                  "retry the prepares beyond its own max window");
+
+// weight of the latest sample in the EWMAs
+static const double kEwmaWeight = 0.1;
+static const uint64_t kRateSampleIntervalNs = 1000000;
+// see mutation::is_full()
+static const double kMaxMutationBytes = 1024 * 1024;
+
+static void update_ewma(double &ewma, double sample)
+{
+    ewma = (ewma == 0) ? sample : (1 - kEwmaWeight) * ewma + kEwmaWeight * sample;
+}
+
+/*static*/ int adaptive_prepare_window::max_window_of(int staleness_for_commit,
+                                                     int prepare_list_capacity)
+{
+    int max_window = std::max(static_cast<int>(FLAGS_adaptive_prepare_window_max),
+                              staleness_for_commit);
+    return std::min(max_window, prepare_list_capacity);
+}
+
+adaptive_prepare_window::adaptive_prepare_window(int initial_window,
+                                                 int max_window,
+                                                 bool batch_write_disabled)
+    : _max_window(max_window),
+      _batch_write_disabled(batch_write_disabled),
+      _window(std::min(initial_window, max_window)),
+      _rate_sample_start_ns(0),
+      _sampled_bytes(0),
+      _sampled_requests(0),
+      _bytes_per_ns(0),
+      _requests_per_ns(0),
+      _prepare_rtt_ns(0),
+      _local_log_latency_ns(0)
+{
+}
+
+void adaptive_prepare_window::on_write_arrived(uint64_t now_ns, size_t bytes)
+{
+    if (_rate_sample_start_ns == 0) {
+        _rate_sample_start_ns = now_ns;
+    }
+    _sampled_bytes += bytes;
+    _sampled_requests++;
+
+    uint64_t elapsed = now_ns - std::min(now_ns, _rate_sample_start_ns);
+    if (elapsed >= kRateSampleIntervalNs) {
+        update_ewma(_bytes_per_ns, static_cast<double>(_sampled_bytes) / elapsed);
+        update_ewma(_requests_per_ns, static_cast<double>(_sampled_requests) / elapsed);
+        _rate_sample_start_ns = now_ns;
+        _sampled_bytes = 0;
+        _sampled_requests = 0;
+        update_window();
+    }
+}
+
+void adaptive_prepare_window::on_prepare_acked(uint64_t rtt_ns)
+{
+    update_ewma(_prepare_rtt_ns, rtt_ns);
+    update_window();
+}
+
+void adaptive_prepare_window::on_local_log_completed(uint64_t latency_ns)
+{
+    update_ewma(_local_log_latency_ns, latency_ns);
+    update_window();
+}
+
+void adaptive_prepare_window::update_window()
+{
+    // keep the static window until all of the rate and latencies are measured
+    if (_requests_per_ns == 0 || _prepare_rtt_ns == 0 || _local_log_latency_ns == 0) {
+        return;
+    }
+
+    double round_latency_ns = std::max(_prepare_rtt_ns, _local_log_latency_ns);
+    double rounds = _batch_write_disabled
+                        ? _requests_per_ns * round_latency_ns
+                        : _bytes_per_ns * round_latency_ns / kMaxMutationBytes;
+    double w = std::ceil(rounds) + 1;
+    int min_window = std::min(static_cast<int>(FLAGS_adaptive_prepare_window_min), _max_window);
+    _window = static_cast<int>(std::max<double>(min_window, std::min<double>(w, _max_window)));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(enable_adaptive_prepare_window);
+
+// adaptive_prepare_window sizes the max count of the in-flight 2PC rounds of a primary.
+//
+// A round lasts until both the local log and the slowest secondary (whose prepare round trip
+// includes its own log latency) are done. By Little's law, keeping up with the incoming
+// writes needs `write_rate * round_latency` of data in flight, and a round carries at most
+// one mutation (at most 1MB, see mutation::is_full(), or one request if batch write is
+// disabled). So the window is:
+//
+//   window = ceil(write_rate * max(prepare_rtt, local_log_latency) / mutation_capacity) + 1
+//
+// bounded by [adaptive_prepare_window_min, max_window], see max_window_of(). It starts from the
+// static window `staleness_for_commit` until the rate and the latencies are measured. A small
+// window lets the writes be batched into fewer mutations under low load, while a window wider
+// than the static one keeps the pipeline full on high-rtt links. The rates and latencies are
+// EWMAs. The commits are still applied in decree order by prepare_list, so the acks of the
+// rounds in the window may arrive out of order.
+//
+// The secondaries ack ERR_TRY_AGAIN to the prepares beyond their own max window, while the ones
+// of the older versions abort on the prepares beyond `staleness_for_commit`, so
+// enable_adaptive_prepare_window must not be turned on until all the replica servers are upgraded.
+//
+// Not thread safe, it's accessed in the replica thread.
+class adaptive_prepare_window
+{
+public:
+    adaptive_prepare_window(int initial_window, int max_window, bool batch_write_disabled);
+
+    // Returns the max window: `adaptive_prepare_window_max`, no less than the static window
+    // `staleness_for_commit`, and no more than the capacity of the prepare list, which has to
+    // hold all the uncommitted mutations.
+    static int max_window_of(int staleness_for_commit, int prepare_list_capacity);
+
+    // called when a client write of `bytes` arrives at `now_ns`
+    void on_write_arrived(uint64_t now_ns, size_t bytes);
+
+    // `rtt_ns` is from sending a prepare to receiving its ack from a secondary
+    void on_prepare_acked(uint64_t rtt_ns);
+
+    // `latency_ns` is from appending a mutation to the local log to its completion
+    void on_local_log_completed(uint64_t latency_ns);
+
+    int window() const { return _window; }
+    int max_window() const { return _max_window; }
+
+private:
+    void update_window();
+
+private:
+    const int _max_window;
+    const bool _batch_write_disabled;
+    int _window;
+
+    // write rate, sampled every `kRateSampleIntervalNs`
+    uint64_t _rate_sample_start_ns;
+    uint64_t _sampled_bytes;
+    uint64_t _sampled_requests;
+    double _bytes_per_ns;
+    double _requests_per_ns;
+
+    double _prepare_rtt_ns;
+    double _local_log_latency_ns;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -408,8 +408,9 @@ error_code replica_bulk_loader::download_sst_files(const std::string &remote_dir
 
     // download metadata file synchronously
     uint64_t file_size = 0;
+    std::string file_md5;
     error_code err = _stub->_block_service_manager.download_file(
-        remote_dir, local_dir, bulk_load_constant::BULK_LOAD_METADATA, fs, file_size);
+        remote_dir, local_dir, bulk_load_constant::BULK_LOAD_METADATA, fs, file_size, file_md5);
     if (err != ERR_OK && err != ERR_PATH_ALREADY_EXIST) {
         derror_replica("download bulk load metadata file failed, error = {}", err.to_string());
         return err;
@@ -429,8 +430,9 @@ error_code replica_bulk_loader::download_sst_files(const std::string &remote_dir
         auto bulk_load_download_task = tasking::enqueue(
             LPC_BACKGROUND_BULK_LOAD, tracker(), [this, remote_dir, local_dir, f_meta, fs]() {
                 uint64_t f_size = 0;
+                std::string f_md5;
                 error_code ec = _stub->_block_service_manager.download_file(
-                    remote_dir, local_dir, f_meta.name, fs, f_size);
+                    remote_dir, local_dir, f_meta.name, fs, f_size, f_md5);
                 const std::string &file_name =
                     utils::filesystem::path_combine(local_dir, f_meta.name);
                 bool verified = false;
@@ -450,13 +452,30 @@ error_code replica_bulk_loader::download_sst_files(const std::string &remote_dir
                             ec = ERR_FILE_OPERATION_FAILED;
                         } else {
                             ec = _stub->_block_service_manager.download_file(
-                                remote_dir, local_dir, f_meta.name, fs, f_size);
+                                remote_dir, local_dir, f_meta.name, fs, f_size, f_md5);
                         }
                     }
                 }
-                if (ec == ERR_OK && !verified &&
-                    !utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size)) {
-                    ec = ERR_CORRUPTION;
+                if (ec == ERR_OK && !verified) {
+                    // the md5 calculated while downloading saves reading the file again
+                    if (f_md5.empty()) {
+                        verified =
+                            utils::filesystem::verify_file(file_name, f_meta.md5, f_meta.size);
+                    } else {
+                        verified = (f_size == static_cast<uint64_t>(f_meta.size) &&
+                                    f_md5 == f_meta.md5);
+                        if (!verified) {
+                            derror_replica("file({}) damaged, size: {} VS {}, md5: {} VS {}",
+                                           file_name,
+                                           f_size,
+                                           f_meta.size,
+                                           f_md5,
+                                           f_meta.md5);
+                        }
+                    }
+                    if (!verified) {
+                        ec = ERR_CORRUPTION;
+                    }
                 }
                 if (ec != ERR_OK) {
                     try_decrease_bulk_load_download_count();
@@ -21,6 +21,7 @@
 #include "replica/replica_stub.h"
 #include "duplication_pipeline.h"
 #include "load_from_private_log.h"
+#include "replica_duplicator_manager.h"
 
 namespace dsn {
 namespace replication {
@@ -41,12 +42,27 @@ void load_mutation::run()
 {
     decree last_decree = _duplicator->progress().last_decree;
     _start_decree = last_decree + 1;
-    if (_replica->private_log()->max_commit_on_disk() < _start_decree) {
+    decree max_commit_on_disk = _replica->private_log()->max_commit_on_disk();
+    if (max_commit_on_disk < _start_decree) {
         // wait 100ms for next try if no mutation was added.
         repeat(100_ms);
         return;
     }
 
+    // read the recently committed mutations from memory if they are still there, which are
+    // bounded by the private log as the mutations loaded from disk are
+    mutation_tuple_set mutations;
+    decree hot_tail_last_decree = invalid_decree;
+    if (_replica->get_duplication_manager()->hot_tail()->fetch(_start_decree,
+                                                               max_commit_on_disk,
+                                                               mutations,
+                                                               hot_tail_last_decree)) {
+        _counter_dup_hot_tail_hit_rate->increment();
+        step_down_next_stage(hot_tail_last_decree, std::move(mutations));
+        return;
+    }
+    _counter_dup_hot_tail_miss_rate->increment();
+
     _log_on_disk->set_start_decree(_start_decree);
     _log_on_disk->async();
 }
@@ -58,6 +74,16 @@ load_mutation::load_mutation(replica_duplicator *duplicator,
                              load_from_private_log *load_private)
     : replica_base(r), _log_on_disk(load_private), _replica(r), _duplicator(duplicator)
 {
+    _counter_dup_hot_tail_hit_rate.init_app_counter(
+        "eon.replica_stub",
+        "dup.hot_tail_hit_rate",
+        COUNTER_TYPE_RATE,
+        "rate of the mutation loads served by the recently committed mutations in memory");
+    _counter_dup_hot_tail_miss_rate.init_app_counter(
+        "eon.replica_stub",
+        "dup.hot_tail_miss_rate",
+        COUNTER_TYPE_RATE,
+        "rate of the mutation loads that fall back to reading the private log");
 }
 
 //               //
@@ -77,6 +103,16 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
 {
     _last_decree = last_decree;
 
+    // the mutations are timestamped when they are prepared, so the commit time is taken from
+    // the hot tail, which is fed on commit
+    uint64_t commit_time_us = 0;
+    if (!in.empty() &&
+        _replica->get_duplication_manager()->hot_tail()->get_commit_time_us(_last_decree,
+                                                                            commit_time_us)) {
+        uint64_t now_us = dsn_now_us();
+        _counter_dup_lag_ms->set(now_us > commit_time_us ? (now_us - commit_time_us) / 1000 : 0);
+    }
+
     if (in.empty()) {
         update_progress();
         step_down_next_stage();
@@ -111,6 +147,11 @@ ship_mutation::ship_mutation(replica_duplicator *duplicator)
                                                      "dup.shipped_bytes_rate",
                                                      COUNTER_TYPE_RATE,
                                                      "shipping rate of private log in bytes");
+    _counter_dup_lag_ms.init_app_counter(
+        "eon.replica_stub",
+        "dup.lag_ms",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "time from the newest mutation of a batch being committed to it being shipped");
 }
 
 } // namespace replication
@@ -51,6 +51,9 @@ private:
 
     replica *_replica{nullptr};
     replica_duplicator *_duplicator{nullptr};
+
+    perf_counter_wrapper _counter_dup_hot_tail_hit_rate;
+    perf_counter_wrapper _counter_dup_hot_tail_miss_rate;
 };
 
 // ship_mutation is a pipeline stage receiving a set of mutations,
@@ -85,6 +88,7 @@ private:
     decree _last_decree{invalid_decree};
 
     perf_counter_wrapper _counter_dup_shipped_bytes_rate;
+    perf_counter_wrapper _counter_dup_lag_ms;
 };
 
 } // namespace replication
@@ -229,6 +229,12 @@ load_from_private_log::load_from_private_log(replica *r, replica_duplicator *dup
 
 void load_from_private_log::set_start_decree(decree start_decree)
 {
+    if (start_decree != _mutation_batch.last_decree() + 1) {
+        // the mutations before `start_decree` were not loaded from here (e.g. they were read
+        // from the hot tail), so the current file and offset are stale
+        _current = nullptr;
+        _mutation_batch.reset(start_decree - 1);
+    }
     _start_decree = start_decree;
     _mutation_batch.set_start_decree(start_decree);
 }
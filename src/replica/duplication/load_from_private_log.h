@@ -46,6 +46,8 @@ public:
     // The loaded mutations will be passed down to `ship_mutation`.
     void run() override;
 
+    // The file to start is looked up again if `start_decree` doesn't follow the mutations
+    // loaded last time.
     void set_start_decree(decree start_decree);
 
     /// ==== Implementation ==== ///
@@ -59,6 +59,12 @@ decree mutation_batch::last_decree() const { return _mutation_buffer->last_commi
 
 void mutation_batch::set_start_decree(decree d) { _start_decree = d; }
 
+void mutation_batch::reset(decree d)
+{
+    _mutation_buffer->reset(d);
+    _loaded_mutations.clear();
+}
+
 mutation_tuple_set mutation_batch::move_all_mutations()
 {
     // free the internal space
@@ -83,6 +89,20 @@ mutation_batch::mutation_batch(replica_duplicator *r) : replica_base(r)
     _mutation_buffer->reset(r->progress().confirmed_decree);
 }
 
+static bool is_update_duplicable(const mutation_update &update)
+{
+    // ignore WRITE_EMPTY
+    if (update.code == RPC_REPLICATION_WRITE_EMPTY) {
+        return false;
+    }
+    // Ignore non-idempotent writes.
+    // Normally a duplicating replica will reply non-idempotent writes with
+    // ERR_OPERATION_DISABLED, but there could still be a mutation written
+    // before the duplication was added.
+    // To ignore means this write will be lost, which is acceptable under this rare case.
+    return task_spec::get(update.code)->rpc_request_is_write_idempotent;
+}
+
 /*extern*/ void
 add_mutation_if_valid(mutation_ptr &mu, mutation_tuple_set &mutations, decree start_decree)
 {
@@ -91,21 +111,29 @@ add_mutation_if_valid(mutation_ptr &mu, mutation_tuple_set &mutations, decree st
         return;
     }
     for (mutation_update &update : mu->data.updates) {
-        // ignore WRITE_EMPTY
-        if (update.code == RPC_REPLICATION_WRITE_EMPTY) {
+        if (!is_update_duplicable(update)) {
             continue;
         }
-        // Ignore non-idempotent writes.
-        // Normally a duplicating replica will reply non-idempotent writes with
-        // ERR_OPERATION_DISABLED, but there could still be a mutation written
-        // before the duplication was added.
-        // To ignore means this write will be lost, which is acceptable under this rare case.
-        if (!task_spec::get(update.code)->rpc_request_is_write_idempotent) {
+        blob bb;
+        if (update.data.buffer() != nullptr) {
+            bb = std::move(update.data);
+        } else {
+            bb = blob::create_from_bytes(update.data.data(), update.data.length());
+        }
+
+        mutations.emplace(std::make_tuple(mu->data.header.timestamp, update.code, std::move(bb)));
+    }
+}
+
+/*extern*/ void copy_mutation_if_valid(const mutation_ptr &mu, mutation_tuple_set &mutations)
+{
+    for (const mutation_update &update : mu->data.updates) {
+        if (!is_update_duplicable(update)) {
             continue;
         }
         blob bb;
         if (update.data.buffer() != nullptr) {
-            bb = std::move(update.data);
+            bb = update.data;
         } else {
             bb = blob::create_from_bytes(update.data.data(), update.data.length());
         }
@@ -45,6 +45,9 @@ public:
     // mutations with decree < d will be ignored.
     void set_start_decree(decree d);
 
+    // Drops the uncommitted mutations and restarts from the mutations after decree `d`.
+    void reset(decree d);
+
     size_t size() const { return _loaded_mutations.size(); }
 
 private:
@@ -60,5 +63,9 @@ using mutation_batch_u_ptr = std::unique_ptr<mutation_batch>;
 /// Extract mutations into mutation_tuple_set if they are not WRITE_EMPTY.
 extern void add_mutation_if_valid(mutation_ptr &, mutation_tuple_set &, decree start_decree);
 
+/// Same as add_mutation_if_valid, but shares the data of `mu` rather than moving it out,
+/// for the mutations that are still referenced by others.
+extern void copy_mutation_if_valid(const mutation_ptr &mu, mutation_tuple_set &);
+
 } // namespace replication
 } // namespace dsn
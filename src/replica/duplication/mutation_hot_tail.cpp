@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "mutation_hot_tail.h"
+#include "mutation_batch.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint32("replication",
+                  duplication_hot_tail_max_mutations,
+                  1024,
+                  "the max count of the recently committed mutations kept in memory for "
+                  "duplication on each primary replica, 0 means always loading the mutations "
+                  "from the private log");
+DSN_DEFINE_uint64("replication",
+                  duplication_hot_tail_max_bytes,
+                  4 * 1024 * 1024,
+                  "the max bytes of the recently committed mutations kept in memory for "
+                  "duplication on each primary replica");
+
+void mutation_hot_tail::append(const mutation_ptr &mu)
+{
+    if (FLAGS_duplication_hot_tail_max_mutations == 0) {
+        return;
+    }
+
+    zauto_lock l(_lock);
+    if (!_mutations.empty() && _mutations.back().mu->get_decree() + 1 != mu->get_decree()) {
+        _mutations.clear();
+        _bytes = 0;
+    }
+    _mutations.push_back({mu, dsn_now_us()});
+    _bytes += mu->appro_data_bytes();
+
+    while (_mutations.size() > FLAGS_duplication_hot_tail_max_mutations ||
+           (_mutations.size() > 1 && _bytes > FLAGS_duplication_hot_tail_max_bytes)) {
+        _bytes -= _mutations.front().mu->appro_data_bytes();
+        _mutations.pop_front();
+    }
+}
+
+bool mutation_hot_tail::fetch(decree start_decree,
+                              decree end_decree,
+                              /*out*/ mutation_tuple_set &mutations,
+                              /*out*/ decree &last_decree) const
+{
+    zauto_lock l(_lock);
+    if (_mutations.empty() || start_decree < _mutations.front().mu->get_decree() ||
+        start_decree > _mutations.back().mu->get_decree() || start_decree > end_decree) {
+        return false;
+    }
+
+    size_t index = static_cast<size_t>(start_decree - _mutations.front().mu->get_decree());
+    for (; index < _mutations.size(); ++index) {
+        const mutation_ptr &mu = _mutations[index].mu;
+        if (mu->get_decree() > end_decree) {
+            break;
+        }
+        copy_mutation_if_valid(mu, mutations);
+        last_decree = mu->get_decree();
+    }
+    return true;
+}
+
+bool mutation_hot_tail::get_commit_time_us(decree d, /*out*/ uint64_t &commit_time_us) const
+{
+    zauto_lock l(_lock);
+    if (_mutations.empty() || d > _mutations.back().mu->get_decree()) {
+        return false;
+    }
+    if (d < _mutations.front().mu->get_decree()) {
+        commit_time_us = _mutations.front().commit_time_us;
+    } else {
+        commit_time_us =
+            _mutations[static_cast<size_t>(d - _mutations.front().mu->get_decree())]
+                .commit_time_us;
+    }
+    return true;
+}
+
+void mutation_hot_tail::clear()
+{
+    zauto_lock l(_lock);
+    _mutations.clear();
+    _bytes = 0;
+}
+
+size_t mutation_hot_tail::size() const
+{
+    zauto_lock l(_lock);
+    return _mutations.size();
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,85 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <deque>
+
+#include <dsn/dist/replication/mutation_duplicator.h>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/flags.h>
+
+#include "replica/mutation.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(duplication_hot_tail_max_mutations);
+DSN_DECLARE_uint64(duplication_hot_tail_max_bytes);
+
+/// mutation_hot_tail is a bounded ring of the mutations recently committed on a primary
+/// replica, fed from the commit path, so that duplication can read them from memory instead
+/// of reloading them from the private log. It's shared by all the duplications of the replica.
+///
+/// The mutations in the ring are always of consecutive decrees: appending a mutation
+/// which does not follow the last one (e.g. after the replica was not duplicating for a
+/// while) clears the ring first. The oldest mutations are evicted once the ring exceeds
+/// `duplication_hot_tail_max_mutations` or `duplication_hot_tail_max_bytes`.
+///
+/// Thread-safe.
+class mutation_hot_tail
+{
+public:
+    // THREAD_POOL_REPLICATION
+    void append(const mutation_ptr &mu);
+
+    // Collects the duplicable updates of the mutations with decree in [start_decree, end_decree]
+    // into `mutations`, sharing their data with the ring, and sets `last_decree` to the largest
+    // decree collected.
+    // Returns false without collecting anything if `start_decree` is not in the ring, in which
+    // case the mutations should be loaded from the private log.
+    bool fetch(decree start_decree,
+               decree end_decree,
+               /*out*/ mutation_tuple_set &mutations,
+               /*out*/ decree &last_decree) const;
+
+    // Gets the time in us when the mutation of decree `d` was appended, i.e. committed.
+    // If it has been evicted, the time of the oldest mutation in the ring is got instead,
+    // which is a lower bound of the lag since the mutation.
+    // Returns false if the ring is empty or `d` is newer than it.
+    bool get_commit_time_us(decree d, /*out*/ uint64_t &commit_time_us) const;
+
+    void clear();
+
+    size_t size() const;
+
+private:
+    friend class mutation_hot_tail_test;
+
+    struct entry
+    {
+        mutation_ptr mu;
+        uint64_t commit_time_us;
+    };
+
+    mutable zlock _lock;
+    std::deque<entry> _mutations;
+    uint64_t _bytes{0};
+};
+
+} // namespace replication
+} // namespace dsn
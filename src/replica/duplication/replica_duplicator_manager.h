@@ -18,6 +18,7 @@
 #pragma once
 
 #include "replica_duplicator.h"
+#include "mutation_hot_tail.h"
 
 #include <dsn/dist/replication/replication_types.h>
 #include <dsn/dist/replication/duplication_common.h>
@@ -81,6 +82,10 @@ public:
     };
     std::vector<dup_state> get_dup_states() const;
 
+    /// The recently committed mutations, which are fed by replica::execute_mutation() on the
+    /// primary and read by the duplications before they load the private log.
+    mutation_hot_tail *hot_tail() { return &_hot_tail; }
+
 private:
     void sync_duplication(const duplication_entry &ent);
 
@@ -93,6 +98,7 @@ private:
             return;
 
         _duplications.clear();
+        _hot_tail.clear();
     }
 
 private:
@@ -106,6 +112,8 @@ private:
 
     decree _primary_confirmed_decree{invalid_decree};
 
+    mutation_hot_tail _hot_tail;
+
     // avoid thread conflict between replica::on_checkpoint_timer and
     // duplication_sync_timer.
     mutable zlock _lock;
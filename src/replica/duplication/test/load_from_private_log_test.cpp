@@ -198,6 +198,26 @@ public:
         ASSERT_EQ(load._current->index(), 2);
     }
 
+    void test_start_decree_jumps()
+    {
+        load_from_private_log load(_replica.get(), duplicator.get());
+        generate_multiple_log_files(2);
+        auto files = open_log_file_map(_log_dir);
+
+        load.set_start_decree(1);
+        load.find_log_file_to_start(files);
+        ASSERT_TRUE(load._current);
+
+        // following the mutations loaded last time
+        load.set_start_decree(load._mutation_batch.last_decree() + 1);
+        ASSERT_TRUE(load._current);
+
+        // the mutations in between were served by the hot tail
+        load.set_start_decree(load._mutation_batch.last_decree() + 10);
+        ASSERT_FALSE(load._current);
+        ASSERT_EQ(load._start_decree - 1, load._mutation_batch.last_decree());
+    }
+
     mutation_log_ptr create_private_log(gpid id) { return create_private_log(1, id); }
 
     mutation_log_ptr create_private_log(int private_log_size_mb = 1, gpid id = gpid(1, 1))
@@ -287,6 +307,8 @@ TEST_F(load_from_private_log_test, handle_real_private_log)
 
 TEST_F(load_from_private_log_test, restart_duplication) { test_restart_duplication(); }
 
+TEST_F(load_from_private_log_test, start_decree_jumps) { test_start_decree_jumps(); }
+
 TEST_F(load_from_private_log_test, ignore_useless)
 {
     utils::filesystem::remove_path(_log_dir);
@@ -0,0 +1,126 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "duplication_test_base.h"
+#include "replica/duplication/mutation_hot_tail.h"
+
+namespace dsn {
+namespace replication {
+
+class mutation_hot_tail_test : public duplication_test_base
+{
+public:
+    void append_mutations(mutation_hot_tail &tail, decree start, decree end)
+    {
+        for (decree d = start; d <= end; ++d) {
+            tail.append(create_test_mutation(d, "hello"));
+        }
+    }
+
+    decree front_decree(const mutation_hot_tail &tail) const
+    {
+        return tail._mutations.front().mu->get_decree();
+    }
+};
+
+TEST_F(mutation_hot_tail_test, fetch)
+{
+    mutation_hot_tail tail;
+    mutation_tuple_set result;
+    decree last_decree = invalid_decree;
+    ASSERT_FALSE(tail.fetch(1, 10, result, last_decree));
+
+    append_mutations(tail, 1, 10);
+    ASSERT_EQ(tail.size(), 10u);
+
+    ASSERT_TRUE(tail.fetch(3, 8, result, last_decree));
+    ASSERT_EQ(last_decree, 8);
+    ASSERT_EQ(result.size(), 6u);
+    for (const auto &mt : result) {
+        ASSERT_EQ(std::get<2>(mt).to_string(), "hello");
+    }
+
+    // the data is shared rather than moved out of the mutations
+    result.clear();
+    ASSERT_TRUE(tail.fetch(1, 100, result, last_decree));
+    ASSERT_EQ(last_decree, 10);
+    ASSERT_EQ(result.size(), 10u);
+    for (const auto &mt : result) {
+        ASSERT_EQ(std::get<2>(mt).to_string(), "hello");
+    }
+
+    // the decrees out of the ring should be loaded from the private log
+    ASSERT_FALSE(tail.fetch(11, 100, result, last_decree));
+    ASSERT_FALSE(tail.fetch(5, 4, result, last_decree));
+    ASSERT_FALSE(tail.fetch(0, 100, result, last_decree));
+}
+
+TEST_F(mutation_hot_tail_test, evict)
+{
+    PRESERVE_FLAG(duplication_hot_tail_max_mutations);
+    FLAGS_duplication_hot_tail_max_mutations = 16;
+
+    mutation_hot_tail tail;
+    append_mutations(tail, 1, 100);
+    ASSERT_EQ(tail.size(), 16u);
+    ASSERT_EQ(front_decree(tail), 85);
+
+    mutation_tuple_set result;
+    decree last_decree = invalid_decree;
+    ASSERT_FALSE(tail.fetch(84, 100, result, last_decree));
+    ASSERT_TRUE(tail.fetch(85, 100, result, last_decree));
+    ASSERT_EQ(last_decree, 100);
+
+    // the evicted mutations were committed before the oldest one in the ring
+    uint64_t oldest_us = 0;
+    uint64_t evicted_us = 0;
+    uint64_t newest_us = 0;
+    ASSERT_TRUE(tail.get_commit_time_us(85, oldest_us));
+    ASSERT_TRUE(tail.get_commit_time_us(1, evicted_us));
+    ASSERT_TRUE(tail.get_commit_time_us(100, newest_us));
+    ASSERT_EQ(oldest_us, evicted_us);
+    ASSERT_LE(oldest_us, newest_us);
+    ASSERT_FALSE(tail.get_commit_time_us(101, newest_us));
+
+    // a gap of decrees clears the ring, which must be consecutive
+    append_mutations(tail, 102, 103);
+    ASSERT_EQ(tail.size(), 2u);
+    ASSERT_EQ(front_decree(tail), 102);
+
+    // disabled
+    FLAGS_duplication_hot_tail_max_mutations = 0;
+    tail.clear();
+    append_mutations(tail, 1, 10);
+    ASSERT_EQ(tail.size(), 0u);
+}
+
+TEST_F(mutation_hot_tail_test, ignore_non_idempotent_write)
+{
+    mutation_hot_tail tail;
+    mutation_ptr mu = create_test_mutation(1, "hello");
+    mu->data.updates[0].code = RPC_DUPLICATION_NON_IDEMPOTENT_WRITE;
+    tail.append(mu);
+
+    mutation_tuple_set result;
+    decree last_decree = invalid_decree;
+    ASSERT_TRUE(tail.fetch(1, 1, result, last_decree));
+    ASSERT_EQ(last_decree, 1);
+    ASSERT_EQ(result.size(), 0u);
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,176 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "learn_file_reuse.h"
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/strings.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                learn_reuse_local_files,
+                false,
+                "whether a learner reuses the files it already has when learning checkpoints");
+DSN_TAG_VARIABLE(learn_reuse_local_files, FT_MUTABLE);
+
+// the cache is simply cleared once it's too large, files of outdated checkpoints are
+// never accessed again anyway
+static const size_t kMaxCachedFiles = 100000;
+
+error_code file_md5_cache::get_md5(const std::string &path, /*out*/ std::string &md5)
+{
+    int64_t size = 0;
+    time_t mtime = 0;
+    if (!utils::filesystem::file_size(path, size) ||
+        !utils::filesystem::last_write_time(path, mtime)) {
+        return ERR_OBJECT_NOT_FOUND;
+    }
+
+    {
+        zauto_lock l(_lock);
+        auto it = _entries.find(path);
+        if (it != _entries.end() && it->second.size == size && it->second.mtime == mtime) {
+            md5 = it->second.md5;
+            return ERR_OK;
+        }
+    }
+
+    error_code err = utils::filesystem::md5sum(path, md5);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    zauto_lock l(_lock);
+    if (_entries.size() >= kMaxCachedFiles) {
+        _entries.clear();
+    }
+    _entries[path] = entry{size, mtime, md5};
+    return ERR_OK;
+}
+
+std::vector<file_meta> collect_local_files(const std::string &dir)
+{
+    std::vector<file_meta> local_files;
+    std::vector<std::string> files;
+    if (!utils::filesystem::get_subfiles(dir, files, true)) {
+        dwarn_f("get files of {} failed, reuse no file in learning", dir);
+        return local_files;
+    }
+
+    for (const auto &f : files) {
+        file_meta meta;
+        if (!utils::filesystem::file_size(f, meta.size)) {
+            continue;
+        }
+        meta.name = f.substr(dir.length() + 1);
+        local_files.emplace_back(std::move(meta));
+    }
+    return local_files;
+}
+
+std::map<std::string, file_meta>
+match_reusable_files(const std::string &dir,
+                     const std::vector<std::string> &files,
+                     const std::vector<file_meta> &local_files,
+                     file_md5_cache &cache)
+{
+    std::map<std::pair<std::string, int64_t>, const file_meta *> candidates;
+    for (const auto &f : local_files) {
+        candidates.emplace(std::make_pair(utils::get_last_component(f.name, "/"), f.size), &f);
+    }
+
+    std::map<std::string, file_meta> reusable_files;
+    for (const auto &f : files) {
+        const std::string path = utils::filesystem::path_combine(dir, f);
+        int64_t size = 0;
+        if (!utils::filesystem::file_size(path, size)) {
+            continue;
+        }
+        auto it = candidates.find(std::make_pair(utils::get_last_component(f, "/"), size));
+        if (it == candidates.end()) {
+            continue;
+        }
+
+        file_meta meta = *it->second;
+        if (cache.get_md5(path, meta.md5) != ERR_OK) {
+            continue;
+        }
+        reusable_files.emplace(f, std::move(meta));
+    }
+    return reusable_files;
+}
+
+size_t verify_reusable_files(const std::string &data_dir,
+                             /*inout*/ std::map<std::string, file_meta> &reusable_files,
+                             file_md5_cache &cache)
+{
+    size_t removed = 0;
+    for (auto it = reusable_files.begin(); it != reusable_files.end();) {
+        const std::string src = utils::filesystem::path_combine(data_dir, it->second.name);
+        std::string md5;
+        error_code err = cache.get_md5(src, md5);
+        if (err == ERR_OK && md5 == it->second.md5) {
+            ++it;
+            continue;
+        }
+        dwarn_f("local file {} can't be reused as {}, md5: {} VS {}, err = {}",
+                src,
+                it->first,
+                md5,
+                it->second.md5,
+                err);
+        it = reusable_files.erase(it);
+        ++removed;
+    }
+    return removed;
+}
+
+error_code link_reusable_files(const std::string &data_dir,
+                               const std::string &learn_dir,
+                               const std::map<std::string, file_meta> &reusable_files,
+                               file_md5_cache &cache)
+{
+    for (const auto &kv : reusable_files) {
+        const std::string src = utils::filesystem::path_combine(data_dir, kv.second.name);
+        const std::string target = utils::filesystem::path_combine(learn_dir, kv.first);
+
+        std::string md5;
+        error_code err = cache.get_md5(src, md5);
+        if (err != ERR_OK || md5 != kv.second.md5) {
+            dwarn_f("local file {} can't be reused as {}, md5: {} VS {}, err = {}",
+                    src,
+                    kv.first,
+                    md5,
+                    kv.second.md5,
+                    err);
+            return ERR_CORRUPTION;
+        }
+
+        if (!utils::filesystem::create_directory(utils::filesystem::remove_file_name(target)) ||
+            !utils::filesystem::link_file(src, target)) {
+            derror_f("link local file {} to {} failed", src, target);
+            return ERR_FILE_OPERATION_FAILED;
+        }
+    }
+    return ERR_OK;
+}
+
+} // namespace replication
+} // namespace dsn
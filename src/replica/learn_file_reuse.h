@@ -0,0 +1,91 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dsn/dist/replication/replication_types.h>
+#include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(learn_reuse_local_files);
+
+// Incremental learning of checkpoints:
+//
+// Most of the files of a checkpoint (e.g. sst files) are immutable, and the learner may
+// already have some of them, e.g. the ones learned before it was restarted. So the learner
+// tells the learnee the files under its data dir (`learn_request.local_files`), then the
+// learnee picks out the learned files with the same base name and size as one of them
+// (`learn_response.reusable_files`). The learner links these files into its learn dir if
+// their md5 match, and copies the rest from the learnee.
+
+// file_md5_cache caches the md5 of the files, which is invalidated once the size or the
+// modified time of the file changes. Since the files of checkpoints are never modified,
+// they're read only once to be checked whether they can be reused.
+// thread safe
+class file_md5_cache
+{
+public:
+    error_code get_md5(const std::string &path, /*out*/ std::string &md5);
+
+private:
+    struct entry
+    {
+        int64_t size;
+        time_t mtime;
+        std::string md5;
+    };
+
+    zlock _lock;
+    std::unordered_map<std::string, entry> _entries;
+};
+
+// Returns the files under `dir` recursively, with the paths relative to `dir`.
+std::vector<file_meta> collect_local_files(const std::string &dir);
+
+// On learnee: `files` are the learned files relative to `dir`. Returns the ones which
+// have the same base name and size as one of `local_files` of the learner, mapped to that
+// file of the learner with the md5 of the learned file.
+std::map<std::string, file_meta>
+match_reusable_files(const std::string &dir,
+                     const std::vector<std::string> &files,
+                     const std::vector<file_meta> &local_files,
+                     file_md5_cache &cache);
+
+// On learner: removes the files from `reusable_files` whose local file under `data_dir`
+// doesn't match the md5 of the learned file, so that they are copied instead. Returns how
+// many are removed.
+size_t verify_reusable_files(const std::string &data_dir,
+                             /*inout*/ std::map<std::string, file_meta> &reusable_files,
+                             file_md5_cache &cache);
+
+// On learner: links the reusable files from `data_dir` into `learn_dir`.
+// Returns ERR_CORRUPTION if any of the local files doesn't match the md5 of the learned file.
+error_code link_reusable_files(const std::string &data_dir,
+                               const std::string &learn_dir,
+                               const std::map<std::string, file_meta> &reusable_files,
+                               file_md5_cache &cache);
+
+} // namespace replication
+} // namespace dsn
@@ -27,13 +27,30 @@
 #include "log_file.h"
 #include "log_file_stream.h"
 
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/safe_strerror_posix.h>
 #include <dsn/dist/fmt_logging.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                enable_mutation_log_replay_mmap,
+                false,
+                "whether to map the mutation log files into memory and verify their crc in "
+                "parallel when replaying them");
+DSN_DEFINE_uint32("replication",
+                  mutation_log_replay_crc_threads,
+                  4,
+                  "the count of threads verifying the crc of a mapped mutation log file");
+
 log_file::~log_file() { close(); }
 /*static */ log_file_ptr log_file::open_read(const char *path, /*out*/ error_code &err)
 {
@@ -155,6 +172,9 @@ log_file::log_file(
     _index = index;
     _crc32 = 0;
     _last_write_time = 0;
+    _mapping_size = 0;
+    _mapping_offset = 0;
+    _prefetched = false;
     memset(&_header, 0, sizeof(_header));
 
     if (is_read) {
@@ -173,6 +193,9 @@ void log_file::close()
     //_stream implicitly refer to _handle so it needs to be cleaned up first.
     // TODO: We need better abstraction to avoid those manual stuffs..
     _stream.reset(nullptr);
+    // the blobs read from the mapping may still refer to it
+    _mapping.reset();
+    _block_crcs.clear();
     if (_handle) {
         error_code err = file::close(_handle);
         dassert(err == ERR_OK, "file::close failed, err = %s", err.to_string());
@@ -195,6 +218,10 @@ void log_file::flush() const
 error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
 {
     dassert(_is_read, "log file must be of read mode");
+    if (_mapping != nullptr) {
+        return read_next_mapped_log_block(bb);
+    }
+
     auto err = _stream->read_next(sizeof(log_block_header), bb);
     if (err != ERR_OK || bb.length() != sizeof(log_block_header)) {
         if (err == ERR_OK || err == ERR_HANDLE_EOF) {
@@ -242,6 +269,136 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
     return ERR_OK;
 }
 
+error_code log_file::read_next_mapped_log_block(/*out*/ ::dsn::blob &bb)
+{
+    size_t remaining = _mapping_size - _mapping_offset;
+    if (remaining == 0) {
+        return ERR_HANDLE_EOF;
+    }
+    if (remaining < sizeof(log_block_header)) {
+        return ERR_INCOMPLETE_DATA;
+    }
+
+    log_block_header hdr;
+    memcpy(&hdr, _mapping.get() + _mapping_offset, sizeof(hdr));
+    if (hdr.magic != 0xdeadbeef) {
+        derror("invalid data header magic: 0x%x", hdr.magic);
+        return ERR_INVALID_DATA;
+    }
+
+    size_t body_offset = _mapping_offset + sizeof(log_block_header);
+    remaining -= sizeof(log_block_header);
+    if (hdr.length < 0 || static_cast<size_t>(hdr.length) > remaining) {
+        derror("read data block body failed, size = %d vs %d, err = %s",
+               static_cast<int>(remaining),
+               hdr.length,
+               ERR_HANDLE_EOF.to_string());
+        return ERR_INCOMPLETE_DATA;
+    }
+
+    uint32_t crc;
+    auto it = std::lower_bound(_block_crcs.begin(),
+                               _block_crcs.end(),
+                               std::make_pair(body_offset, static_cast<uint32_t>(0)));
+    if (it != _block_crcs.end() && it->first == body_offset) {
+        // chain the crc calculated in advance to the previous block
+        crc = dsn::utils::crc32_concat(0, 0, _crc32, 0, 0, it->second, hdr.length);
+    } else {
+        crc = dsn::utils::crc32_calc(_mapping.get() + body_offset, hdr.length, _crc32);
+    }
+    if (crc != hdr.body_crc) {
+        derror("crc checking failed");
+        return ERR_INVALID_DATA;
+    }
+    _crc32 = crc;
+
+    bb = blob(std::shared_ptr<char>(_mapping, _mapping.get() + body_offset), hdr.length);
+    _mapping_offset = body_offset + hdr.length;
+    return ERR_OK;
+}
+
+bool log_file::map_file()
+{
+    size_t size = static_cast<size_t>(end_offset() - start_offset());
+    if (size == 0) {
+        return false;
+    }
+
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        dwarn_f("open {} failed, read it by aio instead, err = {}",
+                _path,
+                utils::safe_strerror(errno));
+        return false;
+    }
+    void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        dwarn_f("mmap {} failed, read it by aio instead, err = {}",
+                _path,
+                utils::safe_strerror(err));
+        return false;
+    }
+
+    _mapping.reset(static_cast<char *>(addr), [size](char *p) { ::munmap(p, size); });
+    _mapping_size = size;
+    return true;
+}
+
+void log_file::prefetch()
+{
+    dassert(_is_read, "log file must be of read mode");
+    if (!FLAGS_enable_mutation_log_replay_mmap || _prefetched) {
+        return;
+    }
+    _prefetched = true;
+    if (!map_file()) {
+        return;
+    }
+    ::madvise(_mapping.get(), _mapping_size, MADV_WILLNEED);
+    ::madvise(_mapping.get(), _mapping_size, MADV_SEQUENTIAL);
+
+    // the blocks are chained by crc, but the crc of each block can be calculated
+    // independently, and be chained by crc32_concat() when it's read
+    std::vector<std::pair<size_t, size_t>> blocks; // <body offset, length>
+    size_t offset = 0;
+    while (_mapping_size - offset >= sizeof(log_block_header)) {
+        log_block_header hdr;
+        memcpy(&hdr, _mapping.get() + offset, sizeof(hdr));
+        offset += sizeof(log_block_header);
+        if (hdr.magic != 0xdeadbeef || hdr.length < 0 ||
+            static_cast<size_t>(hdr.length) > _mapping_size - offset) {
+            // leave the error to be reported by the reads
+            break;
+        }
+        blocks.emplace_back(offset, hdr.length);
+        offset += hdr.length;
+    }
+
+    _block_crcs.resize(blocks.size());
+    auto calc = [this, &blocks](size_t first, size_t step) {
+        for (size_t i = first; i < blocks.size(); i += step) {
+            _block_crcs[i].first = blocks[i].first;
+            _block_crcs[i].second =
+                dsn::utils::crc32_calc(_mapping.get() + blocks[i].first, blocks[i].second, 0);
+        }
+    };
+    size_t thread_count = std::min<size_t>(FLAGS_mutation_log_replay_crc_threads, blocks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(calc, i, thread_count);
+    }
+    calc(0, std::max<size_t>(thread_count, 1));
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    // replay from the beginning
+    _mapping_offset = 0;
+    _crc32 = 0;
+}
+
 aio_task_ptr log_file::commit_log_block(log_block &block,
                                         int64_t offset,
                                         dsn::task_code evt,
@@ -324,7 +481,9 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
 
 void log_file::reset_stream(size_t offset /*default = 0*/)
 {
-    if (_stream == nullptr) {
+    if (_mapping != nullptr) {
+        _mapping_offset = std::min(offset, _mapping_size);
+    } else if (_stream == nullptr) {
         _stream.reset(new file_streamer(_handle, offset));
     } else {
         _stream->reset(offset);
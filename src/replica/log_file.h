@@ -28,11 +28,17 @@
 
 #include "log_block.h"
 
+#include <memory>
+#include <vector>
+
 #include <dsn/tool-api/zlocks.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_bool(enable_mutation_log_replay_mmap);
+
 // each log file has a log_file_header stored at the beginning of the first block's data content
 struct log_file_header
 {
@@ -121,6 +127,15 @@ public:
     //  - other io errors caused by file read operator
     error_code read_next_log_block(/*out*/ ::dsn::blob &bb);
 
+    // Prepares the file for a sequential replay if [replication] enable_mutation_log_replay_mmap
+    // is set: the whole file is mapped into memory and read ahead, and the crc of all the
+    // blocks is calculated in parallel. The following reads return blobs referring to the
+    // mapped pages directly, which keep the mapping alive.
+    // The data appended after the file is opened is invisible to the following reads, so
+    // it must not be called on the files being written.
+    // It's a no-op if called more than once, or if the file can't be mapped.
+    void prefetch();
+
     //
     // write routines
     //
@@ -188,6 +203,11 @@ private:
     // make private, user should create log_file through open_read() or open_write()
     log_file(const char *path, disk_file *handle, int index, int64_t start_offset, bool is_read);
 
+    // reads the next log block from `_mapping`
+    error_code read_next_mapped_log_block(/*out*/ ::dsn::blob &bb);
+
+    bool map_file();
+
 private:
     friend class mock_log_file;
 
@@ -197,6 +217,15 @@ private:
         _end_offset; // end offset in the global space: end_offset = start_offset + file_size
     class file_streamer;
     std::unique_ptr<file_streamer> _stream;
+
+    // the whole file mapped for read if prefetched, then `_stream` is not used
+    std::shared_ptr<char> _mapping;
+    size_t _mapping_size;
+    size_t _mapping_offset;
+    bool _prefetched;
+    // <local offset of the block body, crc of the block body with 0 as the initial crc>,
+    // sorted by offset, calculated by prefetch()
+    std::vector<std::pair<size_t, uint32_t>> _block_crcs;
     disk_file *_handle;        // file handle
     const bool _is_read;       // if opened for read or write
     std::string _path;         // file path
@@ -0,0 +1,281 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "log_group_committer.h"
+
+#include <algorithm>
+#include <map>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/safe_strerror_posix.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                enable_private_log_group_commit,
+                false,
+                "whether to coalesce the flushes of the private logs on the same disk");
+DSN_DEFINE_uint64("replication",
+                  private_log_group_commit_max_window_us,
+                  2000,
+                  "the max time that a private log group commit waits for more logs to arrive");
+DSN_DEFINE_uint32("replication",
+                  private_log_group_commit_max_batch_size,
+                  256,
+                  "the max count of private log flushes coalesced into one group commit");
+DSN_DEFINE_uint32("replication",
+                  private_log_group_commit_sync_threads,
+                  3,
+                  "the count of the threads helping a private log group commit to flush the logs "
+                  "of a batch in parallel");
+
+// weight of the latest sample in the EWMAs
+static const double kEwmaWeight = 0.1;
+
+/*static*/ log_group_committer *log_group_committer::get(const std::string &dir)
+{
+    // committers are never destroyed, because private logs may be flushed until process exits
+    static std::mutex s_lock;
+    static std::map<std::string, log_group_committer *> s_committers;
+
+    std::string name = dir;
+    struct stat st;
+    if (::stat(dir.c_str(), &st) == 0) {
+        name = fmt::format("dev{}:{}", major(st.st_dev), minor(st.st_dev));
+    } else {
+        dwarn_f("stat {} failed, err = {}, use a dedicated group committer for it",
+                dir,
+                utils::safe_strerror(errno));
+    }
+
+    std::lock_guard<std::mutex> l(s_lock);
+    auto &committer = s_committers[name];
+    if (committer == nullptr) {
+        committer = new log_group_committer(name);
+    }
+    return committer;
+}
+
+log_group_committer::log_group_committer(const std::string &name)
+    : _stopped(false),
+      _last_arrival_ns(0),
+      _arrival_interval_ns(0),
+      _flush_latency_ns(0),
+      _next_sync_file(0),
+      _unsynced_files(0),
+      _sync_stopped(false),
+      _sync_count(0)
+{
+    std::string counter_name = fmt::format("private.log.group.commit.batch.size@{}", name);
+    _batch_size_counter.init_app_counter("eon.replica_stub",
+                                         counter_name.c_str(),
+                                         COUNTER_TYPE_NUMBER_PERCENTILES,
+                                         "private log flushes coalesced into one group commit");
+    counter_name = fmt::format("private.log.group.commit.latency.ns@{}", name);
+    _commit_latency_counter.init_app_counter(
+        "eon.replica_stub",
+        counter_name.c_str(),
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "latency from issuing the private log write to the group commit done");
+
+    for (uint32_t i = 0; i < FLAGS_private_log_group_commit_sync_threads; ++i) {
+        _sync_workers.emplace_back([this]() {
+            task_worker::set_name("plog.group.sync");
+            run_sync_worker();
+        });
+    }
+    _worker = std::thread([this]() {
+        task_worker::set_name("plog.group.commit");
+        run();
+    });
+}
+
+log_group_committer::~log_group_committer()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopped = true;
+    }
+    _cond.notify_all();
+    _worker.join();
+
+    {
+        std::lock_guard<std::mutex> l(_sync_lock);
+        _sync_stopped = true;
+    }
+    _sync_cond.notify_all();
+    for (auto &t : _sync_workers) {
+        t.join();
+    }
+}
+
+void log_group_committer::flush(log_file_ptr lf,
+                                task_ptr continuation,
+                                size_t mutation_count,
+                                uint64_t write_start_ns)
+{
+    uint64_t now = dsn_now_ns();
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        if (_last_arrival_ns != 0) {
+            _arrival_interval_ns = (1 - kEwmaWeight) * _arrival_interval_ns +
+                                   kEwmaWeight * (now - std::min(now, _last_arrival_ns));
+        }
+        _last_arrival_ns = now;
+        _pending.push_back(
+            {std::move(lf), std::move(continuation), mutation_count, write_start_ns});
+    }
+    _cond.notify_one();
+}
+
+uint64_t log_group_committer::batch_window_ns() const
+{
+    // waiting longer than a flush costs more than flushing the logs in the next batch,
+    // and it's not worth waiting if no more log is expected in the meantime
+    auto window = static_cast<uint64_t>(_flush_latency_ns);
+    window = std::min(window, FLAGS_private_log_group_commit_max_window_us * 1000);
+    if (_arrival_interval_ns >= window) {
+        return 0;
+    }
+    return window;
+}
+
+void log_group_committer::sync_batch(const std::vector<flush_request> &batch)
+{
+    // a log may be written several times within one batch
+    std::vector<log_file *> files;
+    for (auto &req : batch) {
+        if (std::find(files.begin(), files.end(), req.lf.get()) == files.end()) {
+            files.push_back(req.lf.get());
+        }
+    }
+
+    _sync_count.fetch_add(files.size(), std::memory_order_relaxed);
+    if (files.size() == 1 || _sync_workers.empty()) {
+        for (auto lf : files) {
+            lf->flush();
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(_sync_lock);
+        _sync_files.swap(files);
+        _next_sync_file = 0;
+        _unsynced_files = _sync_files.size();
+    }
+    _sync_cond.notify_all();
+
+    // flush along with the helpers, then wait for the logs they have taken
+    sync_files();
+    std::unique_lock<std::mutex> l(_sync_lock);
+    _sync_cond.wait(l, [this]() { return _unsynced_files == 0; });
+    _sync_files.clear();
+}
+
+void log_group_committer::sync_files()
+{
+    while (true) {
+        log_file *lf;
+        {
+            std::lock_guard<std::mutex> l(_sync_lock);
+            if (_next_sync_file >= _sync_files.size()) {
+                return;
+            }
+            lf = _sync_files[_next_sync_file++];
+        }
+
+        // dies on failure, the data may be lost once the flush fails
+        lf->flush();
+
+        std::lock_guard<std::mutex> l(_sync_lock);
+        if (--_unsynced_files == 0) {
+            _sync_cond.notify_all();
+        }
+    }
+}
+
+void log_group_committer::run_sync_worker()
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> l(_sync_lock);
+            _sync_cond.wait(l, [this]() {
+                return _sync_stopped || _next_sync_file < _sync_files.size();
+            });
+            if (_sync_stopped) {
+                return;
+            }
+        }
+        sync_files();
+    }
+}
+
+void log_group_committer::run()
+{
+    std::vector<flush_request> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> l(_lock);
+            _cond.wait(l, [this]() { return _stopped || !_pending.empty(); });
+            if (_stopped) {
+                return;
+            }
+
+            uint64_t window = batch_window_ns();
+            if (window > 0 && _pending.size() < FLAGS_private_log_group_commit_max_batch_size) {
+                _cond.wait_for(l, std::chrono::nanoseconds(window), [this]() {
+                    return _stopped ||
+                           _pending.size() >= FLAGS_private_log_group_commit_max_batch_size;
+                });
+                if (_stopped) {
+                    return;
+                }
+            }
+            batch.swap(_pending);
+        }
+
+        uint64_t start = dsn_now_ns();
+        sync_batch(batch);
+        uint64_t end = dsn_now_ns();
+
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            _flush_latency_ns = (_flush_latency_ns == 0)
+                                    ? (end - start)
+                                    : (1 - kEwmaWeight) * _flush_latency_ns +
+                                          kEwmaWeight * (end - start);
+        }
+
+        _batch_size_counter->set(batch.size());
+        for (auto &req : batch) {
+            for (size_t i = 0; i < req.mutation_count; ++i) {
+                _commit_latency_counter->set(end - req.write_start_ns);
+            }
+            req.continuation->enqueue();
+        }
+        batch.clear();
+    }
+}
+
+} // namespace replication
+} // namespace dsn
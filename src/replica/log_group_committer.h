@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include "log_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(enable_private_log_group_commit);
+
+// log_group_committer coalesces the flushes of all private logs located on the same
+// disk. Each private log issues its write as usual, then hands the flush over to the
+// committer of its disk, which makes a batch of logs durable in a dedicated thread, and then
+// enqueues the continuation of every log. A log written several times within a batch is
+// flushed once, and the distinct logs of a batch are flushed in parallel by the committer
+// thread and `private_log_group_commit_sync_threads` helpers, so that the file system can
+// commit them in fewer journal transactions and the disk can serve them concurrently.
+//
+// Before each batch the committer may wait a short window for more logs to arrive. The
+// window is adapted to the observed arrival interval and flush latency: it is only opened
+// when another log is expected within one flush latency, and never exceeds the flush
+// latency or `private_log_group_commit_max_window_us`.
+class log_group_committer
+{
+public:
+    // Returns the committer shared by all the logs on the same disk as `dir`.
+    // thread safe
+    static log_group_committer *get(const std::string &dir);
+
+    explicit log_group_committer(const std::string &name);
+    ~log_group_committer();
+
+    // Flushes `lf` asynchronously, and enqueues `continuation` once it's done.
+    // `write_start_ns` is when the write of the `mutation_count` mutations was issued.
+    // thread safe
+    void flush(log_file_ptr lf,
+               task_ptr continuation,
+               size_t mutation_count,
+               uint64_t write_start_ns);
+
+private:
+    struct flush_request
+    {
+        log_file_ptr lf;
+        task_ptr continuation;
+        size_t mutation_count;
+        uint64_t write_start_ns;
+    };
+
+    void run();
+
+    // Makes all the logs of `batch` durable, flushing the distinct logs in parallel.
+    void sync_batch(const std::vector<flush_request> &batch);
+
+    // Flushes the logs of the current round until none is left to take.
+    // thread safe
+    void sync_files();
+
+    void run_sync_worker();
+
+    // how long to wait for more requests before flushing the batch
+    uint64_t batch_window_ns() const;
+
+private:
+    friend class log_group_committer_test;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::vector<flush_request> _pending;
+    bool _stopped;
+
+    // EWMAs to adapt the batch window, protected by `_lock`
+    uint64_t _last_arrival_ns;
+    double _arrival_interval_ns;
+    double _flush_latency_ns;
+
+    // the logs to be flushed in the current round of sync_batch(), protected by `_sync_lock`
+    std::mutex _sync_lock;
+    std::condition_variable _sync_cond;
+    std::vector<log_file *> _sync_files;
+    size_t _next_sync_file;
+    size_t _unsynced_files;
+    bool _sync_stopped;
+
+    // the count of the log flushes issued
+    std::atomic<uint64_t> _sync_count;
+
+    perf_counter_wrapper _batch_size_counter;
+    perf_counter_wrapper _commit_latency_counter;
+
+    std::thread _worker;
+    std::vector<std::thread> _sync_workers;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -47,6 +47,12 @@ DSN_DEFINE_uint64("replication",
                   1000 * 1000 * 1000, // 1s
                   "latency trace will be logged when exceed the write latency threshold");
 
+DSN_DEFINE_uint32("replication",
+                  prepare_zero_copy_min_bytes,
+                  4096,
+                  "update data not smaller than this is referenced by the prepare message "
+                  "rather than copied into it, 0 means always copy");
+
 std::atomic<uint64_t> mutation::s_tid(0);
 
 mutation::mutation()
@@ -203,7 +209,7 @@ void mutation::write_to(const std::function<void(const blob &)> &inserter) const
     }
 }
 
-void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
+void mutation::write_to(binary_writer &writer, dsn::message_ex *to) const
 {
     write_mutation_header(writer, data.header);
     writer.write_pod(static_cast<int>(data.updates.size()));
@@ -220,9 +226,17 @@ void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
 
         writer.write_pod(static_cast<int>(update.data.length()));
     }
-    // TODO(qinzuoyan): directly append buffer to message to avoid memory copy
     for (const mutation_update &update : data.updates) {
-        writer.write(update.data.data(), update.data.length());
+        // directly append the buffer to message to avoid memory copy, small data is still
+        // copied to avoid too many fragments to send
+        if (to != nullptr && FLAGS_prepare_zero_copy_min_bytes > 0 &&
+            update.data.length() >= FLAGS_prepare_zero_copy_min_bytes &&
+            update.data.buffer() != nullptr) {
+            writer.flush();
+            to->write_append(update.data);
+        } else {
+            writer.write(update.data.data(), update.data.length());
+        }
     }
 }
 
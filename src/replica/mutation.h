@@ -133,6 +133,9 @@ public:
     //   - the private log may be transfered to other node with different program
     //   - the private/shared log may be replayed by different program when server restart
     void write_to(const std::function<void(const blob &)> &inserter) const;
+    // If `to` is not null, it must be the message that `writer` writes to (i.e. `writer` is
+    // an rpc_write_stream of `to`), then the large update data is appended to `to` by
+    // reference instead of being copied.
     void write_to(binary_writer &writer, dsn::message_ex *to) const;
     static mutation_ptr read_from(binary_reader &reader, dsn::message_ex *from);
 
@@ -220,6 +223,9 @@ public:
     // which triggers further round of operations as returned
     mutation_ptr check_possible_work(int current_running_count);
 
+    void reset_max_concurrent_ops(int max_c) { _max_concurrent_op = max_c; }
+    int max_concurrent_ops() const { return _max_concurrent_op; }
+
 private:
     mutation_ptr unlink_next_workload()
     {
@@ -231,8 +237,6 @@ private:
         return r;
     }
 
-    void reset_max_concurrent_ops(int max_c) { _max_concurrent_op = max_c; }
-
 private:
     int _current_op_count;
     int _max_concurrent_op;
@@ -27,6 +27,7 @@
 #include "mutation_log.h"
 #include "replica.h"
 #include "mutation_log_utils.h"
+#include "log_group_committer.h"
 
 #include <dsn/utils/latency_tracer.h>
 #include <dsn/utility/filesystem.h>
@@ -202,7 +203,8 @@ mutation_log_private::mutation_log_private(const std::string &dir,
       replica_base(r),
       _batch_buffer_bytes(batch_buffer_bytes),
       _batch_buffer_max_count(batch_buffer_max_count),
-      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms)
+      _batch_buffer_flush_interval_ms(batch_buffer_flush_interval_ms),
+      _group_committer(nullptr)
 {
     mutation_log_private::init_states();
 }
@@ -364,6 +366,14 @@ void mutation_log_private::init_states()
     _pending_write_max_decree = 0;
 }
 
+void mutation_log_private::on_opened()
+{
+    // the log dir exists since now, which tells the disk of the committer
+    if (FLAGS_enable_private_log_group_commit) {
+        _group_committer = log_group_committer::get(dir());
+    }
+}
+
 void mutation_log_private::write_pending_mutations(bool release_lock_required)
 {
     dassert(release_lock_required, "lock must be hold at this point");
@@ -395,11 +405,12 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
                                                     std::shared_ptr<log_appender> &pending,
                                                     decree max_commit)
 {
+    uint64_t write_start_ns = dsn_now_ns();
     lf->commit_log_blocks(
         *pending,
         LPC_WRITE_REPLICATION_LOG_PRIVATE,
         &_tracker,
-        [this, lf, pending, max_commit](error_code err, size_t sz) mutable {
+        [this, lf, pending, max_commit, write_start_ns](error_code err, size_t sz) mutable {
             dassert(_is_writing.load(std::memory_order_relaxed), "");
 
             for (auto &block : pending->all_blocks()) {
@@ -421,26 +432,43 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
             // so that we can get all mutations in learning process.
             //
             // FIXME : the file could have been closed
+            if (_group_committer != nullptr) {
+                // the continuation is tracked by `_tracker` since now, so `flush_internal`
+                // would wait for the group commit.
+                task_ptr continuation = tasking::create_task(
+                    LPC_WRITE_REPLICATION_LOG_PRIVATE,
+                    &_tracker,
+                    [this, max_commit]() { on_pending_mutations_flushed(max_commit); },
+                    get_gpid().thread_hash());
+                _group_committer->flush(
+                    lf, std::move(continuation), pending->mutations().size(), write_start_ns);
+                return;
+            }
+
             lf->flush();
+            on_pending_mutations_flushed(max_commit);
+        },
+        get_gpid().thread_hash());
+}
 
-            // update _private_max_commit_on_disk after written into log file done
-            update_max_commit_on_disk(max_commit);
+void mutation_log_private::on_pending_mutations_flushed(decree max_commit)
+{
+    // update _private_max_commit_on_disk after written into log file done
+    update_max_commit_on_disk(max_commit);
 
-            _is_writing.store(false, std::memory_order_relaxed);
+    _is_writing.store(false, std::memory_order_relaxed);
 
-            // start to write if possible
-            _plock.lock();
+    // start to write if possible
+    _plock.lock();
 
-            if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
-                (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
-                 static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
-                 flush_interval_expired())) {
-                write_pending_mutations(true);
-            } else {
-                _plock.unlock();
-            }
-        },
-        get_gpid().thread_hash());
+    if (!_is_writing.load(std::memory_order_acquire) && _pending_write &&
+        (static_cast<uint32_t>(_pending_write->size()) >= _batch_buffer_bytes ||
+         static_cast<uint32_t>(_pending_write->blob_count()) >= _batch_buffer_max_count ||
+         flush_interval_expired())) {
+        write_pending_mutations(true);
+    } else {
+        _plock.unlock();
+    }
 }
 
 ///////////////////////////////////////////////////////////////
@@ -667,6 +695,7 @@ error_code mutation_log::open(replay_callback read_callback,
         _global_end_offset = end_offset;
         _last_file_index = _log_files.size() > 0 ? _log_files.rbegin()->first : 0;
         _is_opened = true;
+        on_opened();
     } else {
         // clear
         for (auto &kv : _log_files) {
@@ -47,6 +47,7 @@ namespace replication {
 // this class is thread safe
 //
 class replica;
+class log_group_committer;
 class mutation_log : public ref_counter
 {
 public:
@@ -300,6 +301,9 @@ protected:
     // init memory states
     virtual void init_states();
 
+    // called once the log is opened successfully
+    virtual void on_opened() {}
+
 private:
     //
     //  internal helpers
@@ -488,8 +492,13 @@ private:
                                   std::shared_ptr<log_appender> &pending,
                                   decree max_commit);
 
+    // called after the issued write is written and flushed into the log file
+    void on_pending_mutations_flushed(decree max_commit);
+
     virtual void init_states() override;
 
+    void on_opened() override;
+
     // flush at most count times
     // if count <= 0, means flush until all data is on disk
     void flush_internal(int max_count);
@@ -516,6 +525,10 @@ private:
     uint32_t _batch_buffer_bytes;
     uint32_t _batch_buffer_max_count;
     uint64_t _batch_buffer_flush_interval_ms;
+
+    // the committer of the disk of the log if enable_private_log_group_commit, resolved once
+    // the log is opened
+    log_group_committer *_group_committer;
 };
 
 } // namespace replication
@@ -17,6 +17,7 @@
 
 #include "mutation_log.h"
 #include "mutation_log_utils.h"
+#include <future>
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/errors.h>
 #include <dsn/dist/fmt_logging.h>
@@ -36,6 +37,7 @@ namespace replication {
            log->end_offset() - log->start_offset());
 
     ::dsn::blob bb;
+    log->prefetch();
     log->reset_stream();
     error_s err;
     size_t start_offset = 0;
@@ -160,8 +162,19 @@ namespace replication {
 
     end_offset = g_start_offset;
 
-    for (auto &kv : logs) {
-        log_file_ptr &log = kv.second;
+    // the files must be replayed in order, but the next file can be read ahead and verified
+    // while the current one is replayed
+    std::future<void> prefetching;
+    for (auto it = logs.begin(); it != logs.end(); ++it) {
+        log_file_ptr &log = it->second;
+        if (prefetching.valid()) {
+            prefetching.get();
+        }
+        auto next = std::next(it);
+        if (FLAGS_enable_mutation_log_replay_mmap && next != logs.end()) {
+            log_file_ptr next_log = next->second;
+            prefetching = std::async(std::launch::async, [next_log]() { next_log->prefetch(); });
+        }
 
         if (log->start_offset() != end_offset) {
             derror("offset mismatch in log file offset and global offset %" PRId64 " vs %" PRId64,
@@ -0,0 +1,142 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "node_write_throttler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <dsn/c/api_layer1.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_uint64("replication",
+                  node_write_throttling_log_backlog_kb,
+                  0,
+                  "delay the writes on this node once the shared log is estimated to have more "
+                  "pending bytes than this, 0 means no throttling");
+DSN_DEFINE_uint64("replication",
+                  node_write_throttling_max_delay_ms,
+                  1000,
+                  "reject the writes instead if they are estimated to be delayed longer");
+
+// the bandwidth of the log is sampled no more frequently than this
+static const uint64_t kSampleIntervalNs = 100 * 1000 * 1000;
+// weight of the latest sample in the EWMA of the bandwidth
+static const double kEwmaWeight = 0.3;
+
+node_write_throttler::node_write_throttler()
+    : _pending_bytes(0),
+      _pending_time_ns(0),
+      _written_bytes(0),
+      _busy(false),
+      _sample_start_ns(0),
+      _bandwidth(0)
+{
+}
+
+void node_write_throttler::on_log_write_issued(int64_t pending_bytes)
+{
+    if (FLAGS_node_write_throttling_log_backlog_kb == 0) {
+        return;
+    }
+    _pending_bytes.store(pending_bytes, std::memory_order_relaxed);
+    _pending_time_ns.store(dsn_now_ns(), std::memory_order_relaxed);
+    if (pending_bytes > 0 && !_busy.load(std::memory_order_relaxed)) {
+        _busy.store(true, std::memory_order_relaxed);
+    }
+}
+
+void node_write_throttler::on_log_write_completed(int64_t bytes)
+{
+    if (FLAGS_node_write_throttling_log_backlog_kb == 0) {
+        return;
+    }
+    _written_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t now = dsn_now_ns();
+    if (now - _sample_start_ns.load(std::memory_order_relaxed) >= kSampleIntervalNs) {
+        sample_bandwidth(now);
+    }
+}
+
+void node_write_throttler::sample_bandwidth(uint64_t now_ns)
+{
+    std::unique_lock<std::mutex> l(_sample_lock, std::try_to_lock);
+    uint64_t start = _sample_start_ns.load(std::memory_order_relaxed);
+    if (!l.owns_lock() || now_ns - start < kSampleIntervalNs) {
+        return;
+    }
+
+    int64_t bytes = _written_bytes.exchange(0, std::memory_order_relaxed);
+    _sample_start_ns.store(now_ns, std::memory_order_relaxed);
+    // the completions reflect the bandwidth of the log only if it was busy all along
+    if (start == 0 || !_busy.exchange(false, std::memory_order_relaxed)) {
+        return;
+    }
+    double sample = static_cast<double>(bytes) * 1e9 / (now_ns - start);
+    double bandwidth = _bandwidth.load(std::memory_order_relaxed);
+    _bandwidth.store(bandwidth == 0 ? sample : (1 - kEwmaWeight) * bandwidth + kEwmaWeight * sample,
+                     std::memory_order_relaxed);
+}
+
+int64_t node_write_throttler::backlog_bytes(uint64_t now_ns) const
+{
+    uint64_t pending_time = _pending_time_ns.load(std::memory_order_relaxed);
+    double drained = log_bandwidth() * (now_ns - std::min(now_ns, pending_time)) / 1e9;
+    return std::max<int64_t>(
+        _pending_bytes.load(std::memory_order_relaxed) - static_cast<int64_t>(drained), 0);
+}
+
+throttling_controller::throttling_type node_write_throttler::control(int64_t client_timeout_ms,
+                                                                     int32_t request_bytes,
+                                                                     int64_t &delay_ms)
+{
+    if (FLAGS_node_write_throttling_log_backlog_kb == 0) {
+        return throttling_controller::PASS;
+    }
+    double bandwidth = log_bandwidth();
+    if (bandwidth <= 0) {
+        return throttling_controller::PASS;
+    }
+    auto threshold = static_cast<int64_t>(FLAGS_node_write_throttling_log_backlog_kb * 1024);
+    int64_t excess = backlog_bytes(dsn_now_ns()) - threshold;
+    if (excess <= 0) {
+        return throttling_controller::PASS;
+    }
+
+    // wait until the excess backlog is drained, and for the turn of this request
+    double burst = std::max(bandwidth * kSampleIntervalNs / 1e9, double(request_bytes));
+    auto wait_s = _bucket.consumeWithBorrowNonBlocking(request_bytes, bandwidth, burst);
+    double wait_ms = std::max(excess * 1000 / bandwidth, wait_s.get_value_or(0) * 1000);
+    if (wait_ms > FLAGS_node_write_throttling_max_delay_ms) {
+        if (wait_s && request_bytes > 0) {
+            _bucket.returnTokens(request_bytes, bandwidth);
+        }
+        delay_ms = 0;
+        return throttling_controller::REJECT;
+    }
+
+    delay_ms = static_cast<int64_t>(std::ceil(wait_ms));
+    if (client_timeout_ms > 0) {
+        delay_ms = std::min(delay_ms, client_timeout_ms / 2);
+    }
+    return throttling_controller::DELAY;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include <dsn/utility/TokenBucket.h>
+#include <dsn/utility/flags.h>
+
+#include "utils/throttling_controller.h"
+
+namespace dsn {
+namespace replication {
+
+// node_write_throttler applies backpressure to all the writes on a node once the shared log
+// can't keep up with them.
+//
+// It measures the bandwidth of the shared log from the completed appends issued by the
+// primaries while the log is busy, and estimates its backlog from the pending bytes reported
+// by the latest append. Once the backlog exceeds `node_write_throttling_log_backlog_kb`, the
+// writes are delayed until the backlog is expected to be drained, and are admitted no faster
+// than the measured bandwidth.
+//
+// thread safe
+class node_write_throttler
+{
+public:
+    node_write_throttler();
+
+    // `pending_bytes` is the bytes of the shared log pending to be written after an append
+    void on_log_write_issued(int64_t pending_bytes);
+
+    void on_log_write_completed(int64_t bytes);
+
+    // 'delay_ms' is set when the return type is not PASS
+    throttling_controller::throttling_type
+    control(int64_t client_timeout_ms, int32_t request_bytes, /*out*/ int64_t &delay_ms);
+
+    // bytes per second, 0 if not measured yet
+    double log_bandwidth() const { return _bandwidth.load(std::memory_order_relaxed); }
+
+private:
+    friend class node_write_throttler_test;
+
+    // the estimated bytes still pending in the shared log at `now_ns`
+    int64_t backlog_bytes(uint64_t now_ns) const;
+
+    void sample_bandwidth(uint64_t now_ns);
+
+private:
+    // the pending bytes reported by the latest append and when
+    std::atomic<int64_t> _pending_bytes;
+    std::atomic<uint64_t> _pending_time_ns;
+
+    std::atomic<int64_t> _written_bytes;
+    // whether the log was busy in the current sampling window
+    std::atomic<bool> _busy;
+    std::mutex _sample_lock;
+    std::atomic<uint64_t> _sample_start_ns;
+    std::atomic<double> _bandwidth;
+
+    // paces the writes admitted while throttling at the bandwidth of the log
+    folly::DynamicTokenBucket _bucket;
+};
+
+} // namespace replication
+} // namespace dsn
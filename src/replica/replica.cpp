@@ -53,8 +53,12 @@ replica::replica(
     : serverlet<replica>("replica"),
       replica_base(gpid, fmt::format("{}@{}", gpid, stub->_primary_address_str), app.app_name),
       _app_info(app),
-      _primary_states(
-          gpid, stub->options().staleness_for_commit, stub->options().batch_write_disabled),
+      _primary_states(gpid,
+                      stub->options().staleness_for_commit,
+                      stub->options().batch_write_disabled,
+                      adaptive_prepare_window::max_window_of(
+                          stub->options().staleness_for_commit,
+                          stub->options().max_mutation_count_in_prepare_list)),
       _potential_secondary_states(this),
       _cold_backup_running_count(0),
       _cold_backup_max_duration_time_ms(0),
@@ -339,6 +343,9 @@ void replica::execute_mutation(mutation_ptr &mu)
 
     if (status() == partition_status::PS_PRIMARY) {
         ADD_CUSTOM_POINT(mu->tracer, "completed");
+        if (_duplicating && err == ERR_OK) {
+            _duplication_mgr->hot_tail()->append(mu);
+        }
         mutation_ptr next = _primary_states.write_queue.check_possible_work(
             static_cast<int>(_prepare_list->max_decree() - d));
 
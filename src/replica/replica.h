@@ -268,6 +268,10 @@ private:
                               bool pop_all_committed_mutations = false,
                               int64_t learn_signature = invalid_signature);
     void on_append_log_completed(mutation_ptr &mu, error_code err, size_t size);
+    // apply the adaptive prepare window to the write queue
+    void update_prepare_window();
+    // the max count of uncommitted mutations of the primary
+    int max_prepare_window() const;
     void on_prepare_reply(std::pair<mutation_ptr, partition_status::type> pr,
                           error_code err,
                           dsn::message_ex *request,
@@ -280,6 +284,13 @@ private:
     // learning
     void init_learn(uint64_t signature);
     void on_learn_reply(error_code err, learn_request &&req, learn_response &&resp);
+    // called in the replication thread once the md5 of the reusable files is verified,
+    // `mismatched` of them are copied instead
+    void on_reusable_files_verified(size_t mismatched,
+                                    learn_request &&req,
+                                    learn_response &&resp);
+    // copies the learned files except the reusable ones, which are linked after the copy
+    void copy_learned_files(learn_request &&req, learn_response &&resp);
     void on_copy_remote_state_completed(error_code err,
                                         size_t size,
                                         uint64_t copy_start_time,
@@ -437,6 +448,8 @@ private:
     void update_throttle_env_internal(const std::map<std::string, std::string> &envs,
                                       const std::string &key,
                                       throttling_controller &cntl);
+    // only the primaries count in the throttling quotas shared on this node
+    void update_throttle_primary();
 
     // update allowed users for access controller
     void update_ac_allowed_users(const std::map<std::string, std::string> &envs);
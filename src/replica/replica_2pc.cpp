@@ -133,6 +133,9 @@ void replica::on_client_write(dsn::message_ex *request, bool ignore_throttling)
     }
 
     dinfo("%s: got write request from %s", name(), request->header->from_address.to_string());
+    if (FLAGS_enable_adaptive_prepare_window) {
+        _primary_states.prepare_window.on_write_arrived(dsn_now_ns(), request->body_size());
+    }
     auto mu = _primary_states.write_queue.add_work(request->rpc_code(), request, this);
     if (mu) {
         init_prepare(mu, false);
@@ -174,7 +177,7 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
     mu->set_is_sync_to_child(_primary_states.sync_send_write_request);
 
     // check bounded staleness
-    if (mu->data.header.decree > last_committed_decree() + _options->staleness_for_commit) {
+    if (mu->data.header.decree > last_committed_decree() + max_prepare_window()) {
         err = ERR_CAPACITY_EXCEEDED;
         goto ErrOut;
     }
@@ -257,17 +260,23 @@ void replica::init_prepare(mutation_ptr &mu, bool reconciliation, bool pop_all_c
                 mu->data.header.log_offset);
         dassert(mu->log_task() == nullptr, "");
         int64_t pending_size;
-        mu->log_task() = _stub->_log->append(mu,
-                                             LPC_WRITE_REPLICATION_LOG,
-                                             &_tracker,
-                                             std::bind(&replica::on_append_log_completed,
-                                                       this,
-                                                       mu,
-                                                       std::placeholders::_1,
-                                                       std::placeholders::_2),
-                                             get_gpid().thread_hash(),
-                                             &pending_size);
+        uint64_t log_start_ns = dsn_now_ns();
+        mu->log_task() = _stub->_log->append(
+            mu,
+            LPC_WRITE_REPLICATION_LOG,
+            &_tracker,
+            [this, mu, log_start_ns](error_code err, size_t size) mutable {
+                if (err == ERR_OK && FLAGS_enable_adaptive_prepare_window) {
+                    _primary_states.prepare_window.on_local_log_completed(dsn_now_ns() -
+                                                                          log_start_ns);
+                    update_prepare_window();
+                }
+                on_append_log_completed(mu, err, size);
+            },
+            get_gpid().thread_hash(),
+            &pending_size);
         dassert(nullptr != mu->log_task(), "");
+        _stub->_node_write_throttler.on_log_write_issued(pending_size);
         if (_options->log_shared_pending_size_throttling_threshold_kb > 0 &&
             _options->log_shared_pending_size_throttling_delay_ms > 0 &&
             pending_size >= _options->log_shared_pending_size_throttling_threshold_kb * 1024) {
@@ -318,11 +327,19 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
         mu->write_to(writer, msg);
     }
 
+    uint64_t send_ts_ns = dsn_now_ns();
     mu->remote_tasks()[addr] =
         rpc::call(addr,
                   msg,
                   &_tracker,
                   [=](error_code err, dsn::message_ex *request, dsn::message_ex *reply) {
+                      // potential secondaries are learning, don't size the window by them
+                      if (err == ERR_OK && FLAGS_enable_adaptive_prepare_window &&
+                          rconfig.status == partition_status::PS_SECONDARY) {
+                          _primary_states.prepare_window.on_prepare_acked(dsn_now_ns() -
+                                                                          send_ts_ns);
+                          update_prepare_window();
+                      }
                       on_prepare_reply(std::make_pair(mu, rconfig.status), err, request, reply);
                   },
                   get_gpid().thread_hash());
@@ -334,6 +351,38 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
           enum_to_string(rconfig.status));
 }
 
+int replica::max_prepare_window() const
+{
+    return FLAGS_enable_adaptive_prepare_window ? _primary_states.prepare_window.max_window()
+                                                : _options->staleness_for_commit;
+}
+
+void replica::update_prepare_window()
+{
+    int window = _primary_states.prepare_window.window();
+    int old_window = _primary_states.write_queue.max_concurrent_ops();
+    if (window == old_window) {
+        return;
+    }
+
+    dinfo_replica("max concurrent 2pc rounds changed from {} to {}", old_window, window);
+    _primary_states.write_queue.reset_max_concurrent_ops(window);
+    if (window < old_window || status() != partition_status::PS_PRIMARY) {
+        return;
+    }
+
+    // start the queued writes the wider window allows now, rather than waiting for the next
+    // round to complete
+    for (int i = old_window; i < window; ++i) {
+        mutation_ptr next = _primary_states.write_queue.check_possible_work(
+            static_cast<int>(_prepare_list->max_decree() - last_committed_decree()));
+        if (!next) {
+            break;
+        }
+        init_prepare(next, false);
+    }
+}
+
 void replica::do_possible_commit_on_primary(mutation_ptr &mu)
 {
     dassert(_config.ballot == mu->data.header.ballot,
@@ -469,6 +518,28 @@ void replica::on_prepare(dsn::message_ex *request)
         return;
     }
 
+    if (partition_status::PS_SECONDARY == status()) {
+        // the primary may run a prepare window wider than staleness_for_commit, up to its own
+        // adaptive_prepare_window_max, which may differ from ours while the config is changing,
+        // so the prepares beyond our window are rejected to be retried rather than asserted.
+        // The prepare commits up to the last committed decree of the primary first.
+        int max_window = adaptive_prepare_window::max_window_of(
+            _options->staleness_for_commit, _options->max_mutation_count_in_prepare_list);
+        decree committed =
+            std::max(last_committed_decree(), mu->data.header.last_committed_decree);
+        if (decree > committed + max_window) {
+            derror("%s: mutation %s on_prepare skipped as out of the prepare window, "
+                   "last_committed_decree = %" PRId64 ", max_window = %d, ack %s",
+                   name(),
+                   mu->name(),
+                   committed,
+                   max_window,
+                   ERR_TRY_AGAIN.to_string());
+            ack_prepare_message(ERR_TRY_AGAIN, mu);
+            return;
+        }
+    }
+
     error_code err = _prepare_list->prepare(mu, status());
     dassert(err == ERR_OK, "prepare mutation failed, err = %s", err.to_string());
 
@@ -480,14 +551,7 @@ void replica::on_prepare(dsn::message_ex *request)
                 last_committed_decree() + _options->max_mutation_count_in_prepare_list,
                 last_committed_decree(),
                 _options->max_mutation_count_in_prepare_list);
-    } else if (partition_status::PS_SECONDARY == status()) {
-        dassert(mu->data.header.decree <= last_committed_decree() + _options->staleness_for_commit,
-                "%" PRId64 " VS %" PRId64 "(%" PRId64 " + %d)",
-                mu->data.header.decree,
-                last_committed_decree() + _options->staleness_for_commit,
-                last_committed_decree(),
-                _options->staleness_for_commit);
-    } else {
+    } else if (partition_status::PS_SECONDARY != status()) {
         derror("%s: mutation %s on_prepare failed as invalid replica state, state = %s",
                name(),
                mu->name(),
@@ -527,6 +591,10 @@ void replica::on_append_log_completed(mutation_ptr &mu, error_code err, size_t s
 
     if (err == ERR_OK) {
         mu->set_logged();
+        // only the writes issued by the primaries are sampled, like the pending bytes
+        if (status() == partition_status::PS_PRIMARY) {
+            _stub->_node_write_throttler.on_log_write_completed(mu->appro_data_bytes());
+        }
     } else {
         derror("%s: append shared log failed for mutation %s, err = %s",
                name(),
@@ -995,6 +995,8 @@ bool replica::update_local_configuration(const replica_configuration &config,
            boost::lexical_cast<std::string>(_config).c_str());
 
     if (status() != old_status) {
+        update_throttle_primary();
+
         bool is_closing =
             (status() == partition_status::PS_ERROR ||
              (status() == partition_status::PS_INACTIVE && get_ballot() > old_ballot));
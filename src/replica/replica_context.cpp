@@ -247,6 +247,7 @@ bool potential_secondary_context::cleanup(bool force)
     }
     learning_start_prepare_decree = invalid_decree;
     first_learn_start_decree = invalid_decree;
+    reuse_local_files_failed = false;
     learning_status = learner_status::LearningInvalid;
     return true;
 }
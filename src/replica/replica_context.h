@@ -31,6 +31,7 @@
 #include <dsn/cpp/json_helper.h>
 
 #include "mutation.h"
+#include "adaptive_prepare_window.h"
 
 class replication_service_test_app;
 
@@ -77,9 +78,15 @@ typedef std::unordered_map<::dsn::rpc_address, remote_learner_state> learner_map
 class primary_context
 {
 public:
-    primary_context(gpid gpid, int max_concurrent_2pc_count = 1, bool batch_write_disabled = false)
+    primary_context(gpid gpid,
+                    int max_concurrent_2pc_count = 1,
+                    bool batch_write_disabled = false,
+                    int max_prepare_window = 1)
         : next_learning_version(0),
           write_queue(gpid, max_concurrent_2pc_count, batch_write_disabled),
+          prepare_window(max_concurrent_2pc_count,
+                         std::max(max_prepare_window, max_concurrent_2pc_count),
+                         batch_write_disabled),
           last_prepare_decree_on_new_primary(0),
           last_prepare_ts_ms(dsn_now_ms())
     {
@@ -115,6 +122,8 @@ public:
 
     // 2pc batching
     mutation_queue write_queue;
+    // sizes the max concurrent 2pc rounds of write_queue if enable_adaptive_prepare_window
+    adaptive_prepare_window prepare_window;
 
     // group check
     dsn::task_ptr group_check_task; // the repeated group check task of LPC_GROUP_CHECK
@@ -228,6 +237,10 @@ public:
     volatile bool learn_app_concurrent_count_increased;
     decree learning_start_prepare_decree;
 
+    // Set if the learner failed to reuse its local files in a round of learn, then it copies
+    // all the files in the following rounds.
+    volatile bool reuse_local_files_failed{false};
+
     // The start decree in the first round of learn.
     // It indicates the minimum decree under `learn/` dir.
     decree first_learn_start_decree{invalid_decree};
@@ -202,6 +202,9 @@ void replica::init_learn(uint64_t signature)
     request.learner = _stub->_primary_address;
     request.signature = _potential_secondary_states.learning_version;
     _app->prepare_get_checkpoint(request.app_specific_learn_request);
+    if (FLAGS_learn_reuse_local_files && !_potential_secondary_states.reuse_local_files_failed) {
+        request.__set_local_files(collect_local_files(_app->data_dir()));
+    }
 
     ddebug("%s: init_learn[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
            " ms, max_gced_decree = %" PRId64 ", local_committed_decree = %" PRId64 ", "
@@ -543,6 +546,29 @@ void replica::on_learn(dsn::message_ex *msg, const learn_request &request)
         file = file.substr(response.base_local_dir.length() + 1);
     }
 
+    if (response.type == learn_type::LT_APP && !request.local_files.empty() &&
+        !response.state.files.empty() && !delayed_replay_prepare_list) {
+        // the md5 of the learned files may have to be calculated, which is too slow for the
+        // replication thread
+        tasking::enqueue(
+            LPC_REPLICATION_LONG_COMMON,
+            &_tracker,
+            [ this, msg_cap = message_ptr(msg), request, response ]() mutable {
+                response.__set_reusable_files(match_reusable_files(response.base_local_dir,
+                                                                   response.state.files,
+                                                                   request.local_files,
+                                                                   _stub->_learn_file_md5_cache));
+                ddebug_replica("on_learn[{:#018x}]: learner = {}, {} of {} learned files can be "
+                               "reused by the learner",
+                               request.signature,
+                               request.learner.to_string(),
+                               response.reusable_files.size(),
+                               response.state.files.size());
+                reply(msg_cap.get(), response);
+            });
+        return;
+    }
+
     reply(msg, response);
 
     // the replayed prepare msg needs to be AFTER the learning response msg
@@ -913,34 +939,37 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
             return;
         }
 
-        bool high_priority = (resp.type == learn_type::LT_APP ? false : true);
-        ddebug("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
-               " ms, start to copy remote files, copy_file_count = %d, priority = %s",
-               name(),
-               req.signature,
-               resp.config.primary.to_string(),
-               _potential_secondary_states.duration_ms(),
-               static_cast<int>(resp.state.files.size()),
-               high_priority ? "high" : "low");
-
-        _potential_secondary_states.learn_remote_files_task = _stub->_nfs->copy_remote_files(
-            resp.config.primary,
-            resp.base_local_dir,
-            resp.state.files,
-            learn_dir,
-            true, // overwrite
-            high_priority,
-            LPC_REPLICATION_COPY_REMOTE_FILES,
-            &_tracker,
-            [
-              this,
-              copy_start = _potential_secondary_states.duration_ms(),
-              req_cap = std::move(req),
-              resp_copy = resp
-            ](error_code err, size_t sz) mutable {
-                on_copy_remote_state_completed(
-                    err, sz, copy_start, std::move(req_cap), std::move(resp_copy));
+        if (resp.reusable_files.empty()) {
+            copy_learned_files(std::move(req), std::move(resp));
+            return;
+        }
+
+        // the local files which don't match the md5 of the learned files are copied as the
+        // others, the md5 may have to be calculated, which is too slow for the replication
+        // thread, so it's calculated in the long pool and the copy is started back in the
+        // replication thread
+        _potential_secondary_states.learn_remote_files_task =
+            tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES, &_tracker, [
+                this,
+                req_cap = std::move(req),
+                resp_cap = std::move(resp)
+            ]() mutable {
+                size_t mismatched = verify_reusable_files(
+                    _app->data_dir(), resp_cap.reusable_files, _stub->_learn_file_md5_cache);
+                tasking::enqueue(LPC_LEARN_REUSABLE_FILES_VERIFIED,
+                                 &_tracker,
+                                 [
+                                   this,
+                                   mismatched,
+                                   req_cap = std::move(req_cap),
+                                   resp_cap = std::move(resp_cap)
+                                 ]() mutable {
+                                     on_reusable_files_verified(
+                                         mismatched, std::move(req_cap), std::move(resp_cap));
+                                 },
+                                 get_gpid().thread_hash());
             });
+        _potential_secondary_states.learn_remote_files_task->enqueue();
     } else {
         _potential_secondary_states.learn_remote_files_task =
             tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES, &_tracker, [
@@ -956,6 +985,91 @@ void replica::on_learn_reply(error_code err, learn_request &&req, learn_response
     }
 }
 
+void replica::on_reusable_files_verified(size_t mismatched,
+                                         learn_request &&req,
+                                         learn_response &&resp)
+{
+    _checker.only_one_thread_access();
+
+    // the learning may have been cleaned up or restarted while the md5 was being calculated
+    if (partition_status::PS_POTENTIAL_SECONDARY != status() ||
+        req.signature != (int64_t)_potential_secondary_states.learning_version) {
+        dwarn_replica("on_reusable_files_verified[{:#018x}]: learnee = {}, the learning is "
+                      "already over, status = {}, learning_version = {:#018x}, ignore",
+                      req.signature,
+                      resp.config.primary.to_string(),
+                      enum_to_string(status()),
+                      _potential_secondary_states.learning_version);
+        return;
+    }
+
+    if (mismatched > 0) {
+        dwarn_replica("on_learn_reply[{:#018x}]: learnee = {}, {} local files can't be reused, "
+                      "copy them instead",
+                      req.signature,
+                      resp.config.primary.to_string(),
+                      mismatched);
+    }
+    copy_learned_files(std::move(req), std::move(resp));
+}
+
+void replica::copy_learned_files(learn_request &&req, learn_response &&resp)
+{
+    // the reusable files are linked from local after the others are copied
+    std::vector<std::string> copy_files;
+    for (const auto &f : resp.state.files) {
+        if (resp.reusable_files.find(f) == resp.reusable_files.end()) {
+            copy_files.push_back(f);
+        }
+    }
+
+    bool high_priority = (resp.type == learn_type::LT_APP ? false : true);
+    ddebug("%s: on_learn_reply[%016" PRIx64 "]: learnee = %s, learn_duration = %" PRIu64
+           " ms, start to copy remote files, copy_file_count = %d, reuse_file_count = %d, "
+           "priority = %s",
+           name(),
+           req.signature,
+           resp.config.primary.to_string(),
+           _potential_secondary_states.duration_ms(),
+           static_cast<int>(copy_files.size()),
+           static_cast<int>(resp.reusable_files.size()),
+           high_priority ? "high" : "low");
+
+    if (copy_files.empty()) {
+        _potential_secondary_states.learn_remote_files_task =
+            tasking::create_task(LPC_LEARN_REMOTE_DELTA_FILES, &_tracker, [
+                this,
+                copy_start = _potential_secondary_states.duration_ms(),
+                req_cap = std::move(req),
+                resp_cap = std::move(resp)
+            ]() mutable {
+                on_copy_remote_state_completed(
+                    ERR_OK, 0, copy_start, std::move(req_cap), std::move(resp_cap));
+            });
+        _potential_secondary_states.learn_remote_files_task->enqueue();
+        return;
+    }
+
+    _potential_secondary_states.learn_remote_files_task = _stub->_nfs->copy_remote_files(
+        resp.config.primary,
+        resp.base_local_dir,
+        copy_files,
+        _app->learn_dir(),
+        true, // overwrite
+        high_priority,
+        LPC_REPLICATION_COPY_REMOTE_FILES,
+        &_tracker,
+        [
+          this,
+          copy_start = _potential_secondary_states.duration_ms(),
+          req_cap = std::move(req),
+          resp_copy = resp
+        ](error_code err, size_t sz) mutable {
+            on_copy_remote_state_completed(
+                err, sz, copy_start, std::move(req_cap), std::move(resp_copy));
+        });
+}
+
 bool replica::prepare_cached_learn_state(const learn_request &request,
                                          decree learn_start_decree,
                                          decree local_committed_decree,
@@ -1062,10 +1176,28 @@ void replica::on_copy_remote_state_completed(error_code err,
                _stub->_learn_app_concurrent_count.load());
     }
 
+    if (err == ERR_OK && !resp.reusable_files.empty()) {
+        err = link_reusable_files(_app->data_dir(),
+                                  _app->learn_dir(),
+                                  resp.reusable_files,
+                                  _stub->_learn_file_md5_cache);
+        if (err != ERR_OK) {
+            // it's rare, just copy all the files in the next rounds
+            _potential_secondary_states.reuse_local_files_failed = true;
+        }
+        ddebug_replica("on_copy_remote_state_completed[{:#018x}]: learnee = {}, link {} "
+                       "reusable local files, err = {}",
+                       req.signature,
+                       resp.config.primary.to_string(),
+                       resp.reusable_files.size(),
+                       err);
+    }
+
     if (err == ERR_OK) {
-        _potential_secondary_states.learning_copy_file_count += resp.state.files.size();
+        const size_t copy_file_count = resp.state.files.size() - resp.reusable_files.size();
+        _potential_secondary_states.learning_copy_file_count += copy_file_count;
         _potential_secondary_states.learning_copy_file_size += size;
-        _stub->_counter_replicas_learning_recent_copy_file_count->add(resp.state.files.size());
+        _stub->_counter_replicas_learning_recent_copy_file_count->add(copy_file_count);
         _stub->_counter_replicas_learning_recent_copy_file_size->add(size);
     }
 
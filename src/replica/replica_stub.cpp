@@ -747,6 +747,8 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
 
     // attach rps
     _replicas = std::move(rps);
+    _replicas_snapshot.publish(_replicas);
+    _replicas_snapshot.reclaim();
     _counter_replicas_count->add((uint64_t)_replicas.size());
     for (const auto &kv : _replicas) {
         _fs_manager.add_replica(kv.first, kv.second->dir());
@@ -895,15 +897,7 @@ dsn::error_code replica_stub::on_kill_replica(gpid id)
     }
 }
 
-replica_ptr replica_stub::get_replica(gpid id) const
-{
-    zauto_read_lock l(_replicas_lock);
-    auto it = _replicas.find(id);
-    if (it != _replicas.end())
-        return it->second;
-    else
-        return nullptr;
-}
+replica_ptr replica_stub::get_replica(gpid id) const { return _replicas_snapshot.get(id); }
 
 replica_stub::replica_life_cycle replica_stub::get_replica_life_cycle(gpid id)
 {
@@ -1932,12 +1926,14 @@ void replica_stub::on_disk_stat()
             _counter_replicas_closing_count->decrement();
 
             _replicas.emplace(id, rep);
+            _replicas_snapshot.publish(_replicas, id);
             _counter_replicas_count->increment();
 
             _closed_replicas.erase(id);
 
             // unlock here to avoid dead lock
             _replicas_lock.unlock_write();
+            _replicas_snapshot.reclaim();
 
             ddebug("open replica '%s.%s' which is to be closed, reopen it",
                    app.app_type.c_str(),
@@ -2058,10 +2054,12 @@ void replica_stub::open_replica(const app_info &app,
         auto it = _replicas.find(id);
         dassert(it == _replicas.end(), "replica %s is already in _replicas", id.to_string());
         _replicas.insert(replicas::value_type(rep->get_gpid(), rep));
+        _replicas_snapshot.publish(_replicas, id);
         _counter_replicas_count->increment();
 
         _closed_replicas.erase(id);
     }
+    _replicas_snapshot.reclaim();
 
     if (nullptr != req) {
         rpc::call_one_way_typed(
@@ -2085,9 +2083,13 @@ void replica_stub::open_replica(const app_info &app,
 
     gpid id = r->get_gpid();
 
-    zauto_write_lock l(_replicas_lock);
-
-    if (_replicas.erase(id) > 0) {
+    task_ptr task;
+    {
+        zauto_write_lock l(_replicas_lock);
+        if (_replicas.erase(id) == 0) {
+            return nullptr;
+        }
+        _replicas_snapshot.publish(_replicas, id);
         _counter_replicas_count->decrement();
 
         int delay_ms = 0;
@@ -2101,17 +2103,16 @@ void replica_stub::open_replica(const app_info &app,
         app_info a_info = *(r->get_app_info());
         replica_info r_info;
         get_replica_info(r_info, r);
-        task_ptr task = tasking::enqueue(LPC_CLOSE_REPLICA,
-                                         &_tracker,
-                                         [=]() { close_replica(r); },
-                                         0,
-                                         std::chrono::milliseconds(delay_ms));
+        task = tasking::enqueue(LPC_CLOSE_REPLICA,
+                                &_tracker,
+                                [=]() { close_replica(r); },
+                                0,
+                                std::chrono::milliseconds(delay_ms));
         _closing_replicas[id] = std::make_tuple(task, r, std::move(a_info), std::move(r_info));
         _counter_replicas_closing_count->increment();
-        return task;
-    } else {
-        return nullptr;
     }
+    _replicas_snapshot.reclaim();
+    return task;
 }
 
 void replica_stub::close_replica(replica_ptr r)
@@ -2589,7 +2590,9 @@ void replica_stub::close()
             _counter_replicas_count->decrement();
             _replicas.erase(_replicas.begin());
         }
+        _replicas_snapshot.publish(_replicas);
     }
+    _replicas_snapshot.reclaim();
     _is_running = false;
 }
 
@@ -2718,32 +2721,40 @@ replica_ptr replica_stub::create_child_replica_if_not_found(gpid child_pid,
                             replica *rep = new replica(this, child_pid, *app, "./", false);
                             rep->_config.status = partition_status::PS_INACTIVE;
                             _replicas.insert(replicas::value_type(child_pid, rep));
+                            _replicas_snapshot.publish(_replicas, child_pid);
+                            _replicas_snapshot.reclaim();
                             ddebug_f("mock create_child_replica_if_not_found succeed");
                             return rep;
                         });
 
-    zauto_write_lock l(_replicas_lock);
-    auto it = _replicas.find(child_pid);
-    if (it != _replicas.end()) {
-        return it->second;
-    } else {
+    replica *rep = nullptr;
+    {
+        zauto_write_lock l(_replicas_lock);
+        auto it = _replicas.find(child_pid);
+        if (it != _replicas.end()) {
+            return it->second;
+        }
         if (_opening_replicas.find(child_pid) != _opening_replicas.end()) {
             dwarn_f("failed create child replica({}) because it is under open", child_pid);
             return nullptr;
-        } else if (_closing_replicas.find(child_pid) != _closing_replicas.end()) {
+        }
+        if (_closing_replicas.find(child_pid) != _closing_replicas.end()) {
             dwarn_f("failed create child replica({}) because it is under close", child_pid);
             return nullptr;
-        } else {
-            replica *rep = replica::newr(this, child_pid, *app, false, parent_dir);
-            if (rep != nullptr) {
-                auto pr = _replicas.insert(replicas::value_type(child_pid, rep));
-                dassert_f(pr.second, "child replica {} has been existed", rep->name());
-                _counter_replicas_count->increment();
-                _closed_replicas.erase(child_pid);
-            }
-            return rep;
         }
+
+        rep = replica::newr(this, child_pid, *app, false, parent_dir);
+        if (rep == nullptr) {
+            return nullptr;
+        }
+        auto pr = _replicas.insert(replicas::value_type(child_pid, rep));
+        dassert_f(pr.second, "child replica {} has been existed", rep->name());
+        _replicas_snapshot.publish(_replicas, child_pid);
+        _counter_replicas_count->increment();
+        _closed_replicas.erase(child_pid);
     }
+    _replicas_snapshot.reclaim();
+    return rep;
 }
 
 // ThreadPool: THREAD_POOL_REPLICATION
@@ -2902,6 +2913,17 @@ void replica_stub::query_app_manual_compact_status(
     }
 }
 
+std::shared_ptr<throttling_quota> replica_stub::get_throttling_quota(int32_t app_id,
+                                                                     const std::string &env_key)
+{
+    std::lock_guard<std::mutex> l(_throttling_quotas_lock);
+    auto &quota = _throttling_quotas[std::make_pair(app_id, env_key)];
+    if (quota == nullptr) {
+        quota = std::make_shared<throttling_quota>();
+    }
+    return quota;
+}
+
 void replica_stub::update_disks_status()
 {
     for (const auto &dir_node : _fs_manager._status_updated_dir_nodes) {
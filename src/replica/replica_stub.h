@@ -41,7 +41,10 @@
 #include "common/replication_common.h"
 #include "common/fs_manager.h"
 #include "block_service/block_service_manager.h"
+#include "learn_file_reuse.h"
+#include "node_write_throttler.h"
 #include "replica.h"
+#include "replicas_snapshot.h"
 
 namespace dsn {
 namespace replication {
@@ -70,7 +73,6 @@ class test_checker;
 class cold_backup_context;
 class replica_split_manager;
 
-typedef std::unordered_map<gpid, replica_ptr> replicas;
 typedef std::function<void(
     ::dsn::rpc_address /*from*/, const replica_configuration & /*new_config*/, bool /*is_closing*/)>
     replica_state_subscriber;
@@ -224,6 +226,11 @@ public:
     void query_app_manual_compact_status(
         int32_t app_id, /*out*/ std::unordered_map<gpid, manual_compaction_status> &status);
 
+    // the throttling quota shared by the replicas of `app_id` on this node for the throttling
+    // configured by the app env `env_key`
+    std::shared_ptr<throttling_quota> get_throttling_quota(int32_t app_id,
+                                                           const std::string &env_key);
+
 private:
     enum replica_node_state
     {
@@ -331,6 +338,8 @@ private:
 
     mutable zrwlock_nr _replicas_lock;
     replicas _replicas;
+    // a copy of `_replicas` for get_replica(), must be published once `_replicas` is changed
+    replicas_snapshot _replicas_snapshot;
     opening_replicas _opening_replicas;
     closing_replicas _closing_replicas;
     closed_replicas _closed_replicas;
@@ -384,6 +393,9 @@ private:
     // too simple, it do not support priority.
     std::atomic_int _learn_app_concurrent_count;
 
+    // md5 of the checkpoint files, to find the files which can be reused in learning
+    file_md5_cache _learn_file_md5_cache;
+
     // handle all the data dirs
     fs_manager _fs_manager;
 
@@ -397,6 +409,11 @@ private:
     // write body size exceed this threshold will be logged and reject, 0 means no check
     uint64_t _max_allowed_write_size;
 
+    std::mutex _throttling_quotas_lock;
+    std::map<std::pair<int32_t, std::string>, std::shared_ptr<throttling_quota>>
+        _throttling_quotas;
+    node_write_throttler _node_write_throttler;
+
     // replica count exectuting bulk load downloading concurrently
     std::atomic_int _bulk_load_downloading_count;
 
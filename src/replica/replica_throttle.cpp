@@ -23,15 +23,21 @@
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replica_envs.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
-#define THROTTLE_REQUEST(op_type, throttling_type, request, request_units)                         \
+DSN_DEFINE_bool("replication",
+                enable_app_throttling_quota_sharing,
+                false,
+                "whether the partitions of an app on the same node share their throttling "
+                "quota, so that a hot partition may borrow the quota unused by the others");
+
+#define THROTTLE_REQUEST_BY(op_type, request, control_expr)                                        \
     do {                                                                                           \
         int64_t delay_ms = 0;                                                                      \
-        auto type = _##op_type##_##throttling_type##_throttling_controller.control(                \
-            request->header->client.timeout_ms, request_units, delay_ms);                          \
+        auto type = control_expr;                                                                  \
         if (type != throttling_controller::PASS) {                                                 \
             if (type == throttling_controller::DELAY) {                                            \
                 tasking::enqueue(                                                                  \
@@ -59,10 +65,20 @@ namespace replication {
         }                                                                                          \
     } while (0)
 
+#define THROTTLE_REQUEST(op_type, throttling_type, request, request_units)                         \
+    THROTTLE_REQUEST_BY(op_type,                                                                   \
+                        request,                                                                   \
+                        _##op_type##_##throttling_type##_throttling_controller.control(            \
+                            request->header->client.timeout_ms, request_units, delay_ms))
+
 bool replica::throttle_write_request(message_ex *request)
 {
     THROTTLE_REQUEST(write, qps, request, 1);
     THROTTLE_REQUEST(write, size, request, request->body_size());
+    THROTTLE_REQUEST_BY(write,
+                        request,
+                        _stub->_node_write_throttler.control(
+                            request->header->client.timeout_ms, request->body_size(), delay_ms));
     return false;
 }
 
@@ -82,6 +98,14 @@ void replica::update_throttle_envs(const std::map<std::string, std::string> &env
         envs, replica_envs::READ_QPS_THROTTLING, _read_qps_throttling_controller);
 }
 
+void replica::update_throttle_primary()
+{
+    bool is_primary = (status() == partition_status::PS_PRIMARY);
+    _write_qps_throttling_controller.set_primary(is_primary);
+    _write_size_throttling_controller.set_primary(is_primary);
+    _read_qps_throttling_controller.set_primary(is_primary);
+}
+
 void replica::update_throttle_env_internal(const std::map<std::string, std::string> &envs,
                                            const std::string &key,
                                            throttling_controller &cntl)
@@ -107,6 +131,12 @@ void replica::update_throttle_env_internal(const std::map<std::string, std::stri
         // reset if env not found
         cntl.reset(throttling_changed, old_throttling);
     }
+    if (FLAGS_enable_app_throttling_quota_sharing && find != envs.end()) {
+        cntl.set_quota(_stub->get_throttling_quota(get_gpid().get_app_id(), key));
+    } else {
+        cntl.set_quota(nullptr);
+    }
+    cntl.set_primary(status() == partition_status::PS_PRIMARY);
     if (throttling_changed) {
         ddebug_replica("switch {} from \"{}\" to \"{}\"", key, old_throttling, cntl.env_value());
     }
@@ -0,0 +1,140 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replicas_snapshot.h"
+
+#include <thread>
+
+namespace dsn {
+namespace replication {
+
+replicas_snapshot::replicas_snapshot() : _epoch(0)
+{
+    for (auto &shard : _shards) {
+        shard.store(new replicas());
+    }
+    for (auto &slot : _slots) {
+        slot.readers[0].store(0);
+        slot.readers[1].store(0);
+    }
+}
+
+replicas_snapshot::~replicas_snapshot()
+{
+    for (auto &shard : _shards) {
+        delete shard.load();
+    }
+    for (auto rs : _retired) {
+        delete rs;
+    }
+}
+
+/*static*/ int replicas_snapshot::current_reader_slot()
+{
+    static std::atomic<int> s_next_slot(0);
+    static thread_local int tls_slot = s_next_slot.fetch_add(1) % kReaderSlotCount;
+    return tls_slot;
+}
+
+/*static*/ int replicas_snapshot::shard_index(gpid id)
+{
+    return static_cast<int>(std::hash<gpid>()(id) % kShardCount);
+}
+
+void replicas_snapshot::publish(const replicas &rs)
+{
+    std::vector<replicas *> shards(kShardCount);
+    for (auto &shard : shards) {
+        shard = new replicas();
+    }
+    for (const auto &kv : rs) {
+        shards[shard_index(kv.first)]->emplace(kv.first, kv.second);
+    }
+
+    std::lock_guard<std::mutex> l(_retired_lock);
+    for (int i = 0; i < kShardCount; ++i) {
+        _retired.push_back(_shards[i].exchange(shards[i]));
+    }
+}
+
+void replicas_snapshot::publish(const replicas &rs, gpid id)
+{
+    int index = shard_index(id);
+    auto shard = new replicas(*_shards[index].load());
+    auto it = rs.find(id);
+    if (it != rs.end()) {
+        (*shard)[id] = it->second;
+    } else {
+        shard->erase(id);
+    }
+
+    std::lock_guard<std::mutex> l(_retired_lock);
+    _retired.push_back(_shards[index].exchange(shard));
+}
+
+void replicas_snapshot::synchronize()
+{
+    // the readers which may refer to the retired shards counted themselves before the shards
+    // were replaced, under either epoch
+    for (int i = 0; i < 2; ++i) {
+        int epoch = _epoch.load();
+        _epoch.store(1 - epoch);
+        for (auto &slot : _slots) {
+            while (slot.readers[epoch].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+void replicas_snapshot::reclaim()
+{
+    std::lock_guard<std::mutex> reclaim_guard(_reclaim_lock);
+    std::vector<const replicas *> retired;
+    {
+        std::lock_guard<std::mutex> l(_retired_lock);
+        retired.swap(_retired);
+    }
+    if (retired.empty()) {
+        return;
+    }
+
+    synchronize();
+    for (auto rs : retired) {
+        delete rs;
+    }
+}
+
+replica_ptr replicas_snapshot::get(gpid id) const
+{
+    reader_slot &slot = _slots[current_reader_slot()];
+    int epoch = _epoch.load();
+    slot.readers[epoch].fetch_add(1);
+
+    replica_ptr r;
+    const replicas *rs = _shards[shard_index(id)].load();
+    auto it = rs->find(id);
+    if (it != rs->end()) {
+        r = it->second;
+    }
+
+    slot.readers[epoch].fetch_sub(1, std::memory_order_release);
+    return r;
+}
+
+} // namespace replication
+} // namespace dsn
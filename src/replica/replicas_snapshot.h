@@ -0,0 +1,95 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "replica.h"
+
+namespace dsn {
+namespace replication {
+
+typedef std::unordered_map<gpid, replica_ptr> replicas;
+
+// replicas_snapshot publishes immutable copies of the replica map of replica_stub, so that
+// the lookups on the client request path neither take `_replicas_lock` nor write any shared
+// cacheline.
+//
+// The replicas are split into `kShardCount` shards by gpid, and each shard is an immutable
+// map, so that a change of one replica only copies its shard.
+//
+// The replaced shards are reclaimed in the way of SRCU. Each reader thread is assigned one of
+// the cacheline-aligned reader slots, and counts itself in the slot under the current epoch
+// while it reads. To reclaim, the epoch is flipped and the readers counted under the previous
+// epoch are waited for, twice. The readers arriving after a flip are counted under the new
+// epoch, so they can't starve the reclaimer.
+class replicas_snapshot
+{
+public:
+    replicas_snapshot();
+    ~replicas_snapshot();
+
+    // Publishes a copy of `rs`, in O(n).
+    // The publishers must be serialized, e.g. by the write lock of `_replicas_lock`. They
+    // don't wait for the readers, and the replaced shards are retired to be freed by reclaim().
+    void publish(const replicas &rs);
+
+    // Publishes the change of replica `id` in `rs`, which only copies the shard of `id`.
+    void publish(const replicas &rs, gpid id);
+
+    // Frees the retired shards once no reader refers to them. It waits for the readers in
+    // progress, so it should be called without holding `_replicas_lock`.
+    // thread safe
+    void reclaim();
+
+    // thread safe and lock free
+    replica_ptr get(gpid id) const;
+
+private:
+    static const int kShardCount = 256;
+    static const int kReaderSlotCount = 64;
+
+    struct alignas(64) reader_slot
+    {
+        // indexed by epoch
+        std::atomic<int> readers[2];
+    };
+
+    static int current_reader_slot();
+    static int shard_index(gpid id);
+
+    // Waits until no reader started before it is in progress.
+    void synchronize();
+
+private:
+    std::atomic<const replicas *> _shards[kShardCount];
+
+    std::atomic<int> _epoch;
+    mutable reader_slot _slots[kReaderSlotCount];
+
+    std::mutex _retired_lock;
+    std::vector<const replicas *> _retired;
+    // serializes the reclaimers
+    std::mutex _reclaim_lock;
+};
+
+} // namespace replication
+} // namespace dsn
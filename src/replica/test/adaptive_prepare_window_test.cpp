@@ -0,0 +1,248 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/adaptive_prepare_window.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(adaptive_prepare_window_min);
+DSN_DECLARE_uint32(adaptive_prepare_window_max);
+
+// feeds the writes of `bytes` every `interval_ns` for 10ms since `now_ns`
+static uint64_t feed_writes(adaptive_prepare_window &w,
+                            uint64_t now_ns,
+                            uint64_t interval_ns,
+                            size_t bytes)
+{
+    for (uint64_t end = now_ns + 10000000; now_ns < end; now_ns += interval_ns) {
+        w.on_write_arrived(now_ns, bytes);
+    }
+    return now_ns;
+}
+
+TEST(adaptive_prepare_window_test, window)
+{
+    adaptive_prepare_window w(10, 10, false);
+    // static window until the rate and both latencies are measured
+    ASSERT_EQ(10, w.window());
+    w.on_prepare_acked(1000000);
+    w.on_local_log_completed(1000000);
+    ASSERT_EQ(10, w.window());
+
+    // 1.6 bytes per ns * 1ms = 1.5 mutations of 1MB in flight
+    uint64_t now = feed_writes(w, 1, 10000, 16384);
+    ASSERT_EQ(3, w.window());
+
+    // the window grows with the rtt: 1.6 bytes per ns * 4ms = 6.25 mutations
+    for (int i = 0; i < 100; ++i) {
+        w.on_prepare_acked(4000000);
+    }
+    ASSERT_EQ(8, w.window());
+
+    // bounded by the max window
+    for (int i = 0; i < 100; ++i) {
+        w.on_prepare_acked(100000000);
+    }
+    ASSERT_EQ(10, w.window());
+
+    // the log latency dominates if the rtt is lower
+    for (int i = 0; i < 100; ++i) {
+        w.on_prepare_acked(1000);
+    }
+    ASSERT_EQ(3, w.window());
+
+    // bounded by the min window under low load
+    for (int i = 0; i < 100; ++i) {
+        now = feed_writes(w, now, 1000000, 100);
+    }
+    ASSERT_EQ(static_cast<int>(FLAGS_adaptive_prepare_window_min), w.window());
+}
+
+TEST(adaptive_prepare_window_test, grow_beyond_static_window)
+{
+    // the static window is 10, and the max window is 40
+    adaptive_prepare_window w(10, 40, false);
+    ASSERT_EQ(10, w.window());
+
+    // 1.6 bytes per ns * 20ms = 31.25 mutations of 1MB in flight on a high-rtt link
+    w.on_local_log_completed(1000000);
+    for (int i = 0; i < 100; ++i) {
+        w.on_prepare_acked(20000000);
+    }
+    feed_writes(w, 1, 10000, 16384);
+    ASSERT_EQ(33, w.window());
+
+    // bounded by the max window
+    for (int i = 0; i < 100; ++i) {
+        w.on_prepare_acked(100000000);
+    }
+    ASSERT_EQ(40, w.window());
+}
+
+TEST(adaptive_prepare_window_test, max_window_of)
+{
+    PRESERVE_FLAG(adaptive_prepare_window_max);
+    FLAGS_adaptive_prepare_window_max = 40;
+    ASSERT_EQ(40, adaptive_prepare_window::max_window_of(10, 110));
+    // never narrower than the static window
+    ASSERT_EQ(50, adaptive_prepare_window::max_window_of(50, 110));
+    // bounded by the capacity of the prepare list
+    ASSERT_EQ(30, adaptive_prepare_window::max_window_of(10, 30));
+}
+
+TEST(adaptive_prepare_window_test, batch_write_disabled)
+{
+    adaptive_prepare_window w(10, 10, true);
+    w.on_prepare_acked(18000);
+    w.on_local_log_completed(10000);
+    // every request is a mutation: 1 request per 4us * 18us = 4.5 mutations in flight
+    feed_writes(w, 1, 4000, 16);
+    ASSERT_EQ(6, w.window());
+}
+
+// A discrete-event model of the primary's 2PC pipeline. Write requests arrive at a fixed
+// interval, and are batched into a mutation (of at most `kMaxBatchSize` requests, like the
+// 1MB limit of a mutation) when a round is allowed to start. The local log group commits: one
+// flush covers all the mutations appended before it starts. A mutation is committed after
+// both its log flush and its prepare round trip, in decree order.
+struct pipeline_result
+{
+    double throughput; // requests per second
+    double avg_latency_us;
+};
+
+static pipeline_result
+run_pipeline(uint64_t rtt_us, uint64_t log_us, int fixed_window, bool adaptive)
+{
+    const uint64_t kArrivalIntervalUs = 5;
+    const uint64_t kDurationUs = 2000000;
+    const size_t kMaxBatchSize = 64;
+    const int kMaxWindow = 10;
+    const size_t kRequestBytes = 1024 * 1024 / kMaxBatchSize;
+
+    struct round
+    {
+        uint64_t start;
+        uint64_t log_done;
+        std::vector<uint64_t> arrivals;
+    };
+
+    adaptive_prepare_window aw(kMaxWindow, kMaxWindow, false);
+    int window = adaptive ? aw.window() : fixed_window;
+
+    std::deque<uint64_t> waiting; // arrival time of the requests not prepared yet
+    std::deque<round> flights;    // in decree order
+    size_t unflushed = 0;         // count of the last rounds not being flushed yet
+    uint64_t flush_done = 0;      // when the current log flush is done
+    size_t flushing = 0;          // count of the last rounds being flushed
+    uint64_t committed = 0;
+    double total_latency = 0;
+
+    for (uint64_t now = 0; now < kDurationUs; ++now) {
+        if (now % kArrivalIntervalUs == 0) {
+            waiting.push_back(now);
+            if (adaptive) {
+                aw.on_write_arrived(now * 1000, kRequestBytes);
+            }
+        }
+
+        // finish the current flush, and start the next one for the appended rounds
+        if (flushing > 0 && now >= flush_done) {
+            size_t i = flights.size() - unflushed - flushing;
+            for (; flushing > 0; ++i, --flushing) {
+                flights[i].log_done = now;
+                if (adaptive) {
+                    aw.on_local_log_completed((now - flights[i].start) * 1000);
+                }
+            }
+        }
+        if (flushing == 0 && unflushed > 0) {
+            flushing = unflushed;
+            unflushed = 0;
+            flush_done = now + log_us;
+        }
+
+        while (!flights.empty() && flights.front().log_done != 0 &&
+               now >= flights.front().start + rtt_us) {
+            for (uint64_t arrival : flights.front().arrivals) {
+                total_latency += now - arrival;
+            }
+            committed += flights.front().arrivals.size();
+            flights.pop_front();
+            if (adaptive) {
+                aw.on_prepare_acked(rtt_us * 1000);
+            }
+        }
+
+        if (adaptive) {
+            window = aw.window();
+        }
+        while (static_cast<int>(flights.size()) < window && !waiting.empty()) {
+            size_t n = std::min(kMaxBatchSize, waiting.size());
+            flights.push_back({now, 0, {waiting.begin(), waiting.begin() + n}});
+            waiting.erase(waiting.begin(), waiting.begin() + n);
+            ++unflushed;
+        }
+    }
+
+    pipeline_result r;
+    r.throughput = committed * 1e6 / kDurationUs;
+    r.avg_latency_us = committed ? total_latency / committed : 0;
+    return r;
+}
+
+TEST(adaptive_prepare_window_test, simulated_pipeline)
+{
+    const uint64_t kLogUs = 500;
+    for (uint64_t rtt_us : {200, 1000, 5000}) {
+        // the adaptive window keeps up with the widest static window on high-rtt links
+        pipeline_result wide = run_pipeline(rtt_us, kLogUs, 10, false);
+        pipeline_result adaptive = run_pipeline(rtt_us, kLogUs, 10, true);
+        ASSERT_GE(adaptive.throughput, wide.throughput * 0.95);
+        ASSERT_LE(adaptive.avg_latency_us, wide.avg_latency_us * 1.05);
+
+        // while a narrow static window can't keep up with the load
+        pipeline_result narrow = run_pipeline(rtt_us, kLogUs, 2, false);
+        ASSERT_GT(adaptive.throughput, narrow.throughput);
+    }
+}
+
+// prints the throughput and latency of the static and the adaptive windows, run it with
+// --gtest_also_run_disabled_tests
+TEST(adaptive_prepare_window_test, DISABLED_throughput_vs_latency)
+{
+    const uint64_t kLogUs = 500;
+    for (uint64_t rtt_us : {200, 1000, 5000}) {
+        for (int mode = 0; mode < 3; ++mode) {
+            pipeline_result r = run_pipeline(rtt_us, kLogUs, mode == 0 ? 2 : 10, mode == 2);
+            std::cout << "rtt = " << rtt_us << "us, log = " << kLogUs << "us, "
+                      << (mode == 0 ? "window = 2 " : (mode == 1 ? "window = 10" : "adaptive   "))
+                      << ": " << r.throughput << " req/s, avg latency = " << r.avg_latency_us
+                      << "us" << std::endl;
+        }
+    }
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <fstream>
+
+#include <dsn/utility/filesystem.h>
+#include <dsn/utility/strings.h>
+#include <gtest/gtest.h>
+
+#include "replica/learn_file_reuse.h"
+
+namespace dsn {
+namespace replication {
+
+class learn_file_reuse_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        utils::filesystem::remove_path(_test_dir);
+        utils::filesystem::create_directory(_test_dir);
+    }
+
+    void TearDown() override { utils::filesystem::remove_path(_test_dir); }
+
+    std::string
+    write_file(const std::string &sub_dir, const std::string &name, const std::string &data)
+    {
+        std::string path = utils::filesystem::path_combine(dir(sub_dir), name);
+        utils::filesystem::create_directory(utils::filesystem::remove_file_name(path));
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs << data;
+        return path;
+    }
+
+    std::string dir(const std::string &name) const
+    {
+        return utils::filesystem::path_combine(_test_dir, name);
+    }
+
+    std::string read_file(const std::string &path)
+    {
+        std::string data;
+        EXPECT_EQ(ERR_OK, utils::filesystem::read_file(path, data));
+        return data;
+    }
+
+protected:
+    const std::string _test_dir = "learn_file_reuse_test";
+    file_md5_cache _cache;
+};
+
+TEST_F(learn_file_reuse_test, file_md5_cache)
+{
+    std::string path = write_file("data", "1.sst", "aaaa");
+    std::string md5;
+    ASSERT_EQ(ERR_OK, _cache.get_md5(path, md5));
+    ASSERT_EQ(utils::string_md5("aaaa", 4), md5);
+
+    // the md5 is recalculated once the file is changed
+    write_file("data", "1.sst", "bbbbb");
+    ASSERT_EQ(ERR_OK, _cache.get_md5(path, md5));
+    ASSERT_EQ(utils::string_md5("bbbbb", 5), md5);
+
+    ASSERT_EQ(ERR_OBJECT_NOT_FOUND, _cache.get_md5(dir("data/2.sst"), md5));
+}
+
+TEST_F(learn_file_reuse_test, reuse_local_files)
+{
+    // learner
+    write_file("learner/data/rdb", "1.sst", "same content");
+    write_file("learner/data/rdb", "2.sst", "same size 1");
+    write_file("learner/data/rdb", "3.sst", "only on learner");
+    // learnee
+    write_file("learnee/data/checkpoint.10", "1.sst", "same content");
+    write_file("learnee/data/checkpoint.10", "2.sst", "same size 2");
+    write_file("learnee/data/checkpoint.10", "4.sst", "only on learnee");
+
+    std::vector<file_meta> local_files = collect_local_files(dir("learner/data"));
+    ASSERT_EQ(3u, local_files.size());
+    for (const auto &f : local_files) {
+        ASSERT_EQ("rdb/", f.name.substr(0, 4));
+    }
+
+    std::vector<std::string> learned_files = {
+        "checkpoint.10/1.sst", "checkpoint.10/2.sst", "checkpoint.10/4.sst"};
+    auto reusable_files =
+        match_reusable_files(dir("learnee/data"), learned_files, local_files, _cache);
+    ASSERT_EQ(2u, reusable_files.size());
+    ASSERT_EQ("rdb/1.sst", reusable_files["checkpoint.10/1.sst"].name);
+    ASSERT_EQ(utils::string_md5("same content", 12), reusable_files["checkpoint.10/1.sst"].md5);
+    ASSERT_EQ("rdb/2.sst", reusable_files["checkpoint.10/2.sst"].name);
+
+    // 1.sst is linked
+    std::map<std::string, file_meta> files_to_link = {
+        {"checkpoint.10/1.sst", reusable_files["checkpoint.10/1.sst"]}};
+    ASSERT_EQ(ERR_OK,
+              link_reusable_files(
+                  dir("learner/data"), dir("learner/learn"), files_to_link, _cache));
+    ASSERT_EQ("same content", read_file(dir("learner/learn/checkpoint.10/1.sst")));
+
+    // 2.sst has the same name and size, but the content differs
+    ASSERT_EQ(ERR_CORRUPTION,
+              link_reusable_files(
+                  dir("learner/data"), dir("learner/learn2"), reusable_files, _cache));
+    ASSERT_FALSE(utils::filesystem::file_exists(dir("learner/learn2/checkpoint.10/2.sst")));
+
+    // so it's moved back to be copied before the copy is started
+    ASSERT_EQ(1u, verify_reusable_files(dir("learner/data"), reusable_files, _cache));
+    ASSERT_EQ(1u, reusable_files.size());
+    ASSERT_EQ(1u, reusable_files.count("checkpoint.10/1.sst"));
+    ASSERT_EQ(0u, verify_reusable_files(dir("learner/data"), reusable_files, _cache));
+    ASSERT_EQ(ERR_OK,
+              link_reusable_files(
+                  dir("learner/data"), dir("learner/learn3"), reusable_files, _cache));
+}
+
+} // namespace replication
+} // namespace dsn
@@ -214,7 +214,12 @@ public:
 
     ~mock_replica_stub() override = default;
 
-    void add_replica(replica *r) { _replicas[r->get_gpid()] = replica_ptr(r); }
+    void add_replica(replica *r)
+    {
+        _replicas[r->get_gpid()] = replica_ptr(r);
+        _replicas_snapshot.publish(_replicas, r->get_gpid());
+        _replicas_snapshot.reclaim();
+    }
 
     mock_replica *add_primary_replica(int appid, int part_index = 1)
     {
@@ -256,6 +261,8 @@ public:
         mock_replica_ptr rep = new mock_replica(this, pid, std::move(info), "./");
         rep->set_replica_config(config);
         _replicas[pid] = rep;
+        _replicas_snapshot.publish(_replicas, pid);
+        _replicas_snapshot.reclaim();
 
         return rep;
     }
@@ -25,6 +25,7 @@
  */
 
 #include "replica/mutation_log.h"
+#include "replica/log_group_committer.h"
 #include "replica_test_base.h"
 
 #include <dsn/utility/filesystem.h>
@@ -482,6 +483,53 @@ TEST_F(mutation_log_test, replay_multiple_files_20000_1mb) { test_replay_multipl
 
 TEST_F(mutation_log_test, replay_multiple_files_50000_1mb) { test_replay_multiple_files(50000, 1); }
 
+TEST_F(mutation_log_test, replay_mmap)
+{
+    PRESERVE_FLAG(enable_mutation_log_replay_mmap);
+    FLAGS_enable_mutation_log_replay_mmap = true;
+    test_replay_single_file(1000);
+    test_replay_multiple_files(20000, 1);
+}
+
+TEST_F(mutation_log_test, replay_mmap_corrupted)
+{
+    { // writing logs
+        mutation_log_ptr mlog = create_private_log();
+        for (int i = 0; i < 1000; i++) {
+            mutation_ptr mu = create_test_mutation(2 + i, "hello!");
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+    }
+
+    std::string log_file_path = _log_dir + "/log.1.0";
+    int64_t file_size;
+    ASSERT_TRUE(utils::filesystem::file_size(log_file_path, file_size));
+    overwrite_file(log_file_path.c_str(), static_cast<int>(file_size / 2), "xxxxx", 5);
+
+    // the same mutations are replayed before the corrupted block with or without mmap
+    PRESERVE_FLAG(enable_mutation_log_replay_mmap);
+    int replayed[2];
+    for (bool mmap : {false, true}) {
+        FLAGS_enable_mutation_log_replay_mmap = mmap;
+        error_code ec;
+        log_file_ptr file = log_file::open_read(log_file_path.c_str(), ec);
+        ASSERT_EQ(ERR_OK, ec);
+
+        int64_t end_offset;
+        int count = 0;
+        ec = mutation_log::replay(file,
+                                  [&count](int log_length, mutation_ptr &mu) -> bool {
+                                      count++;
+                                      return true;
+                                  },
+                                  end_offset);
+        ASSERT_EQ(ERR_INVALID_DATA, ec);
+        ASSERT_GT(1000, count);
+        replayed[mmap] = count;
+    }
+    ASSERT_EQ(replayed[0], replayed[1]);
+}
+
 TEST_F(mutation_log_test, replay_start_decree)
 {
     // decree ranges from [1, 30)
@@ -495,5 +543,90 @@ TEST_F(mutation_log_test, replay_start_decree)
     ASSERT_EQ(mlog->get_log_file_map().size(), 3);
 }
 
+TEST_F(mutation_log_test, private_log_group_commit)
+{
+    PRESERVE_FLAG(enable_private_log_group_commit);
+    FLAGS_enable_private_log_group_commit = true;
+
+    std::vector<mutation_ptr> mutations;
+    {
+        mutation_log_ptr mlog = create_private_log();
+        for (int i = 0; i < 1000; i++) {
+            mutation_ptr mu = create_test_mutation(2 + i, "hello!");
+            mutations.push_back(mu);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+
+        // flush waits for the group commits
+        mlog->flush();
+        ASSERT_EQ(mutations.back()->data.header.last_committed_decree,
+                  mlog->max_commit_on_disk());
+    }
+
+    FLAGS_enable_private_log_group_commit = false;
+
+    mutation_log_ptr mlog =
+        new mutation_log_private(_log_dir, 4, get_gpid(), _replica.get(), 1024, 512, 10000);
+    int mutation_index = -1;
+    mlog->open(
+        [&mutations, &mutation_index](int log_length, mutation_ptr &mu) -> bool {
+            mutation_ptr wmu = mutations[++mutation_index];
+            EXPECT_EQ(wmu->data.header, mu->data.header);
+            return true;
+        },
+        nullptr);
+    ASSERT_EQ(mutation_index + 1, (int)mutations.size());
+}
+
+class log_group_committer_test : public mutation_log_test
+{
+public:
+    // Hands the flushes of `files` to `committer` as one batch, and waits for them.
+    void flush_batch(log_group_committer &committer, const std::vector<log_file_ptr> &files)
+    {
+        std::vector<task_ptr> continuations;
+        {
+            // hold the lock, so that the committer can't take the batch before it's complete
+            std::lock_guard<std::mutex> l(committer._lock);
+            for (auto &lf : files) {
+                continuations.push_back(
+                    tasking::create_task(LPC_AIO_IMMEDIATE_CALLBACK, nullptr, []() {}));
+                committer._pending.push_back({lf, continuations.back(), 1, dsn_now_ns()});
+            }
+        }
+        committer._cond.notify_one();
+        for (auto &t : continuations) {
+            ASSERT_TRUE(t->wait(10000));
+        }
+    }
+
+    uint64_t sync_count(log_group_committer &committer) { return committer._sync_count.load(); }
+};
+
+TEST_F(log_group_committer_test, one_flush_per_log)
+{
+    log_group_committer committer("test");
+    std::vector<log_file_ptr> files;
+    for (int i = 1; i <= 10; i++) {
+        files.push_back(log_file::create_write(_log_dir.c_str(), i, 0));
+        ASSERT_NE(nullptr, files.back());
+    }
+
+    // the logs of a batch are flushed in parallel
+    flush_batch(committer, files);
+    ASSERT_EQ(10, sync_count(committer));
+
+    // a log written several times within a batch is flushed once
+    flush_batch(committer, {files[0], files[0], files[0]});
+    ASSERT_EQ(11, sync_count(committer));
+
+    flush_batch(committer, {files[0], files[1], files[0], files[1]});
+    ASSERT_EQ(13, sync_count(committer));
+
+    for (auto &lf : files) {
+        lf->close();
+    }
+}
+
 } // namespace replication
 } // namespace dsn
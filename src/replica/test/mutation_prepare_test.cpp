@@ -0,0 +1,177 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <ctime>
+#include <iostream>
+
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+#include "replica/mutation.h"
+#include "replica/storage/simple_kv/simple_kv.code.definition.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint32(prepare_zero_copy_min_bytes);
+
+class mutation_prepare_test : public ::testing::Test
+{
+public:
+    void TearDown() override { FLAGS_prepare_zero_copy_min_bytes = _saved_min_bytes; }
+
+    // a mutation of simple_kv writes, whose data is referenced from one client request
+    // buffer, like what the primary gets from rpc
+    mutation_ptr create_simple_kv_mutation(const std::vector<size_t> &value_sizes)
+    {
+        size_t total = 0;
+        for (size_t sz : value_sizes) {
+            total += sz;
+        }
+        std::shared_ptr<char> request_buffer = utils::make_shared_array<char>(total);
+        for (size_t i = 0; i < total; ++i) {
+            request_buffer.get()[i] = static_cast<char>(i * 31);
+        }
+        blob request(request_buffer, static_cast<unsigned int>(total));
+
+        mutation_ptr mu(new mutation());
+        mu->data.header.pid = gpid(1, 1);
+        mu->data.header.ballot = 1;
+        mu->data.header.decree = 2;
+        mu->data.header.last_committed_decree = 1;
+        mu->data.header.log_offset = 0;
+        size_t offset = 0;
+        for (size_t sz : value_sizes) {
+            mu->data.updates.emplace_back(mutation_update());
+            mu->data.updates.back().code = application::RPC_SIMPLE_KV_SIMPLE_KV_WRITE;
+            mu->data.updates.back().data = request.range(offset, sz);
+            mu->client_requests.push_back(nullptr);
+            offset += sz;
+        }
+        return mu;
+    }
+
+    // returns the prepare message of `mu`, the caller should release it
+    message_ex *create_prepare_message(const mutation_ptr &mu)
+    {
+        message_ex *msg =
+            message_ex::create_request(RPC_PREPARE, 0, mu->data.header.pid.thread_hash());
+        msg->add_ref();
+        {
+            rpc_write_stream writer(msg);
+            marshall(writer, mu->data.header.pid, DSF_THRIFT_BINARY);
+            mu->write_to(writer, msg);
+        }
+        return msg;
+    }
+
+    void check_prepare_message(const mutation_ptr &mu)
+    {
+        message_ex *msg = create_prepare_message(mu);
+        message_ex *recv = msg->copy(true, true);
+        recv->add_ref();
+        {
+            rpc_read_stream reader(recv);
+            gpid pid;
+            unmarshall(reader, pid, DSF_THRIFT_BINARY);
+            ASSERT_EQ(mu->data.header.pid, pid);
+            mutation_ptr recv_mu = mutation::read_from(reader, recv);
+            ASSERT_EQ(mu->data.header.decree, recv_mu->data.header.decree);
+            ASSERT_EQ(mu->data.updates.size(), recv_mu->data.updates.size());
+            for (size_t i = 0; i < mu->data.updates.size(); ++i) {
+                ASSERT_EQ(mu->data.updates[i].code, recv_mu->data.updates[i].code);
+                ASSERT_EQ(mu->data.updates[i].data.to_string(),
+                          recv_mu->data.updates[i].data.to_string());
+            }
+        }
+        recv->release_ref();
+        msg->release_ref();
+    }
+
+private:
+    uint32_t _saved_min_bytes = FLAGS_prepare_zero_copy_min_bytes;
+};
+
+TEST_F(mutation_prepare_test, prepare_message_content)
+{
+    std::vector<std::vector<size_t>> cases = {
+        {0}, {100}, {100 * 1024}, {100, 100 * 1024, 10, 8192, 100 * 1024}};
+    for (uint32_t min_bytes : {0, 4096}) {
+        FLAGS_prepare_zero_copy_min_bytes = min_bytes;
+        for (const auto &value_sizes : cases) {
+            check_prepare_message(create_simple_kv_mutation(value_sizes));
+        }
+    }
+}
+
+TEST_F(mutation_prepare_test, prepare_message_references_large_data)
+{
+    FLAGS_prepare_zero_copy_min_bytes = 4096;
+    mutation_ptr mu = create_simple_kv_mutation({100, 100 * 1024});
+    message_ex *msg = create_prepare_message(mu);
+
+    // the large value is referenced, while the small one is copied
+    const char *large_data = mu->data.updates[1].data.data();
+    int referenced = 0;
+    for (const blob &bb : msg->buffers) {
+        if (bb.data() == large_data) {
+            ++referenced;
+        }
+        ASSERT_NE(mu->data.updates[0].data.data(), bb.data());
+    }
+    ASSERT_EQ(1, referenced);
+    msg->release_ref();
+}
+
+TEST_F(mutation_prepare_test, prepare_message_copies_all_data_if_disabled)
+{
+    FLAGS_prepare_zero_copy_min_bytes = 0;
+    mutation_ptr mu = create_simple_kv_mutation({100, 100 * 1024});
+    message_ex *msg = create_prepare_message(mu);
+    for (const blob &bb : msg->buffers) {
+        for (const auto &update : mu->data.updates) {
+            ASSERT_NE(update.data.data(), bb.data());
+        }
+    }
+    msg->release_ref();
+}
+
+// compare the cpu cost of building prepare messages for 100KB simple_kv writes, run it with
+// --gtest_also_run_disabled_tests
+TEST_F(mutation_prepare_test, DISABLED_prepare_message_cpu_per_byte)
+{
+    const int kRounds = 2000;
+    mutation_ptr mu = create_simple_kv_mutation({100 * 1024});
+    for (uint32_t min_bytes : {0, 4096}) {
+        FLAGS_prepare_zero_copy_min_bytes = min_bytes;
+        std::clock_t start = std::clock();
+        for (int i = 0; i < kRounds; ++i) {
+            // 2 prepare messages per write for 3 replicas
+            message_ex *msg1 = create_prepare_message(mu);
+            message_ex *msg2 = create_prepare_message(mu);
+            msg1->release_ref();
+            msg2->release_ref();
+        }
+        double cpu_ns = (std::clock() - start) * 1e9 / CLOCKS_PER_SEC;
+        std::cout << (min_bytes == 0 ? "copy" : "zero-copy") << " prepare: "
+                  << cpu_ns / (2.0 * kRounds * 100 * 1024) << " cpu ns/byte" << std::endl;
+    }
+}
+
+} // namespace replication
+} // namespace dsn
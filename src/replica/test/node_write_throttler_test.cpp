@@ -0,0 +1,118 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/node_write_throttler.h"
+
+#include <dsn/c/api_layer1.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_uint64(node_write_throttling_log_backlog_kb);
+DSN_DECLARE_uint64(node_write_throttling_max_delay_ms);
+
+class node_write_throttler_test : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _old_backlog_kb = FLAGS_node_write_throttling_log_backlog_kb;
+        _old_max_delay_ms = FLAGS_node_write_throttling_max_delay_ms;
+        FLAGS_node_write_throttling_log_backlog_kb = 1024;
+        FLAGS_node_write_throttling_max_delay_ms = 1000;
+    }
+
+    void TearDown() override
+    {
+        FLAGS_node_write_throttling_log_backlog_kb = _old_backlog_kb;
+        FLAGS_node_write_throttling_max_delay_ms = _old_max_delay_ms;
+    }
+
+    // the log writes 100MB per second while it's busy
+    void measure_bandwidth(node_write_throttler &throttler)
+    {
+        uint64_t now = dsn_now_ns();
+        throttler._sample_start_ns = now - 1000 * 1000 * 1000;
+        throttler.on_log_write_issued(1);
+        throttler._written_bytes = 100 << 20;
+        throttler.sample_bandwidth(now);
+    }
+
+    void test_measure_bandwidth()
+    {
+        node_write_throttler throttler;
+        ASSERT_EQ(0, throttler.log_bandwidth());
+
+        // not measured while the log is idle
+        uint64_t now = dsn_now_ns();
+        throttler._sample_start_ns = now - 1000 * 1000 * 1000;
+        throttler._written_bytes = 1 << 20;
+        throttler.sample_bandwidth(now);
+        ASSERT_EQ(0, throttler.log_bandwidth());
+
+        measure_bandwidth(throttler);
+        ASSERT_NEAR(100 << 20, throttler.log_bandwidth(), 1 << 20);
+    }
+
+    void test_control()
+    {
+        node_write_throttler throttler;
+        int64_t delay_ms = 0;
+
+        // never throttles before the bandwidth is measured
+        throttler.on_log_write_issued(100 << 20);
+        ASSERT_EQ(throttling_controller::PASS, throttler.control(0, 1024, delay_ms));
+
+        measure_bandwidth(throttler);
+        throttler.on_log_write_issued(512 << 10);
+        ASSERT_EQ(throttling_controller::PASS, throttler.control(0, 1024, delay_ms));
+
+        // 10MB over the threshold is drained in about 100ms
+        throttler.on_log_write_issued(11 << 20);
+        ASSERT_EQ(throttling_controller::DELAY, throttler.control(0, 1024, delay_ms));
+        ASSERT_GT(delay_ms, 80);
+        ASSERT_LE(delay_ms, 100);
+        ASSERT_EQ(throttling_controller::DELAY, throttler.control(100, 1024, delay_ms));
+        ASSERT_EQ(50, delay_ms);
+
+        // the writes delayed are paced at the bandwidth of the log
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(throttling_controller::DELAY, throttler.control(0, 1 << 20, delay_ms));
+            ASSERT_GT(delay_ms, 0);
+        }
+        ASSERT_GT(delay_ms, 800);
+
+        // rejected if the estimated delay is too long
+        throttler.on_log_write_issued(1 << 30);
+        ASSERT_EQ(throttling_controller::REJECT, throttler.control(0, 1024, delay_ms));
+        ASSERT_EQ(0, delay_ms);
+
+        FLAGS_node_write_throttling_log_backlog_kb = 0;
+        ASSERT_EQ(throttling_controller::PASS, throttler.control(0, 1024, delay_ms));
+    }
+
+    uint64_t _old_backlog_kb;
+    uint64_t _old_max_delay_ms;
+};
+
+TEST_F(node_write_throttler_test, measure_bandwidth) { test_measure_bandwidth(); }
+
+TEST_F(node_write_throttler_test, control) { test_control(); }
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,175 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "replica/replicas_snapshot.h"
+#include "replica_test_base.h"
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include <dsn/tool-api/zlocks.h>
+
+namespace dsn {
+namespace replication {
+
+class replicas_snapshot_test : public replica_stub_test_base
+{
+public:
+    replicas create_replicas(int partition_count)
+    {
+        replicas rs;
+        for (int i = 0; i < partition_count; ++i) {
+            replica_ptr r(create_mock_replica(stub.get(), 1, i).release());
+            rs.emplace(r->get_gpid(), r);
+        }
+        return rs;
+    }
+};
+
+TEST_F(replicas_snapshot_test, get)
+{
+    replicas_snapshot snapshot;
+    ASSERT_EQ(nullptr, snapshot.get(gpid(1, 0)));
+
+    replicas rs = create_replicas(4);
+    snapshot.publish(rs);
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(rs[gpid(1, i)], snapshot.get(gpid(1, i)));
+    }
+    ASSERT_EQ(nullptr, snapshot.get(gpid(1, 4)));
+    ASSERT_EQ(nullptr, snapshot.get(gpid(2, 0)));
+
+    // the published copy is not affected by the later changes
+    rs.erase(gpid(1, 0));
+    ASSERT_NE(nullptr, snapshot.get(gpid(1, 0)));
+    snapshot.publish(rs);
+    snapshot.reclaim();
+    ASSERT_EQ(nullptr, snapshot.get(gpid(1, 0)));
+
+    // publish the change of a replica
+    replica_ptr r = rs[gpid(1, 1)];
+    rs.erase(gpid(1, 1));
+    snapshot.publish(rs, gpid(1, 1));
+    ASSERT_EQ(nullptr, snapshot.get(gpid(1, 1)));
+    rs.emplace(gpid(1, 0), r);
+    snapshot.publish(rs, gpid(1, 0));
+    snapshot.reclaim();
+    ASSERT_EQ(r, snapshot.get(gpid(1, 0)));
+    for (int i = 2; i < 4; ++i) {
+        ASSERT_EQ(rs[gpid(1, i)], snapshot.get(gpid(1, i)));
+    }
+}
+
+TEST_F(replicas_snapshot_test, publish_while_reading)
+{
+    replicas_snapshot snapshot;
+    replicas rs = create_replicas(8);
+    snapshot.publish(rs);
+    replica_ptr removable = rs[gpid(1, 7)];
+
+    std::atomic<bool> stopped(false);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!stopped) {
+                // the partitions never removed are always found
+                for (int p = 0; p < 7; ++p) {
+                    if (snapshot.get(gpid(1, p)) == nullptr) {
+                        failed = true;
+                    }
+                }
+                replica_ptr r = snapshot.get(gpid(1, 7));
+                if (r != nullptr && r != removable) {
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 200; ++i) {
+        if (i % 2 == 0) {
+            rs.erase(gpid(1, 7));
+        } else {
+            rs.emplace(gpid(1, 7), removable);
+        }
+        snapshot.publish(rs, gpid(1, 7));
+        if (i % 10 == 0) {
+            snapshot.reclaim();
+        }
+    }
+    snapshot.reclaim();
+    stopped = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    ASSERT_FALSE(failed);
+}
+
+// returns the lookups per second of `kThreads` threads
+template <typename Lookup>
+static double run_lookup_benchmark(int partition_count, Lookup &&lookup)
+{
+    const int kThreads = 32;
+    const int kLookupsPerThread = 200000;
+
+    std::atomic<int> not_found(0);
+    std::vector<std::thread> threads;
+    uint64_t start = dsn_now_ns();
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kLookupsPerThread; ++i) {
+                if (lookup(gpid(1, (t + i) % partition_count)) == nullptr) {
+                    ++not_found;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    uint64_t elapsed = dsn_now_ns() - start;
+    EXPECT_EQ(0, not_found.load());
+    return kThreads * kLookupsPerThread * 1e9 / elapsed;
+}
+
+// run it with --gtest_also_run_disabled_tests
+TEST_F(replicas_snapshot_test, DISABLED_lookup_benchmark)
+{
+    const int kPartitionCount = 256;
+    replicas rs = create_replicas(kPartitionCount);
+
+    // the way replica_stub::get_replica() looked up the replicas before
+    zrwlock_nr lock;
+    double locked = run_lookup_benchmark(kPartitionCount, [&](gpid id) -> replica_ptr {
+        zauto_read_lock l(lock);
+        auto it = rs.find(id);
+        return it == rs.end() ? nullptr : it->second;
+    });
+
+    replicas_snapshot snapshot;
+    snapshot.publish(rs);
+    double lock_free =
+        run_lookup_benchmark(kPartitionCount, [&](gpid id) { return snapshot.get(id); });
+
+    std::cout << "replica lookups with 32 threads: rwlock = " << locked
+              << " ops/s, snapshot = " << lock_free << " ops/s" << std::endl;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -17,11 +17,14 @@
 
 #include "utils/throttling_controller.h"
 
+#include <dsn/c/api_layer1.h>
 #include <gtest/gtest.h>
 
 namespace dsn {
 namespace replication {
 
+static const int kPartitions = 8;
+
 class throttling_controller_test : public ::testing::Test
 {
 public:
@@ -121,11 +124,116 @@ public:
             ASSERT_NE(parse_err, "");
         }
     }
+
+    // sends `total` requests to `kPartitions` partitions, half of which are to partition 0,
+    // returns the count of the rejected ones
+    int send_skewed_requests(throttling_controller *cntls, int total)
+    {
+        int rejected = 0;
+        for (int i = 0; i < total; ++i) {
+            int pidx = (i % 2 == 0) ? 0 : (i / 2) % (kPartitions - 1) + 1;
+            int64_t delay_ms = 0;
+            if (cntls[pidx].control(0, 1, delay_ms) == throttling_controller::REJECT) {
+                ++rejected;
+            }
+        }
+        return rejected;
+    }
+
+    void test_skewed_workload()
+    {
+        std::string parse_err;
+        bool env_changed = false;
+        std::string old_value;
+
+        // the app-level limit is 8000 qps, and the total qps is 6000
+        throttling_controller isolated[kPartitions];
+        for (auto &cntl : isolated) {
+            ASSERT_TRUE(cntl.parse_from_env(
+                "8000*reject*0", kPartitions, parse_err, env_changed, old_value));
+        }
+        int isolated_rejected = send_skewed_requests(isolated, 6000);
+
+        auto quota = std::make_shared<throttling_quota>();
+        throttling_controller shared[kPartitions];
+        for (auto &cntl : shared) {
+            ASSERT_TRUE(cntl.parse_from_env(
+                "8000*reject*0", kPartitions, parse_err, env_changed, old_value));
+            cntl.set_primary(true);
+            cntl.set_quota(quota);
+        }
+        ASSERT_EQ(kPartitions, quota->primary_count.load());
+        uint64_t start_ns = dsn_now_ns();
+        int shared_rejected = send_skewed_requests(shared, 6000);
+
+        // partition 0 is over its share of 1000 qps, but the app is still within its budget
+        ASSERT_GT(isolated_rejected, 0);
+        ASSERT_EQ(0, shared_rejected);
+
+        // the quota of the app is never exceeded
+        int passed = 20000 - send_skewed_requests(shared, 20000);
+        double elapsed_s = (dsn_now_ns() - start_ns) / 1e9;
+        ASSERT_LE(6000 + passed, 8000 + kPartitions * 1001 + 8000 * (elapsed_s + 1));
+        ASSERT_LT(passed, 20000);
+
+        // stop sharing the quota
+        // the secondaries don't count in the quota
+        shared[0].set_primary(false);
+        ASSERT_EQ(kPartitions - 1, quota->primary_count.load());
+        throttling_controller secondary;
+        secondary.set_quota(quota);
+        ASSERT_EQ(kPartitions - 1, quota->primary_count.load());
+        shared[0].set_primary(true);
+        ASSERT_EQ(kPartitions, quota->primary_count.load());
+
+        // stop sharing the quota
+        shared[0].set_quota(nullptr);
+        ASSERT_EQ(kPartitions - 1, quota->primary_count.load());
+    }
+
+    void test_delay_estimate()
+    {
+        std::string parse_err;
+        bool env_changed = false;
+        std::string old_value;
+
+        auto quota = std::make_shared<throttling_quota>();
+        throttling_controller cntls[2];
+        for (auto &cntl : cntls) {
+            ASSERT_TRUE(
+                cntl.parse_from_env("1000*delay*500", 2, parse_err, env_changed, old_value));
+            cntl.set_primary(true);
+            cntl.set_quota(quota);
+        }
+
+        // exhaust the burst of the quota
+        int64_t delay_ms = 0;
+        int delayed = 0;
+        for (int i = 0; i < 1100; ++i) {
+            if (cntls[0].control(0, 1, delay_ms) == throttling_controller::DELAY) {
+                ++delayed;
+            }
+        }
+        ASSERT_GT(delayed, 0);
+        ASSERT_LT(delayed, 1100 - 501);
+
+        // the next request waits for the units borrowed by the delayed ones, which is
+        // about 1ms per request at 1000 qps, no longer than the configured 500ms
+        ASSERT_EQ(throttling_controller::DELAY, cntls[0].control(0, 1, delay_ms));
+        ASSERT_GE(delay_ms, delayed / 2);
+        ASSERT_LE(delay_ms, 500);
+        ASSERT_EQ(throttling_controller::DELAY, cntls[0].control(100, 1, delay_ms));
+        ASSERT_LE(delay_ms, 50);
+    }
 };
 
 TEST_F(throttling_controller_test, parse_env_basic) { test_parse_env_basic(); }
 
 TEST_F(throttling_controller_test, parse_env_multiplier) { test_parse_env_multiplier(); }
 
+TEST_F(throttling_controller_test, skewed_workload) { test_skewed_workload(); }
+
+TEST_F(throttling_controller_test, delay_estimate) { test_delay_estimate(); }
+
 } // namespace replication
 } // namespace dsn
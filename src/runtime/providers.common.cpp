@@ -38,6 +38,8 @@
 #include "utils/lockp.std.h"
 #include "runtime/task/simple_task_queue.h"
 #include "runtime/task/hpc_task_queue.h"
+#include "runtime/task/work_stealing_task_queue.h"
+#include "runtime/task/timer_wheel_timer_service.h"
 #include "runtime/rpc/network.sim.h"
 #include "utils/simple_logger.h"
 #include "runtime/rpc/dsn_message_parser.h"
@@ -69,7 +71,9 @@ void register_common_providers()
     register_component_provider<sim_network_provider>("dsn::tools::sim_network_provider");
     register_component_provider<simple_task_queue>("dsn::tools::simple_task_queue");
     register_component_provider<hpc_concurrent_task_queue>("dsn::tools::hpc_concurrent_task_queue");
+    register_component_provider<work_stealing_task_queue>("dsn::tools::work_stealing_task_queue");
     register_component_provider<simple_timer_service>("dsn::tools::simple_timer_service");
+    register_component_provider<timer_wheel_timer_service>("dsn::tools::timer_wheel_timer_service");
 
     register_message_header_parser<dsn_message_parser>(NET_HDR_DSN, {"RDSN"});
     register_message_header_parser<thrift_message_parser>(NET_HDR_THRIFT, {"THFT"});
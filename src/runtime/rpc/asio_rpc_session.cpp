@@ -26,9 +26,42 @@
 
 #include "asio_rpc_session.h"
 
+#include <climits>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_bool("network",
+                enable_inline_send,
+                true,
+                "whether to try sending a batch of messages with one sendmsg in the calling "
+                "thread before handing it over to the io threads");
+DSN_DEFINE_uint32("network",
+                  tcp_cork_min_batch_messages,
+                  0,
+                  "cork the socket while sending a batch of at least this many messages, so "
+                  "that the batch is sent in full-sized segments, 0 means never cork");
+DSN_DEFINE_bool("network",
+                enable_session_send_counters,
+                false,
+                "whether to publish the messages and bytes per send syscall of each session");
+
+// max count of buffers that boost::asio passes to one sendmsg
+static const int kAsioMaxBuffersPerSyscall = 64;
+
+// how many sends are averaged for the per-session counters
+static const uint64_t kSendStatsWindow = 128;
+
+// whether the current thread is sending inline, to avoid recursion when the completion of
+// the inline send starts the next send
+static thread_local bool tls_sending_inline = false;
+
 void asio_rpc_session::set_options()
 {
     utils::auto_write_lock socket_guard(_socket_lock);
@@ -73,6 +106,89 @@ void asio_rpc_session::set_options()
         if (ec)
             dwarn("asio socket set option failed, error = %s", ec.message().c_str());
         dinfo("boost asio set no_delay = true");
+
+        // allow the inline send to return immediately when the socket buffer is full
+        _socket->non_blocking(true, ec);
+        if (ec)
+            dwarn("asio socket set non_blocking failed, error = %s", ec.message().c_str());
+    }
+}
+
+void asio_rpc_session::set_cork(bool cork)
+{
+    int value = cork ? 1 : 0;
+    utils::auto_read_lock socket_guard(_socket_lock);
+    if (!_socket->is_open()) {
+        return;
+    }
+    if (::setsockopt(_socket->native_handle(), IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) !=
+        0) {
+        dwarn_f("set TCP_CORK = {} on session {} failed, err = {}",
+                value,
+                _remote_addr.to_string(),
+                errno);
+    }
+}
+
+size_t asio_rpc_session::send_inline()
+{
+    if (!FLAGS_enable_inline_send || tls_sending_inline ||
+        _sending_buffers.size() > static_cast<size_t>(IOV_MAX)) {
+        return 0;
+    }
+
+    std::vector<struct iovec> iovs(_sending_buffers.size());
+    for (size_t i = 0; i < _sending_buffers.size(); i++) {
+        iovs[i].iov_base = _sending_buffers[i].buf;
+        iovs[i].iov_len = _sending_buffers[i].sz;
+    }
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iovs.data();
+    mh.msg_iovlen = iovs.size();
+
+    ssize_t sent;
+    {
+        utils::auto_read_lock socket_guard(_socket_lock);
+        if (!_socket->is_open()) {
+            return 0;
+        }
+        sent = ::sendmsg(_socket->native_handle(), &mh, MSG_NOSIGNAL);
+    }
+
+    // leave the errors to the async write, which fails the session in the io thread
+    return sent > 0 ? static_cast<size_t>(sent) : 0;
+}
+
+void asio_rpc_session::on_batch_sent(size_t messages, size_t bytes, size_t syscalls)
+{
+    if (!FLAGS_enable_session_send_counters) {
+        return;
+    }
+
+    utils::auto_lock<utils::ex_lock_nr> l(_send_stats_lock);
+    if (_msgs_per_send_counter.get() == nullptr) {
+        std::string suffix =
+            fmt::format("@{}.{}", is_client() ? "client" : "server", _remote_addr.to_string());
+        _msgs_per_send_counter.init_global_counter(_net.node()->full_name(),
+                                                   "network",
+                                                   ("session.msgs.per.send" + suffix).c_str(),
+                                                   COUNTER_TYPE_NUMBER,
+                                                   "messages sent per send syscall");
+        _bytes_per_send_counter.init_global_counter(_net.node()->full_name(),
+                                                    "network",
+                                                    ("session.bytes.per.send" + suffix).c_str(),
+                                                    COUNTER_TYPE_NUMBER,
+                                                    "bytes sent per send syscall");
+    }
+
+    _window_messages += messages;
+    _window_bytes += bytes;
+    _window_syscalls += syscalls;
+    if (_window_syscalls >= kSendStatsWindow) {
+        _msgs_per_send_counter->set(_window_messages / _window_syscalls);
+        _bytes_per_send_counter->set(_window_bytes / _window_syscalls);
+        _window_messages = _window_bytes = _window_syscalls = 0;
     }
 }
 
@@ -131,25 +247,65 @@ void asio_rpc_session::do_read(int read_next)
 
 void asio_rpc_session::send(uint64_t signature)
 {
-    std::vector<boost::asio::const_buffer> asio_wbufs;
-    int bcount = (int)_sending_buffers.size();
+    size_t messages = _sending_msgs.size();
+    size_t total_bytes = 0;
+    for (const auto &buf : _sending_buffers) {
+        total_bytes += buf.sz;
+    }
+
+    // all the pending messages are sent with one sendmsg if the socket buffer allows, and the
+    // rest is sent asynchronously
+    size_t sent = send_inline();
+    if (sent == total_bytes) {
+        on_batch_sent(messages, total_bytes, 1);
+
+        tls_sending_inline = true;
+        on_send_completed(signature);
+        tls_sending_inline = false;
+        return;
+    }
 
     // prepare buffers
-    asio_wbufs.resize(bcount);
-    for (int i = 0; i < bcount; i++) {
-        asio_wbufs[i] = boost::asio::const_buffer(_sending_buffers[i].buf, _sending_buffers[i].sz);
+    std::vector<boost::asio::const_buffer> asio_wbufs;
+    asio_wbufs.reserve(_sending_buffers.size());
+    size_t skipped = sent;
+    for (const auto &buf : _sending_buffers) {
+        if (skipped >= buf.sz) {
+            skipped -= buf.sz;
+            continue;
+        }
+        asio_wbufs.emplace_back(static_cast<const char *>(buf.buf) + skipped, buf.sz - skipped);
+        skipped = 0;
+    }
+    size_t syscalls = (sent > 0 ? 1 : 0) +
+                      (asio_wbufs.size() + kAsioMaxBuffersPerSyscall - 1) /
+                          kAsioMaxBuffersPerSyscall;
+
+    // the rest of a large batch may take several syscalls, cork the socket to avoid sending
+    // partial segments in between
+    bool cork = FLAGS_tcp_cork_min_batch_messages > 0 &&
+                messages >= FLAGS_tcp_cork_min_batch_messages;
+    if (cork) {
+        set_cork(true);
     }
 
     add_ref();
 
     utils::auto_read_lock socket_guard(_socket_lock);
     boost::asio::async_write(
-        *_socket, asio_wbufs, [this, signature](boost::system::error_code ec, std::size_t length) {
+        *_socket,
+        asio_wbufs,
+        [this, signature, cork, messages, total_bytes, syscalls](boost::system::error_code ec,
+                                                                 std::size_t length) {
+            if (cork) {
+                set_cork(false);
+            }
             if (ec) {
                 derror(
                     "asio write to %s failed: %s", _remote_addr.to_string(), ec.message().c_str());
                 on_failure(true);
             } else {
+                on_batch_sent(messages, total_bytes, syscalls);
                 on_send_completed(signature);
             }
 
@@ -162,11 +318,21 @@ asio_rpc_session::asio_rpc_session(asio_network_provider &net,
                                    std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                                    message_parser_ptr &parser,
                                    bool is_client)
-    : rpc_session(net, remote_addr, parser, is_client), _socket(socket)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _socket(socket),
+      _window_messages(0),
+      _window_bytes(0),
+      _window_syscalls(0)
 {
     set_options();
 }
 
+asio_rpc_session::~asio_rpc_session()
+{
+    _msgs_per_send_counter.clear();
+    _bytes_per_send_counter.clear();
+}
+
 void asio_rpc_session::close()
 {
     utils::auto_write_lock socket_guard(_socket_lock);
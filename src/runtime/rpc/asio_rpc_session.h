@@ -29,6 +29,7 @@
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/utility/priority_queue.h>
 #include <dsn/tool-api/message_parser.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <boost/asio.hpp>
 #include "asio_net_provider.h"
 
@@ -46,7 +47,7 @@ public:
                      message_parser_ptr &parser,
                      bool is_client);
 
-    ~asio_rpc_session() override = default;
+    ~asio_rpc_session() override;
 
     void send(uint64_t signature) override;
 
@@ -57,6 +58,13 @@ public:
 private:
     void do_read(int read_next) override;
     void set_options();
+    void set_cork(bool cork);
+
+    // try to send the whole `_sending_buffers` with one sendmsg without blocking,
+    // returns the bytes sent
+    size_t send_inline();
+
+    void on_batch_sent(size_t messages, size_t bytes, size_t syscalls);
     void on_message_read(message_ex *msg)
     {
         if (!on_recv_message(msg, 0)) {
@@ -69,6 +77,14 @@ private:
     // reading/writing socket being modified or closed concurrently.
     std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
     ::dsn::utils::rw_lock_nr _socket_lock;
+
+    // stats of the recent sends, averaged into the per-session counters
+    ::dsn::utils::ex_lock_nr _send_stats_lock;
+    uint64_t _window_messages;
+    uint64_t _window_bytes;
+    uint64_t _window_syscalls;
+    perf_counter_wrapper _msgs_per_send_counter;
+    perf_counter_wrapper _bytes_per_send_counter;
 };
 
 } // namespace tools
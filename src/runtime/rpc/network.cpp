@@ -507,7 +507,13 @@ network::network(rpc_engine *srv, network *inner_provider)
     : _engine(srv), _client_hdr_format(NET_HDR_DSN), _unknown_msg_header_format(NET_HDR_INVALID)
 {
     _message_buffer_block_size = 1024 * 64;
-    _max_buffer_block_count_per_send = 64; // TODO: windows, how about the other platforms?
+    // all the pending messages of a session are sent with one sendmsg, so up to IOV_MAX
+    // TODO: windows, how about the other platforms?
+    _max_buffer_block_count_per_send =
+        (int)dsn_config_get_value_uint64("network",
+                                         "max_buffer_block_count_per_send",
+                                         1024,
+                                         "max count of buffers sent by a session at a time");
     _send_queue_threshold =
         (int)dsn_config_get_value_uint64("network",
                                          "send_queue_threshold",
@@ -32,6 +32,7 @@
 #include <cctype>
 
 #include "runtime/task/task_engine.h"
+#include "utils/block_pool.h"
 
 using namespace dsn::utils;
 
@@ -78,6 +79,13 @@ message_ex::~message_ex()
     }
 }
 
+/*static*/ void *message_ex::operator new(size_t size) { return block_pool::allocate(size); }
+
+/*static*/ void message_ex::operator delete(void *p, size_t size)
+{
+    block_pool::deallocate(p, size);
+}
+
 error_code message_ex::error()
 {
     dsn::error_code code;
@@ -229,7 +237,7 @@ message_ex *message_ex::copy(bool clone_content, bool copy_for_receive)
         msg->buffers = buffers;
     } else {
         int total_length = body_size() + sizeof(dsn::message_header);
-        std::shared_ptr<char> recv_buffer(dsn::utils::make_shared_array<char>(total_length));
+        std::shared_ptr<char> recv_buffer(block_pool::make_shared_block(total_length));
         char *ptr = recv_buffer.get();
         int i = 0;
 
@@ -369,7 +377,7 @@ message_ex *message_ex::create_response()
 void message_ex::prepare_buffer_header()
 {
     size_t header_size = sizeof(message_header);
-    auto ptr(dsn::utils::make_shared_array<char>(header_size));
+    auto ptr(block_pool::make_shared_block(header_size));
 
     // here we should call placement new,
     // so the gpid & rpc_address can be initialized
@@ -395,7 +403,7 @@ void message_ex::write_next(void **ptr, size_t *size, size_t min_size)
     dassert(!this->_is_read && this->_rw_committed,
             "there are pending msg write not committed"
             ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
-    auto ptr_data(utils::make_shared_array<char>(min_size));
+    auto ptr_data(block_pool::make_shared_block(min_size));
     *size = min_size;
     *ptr = ptr_data.get();
     this->_rw_committed = false;
@@ -422,6 +430,22 @@ void message_ex::write_commit(size_t size)
     this->header->body_length += (int)size;
 }
 
+void message_ex::write_append(const blob &data)
+{
+    dassert(!this->_is_read && this->_rw_committed,
+            "there are pending msg write not committed"
+            ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
+    dassert(data.buffer() != nullptr, "the appended buffer must be owned by the blob");
+
+    this->_rw_index++;
+    this->_rw_offset = (int)data.length();
+    this->buffers.push_back(data);
+    this->header->body_length += (int)data.length();
+
+    dassert(this->_rw_index + 1 == (int)this->buffers.size(),
+            "message write buffer count is not right");
+}
+
 bool message_ex::read_next(void **ptr, size_t *size)
 {
     // printf("%p %s %d\n", this, __FUNCTION__, utils::get_current_tid());
@@ -26,6 +26,8 @@
 
 #include "thrift_message_parser.h"
 
+#include <algorithm>
+
 #include <dsn/service_api_c.h>
 #include <dsn/cpp/serialization_helper/thrift_helper.h>
 #include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
@@ -65,6 +67,12 @@ static constexpr size_t THFT_HDR_VERSION_LENGTH = 8;
 // "THFT" + uint32(hdr_version) + uint32(hdr_length) + 36bytes(request_meta_v0)
 static constexpr size_t HEADER_LENGTH_V0 = 48;
 
+DSN_DEFINE_bool("network",
+                enable_thrift_parser_fast_path,
+                true,
+                "whether thrift_message_parser decodes the request meta and the message begin "
+                "by hand, and only falls back to the thrift protocol on unusual encodings");
+
 static void parse_request_meta_v0(data_input &input, /*out*/ request_meta_v0 &meta)
 {
     meta.hdr_crc32 = input.read_u32();
@@ -83,12 +91,141 @@ static int32_t gpid_to_thread_hash(gpid id)
     return id.get_app_id() * magic_number + id.get_partition_index();
 }
 
-// Reads the requests's name, seqid, and TMessageType from the binary data,
+enum class decode_status
+{
+    OK,
+    // not in the encoding that the fast path knows, should be parsed by the thrift protocol
+    UNUSUAL,
+    // the data ends before the encoded length
+    TRUNCATED,
+};
+
+// Decodes thrift_request_meta_v1 in thrift binary protocol, which is a list of
+//     <type(int8)> <field_id(int16)> <value>
+// terminated by T_STOP. An unknown field or type makes it UNUSUAL.
+static decode_status decode_request_meta_v1(string_view data,
+                                            /*out*/ thrift_request_meta_v1 &meta)
+{
+    using namespace ::apache::thrift::protocol;
+
+    data_input input(data);
+    size_t remaining = data.size();
+    auto consume = [&remaining](size_t size) {
+        if (remaining < size) {
+            return false;
+        }
+        remaining -= size;
+        return true;
+    };
+
+    while (true) {
+        if (!consume(1)) {
+            return decode_status::TRUNCATED;
+        }
+        uint8_t type = input.read_u8();
+        if (type == T_STOP) {
+            return decode_status::OK;
+        }
+        if (!consume(2)) {
+            return decode_status::TRUNCATED;
+        }
+        uint16_t field_id = input.read_u16();
+
+        size_t value_size;
+        switch (type) {
+        case T_BOOL:
+            value_size = 1;
+            break;
+        case T_I32:
+            value_size = 4;
+            break;
+        case T_I64:
+            value_size = 8;
+            break;
+        default:
+            return decode_status::UNUSUAL;
+        }
+        if (!consume(value_size)) {
+            return decode_status::TRUNCATED;
+        }
+
+        if (field_id == 1 && type == T_I32) {
+            meta.__set_app_id(static_cast<int32_t>(input.read_u32()));
+        } else if (field_id == 2 && type == T_I32) {
+            meta.__set_partition_index(static_cast<int32_t>(input.read_u32()));
+        } else if (field_id == 3 && type == T_I32) {
+            meta.__set_client_timeout(static_cast<int32_t>(input.read_u32()));
+        } else if (field_id == 4 && type == T_I64) {
+            meta.__set_client_partition_hash(static_cast<int64_t>(input.read_u64()));
+        } else if (field_id == 5 && type == T_BOOL) {
+            meta.__set_is_backup_request(input.read_u8() != 0);
+        } else {
+            return decode_status::UNUSUAL;
+        }
+    }
+}
+
+// Decodes the message begin in the strict thrift binary protocol:
+//     <int32(VERSION_1 | message_type)> <int32(name_length)> <name> <int32(seqid)>
+// `name` refers to `data` without copying.
+static decode_status decode_message_begin(string_view data,
+                                          /*out*/ string_view &name,
+                                          /*out*/ int &message_type,
+                                          /*out*/ int32_t &seqid,
+                                          /*out*/ size_t &length)
+{
+    typedef ::apache::thrift::protocol::TBinaryProtocol protocol;
+
+    if (data.size() < 8) {
+        return decode_status::TRUNCATED;
+    }
+    data_input input(data);
+    auto version = static_cast<int32_t>(input.read_u32());
+    if ((version & protocol::VERSION_MASK) != protocol::VERSION_1) {
+        // the non-strict encoding begins with the name
+        return decode_status::UNUSUAL;
+    }
+    uint32_t name_length = input.read_u32();
+    length = 12 + static_cast<size_t>(name_length);
+    if (data.size() < length) {
+        return decode_status::TRUNCATED;
+    }
+    input.skip(name_length);
+
+    name = string_view(data.data() + 8, name_length);
+    message_type = version & 0x000000ff;
+    seqid = static_cast<int32_t>(input.read_u32());
+    return decode_status::OK;
+}
+
+static bool is_request_type(int message_type)
+{
+    return message_type == ::apache::thrift::protocol::T_CALL ||
+           message_type == ::apache::thrift::protocol::T_ONEWAY;
+}
+
+static void init_request_header(message_ex *msg, string_view name, int32_t seqid)
+{
+    dsn::message_header *dsn_hdr = msg->header;
+    dsn_hdr->id = seqid;
+    size_t name_length = std::min(name.size(), sizeof(dsn_hdr->rpc_name) - 1);
+    memcpy(dsn_hdr->rpc_name, name.data(), name_length);
+    dsn_hdr->rpc_name[name_length] = '\0';
+    dsn_hdr->context.u.is_request = 1;
+    dsn_hdr->context.u.serialize_format = DSF_THRIFT_BINARY; // always serialize in thrift binary
+
+    // common fields
+    msg->hdr_format = NET_HDR_THRIFT;
+    dsn_hdr->hdr_type = THRIFT_HDR_SIG;
+    dsn_hdr->hdr_length = sizeof(message_header);
+    dsn_hdr->hdr_crc32 = msg->header->body_crc32 = CRC_INVALID;
+}
+
+// Reads the requests's name, seqid, and TMessageType through the thrift protocol,
 // and constructs a `message_ex` object.
-static message_ex *create_message_from_request_blob(const blob &body_data)
+static message_ex *create_message_by_thrift_protocol(const blob &body_data)
 {
     dsn::message_ex *msg = message_ex::create_receive_message_with_standalone_header(body_data);
-    dsn::message_header *dsn_hdr = msg->header;
 
     dsn::rpc_read_stream stream(msg);
     ::dsn::binary_reader_transport binary_transport(stream);
@@ -100,15 +237,7 @@ static message_ex *create_message_from_request_blob(const blob &body_data)
     ::apache::thrift::protocol::TMessageType mtype;
     int32_t seqid;
     iprot.readMessageBegin(fname, mtype, seqid);
-    dsn_hdr->id = seqid;
-    strncpy(dsn_hdr->rpc_name, fname.c_str(), sizeof(dsn_hdr->rpc_name) - 1);
-    dsn_hdr->rpc_name[sizeof(dsn_hdr->rpc_name) - 1] = '\0';
-
-    if (mtype == ::apache::thrift::protocol::T_CALL ||
-        mtype == ::apache::thrift::protocol::T_ONEWAY) {
-        dsn_hdr->context.u.is_request = 1;
-    }
-    if (dsn_hdr->context.u.is_request != 1) {
+    if (!is_request_type(mtype)) {
         derror("invalid message type: %d", mtype);
         delete msg;
         /// set set rpc_read_stream::_msg to nullptr,
@@ -116,13 +245,45 @@ static message_ex *create_message_from_request_blob(const blob &body_data)
         stream.set_read_msg(nullptr);
         return nullptr;
     }
-    dsn_hdr->context.u.serialize_format = DSF_THRIFT_BINARY; // always serialize in thrift binary
+    init_request_header(msg, fname, seqid);
+    return msg;
+}
 
-    // common fields
-    msg->hdr_format = NET_HDR_THRIFT;
-    dsn_hdr->hdr_type = THRIFT_HDR_SIG;
-    dsn_hdr->hdr_length = sizeof(message_header);
-    dsn_hdr->hdr_crc32 = msg->header->body_crc32 = CRC_INVALID;
+// Reads the requests's name, seqid, and TMessageType from the binary data,
+// and constructs a `message_ex` object whose body refers to `body_data`.
+static message_ex *create_message_from_request_blob(const blob &body_data)
+{
+    if (!FLAGS_enable_thrift_parser_fast_path) {
+        return create_message_by_thrift_protocol(body_data);
+    }
+
+    string_view name;
+    int mtype;
+    int32_t seqid;
+    size_t length;
+    switch (decode_message_begin(body_data, name, mtype, seqid, length)) {
+    case decode_status::OK:
+        break;
+    case decode_status::UNUSUAL:
+        return create_message_by_thrift_protocol(body_data);
+    case decode_status::TRUNCATED:
+        derror("message begin exceeds the request body of %u bytes", body_data.length());
+        return nullptr;
+    }
+    if (!is_request_type(mtype)) {
+        derror("invalid message type: %d", mtype);
+        return nullptr;
+    }
+
+    dsn::message_ex *msg = message_ex::create_receive_message_with_standalone_header(body_data);
+    // skip the message begin as the thrift protocol does, the arguments are read next
+    void *ptr;
+    size_t size;
+    bool r = msg->read_next(&ptr, &size);
+    dassert(r, "read msg must have one segment of buffer ready");
+    msg->read_commit(length);
+
+    init_request_header(msg, name, seqid);
     return msg;
 }
 
@@ -199,7 +360,7 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
         return nullptr;
     }
 
-    message_ex *msg = create_message_from_request_blob(buf);
+    message_ex *msg = create_message_from_request_blob(buf.range(0, _meta_v0->body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
@@ -221,6 +382,32 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
     return msg;
 }
 
+bool thrift_message_parser::parse_request_meta_v1(const blob &meta_data)
+{
+    thrift_request_meta_v1 &meta = *_v1_specific_vars->_meta_v1;
+    if (FLAGS_enable_thrift_parser_fast_path) {
+        switch (decode_request_meta_v1(meta_data, meta)) {
+        case decode_status::OK:
+            return true;
+        case decode_status::UNUSUAL:
+            // drop the fields decoded so far, and read them again through the thrift protocol
+            meta = thrift_request_meta_v1();
+            break;
+        case decode_status::TRUNCATED:
+            derror("request meta exceeds its length of %u bytes", meta_data.length());
+            return false;
+        }
+    }
+
+    binary_reader meta_reader(meta_data);
+    ::dsn::binary_reader_transport trans(meta_reader);
+    boost::shared_ptr<::dsn::binary_reader_transport> transport(
+        &trans, [](::dsn::binary_reader_transport *) {});
+    ::apache::thrift::protocol::TBinaryProtocol proto(transport);
+    meta.read(&proto);
+    return true;
+}
+
 message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader, int &read_next)
 {
     // Parses request meta
@@ -231,12 +418,11 @@ message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader,
             return nullptr;
         }
 
-        binary_reader meta_reader(buf);
-        ::dsn::binary_reader_transport trans(meta_reader);
-        boost::shared_ptr<::dsn::binary_reader_transport> transport(
-            &trans, [](::dsn::binary_reader_transport *) {});
-        ::apache::thrift::protocol::TBinaryProtocol proto(transport);
-        _v1_specific_vars->_meta_v1->read(&proto);
+        if (!parse_request_meta_v1(buf.range(0, _v1_specific_vars->_meta_length))) {
+            read_next = -1;
+            reset();
+            return nullptr;
+        }
         _v1_specific_vars->_meta_parsed = true;
     }
     buf = buf.range(_v1_specific_vars->_meta_length);
@@ -246,7 +432,8 @@ message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader,
         read_next = _v1_specific_vars->_body_length - buf.size();
         return nullptr;
     }
-    message_ex *msg = create_message_from_request_blob(buf);
+    message_ex *msg =
+        create_message_from_request_blob(buf.range(0, _v1_specific_vars->_body_length));
     if (msg == nullptr) {
         read_next = -1;
         reset();
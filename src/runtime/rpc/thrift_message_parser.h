@@ -30,6 +30,7 @@
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/utility/ports.h>
 #include <dsn/utility/endians.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest_prod.h>
 #include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
 
@@ -37,6 +38,8 @@
 
 namespace dsn {
 
+DSN_DECLARE_bool(enable_thrift_parser_fast_path);
+
 struct request_meta_v0
 {
     void clear()
@@ -67,7 +70,8 @@ struct v1_specific_vars
 
     void clear()
     {
-        _meta_v1.reset(new thrift_request_meta_v1);
+        // reuse the meta rather than allocating it for each request
+        *_meta_v1 = thrift_request_meta_v1();
         _meta_parsed = false;
         _meta_length = 0;
         _body_length = 0;
@@ -86,6 +90,11 @@ DEFINE_CUSTOMIZED_ID(network_header_format, NET_HDR_THRIFT)
 // Parses request sent in rDSN thrift protocol, which is
 // mainly used by our Java/GoLang/NodeJs/Python clients,
 // and encodes response to them.
+//
+// If [network] enable_thrift_parser_fast_path is set, the request meta and the thrift
+// message begin are decoded by hand without any allocation, and the request body refers to
+// the received buffer. Only the encodings the clients do not send (e.g. unknown meta fields,
+// or the non-strict message begin) are parsed through the thrift protocol.
 class thrift_message_parser final : public message_parser
 {
 public:
@@ -114,6 +123,9 @@ private:
 
     bool parse_request_header(message_reader *reader, int &read_next);
 
+    // parses `meta_data` into `_v1_specific_vars->_meta_v1`
+    bool parse_request_meta_v1(const blob &meta_data);
+
 private:
     friend class thrift_message_parser_test;
     FRIEND_TEST(thrift_message_parser_test, get_message_on_receive_incomplete_second_field);
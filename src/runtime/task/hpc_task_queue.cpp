@@ -39,20 +39,13 @@
 namespace dsn {
 namespace tools {
 
-hpc_concurrent_task_queue::hpc_concurrent_task_queue(task_worker_pool *pool,
-                                                     int index,
-                                                     task_queue *inner_provider)
-    : task_queue(pool, index, inner_provider)
+void concurrent_priority_queues::enqueue(task *task)
 {
-}
-
-void hpc_concurrent_task_queue::enqueue(task *task)
-{
-    _queues[task->spec().priority].q.enqueue(task);
+    _queues[task->spec().priority].enqueue(task);
     _sema.signal(1);
 }
 
-task *hpc_concurrent_task_queue::dequeue(int &batch_size)
+task *concurrent_priority_queues::dequeue(int &batch_size)
 {
     batch_size = _sema.waitMany(batch_size);
     if (batch_size == 0) {
@@ -69,10 +62,11 @@ task *hpc_concurrent_task_queue::dequeue(int &batch_size)
         last = in;
         last->next = nullptr;
     });
+    // the semaphore counts the queued tasks, so once acquired they must be dequeued
     auto count = batch_size;
     do {
-        for (auto &qs : _queues) {
-            count -= qs.q.try_dequeue_bulk(out, count);
+        for (int p = TASK_PRIORITY_COUNT - 1; p >= 0; --p) {
+            count -= _queues[p].try_dequeue_bulk(out, count);
             if (count == 0) {
                 break;
             }
@@ -80,5 +74,16 @@ task *hpc_concurrent_task_queue::dequeue(int &batch_size)
     } while (count != 0);
     return head;
 }
+
+hpc_concurrent_task_queue::hpc_concurrent_task_queue(task_worker_pool *pool,
+                                                     int index,
+                                                     task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider)
+{
+}
+
+void hpc_concurrent_task_queue::enqueue(task *task) { _queues.enqueue(task); }
+
+task *hpc_concurrent_task_queue::dequeue(int &batch_size) { return _queues.dequeue(batch_size); }
 }
 }
@@ -42,13 +42,26 @@
 
 namespace dsn {
 namespace tools {
-class hpc_concurrent_task_queue : public task_queue
+
+// A lock-free MPMC queue per priority, with a semaphore counting the queued tasks, so that idle
+// workers spin for a while then park on it (which is a futex on linux) until tasks arrive.
+class concurrent_priority_queues
 {
+public:
+    void enqueue(task *task);
+
+    // blocks until tasks are queued, then dequeues up to `batch_size` of them with the higher
+    // priority first, linked by task::next, and sets `batch_size` to the dequeued count
+    task *dequeue(/*inout*/ int &batch_size);
+
+private:
     moodycamel::LightweightSemaphore _sema;
-    struct queue_t
-    {
-        moodycamel::ConcurrentQueue<task *> q;
-    } _queues[TASK_PRIORITY_COUNT];
+    moodycamel::ConcurrentQueue<task *> _queues[TASK_PRIORITY_COUNT];
+};
+
+class hpc_concurrent_task_queue : public task_queue
+{
+    concurrent_priority_queues _queues;
 
 public:
     hpc_concurrent_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
@@ -29,6 +29,12 @@
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_bool("core",
+                enable_lock_free_simple_task_queue,
+                false,
+                "whether simple_task_queue uses a lock-free queue per priority instead of a "
+                "locked priority queue");
+
 simple_timer_service::simple_timer_service(service_node *node, timer_service *inner_provider)
     : timer_service(node, inner_provider), _is_running(false)
 {
@@ -90,15 +96,28 @@ void simple_timer_service::add_timer(task *task)
 }
 
 simple_task_queue::simple_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider)
-    : task_queue(pool, index, inner_provider), _samples("")
+    : task_queue(pool, index, inner_provider),
+      _lock_free(FLAGS_enable_lock_free_simple_task_queue),
+      _samples("")
 {
 }
 
-void simple_task_queue::enqueue(task *task) { _samples.enqueue(task, task->spec().priority); }
+void simple_task_queue::enqueue(task *task)
+{
+    if (_lock_free) {
+        _queues.enqueue(task);
+        return;
+    }
+    _samples.enqueue(task, task->spec().priority);
+}
 
-// always return 1 or 0 task so far
+// always return 1 or 0 task so far if not `_lock_free`
 task *simple_task_queue::dequeue(/*inout*/ int &batch_size)
 {
+    if (_lock_free) {
+        return _queues.dequeue(batch_size);
+    }
+
     long c = 0;
     auto t = _samples.dequeue(c);
     dassert(t != nullptr, "dequeue does not return empty tasks");
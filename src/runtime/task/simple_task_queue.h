@@ -27,11 +27,25 @@
 #pragma once
 
 #include <dsn/tool_api.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/priority_queue.h>
 #include <boost/asio.hpp>
 
+#include "hpc_task_queue.h"
+
 namespace dsn {
 namespace tools {
+
+DSN_DECLARE_bool(enable_lock_free_simple_task_queue);
+
+// simple_task_queue dequeues the tasks with higher priority first, and FIFO within a priority.
+//
+// By default all the tasks are kept in a priority queue guarded by a lock. If
+// [core] enable_lock_free_simple_task_queue is set, each priority is a lock-free MPMC queue
+// instead, and idle workers spin for a while then park on a semaphore (which is a futex on
+// linux) until tasks arrive. In this mode a worker dequeues up to `batch_size` tasks at once,
+// and the FIFO order within a priority is only kept for the tasks enqueued by the same
+// thread: the tasks enqueued by different threads may be dequeued out of their enqueue order.
 class simple_task_queue : public task_queue
 {
 public:
@@ -43,8 +57,13 @@ public:
     virtual task *dequeue(/*inout*/ int &batch_size) override;
 
 private:
+    const bool _lock_free;
+
     typedef utils::blocking_priority_queue<task *, TASK_PRIORITY_COUNT> tqueue;
     tqueue _samples;
+
+    // used if `_lock_free`
+    concurrent_priority_queues _queues;
 };
 
 class simple_timer_service : public timer_service
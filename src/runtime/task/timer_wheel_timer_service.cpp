@@ -0,0 +1,195 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "timer_wheel_timer_service.h"
+
+#include <limits>
+
+namespace dsn {
+namespace tools {
+
+timer_wheel_timer_service::timer_wheel_timer_service(service_node *node,
+                                                     timer_service *inner_provider)
+    : timer_service(node, inner_provider),
+      _current_tick(dsn_now_ms()),
+      _next_wakeup_tick(std::numeric_limits<uint64_t>::max()),
+      _timer_count(0),
+      _stopping(false),
+      _is_running(false)
+{
+}
+
+void timer_wheel_timer_service::start()
+{
+    if (_is_running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopping = false;
+    }
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+
+        char buffer[128];
+        sprintf(buffer, "%s.timer", get_service_node_name(node()));
+
+        task_worker::set_name(buffer);
+        task_worker::set_priority(worker_priority_t::THREAD_xPRIORITY_ABOVE_NORMAL);
+
+        run();
+    });
+    _is_running = true;
+}
+
+void timer_wheel_timer_service::stop()
+{
+    if (!_is_running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _stopping = true;
+    }
+    _cond.notify_one();
+    _worker.join();
+    _is_running = false;
+}
+
+void timer_wheel_timer_service::add_timer(task *task)
+{
+    uint64_t expire_tick = dsn_now_ms() + task->delay_milliseconds();
+    task->set_delay(0);
+
+    bool wakeup = false;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        insert(task, expire_tick);
+        ++_timer_count;
+        if (expire_tick < _next_wakeup_tick) {
+            _next_wakeup_tick = expire_tick;
+            wakeup = true;
+        }
+    }
+    if (wakeup) {
+        _cond.notify_one();
+    }
+}
+
+void timer_wheel_timer_service::insert(task *t, uint64_t expire_tick)
+{
+    // the ticks before `_current_tick` have been processed, expire it at the next one
+    expire_tick = std::max(expire_tick, _current_tick);
+
+    uint64_t delta = expire_tick - _current_tick;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    if (level == kLevels - 1 && delta >= (1ULL << (kSlotBits * kLevels))) {
+        // far beyond the delays a task can have, just wait for the longest possible
+        expire_tick = _current_tick + (1ULL << (kSlotBits * kLevels)) - 1;
+    }
+    _wheels[level][(expire_tick >> (kSlotBits * level)) & kSlotMask].push_back({t, expire_tick});
+}
+
+void timer_wheel_timer_service::expire_current_tick(/*out*/ std::vector<task *> &expired)
+{
+    // a slot of level i comes due when the lower 8*i bits of the tick are all zero, then its
+    // timers are re-inserted into the lower levels by their remaining delays
+    for (int level = kLevels - 1; level > 0; --level) {
+        if ((_current_tick & ((1ULL << (kSlotBits * level)) - 1)) != 0) {
+            continue;
+        }
+        timer_slot &slot = _wheels[level][(_current_tick >> (kSlotBits * level)) & kSlotMask];
+        if (slot.empty()) {
+            continue;
+        }
+        _cascading.swap(slot);
+        for (const timer_entry &e : _cascading) {
+            insert(e.t, e.expire_tick);
+        }
+        _cascading.clear();
+    }
+
+    timer_slot &slot = _wheels[0][_current_tick & kSlotMask];
+    for (const timer_entry &e : slot) {
+        expired.push_back(e.t);
+    }
+    _timer_count -= slot.size();
+    slot.clear();
+}
+
+uint64_t timer_wheel_timer_service::next_wakeup_tick() const
+{
+    if (_timer_count == 0) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    uint64_t tick = _current_tick;
+    if ((tick & kSlotMask) == 0) {
+        // the higher levels may have timers to cascade at this tick
+        return tick;
+    }
+    do {
+        if (!_wheels[0][tick & kSlotMask].empty()) {
+            return tick;
+        }
+        ++tick;
+    } while ((tick & kSlotMask) != 0);
+    return tick;
+}
+
+void timer_wheel_timer_service::run()
+{
+    std::vector<task *> expired;
+    std::unique_lock<std::mutex> l(_lock);
+    while (!_stopping) {
+        uint64_t now = dsn_now_ms();
+        if (_timer_count == 0) {
+            // nothing to cascade or expire, skip the idle ticks at once
+            _current_tick = std::max(_current_tick, now + 1);
+        }
+        for (; _current_tick <= now; ++_current_tick) {
+            expire_current_tick(expired);
+        }
+
+        if (!expired.empty()) {
+            l.unlock();
+            for (task *t : expired) {
+                t->enqueue();
+                // to consume the added ref count by task::enqueue for add_timer
+                t->release_ref();
+            }
+            expired.clear();
+            l.lock();
+            continue;
+        }
+
+        _next_wakeup_tick = next_wakeup_tick();
+        if (_next_wakeup_tick == std::numeric_limits<uint64_t>::max()) {
+            _cond.wait(l);
+        } else {
+            _cond.wait_for(l, std::chrono::milliseconds(_next_wakeup_tick - now));
+        }
+    }
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool_api.h>
+
+namespace dsn {
+namespace tools {
+
+// timer_wheel_timer_service keeps the delayed tasks in a hierarchical timing wheel with a
+// tick of 1ms, instead of allocating an asio deadline timer for each of them. There are
+// `kLevels` wheels of `kSlots` slots each, the slots of level i span 256^i ticks, so a timer
+// is inserted in O(1) into the lowest level that can hold its delay, and is moved down one
+// level each time the slot it belongs to comes due ("cascading").
+//
+// A dedicated thread advances the wheels, and dispatches all the tasks expired within a tick
+// as a batch after releasing the lock, so the inserting threads are never blocked by the
+// dispatching. It sleeps until the next non-empty slot of the lowest level (or the next
+// cascading), rather than waking up every tick.
+//
+// Cancelling a task stays O(1) as it only changes the task state: the cancelled task is left
+// in the wheel and dropped by task::exec_internal() once it's dispatched.
+class timer_wheel_timer_service : public timer_service
+{
+public:
+    timer_wheel_timer_service(service_node *node, timer_service *inner_provider);
+
+    ~timer_wheel_timer_service() override { stop(); }
+
+    // after milliseconds, the provider should call task->enqueue()
+    void add_timer(task *task) override;
+
+    void start() override;
+
+    // the tasks which have not expired yet are dropped
+    void stop() override;
+
+private:
+    static const int kSlotBits = 8;
+    static const int kLevels = 4;
+    static const uint64_t kSlots = 1ULL << kSlotBits;
+    static const uint64_t kSlotMask = kSlots - 1;
+
+    struct timer_entry
+    {
+        task *t;
+        uint64_t expire_tick;
+    };
+    typedef std::vector<timer_entry> timer_slot;
+
+    void run();
+
+    // put `t` into the slot of `expire_tick`, relative to `_current_tick`
+    // must be called under `_lock`
+    void insert(task *t, uint64_t expire_tick);
+
+    // cascade the higher levels due at `_current_tick`, then move the tasks of its slot of
+    // the lowest level into `expired`
+    // must be called under `_lock`
+    void expire_current_tick(/*out*/ std::vector<task *> &expired);
+
+    // the tick to wake up at, which is the next non-empty slot of the lowest level, or the
+    // next cascading if there is no such slot before it
+    // must be called under `_lock`
+    uint64_t next_wakeup_tick() const;
+
+private:
+    std::mutex _lock;
+    std::condition_variable _cond;
+    timer_slot _wheels[kLevels][kSlots];
+    timer_slot _cascading;
+    // the ticks before `_current_tick` have all been processed
+    uint64_t _current_tick;
+    uint64_t _next_wakeup_tick;
+    size_t _timer_count;
+    bool _stopping;
+
+    std::thread _worker;
+    bool _is_running;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,244 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "work_stealing_task_queue.h"
+
+#include <algorithm>
+#include <climits>
+
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/flags.h>
+
+#include "task_engine.h"
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("core",
+                  work_stealing_idle_wait_ms,
+                  10,
+                  "how long an idle worker of work_stealing_task_queue waits before it tries to "
+                  "steal tasks from its siblings again");
+
+work_stealing_task_queue::work_stealing_task_queue(task_worker_pool *pool,
+                                                   int index,
+                                                   task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider),
+      _waiting(false),
+      _local_count(0),
+      _last_skew_update_ms(0)
+{
+    _steal_count.init_global_counter(pool->node()->full_name(),
+                                     "engine",
+                                     (get_name() + ".steal.count").c_str(),
+                                     COUNTER_TYPE_RATE,
+                                     "task count stolen by this queue from its siblings");
+    if (index == 0) {
+        // the skew is a property of the whole pool, so only the first queue reports it
+        _queue_length_skew.init_global_counter(
+            pool->node()->full_name(),
+            "engine",
+            (pool->spec().name + ".queue.length.skew").c_str(),
+            COUNTER_TYPE_NUMBER,
+            "difference between the longest and the shortest queue of the pool");
+    }
+}
+
+void work_stealing_task_queue::enqueue(task *t)
+{
+    bool notify_sibling = false;
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        auto priority = t->spec().priority;
+        if (is_stealable(t)) {
+            _stealable[priority].push_back(t);
+            // the owner is busy, let an idle sibling take the task over
+            notify_sibling = !_waiting;
+        } else {
+            _bound[priority].push_back(t);
+        }
+        ++_local_count;
+    }
+    _cond.notify_one();
+
+    if (notify_sibling) {
+        notify_idle_sibling();
+    }
+}
+
+task *work_stealing_task_queue::dequeue(/*inout*/ int &batch_size)
+{
+    int expected = batch_size;
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        if (_local_count > 0) {
+            return pop_local(batch_size);
+        }
+    }
+
+    update_queue_length_skew();
+
+    task *head = steal(batch_size);
+    if (head != nullptr) {
+        return head;
+    }
+
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        _waiting = true;
+        // a sibling resets `_waiting` when it has tasks to be stolen
+        _cond.wait_for(l, std::chrono::milliseconds(FLAGS_work_stealing_idle_wait_ms), [this]() {
+            return _local_count > 0 || !_waiting;
+        });
+        _waiting = false;
+        if (_local_count > 0) {
+            batch_size = expected;
+            return pop_local(batch_size);
+        }
+    }
+
+    // an empty batch is returned if there is still nothing to steal, then the worker
+    // calls dequeue again
+    batch_size = expected;
+    return steal(batch_size);
+}
+
+task *work_stealing_task_queue::pop_local(/*inout*/ int &batch_size)
+{
+    task *head = nullptr, *last = nullptr;
+    int count = 0;
+    for (int p = TASK_PRIORITY_COUNT - 1; p >= 0 && count < batch_size; --p) {
+        // bound tasks can only be run by this worker, so they go first
+        for (auto *q : {&_bound[p], &_stealable[p]}) {
+            while (!q->empty() && count < batch_size) {
+                task *t = q->front();
+                q->pop_front();
+                t->next = nullptr;
+                if (last != nullptr) {
+                    last->next = t;
+                } else {
+                    head = t;
+                }
+                last = t;
+                ++count;
+            }
+        }
+    }
+    _local_count -= count;
+    batch_size = count;
+    return head;
+}
+
+task *work_stealing_task_queue::pop_stealable(/*inout*/ int &batch_size)
+{
+    std::lock_guard<std::mutex> l(_lock);
+    task *head = nullptr, *last = nullptr;
+    int count = 0;
+    for (int p = TASK_PRIORITY_COUNT - 1; p >= 0 && count < batch_size; --p) {
+        auto &q = _stealable[p];
+        while (!q.empty() && count < batch_size) {
+            task *t = q.front();
+            q.pop_front();
+            t->next = nullptr;
+            if (last != nullptr) {
+                last->next = t;
+            } else {
+                head = t;
+            }
+            last = t;
+            ++count;
+        }
+    }
+    _local_count -= count;
+    batch_size = count;
+    return head;
+}
+
+task *work_stealing_task_queue::steal(/*inout*/ int &batch_size)
+{
+    auto &queues = pool()->queues();
+    size_t n = queues.size();
+    for (size_t i = 1; i < n; ++i) {
+        work_stealing_task_queue *victim = sibling((index() + i) % n);
+        if (victim == nullptr || victim->count() == 0) {
+            continue;
+        }
+
+        // take at most half of the victim's tasks, to avoid bouncing tasks among the workers
+        int count = std::min(batch_size, std::max(1, victim->count() / 2));
+        task *head = victim->pop_stealable(count);
+        if (count > 0) {
+            // the worker of this queue decreases the count of this queue after running them
+            victim->decrease_count(count);
+            increase_count(count);
+            _steal_count->add(count);
+            batch_size = count;
+            return head;
+        }
+    }
+    batch_size = 0;
+    return nullptr;
+}
+
+void work_stealing_task_queue::notify_idle_sibling()
+{
+    auto &queues = pool()->queues();
+    size_t n = queues.size();
+    for (size_t i = 1; i < n; ++i) {
+        work_stealing_task_queue *s = sibling((index() + i) % n);
+        if (s == nullptr) {
+            continue;
+        }
+        std::unique_lock<std::mutex> l(s->_lock, std::try_to_lock);
+        if (l.owns_lock() && s->_waiting && s->_local_count == 0) {
+            s->_waiting = false;
+            l.unlock();
+            s->_cond.notify_one();
+            return;
+        }
+    }
+}
+
+void work_stealing_task_queue::update_queue_length_skew()
+{
+    if (index() != 0) {
+        return;
+    }
+    uint64_t now = dsn_now_ms();
+    if (now - _last_skew_update_ms < 1000) {
+        return;
+    }
+    _last_skew_update_ms = now;
+
+    int min_count = INT_MAX, max_count = 0;
+    for (task_queue *q : pool()->queues()) {
+        int c = q->count();
+        min_count = std::min(min_count, c);
+        max_count = std::max(max_count, c);
+    }
+    _queue_length_skew->set(max_count - std::min(min_count, max_count));
+}
+
+work_stealing_task_queue *work_stealing_task_queue::sibling(size_t index) const
+{
+    // queues wrapped by aspects are not stealable
+    return dynamic_cast<work_stealing_task_queue *>(
+        pool()->queues()[index]);
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,77 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <dsn/tool-api/task_queue.h>
+
+namespace dsn {
+namespace tools {
+
+// work_stealing_task_queue is designed for partitioned thread pools, where each worker owns
+// one queue. Tasks enqueued with a non-zero hash are bound to the worker selected by the hash
+// (e.g. replica tasks by gpid::thread_hash()), so they keep their single-thread guarantee.
+// Tasks with a zero hash (e.g. LPCs without a hash, timers, aio completions) are not bound
+// to any partition, and an idle worker may steal them from the queues of its siblings.
+class work_stealing_task_queue : public task_queue
+{
+public:
+    work_stealing_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+private:
+    static bool is_stealable(task *t) { return t->hash() == 0; }
+
+    // pop at most `batch_size` tasks from the local queues, the higher priority first
+    // must be called under `_lock`
+    task *pop_local(/*inout*/ int &batch_size);
+
+    // steal at most `batch_size` unbound tasks from the sibling queues
+    task *steal(/*inout*/ int &batch_size);
+
+    // pop at most `batch_size` unbound tasks on behalf of a sibling
+    task *pop_stealable(/*inout*/ int &batch_size);
+
+    // wake up an idle sibling to steal the tasks of this queue
+    void notify_idle_sibling();
+
+    void update_queue_length_skew();
+
+    work_stealing_task_queue *sibling(size_t index) const;
+
+private:
+    std::mutex _lock;
+    std::condition_variable _cond;
+    bool _waiting;
+    int _local_count;
+    std::deque<task *> _bound[TASK_PRIORITY_COUNT];
+    std::deque<task *> _stealable[TASK_PRIORITY_COUNT];
+
+    uint64_t _last_skew_update_ms;
+    dsn::perf_counter_wrapper _steal_count;
+    dsn::perf_counter_wrapper _queue_length_skew;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -37,12 +37,23 @@
 #include "test_utils.h"
 #include <dsn/tool_api.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
 #include <sstream>
+#include <thread>
+
+#include "runtime/task/simple_task_queue.h"
+#include "runtime/task/work_stealing_task_queue.h"
 
 using namespace ::dsn;
 
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_1)
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_2)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_WORK_STEALING)
+DEFINE_TASK_CODE(LPC_TEST_WORK_STEALING, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_WORK_STEALING)
+DEFINE_TASK_CODE(LPC_TEST_TASK_QUEUE_LOW, TASK_PRIORITY_LOW, THREAD_POOL_FOR_TEST_1)
+DEFINE_TASK_CODE(LPC_TEST_TASK_QUEUE_HIGH, TASK_PRIORITY_HIGH, THREAD_POOL_FOR_TEST_1)
 
 TEST(core, task_engine)
 {
@@ -93,3 +104,200 @@ TEST(core, task_engine)
     std::vector<task_worker *> workers2 = pool2->workers();
     ASSERT_EQ(2u, workers2.size());
 }
+
+TEST(core, work_stealing_task_queue)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    task_worker_pool *pool =
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_FOR_TEST_WORK_STEALING);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_EQ(4u, pool->queues().size());
+    ASSERT_NE(nullptr, dynamic_cast<tools::work_stealing_task_queue *>(pool->queues()[0]));
+
+    // block the worker of queue 0 with a task bound to it
+    std::atomic<bool> blocked(true);
+    std::atomic<int> blocked_worker(-1);
+    task_tracker tracker;
+    tasking::enqueue(LPC_TEST_WORK_STEALING,
+                     &tracker,
+                     [&]() {
+                         blocked_worker = task::get_current_worker_index();
+                         while (blocked) {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                         }
+                     },
+                     4);
+    while (blocked_worker == -1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(0, blocked_worker);
+
+    // tasks without hash are also put to queue 0, they should be stolen by the other workers
+    const int kTaskCount = 100;
+    std::atomic<int> stolen(0);
+    for (int i = 0; i < kTaskCount; ++i) {
+        tasking::enqueue(LPC_TEST_WORK_STEALING, &tracker, [&]() {
+            if (task::get_current_worker_index() != 0) {
+                ++stolen;
+            }
+        });
+    }
+    for (int i = 0; i < 1000 && stolen < kTaskCount; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(kTaskCount, stolen);
+
+    // tasks with hash are never stolen, and run in order on their own worker
+    std::vector<int> order;
+    std::atomic<bool> wrong_worker(false);
+    for (int i = 0; i < kTaskCount; ++i) {
+        tasking::enqueue(LPC_TEST_WORK_STEALING,
+                         &tracker,
+                         [&, i]() {
+                             if (task::get_current_worker_index() != 0) {
+                                 wrong_worker = true;
+                             }
+                             order.push_back(i);
+                         },
+                         8);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(order.empty());
+
+    blocked = false;
+    tracker.wait_outstanding_tasks();
+    ASSERT_FALSE(wrong_worker);
+    ASSERT_EQ(kTaskCount, static_cast<int>(order.size()));
+    for (int i = 0; i < kTaskCount; ++i) {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+static std::unique_ptr<tools::simple_task_queue> create_simple_task_queue(bool lock_free,
+                                                                          int index)
+{
+    using tools::FLAGS_enable_lock_free_simple_task_queue;
+    PRESERVE_FLAG(enable_lock_free_simple_task_queue);
+    FLAGS_enable_lock_free_simple_task_queue = lock_free;
+    return std::unique_ptr<tools::simple_task_queue>(new tools::simple_task_queue(
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_FOR_TEST_1),
+        index,
+        nullptr));
+}
+
+TEST(core, simple_task_queue_lock_free)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    auto q = create_simple_task_queue(true, 100);
+    // a task is linked into a batch through task::next, so it can't be enqueued twice at once
+    task_ptr low1(new raw_task(LPC_TEST_TASK_QUEUE_LOW, nullptr));
+    task_ptr low2(new raw_task(LPC_TEST_TASK_QUEUE_LOW, nullptr));
+    task_ptr high(new raw_task(LPC_TEST_TASK_QUEUE_HIGH, nullptr));
+
+    // the higher priority first, up to the batch size
+    q->enqueue(low1);
+    q->enqueue(high);
+    q->enqueue(low2);
+    int batch_size = 2;
+    task *t = q->dequeue(batch_size);
+    ASSERT_EQ(2, batch_size);
+    ASSERT_EQ(high.get(), t);
+    ASSERT_EQ(low1.get(), t->next);
+    ASSERT_EQ(nullptr, t->next->next);
+
+    batch_size = 5;
+    t = q->dequeue(batch_size);
+    ASSERT_EQ(1, batch_size);
+    ASSERT_EQ(low2.get(), t);
+    ASSERT_EQ(nullptr, t->next);
+}
+
+// every task enqueued concurrently is dequeued, returns the dequeued tasks per second
+static double run_task_queue_contention(bool lock_free, int index, int tasks_per_producer)
+{
+    const int kProducers = 32;
+    const int kConsumers = 8;
+    const int kBatchSize = 5;
+
+    auto q = create_simple_task_queue(lock_free, index);
+    // every enqueue needs a distinct task, see simple_task_queue_lock_free
+    std::vector<std::vector<task_ptr>> tasks(kProducers);
+    for (auto &producer_tasks : tasks) {
+        for (int j = 0; j < tasks_per_producer; ++j) {
+            producer_tasks.emplace_back(new raw_task(LPC_TEST_TASK_QUEUE_LOW, nullptr));
+        }
+    }
+    // the stop tasks are told apart by their code
+    std::vector<task_ptr> stops;
+
+    std::atomic<int> dequeued(0);
+    std::atomic<int> stopped(0);
+    std::vector<std::thread> threads;
+    uint64_t start = dsn_now_ns();
+    for (int i = 0; i < kConsumers; ++i) {
+        threads.emplace_back([&]() {
+            while (true) {
+                int batch_size = kBatchSize;
+                int count = 0;
+                bool to_stop = false;
+                for (task *t = q->dequeue(batch_size); t != nullptr; t = t->next) {
+                    if (t->code() == LPC_TEST_TASK_QUEUE_HIGH) {
+                        to_stop = true;
+                    } else {
+                        ++count;
+                    }
+                }
+                dequeued += count;
+                if (to_stop) {
+                    ++stopped;
+                    return;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < kProducers; ++i) {
+        threads.emplace_back([&, i]() {
+            for (auto &t : tasks[i]) {
+                q->enqueue(t);
+            }
+        });
+    }
+
+    while (dequeued < kProducers * tasks_per_producer) {
+        std::this_thread::yield();
+    }
+    uint64_t elapsed = dsn_now_ns() - start;
+    // a consumer may get several stop tasks in one batch, so keep feeding until all stopped
+    while (stopped < kConsumers) {
+        stops.emplace_back(new raw_task(LPC_TEST_TASK_QUEUE_HIGH, nullptr));
+        q->enqueue(stops.back());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(kProducers * tasks_per_producer, dequeued.load());
+    return kProducers * tasks_per_producer * 1e9 / elapsed;
+}
+
+TEST(core, simple_task_queue_contention)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    run_task_queue_contention(false, 101, 2000);
+    run_task_queue_contention(true, 102, 2000);
+}
+
+// run it with --gtest_also_run_disabled_tests
+TEST(core, DISABLED_simple_task_queue_contention_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+    double locked = run_task_queue_contention(false, 103, 20000);
+    double lock_free = run_task_queue_contention(true, 104, 20000);
+    std::cout << "simple_task_queue with 32 producers and 8 consumers: locked = " << locked
+              << " tasks/s, lock-free = " << lock_free << " tasks/s" << std::endl;
+}
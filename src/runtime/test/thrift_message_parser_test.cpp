@@ -15,7 +15,10 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <iostream>
+
 #include <gtest/gtest.h>
+#include <dsn/service_api_c.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/endians.h>
 #include <dsn/cpp/serialization_helper/thrift_helper.h>
@@ -204,6 +207,104 @@ public:
             ASSERT_EQ(read_next, -1);
         }
     }
+
+    static std::string make_body(apache::thrift::protocol::TMessageType messageType, bool strict)
+    {
+        binary_writer writer;
+        binary_writer_transport transport(writer);
+        boost::shared_ptr<binary_writer_transport> trans_ptr(&transport,
+                                                             [](binary_writer_transport *) {});
+        ::apache::thrift::protocol::TBinaryProtocol oprot(trans_ptr);
+        oprot.setStrict(false, strict);
+        oprot.writeMessageBegin("RPC_TEST_THRIFT_MESSAGE_PARSER", messageType, 999);
+        oprot.writeMessageEnd();
+        return writer.get_buffer().to_string();
+    }
+
+    static std::string make_meta_v1(bool with_unknown_field)
+    {
+        binary_writer writer;
+        binary_writer_transport transport(writer);
+        boost::shared_ptr<binary_writer_transport> trans_ptr(&transport,
+                                                             [](binary_writer_transport *) {});
+        ::apache::thrift::protocol::TBinaryProtocol proto(trans_ptr);
+        proto.writeStructBegin("thrift_request_meta_v1");
+        if (with_unknown_field) {
+            proto.writeFieldBegin("unknown", ::apache::thrift::protocol::T_STRING, 100);
+            proto.writeString(std::string("unknown"));
+            proto.writeFieldEnd();
+        }
+        proto.writeFieldBegin("app_id", ::apache::thrift::protocol::T_I32, 1);
+        proto.writeI32(1);
+        proto.writeFieldEnd();
+        proto.writeFieldBegin("partition_index", ::apache::thrift::protocol::T_I32, 2);
+        proto.writeI32(28);
+        proto.writeFieldEnd();
+        proto.writeFieldBegin("client_timeout", ::apache::thrift::protocol::T_I32, 3);
+        proto.writeI32(1000);
+        proto.writeFieldEnd();
+        proto.writeFieldBegin("client_partition_hash", ::apache::thrift::protocol::T_I64, 4);
+        proto.writeI64(5000000000);
+        proto.writeFieldEnd();
+        proto.writeFieldBegin("is_backup_request", ::apache::thrift::protocol::T_BOOL, 5);
+        proto.writeBool(true);
+        proto.writeFieldEnd();
+        proto.writeFieldStop();
+        proto.writeStructEnd();
+        return writer.get_buffer().to_string();
+    }
+
+    static std::string make_request_v0(const std::string &body)
+    {
+        std::string data = std::string("THFT") + std::string(44, '\0');
+        data_output out(&data[4], 44);
+        out.write_u32(0);           // hdr_version
+        out.write_u32(48);          // hdr_length
+        out.write_u32(0);           // hdr_crc32
+        out.write_u32(body.size()); // body_length
+        out.write_u32(0);           // body_crc32
+        out.write_u32(1);           // app_id
+        out.write_u32(28);          // partition_index
+        out.write_u32(1000);        // client_timeout
+        out.write_u32(64);          // client_thread_hash
+        out.write_u64(5000000000);  // client_partition_hash
+        return data + body;
+    }
+
+    static std::string make_request_v1(const std::string &meta, const std::string &body)
+    {
+        std::string data = std::string("THFT") + std::string(12, '\0');
+        data_output out(&data[4], 12);
+        out.write_u32(1);
+        out.write_u32(meta.size());
+        out.write_u32(body.size());
+        return data + meta + body;
+    }
+
+    // parses `data`, and checks the fields shared by both header versions
+    void check_request(message_reader &reader,
+                       thrift_message_parser &parser,
+                       const std::string &data,
+                       size_t body_length)
+    {
+        int read_next = 0;
+        mock_reader_read_data(reader, data);
+        message_ptr msg = parser.get_message_on_receive(&reader, read_next);
+        ASSERT_NE(msg, nullptr);
+        ASSERT_EQ(msg->header->body_length, body_length);
+        ASSERT_EQ(msg->buffers[1].length(), body_length);
+        ASSERT_EQ(msg->header->gpid, gpid(1, 28));
+        ASSERT_EQ(msg->header->id, 999);
+        ASSERT_STREQ(msg->header->rpc_name, "RPC_TEST_THRIFT_MESSAGE_PARSER");
+        ASSERT_EQ(msg->header->client.timeout_ms, 1000);
+        ASSERT_EQ(msg->header->client.partition_hash, 5000000000);
+        ASSERT_EQ(msg->header->context.u.is_request, true);
+        ASSERT_EQ(reader.buffer().size(), 0);
+
+        // the message begin has been read, and the message end is empty
+        rpc_read_stream stream(msg);
+        ASSERT_EQ(stream.get_remaining_size(), 0);
+    }
 };
 
 TEST_F(thrift_message_parser_test, get_message_on_receive_incomplete_second_field)
@@ -406,4 +507,127 @@ TEST_F(thrift_message_parser_test, get_message_on_receive_v1_data)
     reader.truncate_read();
 }
 
+TEST_F(thrift_message_parser_test, get_message_on_receive_without_fast_path)
+{
+    PRESERVE_FLAG(enable_thrift_parser_fast_path);
+    FLAGS_enable_thrift_parser_fast_path = false;
+    message_reader reader(64);
+    ASSERT_NO_FATAL_FAILURE(
+        test_get_message_on_receive_v0_data(reader, apache::thrift::protocol::T_CALL, true));
+    ASSERT_NO_FATAL_FAILURE(test_get_message_on_receive_v0_data(
+        reader, apache::thrift::protocol::TMessageType(65), false));
+    reader.truncate_read();
+    ASSERT_NO_FATAL_FAILURE(
+        test_get_message_on_receive_v1_data(reader, apache::thrift::protocol::T_CALL, true, true));
+    ASSERT_NO_FATAL_FAILURE(test_get_message_on_receive_v1_data(
+        reader, apache::thrift::protocol::TMessageType(65), false, false));
+    reader.truncate_read();
+}
+
+TEST_F(thrift_message_parser_test, get_message_on_receive_unusual_encodings)
+{
+    message_reader reader(64);
+    thrift_message_parser parser;
+    std::string strict_body = make_body(apache::thrift::protocol::T_CALL, true);
+    std::string non_strict_body = make_body(apache::thrift::protocol::T_CALL, false);
+    ASSERT_NE(strict_body, non_strict_body);
+
+    // the non-strict message begin is parsed through the thrift protocol
+    ASSERT_NO_FATAL_FAILURE(
+        check_request(reader, parser, make_request_v0(non_strict_body), non_strict_body.size()));
+    ASSERT_NO_FATAL_FAILURE(check_request(reader,
+                                          parser,
+                                          make_request_v1(make_meta_v1(false), non_strict_body),
+                                          non_strict_body.size()));
+
+    // so is the meta with an unknown field, which is skipped
+    ASSERT_NO_FATAL_FAILURE(check_request(
+        reader, parser, make_request_v1(make_meta_v1(true), strict_body), strict_body.size()));
+
+    // the requests pipelined in one buffer are sliced without copying
+    std::string data = make_request_v1(make_meta_v1(false), strict_body);
+    mock_reader_read_data(reader, data + data);
+    int read_next = 0;
+    for (int i = 0; i < 2; ++i) {
+        message_ptr msg = parser.get_message_on_receive(&reader, read_next);
+        ASSERT_NE(msg, nullptr);
+        ASSERT_EQ(msg->buffers[1].length(), strict_body.size());
+        ASSERT_TRUE(msg->header->context.u.is_backup_request);
+    }
+    ASSERT_EQ(reader.buffer().size(), 0);
+
+    // the message begin exceeding the body is rejected
+    std::string truncated_body = strict_body.substr(0, 10);
+    mock_reader_read_data(reader, make_request_v0(truncated_body));
+    ASSERT_EQ(parser.get_message_on_receive(&reader, read_next), nullptr);
+    ASSERT_EQ(read_next, -1);
+    reader.truncate_read();
+
+    // so is the meta exceeding its length
+    std::string meta = make_meta_v1(false);
+    mock_reader_read_data(reader,
+                          make_request_v1(meta.substr(0, meta.size() - 3), strict_body));
+    ASSERT_EQ(parser.get_message_on_receive(&reader, read_next), nullptr);
+    ASSERT_EQ(read_next, -1);
+    reader.truncate_read();
+}
+
+TEST_F(thrift_message_parser_test, fast_path_same_as_thrift_protocol)
+{
+    PRESERVE_FLAG(enable_thrift_parser_fast_path);
+    std::string body = make_body(apache::thrift::protocol::T_CALL, true);
+    std::string requests[] = {make_request_v0(body), make_request_v1(make_meta_v1(false), body)};
+
+    for (const std::string &request : requests) {
+        message_ptr msgs[2];
+        for (bool fast_path : {false, true}) {
+            FLAGS_enable_thrift_parser_fast_path = fast_path;
+            message_reader reader(4096);
+            thrift_message_parser parser;
+            int read_next = 0;
+            mock_reader_read_data(reader, request);
+            msgs[fast_path] = parser.get_message_on_receive(&reader, read_next);
+            ASSERT_NE(msgs[fast_path], nullptr);
+        }
+
+        const message_header *h1 = msgs[0]->header;
+        const message_header *h2 = msgs[1]->header;
+        ASSERT_STREQ(h1->rpc_name, h2->rpc_name);
+        ASSERT_EQ(h1->body_length, h2->body_length);
+        ASSERT_EQ(h1->gpid, h2->gpid);
+        ASSERT_EQ(h1->client.timeout_ms, h2->client.timeout_ms);
+        ASSERT_EQ(h1->client.thread_hash, h2->client.thread_hash);
+        ASSERT_EQ(h1->client.partition_hash, h2->client.partition_hash);
+        ASSERT_EQ(h1->context.u.is_backup_request, h2->context.u.is_backup_request);
+        ASSERT_EQ(msgs[0]->buffers[1].to_string(), msgs[1]->buffers[1].to_string());
+    }
+}
+
+// compares the fast path with the thrift protocol, run it with --gtest_also_run_disabled_tests
+TEST_F(thrift_message_parser_test, DISABLED_parse_benchmark)
+{
+    PRESERVE_FLAG(enable_thrift_parser_fast_path);
+    const int count = 200000;
+    std::string body = make_body(apache::thrift::protocol::T_CALL, true);
+    std::string requests[] = {make_request_v0(body), make_request_v1(make_meta_v1(false), body)};
+
+    for (bool fast_path : {false, true}) {
+        FLAGS_enable_thrift_parser_fast_path = fast_path;
+        for (int version = 0; version < 2; ++version) {
+            message_reader reader(4096);
+            thrift_message_parser parser;
+            int read_next = 0;
+            uint64_t start = dsn_now_ns();
+            for (int i = 0; i < count; ++i) {
+                mock_reader_read_data(reader, requests[version]);
+                message_ptr msg = parser.get_message_on_receive(&reader, read_next);
+                ASSERT_NE(msg, nullptr);
+            }
+            std::cout << (fast_path ? "fast path" : "thrift protocol") << ", v" << version
+                      << " header: " << (dsn_now_ns() - start) / count << "ns per request"
+                      << std::endl;
+        }
+    }
+}
+
 } // namespace dsn
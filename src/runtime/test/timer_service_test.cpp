@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <dsn/tool_api.h>
+#include <gtest/gtest.h>
+
+#include "runtime/service_engine.h"
+#include "runtime/task/simple_task_queue.h"
+#include "runtime/task/timer_wheel_timer_service.h"
+
+namespace dsn {
+
+DEFINE_TASK_CODE(LPC_TEST_TIMER_SERVICE, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class timer_service_test : public ::testing::Test
+{
+public:
+    struct result
+    {
+        int fired = 0;
+        int early = 0;
+        double add_ns = 0;
+        uint64_t total_ms = 0;
+    };
+
+    // Adds `count` timers with the delays in [min_delay_ms, max_delay_ms] to `svc` as
+    // task::enqueue() does, then waits until all of them are executed.
+    static result schedule_and_wait(timer_service *svc,
+                                    int count,
+                                    int min_delay_ms,
+                                    int max_delay_ms)
+    {
+        std::atomic<int> fired(0);
+        std::atomic<int> early(0);
+        std::vector<task_ptr> tasks;
+        tasks.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            int delay = min_delay_ms + (i * 7919) % (max_delay_ms - min_delay_ms + 1);
+            uint64_t due = dsn_now_ms() + delay;
+            tasks.push_back(tasking::create_task(LPC_TEST_TIMER_SERVICE, nullptr, [&, due]() {
+                if (dsn_now_ms() < due) {
+                    ++early;
+                }
+                ++fired;
+            }));
+            tasks.back()->set_delay(delay);
+        }
+
+        result r;
+        uint64_t start = dsn_now_ns();
+        for (auto &t : tasks) {
+            // released by the timer service once the task is dispatched
+            t->add_ref();
+            svc->add_timer(t.get());
+        }
+        r.add_ns = double(dsn_now_ns() - start) / count;
+
+        uint64_t deadline = dsn_now_ms() + max_delay_ms + 10000;
+        while (fired.load() < count && dsn_now_ms() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        r.total_ms = (dsn_now_ns() - start) / 1000000;
+        r.fired = fired.load();
+        r.early = early.load();
+        return r;
+    }
+};
+
+TEST_F(timer_service_test, timer_wheel_timer_service)
+{
+    if (service_engine::instance().spec().tool == "simulator")
+        return;
+
+    tools::timer_wheel_timer_service svc(task::get_current_node2(), nullptr);
+    svc.start();
+
+    // the delays cross several cascadings from the second level
+    result r = schedule_and_wait(&svc, 10000, 1, 1000);
+    ASSERT_EQ(10000, r.fired);
+    ASSERT_EQ(0, r.early);
+
+    // the timers added after an idle period
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    r = schedule_and_wait(&svc, 100, 256, 256);
+    ASSERT_EQ(100, r.fired);
+    ASSERT_EQ(0, r.early);
+
+    svc.stop();
+}
+
+TEST_F(timer_service_test, timers_added_concurrently)
+{
+    if (service_engine::instance().spec().tool == "simulator")
+        return;
+
+    tools::timer_wheel_timer_service svc(task::get_current_node2(), nullptr);
+    svc.start();
+
+    std::vector<result> results(4);
+    std::vector<std::thread> threads;
+    for (auto &r : results) {
+        threads.emplace_back([&svc, &r]() { r = schedule_and_wait(&svc, 5000, 1, 500); });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (const auto &r : results) {
+        ASSERT_EQ(5000, r.fired);
+        ASSERT_EQ(0, r.early);
+    }
+
+    svc.stop();
+}
+
+// compares the asio and the timer wheel based timer services, run it with
+// --gtest_also_run_disabled_tests
+TEST_F(timer_service_test, DISABLED_benchmark)
+{
+    if (service_engine::instance().spec().tool == "simulator")
+        return;
+
+    const int count = 200000;
+    tools::simple_timer_service asio_svc(task::get_current_node2(), nullptr);
+    asio_svc.start();
+    result asio_result = schedule_and_wait(&asio_svc, count, 500, 1500);
+    asio_svc.stop();
+    ASSERT_EQ(count, asio_result.fired);
+
+    tools::timer_wheel_timer_service wheel_svc(task::get_current_node2(), nullptr);
+    wheel_svc.start();
+    result wheel_result = schedule_and_wait(&wheel_svc, count, 500, 1500);
+    wheel_svc.stop();
+    ASSERT_EQ(count, wheel_result.fired);
+
+    std::cout << "simple_timer_service: " << asio_result.add_ns << "ns per add_timer, "
+              << asio_result.total_ms << "ms until all executed; timer_wheel_timer_service: "
+              << wheel_result.add_ns << "ns per add_timer, " << wheel_result.total_ms
+              << "ms until all executed" << std::endl;
+}
+
+} // namespace dsn
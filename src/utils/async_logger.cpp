@@ -0,0 +1,433 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "async_logger.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include <dsn/utility/flags.h>
+#include <dsn/utility/process_utils.h>
+#include <dsn/utils/time_utils.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint32("tools.async_logger",
+                  buffer_size_kb_per_thread,
+                  256,
+                  "size of the log buffer of each logging thread in KB, rounded up to 2^n");
+DSN_DEFINE_uint32("tools.async_logger",
+                  sample_ratio_on_overload,
+                  16,
+                  "once the buffer of a thread is half full, only 1 of this count of the records "
+                  "below LOG_LEVEL_WARNING is kept");
+DSN_DEFINE_uint32("tools.async_logger",
+                  drain_interval_ms,
+                  10,
+                  "the interval to drain the buffers of the logging threads");
+
+DSN_DECLARE_bool(short_header);
+
+// the header of a record in async_log_buffer
+struct log_record
+{
+    uint32_t size;  // bytes of the header and the message, aligned to 8
+    int32_t level;  // kPaddingLevel if it's the padding to the end of the buffer
+    uint32_t len;   // bytes of the message
+    uint32_t reserved;
+    uint64_t ts;
+};
+
+static const int32_t kPaddingLevel = -1;
+
+static size_t round_up_to_8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+// a single-producer single-consumer ring buffer of log_records
+struct async_log_buffer
+{
+    explicit async_log_buffer(size_t cap)
+        : data(new char[cap]), capacity(cap), head(0), tail(0), orphaned(false), sampled(0)
+    {
+    }
+
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(); }
+
+    // called by the logging thread only
+    bool push(int32_t level, uint64_t ts, const char *msg, size_t len)
+    {
+        size_t need = round_up_to_8(sizeof(log_record) + len);
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        size_t pos = h & (capacity - 1);
+        size_t to_end = capacity - pos;
+        if (capacity - (h - t) < need + (to_end < need ? to_end : 0)) {
+            return false;
+        }
+
+        if (to_end < need) {
+            // to_end >= 8 since all the records are aligned to 8
+            auto pad = reinterpret_cast<log_record *>(data.get() + pos);
+            pad->size = static_cast<uint32_t>(to_end);
+            pad->level = kPaddingLevel;
+            h += to_end;
+            pos = 0;
+        }
+        auto r = reinterpret_cast<log_record *>(data.get() + pos);
+        r->size = static_cast<uint32_t>(need);
+        r->level = level;
+        r->len = static_cast<uint32_t>(len);
+        r->ts = ts;
+        memcpy(data.get() + pos + sizeof(log_record), msg, len);
+        head.store(h + need, std::memory_order_release);
+        return true;
+    }
+
+    // called by the drainer only, under async_logger::_lock
+    template <typename F>
+    void pop_all(F &&f)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (t != h) {
+            auto r = reinterpret_cast<const log_record *>(data.get() + (t & (capacity - 1)));
+            if (r->level != kPaddingLevel) {
+                f(*r, reinterpret_cast<const char *>(r) + sizeof(log_record));
+            }
+            t += r->size;
+        }
+        tail.store(t, std::memory_order_release);
+    }
+
+    std::unique_ptr<char[]> data;
+    const size_t capacity;
+
+    // written by the logging thread only, padded to avoid false sharing with `tail`
+    std::atomic<uint64_t> head;
+    char padding1[64];
+    // written by the drainer only
+    std::atomic<uint64_t> tail;
+    char padding2[64];
+
+    // set when the logging thread exits, then the buffer is freed once drained
+    std::atomic<bool> orphaned;
+    // used by the logging thread only
+    uint32_t sampled;
+};
+
+std::atomic<uint64_t> async_logger::s_dropped_records(0);
+
+static std::atomic<uint64_t> s_next_async_logger_id(1);
+
+// the buffer of the current thread, and the id of the logger it belongs to
+static thread_local async_log_buffer *tls_buffer = nullptr;
+static thread_local uint64_t tls_buffer_logger_id = 0;
+static thread_local bool tls_thread_exiting = false;
+
+// marks the buffer of the current thread orphaned when the thread exits
+struct async_log_buffer_holder
+{
+    std::shared_ptr<async_log_buffer> buffer;
+
+    void reset(std::shared_ptr<async_log_buffer> b)
+    {
+        if (buffer != nullptr) {
+            buffer->orphaned = true;
+        }
+        buffer = std::move(b);
+    }
+
+    ~async_log_buffer_holder()
+    {
+        reset(nullptr);
+        tls_buffer = nullptr;
+        tls_thread_exiting = true;
+    }
+};
+
+static thread_local async_log_buffer_holder tls_buffer_holder;
+
+async_logger::async_logger(const char *log_dir)
+    : simple_logger(log_dir),
+      _id(s_next_async_logger_id.fetch_add(1)),
+      _dropped(0),
+      _reported_dropped(0),
+      _wakeup_requested(false),
+      _stopped(false)
+{
+    _drainer = std::thread([this]() {
+        while (true) {
+            bool stopped;
+            {
+                std::unique_lock<std::mutex> l(_wakeup_lock);
+                _wakeup.wait_for(l, std::chrono::milliseconds(FLAGS_drain_interval_ms), [this]() {
+                    return _stopped || _wakeup_requested.load();
+                });
+                _wakeup_requested = false;
+                stopped = _stopped;
+            }
+
+            {
+                utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
+                drain();
+            }
+            if (stopped) {
+                return;
+            }
+        }
+    });
+}
+
+async_logger::~async_logger()
+{
+    {
+        std::lock_guard<std::mutex> l(_wakeup_lock);
+        _stopped = true;
+    }
+    _wakeup.notify_one();
+    _drainer.join();
+
+    utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
+    drain();
+    ::fflush(_log);
+}
+
+async_log_buffer *async_logger::current_thread_buffer()
+{
+    if (dsn_unlikely(tls_buffer_logger_id != _id)) {
+        if (tls_thread_exiting) {
+            return nullptr;
+        }
+
+        size_t capacity = 4096;
+        while (capacity < FLAGS_buffer_size_kb_per_thread * 1024) {
+            capacity <<= 1;
+        }
+        auto buffer = std::make_shared<async_log_buffer>(capacity);
+        {
+            std::lock_guard<std::mutex> l(_buffers_lock);
+            _buffers.push_back(buffer);
+        }
+        tls_buffer = buffer.get();
+        tls_buffer_logger_id = _id;
+        tls_buffer_holder.reset(std::move(buffer));
+    }
+    return tls_buffer;
+}
+
+void async_logger::wakeup_drainer()
+{
+    if (!_wakeup_requested.load(std::memory_order_relaxed) && !_wakeup_requested.exchange(true)) {
+        _wakeup.notify_one();
+    }
+}
+
+void async_logger::append(dsn_log_level_t log_level, uint64_t ts, const char *msg, size_t len)
+{
+    async_log_buffer *buffer =
+        (log_level >= LOG_LEVEL_FATAL) ? nullptr : current_thread_buffer();
+    if (buffer == nullptr) {
+        // write synchronously if the process is going to exit, or the thread is exiting
+        utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
+        drain();
+        write_record(log_level, msg, len);
+        ::fflush(_log);
+        ::fflush(stdout);
+        return;
+    }
+
+    // a single record can't take up too much of the buffer, and a truncated one still ends
+    // with its newline, so that it doesn't run into the next record
+    std::string truncated;
+    if (len > buffer->capacity / 4) {
+        truncated.assign(msg, buffer->capacity / 4 - 1);
+        truncated.push_back('\n');
+        msg = truncated.data();
+        len = truncated.size();
+    }
+
+    size_t used = buffer->size();
+    bool overloaded = used >= buffer->capacity / 2;
+    if (overloaded && log_level < LOG_LEVEL_WARNING &&
+        buffer->sampled++ % std::max(FLAGS_sample_ratio_on_overload, 1U) != 0) {
+        ++_dropped;
+        ++s_dropped_records;
+    } else if (!buffer->push(log_level, ts, msg, len)) {
+        ++_dropped;
+        ++s_dropped_records;
+    }
+
+    if (log_level >= LOG_LEVEL_ERROR || used >= buffer->capacity / 4) {
+        wakeup_drainer();
+    }
+}
+
+void async_logger::drain()
+{
+    std::vector<std::shared_ptr<async_log_buffer>> buffers;
+    {
+        std::lock_guard<std::mutex> l(_buffers_lock);
+        // the orphaned buffers never get new records
+        _buffers.erase(std::remove_if(_buffers.begin(),
+                                      _buffers.end(),
+                                      [](const std::shared_ptr<async_log_buffer> &b) {
+                                          return b->orphaned && b->size() == 0;
+                                      }),
+                       _buffers.end());
+        buffers = _buffers;
+    }
+
+    struct entry
+    {
+        uint64_t ts;
+        dsn_log_level_t level;
+        size_t offset;
+        size_t len;
+    };
+    std::vector<entry> entries;
+    std::string staging;
+    for (auto &b : buffers) {
+        b->pop_all([&](const log_record &r, const char *msg) {
+            entries.push_back(
+                {r.ts, static_cast<dsn_log_level_t>(r.level), staging.size(), r.len});
+            staging.append(msg, r.len);
+        });
+    }
+    if (entries.empty() && _reported_dropped == _dropped.load()) {
+        return;
+    }
+
+    // the records of different threads are only ordered within a drain
+    std::stable_sort(entries.begin(), entries.end(), [](const entry &l, const entry &r) {
+        return l.ts < r.ts;
+    });
+    for (const entry &e : entries) {
+        write_record(e.level, staging.data() + e.offset, e.len);
+    }
+
+    uint64_t dropped = _dropped.load();
+    if (dropped != _reported_dropped) {
+        std::string msg = "W async_logger dropped " +
+                          std::to_string(dropped - _reported_dropped) +
+                          " records because of overload\n";
+        write_record(LOG_LEVEL_WARNING, msg.data(), msg.size());
+        _reported_dropped = dropped;
+    }
+    ::fflush(_log);
+}
+
+void async_logger::write_record(dsn_log_level_t log_level, const char *msg, size_t len)
+{
+    ::fwrite(msg, 1, len, _log);
+    if (log_level >= _stderr_start_level) {
+        ::fwrite(msg, 1, len, stdout);
+    }
+    if (++_lines >= 200000) {
+        create_log_file();
+    }
+}
+
+// formats the header into `buf` like print_header() of simple_logger, returns its length
+static size_t format_header(char *buf,
+                            size_t size,
+                            uint64_t ts,
+                            const char *file,
+                            const char *function,
+                            const int line,
+                            dsn_log_level_t log_level)
+{
+    static char s_level_char[] = "IDWEF";
+    static thread_local std::string time_str;
+    dsn::utils::time_ms_to_string(ts / 1000000, time_str);
+
+    int n = snprintf(buf,
+                     size,
+                     "%c%s (%" PRIu64 " %d) %s",
+                     s_level_char[log_level],
+                     time_str.c_str(),
+                     ts,
+                     dsn::utils::get_current_tid(),
+                     log_prefixed_message_func().c_str());
+    size_t len = std::min(static_cast<size_t>(std::max(n, 0)), size - 1);
+    if (!FLAGS_short_header) {
+        n = snprintf(buf + len, size - len, "%s:%d:%s(): ", file, line, function);
+        len = std::min(len + std::max(n, 0), size - 1);
+    }
+    return len;
+}
+
+void async_logger::dsn_logv(const char *file,
+                            const char *function,
+                            const int line,
+                            dsn_log_level_t log_level,
+                            const char *fmt,
+                            va_list args)
+{
+    static const size_t kBufferSize = 4096;
+    static thread_local char buf[kBufferSize];
+
+    uint64_t ts = dsn_now_ns();
+    size_t len = format_header(buf, kBufferSize, ts, file, function, line, log_level);
+
+    va_list args2;
+    va_copy(args2, args);
+    int n = vsnprintf(buf + len, kBufferSize - len, fmt, args);
+    if (n < 0) {
+        n = 0;
+    }
+    if (len + n + 1 < kBufferSize) {
+        buf[len + n] = '\n';
+        append(log_level, ts, buf, len + n + 1);
+    } else {
+        // too long for the buffer
+        std::string msg(buf, len);
+        msg.resize(len + n + 1);
+        vsnprintf(&msg[len], n + 1, fmt, args2);
+        msg[len + n] = '\n';
+        append(log_level, ts, msg.data(), msg.size());
+    }
+    va_end(args2);
+}
+
+void async_logger::dsn_log(const char *file,
+                           const char *function,
+                           const int line,
+                           dsn_log_level_t log_level,
+                           const char *str)
+{
+    static const size_t kBufferSize = 512;
+    char header[kBufferSize];
+
+    uint64_t ts = dsn_now_ns();
+    size_t len = format_header(header, kBufferSize, ts, file, function, line, log_level);
+    std::string msg(header, len);
+    msg.append(str);
+    msg.push_back('\n');
+    append(log_level, ts, msg.data(), msg.size());
+}
+
+void async_logger::flush()
+{
+    utils::auto_lock<::dsn::utils::ex_lock> l(_lock);
+    drain();
+    ::fflush(_log);
+    ::fflush(stdout);
+}
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simple_logger.h"
+
+namespace dsn {
+namespace tools {
+
+struct async_log_buffer;
+
+/*
+ * async_logger writes to the same files as simple_logger, but the logging threads never
+ * wait for each other or for the file.
+ *
+ * Each logging thread formats its records and puts them into its own lock-free ring buffer,
+ * and a background thread drains all the buffers periodically, then writes the records
+ * (sorted by time within each drain) to the file in a batch. The records of levels below
+ * LOG_LEVEL_WARNING are sampled once a buffer is half full, and any record is dropped if its
+ * buffer is full; the count of dropped records is reported by dropped_records().
+ *
+ * The LOG_LEVEL_FATAL records are written synchronously, since the process is going to exit.
+ */
+class async_logger : public simple_logger
+{
+public:
+    async_logger(const char *log_dir);
+    ~async_logger() override;
+
+    void dsn_logv(const char *file,
+                  const char *function,
+                  const int line,
+                  dsn_log_level_t log_level,
+                  const char *fmt,
+                  va_list args) override;
+
+    void dsn_log(const char *file,
+                 const char *function,
+                 const int line,
+                 dsn_log_level_t log_level,
+                 const char *str) override;
+
+    // drains all the buffers and flushes the file
+    void flush() override;
+
+    // count of the records dropped by all the async loggers
+    static uint64_t dropped_records() { return s_dropped_records.load(); }
+
+private:
+    // puts the formatted `msg` into the buffer of the current thread
+    void append(dsn_log_level_t log_level, uint64_t ts, const char *msg, size_t len);
+
+    // returns nullptr if the current thread is exiting
+    async_log_buffer *current_thread_buffer();
+
+    void wakeup_drainer();
+
+    // drains all the buffers and writes the records to the file, must be called under `_lock`
+    void drain();
+
+    void write_record(dsn_log_level_t log_level, const char *msg, size_t len);
+
+private:
+    static std::atomic<uint64_t> s_dropped_records;
+
+    const uint64_t _id;
+
+    std::mutex _buffers_lock;
+    std::vector<std::shared_ptr<async_log_buffer>> _buffers;
+
+    std::atomic<uint64_t> _dropped;
+    uint64_t _reported_dropped; // protected by `_lock`
+
+    std::mutex _wakeup_lock;
+    std::condition_variable _wakeup;
+    std::atomic<bool> _wakeup_requested;
+    bool _stopped;
+    std::thread _drainer;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -0,0 +1,313 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "block_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace utils {
+
+DSN_DEFINE_bool("core",
+                enable_block_pool,
+                true,
+                "whether to allocate the memory of rpc messages from the block pool");
+DSN_DEFINE_uint64("core",
+                  block_pool_thread_cache_bytes,
+                  1024 * 1024,
+                  "the max bytes of free blocks cached by each thread for each size class");
+DSN_DEFINE_uint64("core",
+                  block_pool_central_cache_bytes,
+                  8 * 1024 * 1024,
+                  "the max bytes of free blocks cached by all threads for each size class");
+
+namespace {
+
+// 64B, 128B, ..., 64KB
+const int kClassCount = 11;
+// the max count of blocks moved between a thread cache and the central cache at a time
+const size_t kMaxBatchCount = 32;
+
+int size_class(size_t size)
+{
+    if (size <= block_pool::kMinBlockSize) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(size - 1) - 6;
+}
+
+size_t class_size(int c) { return block_pool::kMinBlockSize << c; }
+
+struct free_block
+{
+    free_block *next;
+};
+
+struct free_list
+{
+    free_block *head = nullptr;
+    size_t count = 0;
+
+    void push(void *p)
+    {
+        auto *b = static_cast<free_block *>(p);
+        b->next = head;
+        head = b;
+        ++count;
+    }
+
+    void *pop()
+    {
+        free_block *b = head;
+        head = b->next;
+        --count;
+        return b;
+    }
+};
+
+class thread_cache;
+
+// never destroyed, because blocks may be freed during the destruction of static objects
+class central_cache
+{
+public:
+    static central_cache &instance()
+    {
+        static central_cache *s_instance = new central_cache();
+        return *s_instance;
+    }
+
+    // move at most `count` blocks of class `c` into `to`
+    size_t fetch(int c, free_list &to, size_t count)
+    {
+        std::lock_guard<std::mutex> l(_locks[c]);
+        size_t n = std::min(count, _lists[c].count);
+        for (size_t i = 0; i < n; ++i) {
+            to.push(_lists[c].pop());
+        }
+        _bytes[c].fetch_sub(n * class_size(c), std::memory_order_relaxed);
+        return n;
+    }
+
+    // move `count` blocks of class `c` from `from`, or free them if the central cache is full
+    void release(int c, free_list &from, size_t count)
+    {
+        size_t cap = FLAGS_block_pool_central_cache_bytes / class_size(c);
+        std::lock_guard<std::mutex> l(_locks[c]);
+        for (size_t i = 0; i < count; ++i) {
+            void *p = from.pop();
+            if (_lists[c].count < cap) {
+                _lists[c].push(p);
+                _bytes[c].fetch_add(class_size(c), std::memory_order_relaxed);
+            } else {
+                ::operator delete(p);
+            }
+        }
+    }
+
+    void register_cache(thread_cache *tc)
+    {
+        std::lock_guard<std::mutex> l(_caches_lock);
+        _caches.insert(tc);
+    }
+
+    void unregister_cache(thread_cache *tc, uint64_t hit_count, uint64_t miss_count)
+    {
+        std::lock_guard<std::mutex> l(_caches_lock);
+        _caches.erase(tc);
+        _retired_hit_count += hit_count;
+        _retired_miss_count += miss_count;
+    }
+
+    block_pool::stats get_stats();
+
+private:
+    central_cache()
+    {
+        for (auto &b : _bytes) {
+            b.store(0);
+        }
+    }
+
+    std::mutex _locks[kClassCount];
+    free_list _lists[kClassCount];
+    std::atomic<uint64_t> _bytes[kClassCount];
+
+    std::mutex _caches_lock;
+    std::unordered_set<thread_cache *> _caches;
+    uint64_t _retired_hit_count = 0;
+    uint64_t _retired_miss_count = 0;
+};
+
+class thread_cache
+{
+public:
+    thread_cache() : _hit_count(0), _miss_count(0), _bytes(0)
+    {
+        central_cache::instance().register_cache(this);
+    }
+
+    ~thread_cache()
+    {
+        for (int c = 0; c < kClassCount; ++c) {
+            central_cache::instance().release(c, _lists[c], _lists[c].count);
+        }
+        central_cache::instance().unregister_cache(
+            this, _hit_count.load(), _miss_count.load());
+    }
+
+    void *allocate(int c)
+    {
+        free_list &list = _lists[c];
+        if (list.count == 0) {
+            central_cache::instance().fetch(c, list, batch_count(c));
+            _bytes.fetch_add(list.count * class_size(c), std::memory_order_relaxed);
+        }
+        if (list.count == 0) {
+            _miss_count.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(class_size(c));
+        }
+        _hit_count.fetch_add(1, std::memory_order_relaxed);
+        _bytes.fetch_sub(class_size(c), std::memory_order_relaxed);
+        return list.pop();
+    }
+
+    void deallocate(void *p, int c)
+    {
+        free_list &list = _lists[c];
+        list.push(p);
+        _bytes.fetch_add(class_size(c), std::memory_order_relaxed);
+        if (list.count * class_size(c) > FLAGS_block_pool_thread_cache_bytes) {
+            // keep the other half for the following allocations
+            size_t n = std::max<size_t>(1, list.count / 2);
+            central_cache::instance().release(c, list, n);
+            _bytes.fetch_sub(n * class_size(c), std::memory_order_relaxed);
+        }
+    }
+
+    // read by other threads
+    std::atomic<uint64_t> _hit_count;
+    std::atomic<uint64_t> _miss_count;
+    std::atomic<uint64_t> _bytes;
+
+private:
+    static size_t batch_count(int c)
+    {
+        size_t n = FLAGS_block_pool_thread_cache_bytes / class_size(c) / 2;
+        return std::max<size_t>(1, std::min(n, kMaxBatchCount));
+    }
+
+    free_list _lists[kClassCount];
+};
+
+block_pool::stats central_cache::get_stats()
+{
+    block_pool::stats s;
+    s.retained_bytes = 0;
+    for (auto &b : _bytes) {
+        s.retained_bytes += b.load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> l(_caches_lock);
+    s.hit_count = _retired_hit_count;
+    s.miss_count = _retired_miss_count;
+    for (thread_cache *tc : _caches) {
+        s.hit_count += tc->_hit_count.load(std::memory_order_relaxed);
+        s.miss_count += tc->_miss_count.load(std::memory_order_relaxed);
+        s.retained_bytes += tc->_bytes.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+// the thread cache may be accessed during the destruction of other thread local objects,
+// so it's referenced by a trivial pointer, which is reset when the cache is destroyed
+thread_local thread_cache *tls_cache = nullptr;
+thread_local bool tls_cache_destroyed = false;
+
+struct thread_cache_holder
+{
+    ~thread_cache_holder()
+    {
+        tls_cache_destroyed = true;
+        delete tls_cache;
+        tls_cache = nullptr;
+    }
+};
+
+thread_cache *local_cache()
+{
+    if (tls_cache == nullptr && !tls_cache_destroyed) {
+        thread_local thread_cache_holder holder;
+        tls_cache = new thread_cache();
+    }
+    return tls_cache;
+}
+
+struct block_deleter
+{
+    size_t size;
+    void operator()(char *p) const { block_pool::deallocate(p, size); }
+};
+
+} // anonymous namespace
+
+/*static*/ void *block_pool::allocate(size_t size)
+{
+    int c = size_class(size);
+    if (c >= kClassCount) {
+        return ::operator new(size);
+    }
+
+    thread_cache *tc = FLAGS_enable_block_pool ? local_cache() : nullptr;
+    if (tc == nullptr) {
+        // the memory is always allocated in the size of the class, so that it can be cached
+        // by the pool when it's freed, even if the pool is disabled meanwhile
+        return ::operator new(class_size(c));
+    }
+    return tc->allocate(c);
+}
+
+/*static*/ void block_pool::deallocate(void *p, size_t size)
+{
+    int c = size_class(size);
+    thread_cache *tc = FLAGS_enable_block_pool ? local_cache() : nullptr;
+    if (c >= kClassCount || tc == nullptr) {
+        ::operator delete(p);
+        return;
+    }
+    tc->deallocate(p, c);
+}
+
+/*static*/ std::shared_ptr<char> block_pool::make_shared_block(size_t size)
+{
+    return std::shared_ptr<char>(static_cast<char *>(allocate(size)),
+                                 block_deleter{size},
+                                 block_pool_allocator<char>());
+}
+
+/*static*/ block_pool::stats block_pool::get_stats()
+{
+    return central_cache::instance().get_stats();
+}
+
+} // namespace utils
+} // namespace dsn
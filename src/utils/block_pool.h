@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dsn {
+namespace utils {
+
+// block_pool is a thread-caching allocator for the memory blocks that are allocated and freed
+// at a high rate, such as rpc messages, their headers and their buffers.
+//
+// Requested sizes are rounded up to power-of-two size classes from `kMinBlockSize` to
+// `kMaxBlockSize` (the default message_buffer_block_size), larger blocks are allocated from
+// the system directly. Each thread caches the freed blocks of every size class, and exchanges
+// its surplus or shortage with a central cache in batches. A block may be freed on any thread,
+// it's simply cached by the freeing thread.
+//
+// The pool can be disabled by [core] enable_block_pool, then every block is allocated from
+// the system.
+class block_pool
+{
+public:
+    static const size_t kMinBlockSize = 64;
+    static const size_t kMaxBlockSize = 64 * 1024;
+
+    static void *allocate(size_t size);
+    // `size` must be the same as the one passed to `allocate`
+    static void deallocate(void *p, size_t size);
+
+    // Returns a block of `size` bytes. Both the block and the control block of the returned
+    // shared_ptr are allocated from the pool.
+    static std::shared_ptr<char> make_shared_block(size_t size);
+
+    struct stats
+    {
+        // allocations served by the thread caches or the central cache
+        uint64_t hit_count;
+        // allocations served by the system
+        uint64_t miss_count;
+        // bytes of free blocks cached by the pool
+        uint64_t retained_bytes;
+    };
+    static stats get_stats();
+};
+
+// std allocator on top of block_pool, e.g. for the control blocks of shared_ptr
+template <typename T>
+class block_pool_allocator
+{
+public:
+    typedef T value_type;
+
+    block_pool_allocator() = default;
+    template <typename U>
+    block_pool_allocator(const block_pool_allocator<U> &)
+    {
+    }
+
+    T *allocate(size_t n) { return static_cast<T *>(block_pool::allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t n) { block_pool::deallocate(p, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const block_pool_allocator<T> &, const block_pool_allocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const block_pool_allocator<T> &, const block_pool_allocator<U> &)
+{
+    return false;
+}
+
+} // namespace utils
+} // namespace dsn
@@ -1,6 +1,14 @@
 #include <cstdio>
+#include <cstring>
 #include <dsn/utility/crc.h>
 
+#include "crc_impl.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define DSN_CRC_HAS_SSE42 1
+#endif
+
 namespace dsn {
 namespace utils {
 
@@ -13,6 +21,9 @@ struct crc_generator
     static uintxx_t _crc_table[256];
     static uintxx_t _uX2N[64];
 
+    // _slice8_table[k][i] is the CRC of byte i followed by k zero bytes
+    static uintxx_t _slice8_table[8][256];
+
     //
     // compute CRC
     //
@@ -59,6 +70,35 @@ struct crc_generator
         return (uCrc);
     };
 
+    //
+    // compute CRC by slice-by-8, 8 bytes per iteration
+    //
+    static uintxx_t compute_slice8(const void *pSrc, size_t uSize, uintxx_t uCrc)
+    {
+        const uint8_t *pData = (const uint8_t *)pSrc;
+
+        uCrc = ~uCrc;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (; uSize > 7; uSize -= 8, pData += 8) {
+            uint64_t v;
+            memcpy(&v, pData, sizeof(v));
+            v ^= uCrc;
+            uCrc = _slice8_table[7][(uint8_t)v] ^ _slice8_table[6][(uint8_t)(v >> 8)] ^
+                   _slice8_table[5][(uint8_t)(v >> 16)] ^ _slice8_table[4][(uint8_t)(v >> 24)] ^
+                   _slice8_table[3][(uint8_t)(v >> 32)] ^ _slice8_table[2][(uint8_t)(v >> 40)] ^
+                   _slice8_table[1][(uint8_t)(v >> 48)] ^ _slice8_table[0][(uint8_t)(v >> 56)];
+        }
+#endif
+
+        for (; uSize > 0; uSize -= 1, pData += 1)
+            uCrc = _crc_table[(uint8_t)(uCrc ^ pData[0])] ^ (uCrc >> 8);
+
+        uCrc = ~uCrc;
+
+        return (uCrc);
+    };
+
     //
     // Returns (a * b) mod POLY.
     // "a" and "b" are represented in "reversed" order -- LSB is x**(XX-1) coefficient, MSB is x^0
@@ -222,6 +262,19 @@ struct crc_generator
         }
     }
 
+    static void InitializeSlice8Tables(void)
+    {
+        for (size_t i = 0; i < 256; ++i) {
+            _slice8_table[0][i] = _crc_table[i];
+        }
+        for (size_t k = 1; k < 8; ++k) {
+            for (size_t i = 0; i < 256; ++i) {
+                uintxx_t prev = _slice8_table[k - 1][i];
+                _slice8_table[k][i] = (prev >> 8) ^ _crc_table[(uint8_t)prev];
+            }
+        }
+    }
+
     static void PrintTables(char *pTypeName, char *pClassName)
     {
         size_t i, w;
@@ -260,6 +313,9 @@ struct crc_generator
     };
 };
 
+template <typename uintxx_t, uintxx_t uPoly>
+uintxx_t crc_generator<uintxx_t, uPoly>::_slice8_table[8][256];
+
 #define BIT64(n) (1ull << (63 - (n)))
 #define crc64_POLY                                                                                 \
     (BIT64(63) + BIT64(61) + BIT64(59) + BIT64(58) + BIT64(56) + BIT64(55) + BIT64(52) +           \
@@ -418,9 +474,160 @@ uint64_t crc64::_crc_table[sizeof(crc64::_crc_table) / sizeof(crc64::_crc_table[
 
 namespace dsn {
 namespace utils {
+namespace crc_impl {
+
+#ifdef DSN_CRC_HAS_SSE42
+
+// The crc32 instruction has a latency of 3 cycles but a throughput of 1 per cycle, so
+// large buffers are split into 3 lanes computed in parallel, and then the lanes are
+// combined by shifting the CRC of the former lanes over the length of the latter ones.
+static const size_t kSse42LaneBytes = 1024;
+
+// Shifting a CRC state by a fixed number of zero bytes is linear, so it's done by 4
+// table lookups, one for each byte of the state.
+struct crc32_shift_table
+{
+    uint32_t table[4][256];
+
+    explicit crc32_shift_table(uint64_t bytes)
+    {
+        uint32_t x_n = crc32::ComputeX_N(bytes);
+        for (int k = 0; k < 4; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                table[k][i] = crc32::MulPoly(x_n, i << (8 * k));
+            }
+        }
+    }
+
+    uint32_t shift(uint32_t crc) const
+    {
+        return table[0][(uint8_t)crc] ^ table[1][(uint8_t)(crc >> 8)] ^
+               table[2][(uint8_t)(crc >> 16)] ^ table[3][crc >> 24];
+    }
+};
+
+static const crc32_shift_table &shift_one_lane()
+{
+    static crc32_shift_table t(kSse42LaneBytes);
+    return t;
+}
+
+static const crc32_shift_table &shift_two_lanes()
+{
+    static crc32_shift_table t(2 * kSse42LaneBytes);
+    return t;
+}
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32_sse42_raw(uint32_t crc, const uint8_t *p, size_t size)
+{
+    for (; size > 0 && ((uintptr_t)p & 7) != 0; --size, ++p) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    for (; size > 7; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = (uint32_t)_mm_crc32_u64(crc, v);
+    }
+    for (; size > 0; --size, ++p) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2"))) uint32_t
+crc32_sse42(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    uint32_t crc = ~init_crc;
+
+    if (size >= 3 * kSse42LaneBytes) {
+        const crc32_shift_table &shift1 = shift_one_lane();
+        const crc32_shift_table &shift2 = shift_two_lanes();
+        do {
+            uint64_t a = crc, b = 0, c = 0;
+            for (size_t i = 0; i < kSse42LaneBytes; i += 8) {
+                uint64_t va, vb, vc;
+                memcpy(&va, p + i, sizeof(va));
+                memcpy(&vb, p + kSse42LaneBytes + i, sizeof(vb));
+                memcpy(&vc, p + 2 * kSse42LaneBytes + i, sizeof(vc));
+                a = _mm_crc32_u64(a, va);
+                b = _mm_crc32_u64(b, vb);
+                c = _mm_crc32_u64(c, vc);
+            }
+            crc = shift2.shift((uint32_t)a) ^ shift1.shift((uint32_t)b) ^ (uint32_t)c;
+            p += 3 * kSse42LaneBytes;
+            size -= 3 * kSse42LaneBytes;
+        } while (size >= 3 * kSse42LaneBytes);
+    }
+
+    return ~crc32_sse42_raw(crc, p, size);
+}
+
+bool crc32_sse42_supported() { return __builtin_cpu_supports("sse4.2"); }
+
+#else
+
+uint32_t crc32_sse42(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return crc32_slice8(ptr, size, init_crc);
+}
+
+bool crc32_sse42_supported() { return false; }
+
+#endif // DSN_CRC_HAS_SSE42
+
+static const struct crc_dispatcher &dispatcher();
+
+uint32_t crc32_bytewise(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return crc32::compute(ptr, size, init_crc);
+}
+
+uint32_t crc32_slice8(const void *ptr, size_t size, uint32_t init_crc)
+{
+    dispatcher(); // make sure the tables are initialized
+    return crc32::compute_slice8(ptr, size, init_crc);
+}
+
+uint64_t crc64_bytewise(const void *ptr, size_t size, uint64_t init_crc)
+{
+    return crc64::compute(ptr, size, init_crc);
+}
+
+uint64_t crc64_slice8(const void *ptr, size_t size, uint64_t init_crc)
+{
+    dispatcher(); // make sure the tables are initialized
+    return crc64::compute_slice8(ptr, size, init_crc);
+}
+
+// choose the fastest implementations supported by the cpu
+struct crc_dispatcher
+{
+    uint32_t (*crc32_func)(const void *, size_t, uint32_t);
+    uint64_t (*crc64_func)(const void *, size_t, uint64_t);
+
+    crc_dispatcher()
+    {
+        crc32::InitializeSlice8Tables();
+        crc64::InitializeSlice8Tables();
+
+        crc32_func = crc32_sse42_supported() ? crc32_sse42 : crc32_slice8;
+        crc64_func = crc64_slice8;
+    }
+};
+
+static const crc_dispatcher &dispatcher()
+{
+    static crc_dispatcher d;
+    return d;
+}
+
+} // namespace crc_impl
+
 uint32_t crc32_calc(const void *ptr, size_t size, uint32_t init_crc)
 {
-    return dsn::utils::crc32::compute(ptr, size, init_crc);
+    return crc_impl::dispatcher().crc32_func(ptr, size, init_crc);
 }
 
 uint32_t crc32_concat(uint32_t xy_init,
@@ -437,7 +644,7 @@ uint32_t crc32_concat(uint32_t xy_init,
 
 uint64_t crc64_calc(const void *ptr, size_t size, uint64_t init_crc)
 {
-    return dsn::utils::crc64::compute(ptr, size, init_crc);
+    return crc_impl::dispatcher().crc64_func(ptr, size, init_crc);
 }
 
 uint64_t crc64_concat(uint32_t xy_init,
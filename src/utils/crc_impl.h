@@ -0,0 +1,43 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dsn {
+namespace utils {
+
+// The implementations behind crc32_calc/crc64_calc, which choose the fastest one
+// supported by the cpu at runtime. All of them produce identical results.
+// Exposed only for tests and benchmarks.
+namespace crc_impl {
+
+uint32_t crc32_bytewise(const void *ptr, size_t size, uint32_t init_crc);
+uint32_t crc32_slice8(const void *ptr, size_t size, uint32_t init_crc);
+
+// Uses the SSE4.2 crc32 instruction, only valid if crc32_sse42_supported() is true.
+uint32_t crc32_sse42(const void *ptr, size_t size, uint32_t init_crc);
+bool crc32_sse42_supported();
+
+uint64_t crc64_bytewise(const void *ptr, size_t size, uint64_t init_crc);
+uint64_t crc64_slice8(const void *ptr, size_t size, uint64_t init_crc);
+
+} // namespace crc_impl
+} // namespace utils
+} // namespace dsn
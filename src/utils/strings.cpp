@@ -218,5 +218,23 @@ std::string string_md5(const char *buffer, unsigned length)
 
     return result;
 }
+
+md5_digester::md5_digester() : _ctx(new MD5_CTX()) { MD5_Init(_ctx.get()); }
+
+md5_digester::~md5_digester() = default;
+
+void md5_digester::update(const char *data, size_t length) { MD5_Update(_ctx.get(), data, length); }
+
+std::string md5_digester::finalize()
+{
+    unsigned char out[MD5_DIGEST_LENGTH];
+    MD5_Final(out, _ctx.get());
+
+    char str[MD5_DIGEST_LENGTH * 2 + 1];
+    str[MD5_DIGEST_LENGTH * 2] = 0;
+    for (int n = 0; n < MD5_DIGEST_LENGTH; n++)
+        sprintf(str + n + n, "%02x", out[n]);
+    return std::string(str);
+}
 } // namespace utils
 } // namespace dsn
@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "utils/block_pool.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <dsn/utility/flags.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace utils {
+
+DSN_DECLARE_bool(enable_block_pool);
+
+TEST(block_pool_test, reuse_freed_block)
+{
+    PRESERVE_FLAG(enable_block_pool);
+    FLAGS_enable_block_pool = true;
+    void *p = block_pool::allocate(100);
+    block_pool::deallocate(p, 100);
+
+    // the block is cached by this thread, and reused by the same size class
+    block_pool::stats before = block_pool::get_stats();
+    void *q = block_pool::allocate(128);
+    ASSERT_EQ(p, q);
+    block_pool::stats after = block_pool::get_stats();
+    ASSERT_EQ(before.hit_count + 1, after.hit_count);
+    ASSERT_EQ(before.miss_count, after.miss_count);
+    ASSERT_EQ(before.retained_bytes - 128, after.retained_bytes);
+    block_pool::deallocate(q, 128);
+
+    // large blocks are not pooled
+    p = block_pool::allocate(block_pool::kMaxBlockSize + 1);
+    block_pool::deallocate(p, block_pool::kMaxBlockSize + 1);
+    ASSERT_EQ(block_pool::get_stats().retained_bytes, after.retained_bytes + 128);
+}
+
+TEST(block_pool_test, free_on_other_thread)
+{
+    PRESERVE_FLAG(enable_block_pool);
+    FLAGS_enable_block_pool = true;
+    const int kBlockCount = 10000;
+    std::vector<std::shared_ptr<char>> blocks;
+    for (int i = 0; i < kBlockCount; ++i) {
+        size_t size = 1 + (i * 7919) % (2 * block_pool::kMaxBlockSize);
+        blocks.emplace_back(block_pool::make_shared_block(size));
+        memset(blocks.back().get(), i, std::min<size_t>(size, 64));
+    }
+
+    std::thread t([&blocks]() { blocks.clear(); });
+    t.join();
+    ASSERT_TRUE(blocks.empty());
+
+    // the blocks cached by the exited thread are handed over to the central cache
+    block_pool::stats before = block_pool::get_stats();
+    ASSERT_GT(before.retained_bytes, 0u);
+    auto b = block_pool::make_shared_block(block_pool::kMaxBlockSize);
+    block_pool::stats after = block_pool::get_stats();
+    ASSERT_EQ(before.miss_count, after.miss_count);
+}
+
+TEST(block_pool_test, disabled)
+{
+    PRESERVE_FLAG(enable_block_pool);
+    FLAGS_enable_block_pool = false;
+    block_pool::stats before = block_pool::get_stats();
+    auto b = block_pool::make_shared_block(100);
+    b = nullptr;
+    block_pool::stats after = block_pool::get_stats();
+    ASSERT_EQ(before.hit_count, after.hit_count);
+    ASSERT_EQ(before.miss_count, after.miss_count);
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,132 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "utils/crc_impl.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dsn/utility/crc.h>
+#include <dsn/utility/rand.h>
+#include <gtest/gtest.h>
+
+namespace dsn {
+namespace utils {
+
+TEST(crc_test, known_value)
+{
+    // the check value of CRC-32C
+    ASSERT_EQ(0xe3069283, crc32_calc("123456789", 9, 0));
+}
+
+TEST(crc_test, implementations_identical)
+{
+    std::string data(3 * 1024 * 1024 + 17, '\0');
+    for (auto &c : data) {
+        c = static_cast<char>(rand::next_u32(0, 255));
+    }
+
+    for (size_t size : {0, 1, 7, 8, 15, 64, 1000, 3071, 3072, 3073, 4096, 12345, 1 << 20}) {
+        for (size_t offset : {0, 1, 5}) {
+            for (uint32_t init : {0u, 0xdeadbeefu}) {
+                const char *ptr = data.data() + offset;
+                uint32_t expected32 = crc_impl::crc32_bytewise(ptr, size, init);
+                ASSERT_EQ(expected32, crc_impl::crc32_slice8(ptr, size, init));
+                if (crc_impl::crc32_sse42_supported()) {
+                    ASSERT_EQ(expected32, crc_impl::crc32_sse42(ptr, size, init));
+                }
+                ASSERT_EQ(expected32, crc32_calc(ptr, size, init));
+
+                uint64_t expected64 = crc_impl::crc64_bytewise(ptr, size, init);
+                ASSERT_EQ(expected64, crc_impl::crc64_slice8(ptr, size, init));
+                ASSERT_EQ(expected64, crc64_calc(ptr, size, init));
+            }
+        }
+    }
+}
+
+// The slice-by-8 and the SSE4.2 implementations process the buffers in large blocks, whose
+// boundaries are not aligned with the ones of the concatenated parts.
+TEST(crc_test, concat)
+{
+    std::string data(1 << 20, '\0');
+    for (auto &c : data) {
+        c = static_cast<char>(rand::next_u32(0, 255));
+    }
+
+    for (size_t x_size : {0, 1, 7, 3072, 3073, 12345}) {
+        size_t y_size = data.size() - x_size;
+        const char *x = data.data();
+        const char *y = data.data() + x_size;
+
+        uint32_t xy32 = crc32_calc(x, data.size(), 0);
+        ASSERT_EQ(xy32, crc32_calc(y, y_size, crc32_calc(x, x_size, 0)));
+        ASSERT_EQ(xy32,
+                  crc32_concat(
+                      0, 0, crc32_calc(x, x_size, 0), x_size, 0, crc32_calc(y, y_size, 0), y_size));
+
+        uint64_t xy64 = crc64_calc(x, data.size(), 0);
+        ASSERT_EQ(xy64, crc64_calc(y, y_size, crc64_calc(x, x_size, 0)));
+        ASSERT_EQ(xy64,
+                  crc64_concat(
+                      0, 0, crc64_calc(x, x_size, 0), x_size, 0, crc64_calc(y, y_size, 0), y_size));
+    }
+}
+
+// Measures the throughput of each implementation for buffer sizes from 64B to 4MB, run it with
+// --gtest_also_run_disabled_tests.
+TEST(crc_test, DISABLED_throughput)
+{
+    const size_t max_size = 4 * 1024 * 1024;
+    const size_t bytes_per_case = 32 * 1024 * 1024;
+    std::string data(max_size, 'x');
+
+    struct impl
+    {
+        std::string name;
+        std::function<void(const char *, size_t)> calc;
+    };
+    std::vector<impl> impls = {
+        {"crc32_bytewise",
+         [](const char *p, size_t n) { crc_impl::crc32_bytewise(p, n, 0); }},
+        {"crc32_slice8", [](const char *p, size_t n) { crc_impl::crc32_slice8(p, n, 0); }},
+        {"crc64_bytewise",
+         [](const char *p, size_t n) { crc_impl::crc64_bytewise(p, n, 0); }},
+        {"crc64_slice8", [](const char *p, size_t n) { crc_impl::crc64_slice8(p, n, 0); }}};
+    if (crc_impl::crc32_sse42_supported()) {
+        impls.push_back(
+            {"crc32_sse42", [](const char *p, size_t n) { crc_impl::crc32_sse42(p, n, 0); }});
+    }
+
+    for (const auto &i : impls) {
+        for (size_t size = 64; size <= max_size; size *= 4) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t done = 0; done < bytes_per_case; done += size) {
+                i.calc(data.data(), size);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << i.name << ", size = " << size
+                      << ", GB/s = " << bytes_per_case / elapsed.count() / 1e9 << std::endl;
+        }
+    }
+}
+
+} // namespace utils
+} // namespace dsn
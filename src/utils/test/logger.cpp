@@ -33,13 +33,23 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include "utils/async_logger.h"
 #include "utils/simple_logger.h"
 #include <gtest/gtest.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
+#include <fstream>
+#include <thread>
 
 using namespace dsn;
 using namespace dsn::tools;
 
+namespace dsn {
+namespace tools {
+DSN_DECLARE_uint32(buffer_size_kb_per_thread);
+} // namespace tools
+} // namespace dsn
+
 static const int simple_logger_gc_gap = 20;
 
 static void get_log_file_index(std::vector<int> &log_index)
@@ -125,3 +135,107 @@ TEST(tools_common, simple_logger)
     clear_files(index);
     finish_test_dir();
 }
+
+static void read_log_lines(const std::vector<int> &log_index, std::vector<std::string> &lines)
+{
+    for (auto i : log_index) {
+        std::ifstream in("log." + std::to_string(i) + ".txt");
+        std::string line;
+        while (std::getline(in, line)) {
+            lines.push_back(line);
+        }
+    }
+}
+
+TEST(tools_common, async_logger)
+{
+    prepare_test_dir();
+
+    // never drops if flushed in time, and rotates at the same line count as simple_logger
+    async_logger *logger = new async_logger("./");
+    for (int i = 0; i < 210000; ++i) {
+        log_print(logger, "%d", i);
+        if (i % 1000 == 999) {
+            logger->flush();
+        }
+    }
+    delete logger;
+
+    std::vector<int> index;
+    get_log_file_index(index);
+    sort(index.begin(), index.end());
+    ASSERT_EQ(2, index.size());
+    std::vector<std::string> lines;
+    read_log_lines(index, lines);
+    ASSERT_EQ(210000, lines.size());
+    for (int i = 0; i < 210000; ++i) {
+        ASSERT_EQ(" " + std::to_string(i), lines[i].substr(lines[i].rfind(' ')));
+    }
+    clear_files(index);
+
+    // every record of the concurrent threads is either written in order or counted as dropped
+    const int kThreads = 4;
+    const int kRecordsPerThread = 20000;
+    uint64_t dropped = async_logger::dropped_records();
+    logger = new async_logger("./");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([logger, t]() {
+            for (int i = 0; i < kRecordsPerThread; ++i) {
+                log_print(logger, "thread %d record %d", t, i);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    delete logger;
+    dropped = async_logger::dropped_records() - dropped;
+
+    index.clear();
+    get_log_file_index(index);
+    sort(index.begin(), index.end());
+    lines.clear();
+    read_log_lines(index, lines);
+
+    uint64_t written = 0;
+    uint64_t reported_dropped = 0;
+    std::vector<int> last(kThreads, -1);
+    for (const auto &line : lines) {
+        int t, i;
+        unsigned long long n;
+        auto pos = line.find("thread ");
+        if (pos != std::string::npos &&
+            2 == sscanf(line.c_str() + pos, "thread %d record %d", &t, &i)) {
+            ASSERT_LT(last[t], i);
+            last[t] = i;
+            ++written;
+        } else if ((pos = line.find("async_logger dropped ")) != std::string::npos &&
+                   1 == sscanf(line.c_str() + pos, "async_logger dropped %llu", &n)) {
+            reported_dropped += n;
+        }
+    }
+    ASSERT_EQ(dropped, reported_dropped);
+    ASSERT_EQ(kThreads * kRecordsPerThread, written + dropped);
+    clear_files(index);
+
+    // a record too long for the buffer is truncated, but still on a line of its own
+    logger = new async_logger("./");
+    std::string long_record(FLAGS_buffer_size_kb_per_thread * 1024, 'x');
+    log_print(logger, "%s", long_record.c_str());
+    log_print(logger, "%s", "after the long record");
+    delete logger;
+
+    index.clear();
+    get_log_file_index(index);
+    lines.clear();
+    read_log_lines(index, lines);
+    ASSERT_EQ(2, lines.size());
+    ASSERT_LT(lines[0].size(), long_record.size());
+    ASSERT_EQ('x', lines[0].back());
+    ASSERT_NE(std::string::npos, lines[1].find("after the long record"));
+    ASSERT_EQ(std::string::npos, lines[1].find("xxxx"));
+    clear_files(index);
+
+    finish_test_dir();
+}
@@ -17,6 +17,8 @@
 
 #include "throttling_controller.h"
 
+#include <cmath>
+
 #include <dsn/c/api_layer1.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/utility/strings.h>
@@ -31,9 +33,33 @@ throttling_controller::throttling_controller()
       _delay_ms(0),
       _reject_units(0),
       _reject_delay_ms(0),
+      _delay_total_units(0),
+      _reject_total_units(0),
       _last_request_time(0),
-      _cur_units(0)
+      _cur_units(0),
+      _is_primary(false)
+{
+}
+
+throttling_controller::~throttling_controller() { set_quota(nullptr); }
+
+void throttling_controller::set_quota(std::shared_ptr<throttling_quota> quota)
 {
+    if (_quota != nullptr && _is_primary) {
+        --_quota->primary_count;
+    }
+    _quota = std::move(quota);
+    if (_quota != nullptr && _is_primary) {
+        ++_quota->primary_count;
+    }
+}
+
+void throttling_controller::set_primary(bool is_primary)
+{
+    if (_quota != nullptr && _is_primary != is_primary) {
+        _quota->primary_count += is_primary ? 1 : -1;
+    }
+    _is_primary = is_primary;
 }
 
 bool throttling_controller::parse_from_env(const std::string &env_value,
@@ -53,9 +79,11 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
     }
     bool delay_parsed = false;
     int64_t delay_units = 0;
+    int64_t delay_total_units = 0;
     int64_t delay_ms = 0;
     bool reject_parsed = false;
     int64_t reject_units = 0;
+    int64_t reject_total_units = 0;
     int64_t reject_delay_ms = 0;
     for (std::string &s : sargs) {
         std::vector<std::string> sargs1;
@@ -95,6 +123,7 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
             }
             delay_parsed = true;
             delay_units = units / partition_count + 1;
+            delay_total_units = units;
             delay_ms = ms;
         } else if (sargs1[1] == "reject") {
             if (reject_parsed) {
@@ -103,6 +132,7 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
             }
             reject_parsed = true;
             reject_units = units / partition_count + 1;
+            reject_total_units = units;
             reject_delay_ms = ms;
         } else {
             parse_error = "invalid throttling type";
@@ -118,6 +148,8 @@ bool throttling_controller::parse_from_env(const std::string &env_value,
     _delay_ms = delay_ms;
     _reject_units = reject_units;
     _reject_delay_ms = reject_delay_ms;
+    _delay_total_units = delay_total_units;
+    _reject_total_units = reject_total_units;
     return true;
 }
 
@@ -133,6 +165,8 @@ void throttling_controller::reset(bool &changed, std::string &old_env_value)
         _delay_ms = 0;
         _reject_units = 0;
         _reject_delay_ms = 0;
+        _delay_total_units = 0;
+        _reject_total_units = 0;
         _last_request_time = 0;
         _cur_units = 0;
     } else {
@@ -154,7 +188,11 @@ throttling_controller::throttling_type throttling_controller::control(
         _last_request_time = now_s;
     }
     _cur_units += request_units;
-    if (_reject_units > 0 && _cur_units > _reject_units) {
+    if (_reject_units > 0 &&
+        (_quota == nullptr
+             ? _cur_units > _reject_units
+             : !consume(
+                   _quota->reject_bucket, _reject_total_units, _reject_units, request_units))) {
         _cur_units -= request_units;
         if (client_timeout_ms > 0) {
             delay_ms = std::min(_reject_delay_ms, client_timeout_ms / 2);
@@ -163,16 +201,49 @@ throttling_controller::throttling_type throttling_controller::control(
         }
         return REJECT;
     }
-    if (_delay_units > 0 && _cur_units > _delay_units) {
+    if (_delay_units > 0 &&
+        (_quota == nullptr
+             ? _cur_units > _delay_units
+             : !consume(_quota->delay_bucket, _delay_total_units, _delay_units, request_units))) {
+        delay_ms = _delay_ms;
+        if (_quota != nullptr) {
+            // the request is going to be executed after the delay, so borrow its units now
+            double rate = quota_rate(_delay_total_units);
+            auto wait_s = _quota->delay_bucket.consumeWithBorrowNonBlocking(
+                request_units, rate, std::max(rate, static_cast<double>(request_units)));
+            if (wait_s) {
+                delay_ms = std::min(delay_ms, static_cast<int64_t>(std::ceil(*wait_s * 1000)));
+            }
+        }
         if (client_timeout_ms > 0) {
-            delay_ms = std::min(_delay_ms, client_timeout_ms / 2);
-        } else {
-            delay_ms = _delay_ms;
+            delay_ms = std::min(delay_ms, client_timeout_ms / 2);
         }
         return DELAY;
     }
     return PASS;
 }
 
+double throttling_controller::quota_rate(int64_t total_units) const
+{
+    // at least the share of this partition
+    double primaries = std::max(_quota->primary_count.load(), 1);
+    return std::max(static_cast<double>(total_units) * primaries / _partition_count, 1.0);
+}
+
+bool throttling_controller::consume(folly::DynamicTokenBucket &bucket,
+                                    int64_t total_units,
+                                    int64_t partition_units,
+                                    int32_t request_units)
+{
+    double rate = quota_rate(total_units);
+    double burst = std::max(rate, static_cast<double>(request_units));
+    if (_cur_units <= partition_units) {
+        // always within the share of this partition, which may leave the bucket in debt
+        bucket.consumeWithBorrowNonBlocking(request_units, rate, burst);
+        return true;
+    }
+    return bucket.consume(request_units, rate, burst);
+}
+
 } // namespace replication
 } // namespace dsn
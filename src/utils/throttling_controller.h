@@ -17,13 +17,37 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <stdint.h>
 #include <string>
 
+#include <dsn/utility/TokenBucket.h>
+
 namespace dsn {
 
 namespace replication {
 
+// The throttling quota of an app shared by all its replicas on the same node.
+//
+// Each partition is still guaranteed its even share of the app-level limit, and a partition
+// exceeding its share may borrow the units left unused by the other partitions of the app
+// on the same node. Thus a skewed workload isn't rejected on the hot partitions as long as
+// the total units of the app on this node stay within its budget. The requests are throttled
+// on the primaries only, so the budget is the app-level limit split evenly by the partitions,
+// times the count of the primaries of the app on this node.
+//
+// thread safe
+struct throttling_quota
+{
+    throttling_quota() : primary_count(0) {}
+
+    folly::DynamicTokenBucket delay_bucket;
+    folly::DynamicTokenBucket reject_bucket;
+    // count of the primaries on this node sharing this quota
+    std::atomic<int32_t> primary_count;
+};
+
 // Used for replica throttling.
 // Different throttling strategies may use different 'request_units', which is
 // the cost of each request. For QPS-based throttling, request_units=1.
@@ -43,6 +67,7 @@ public:
 
 public:
     throttling_controller();
+    ~throttling_controller();
 
     // Configures throttling strategy dynamically from app-envs.
     // The result of `delay_units` and `reject_units` are ensured greater than 0.
@@ -60,6 +85,13 @@ public:
                         /*out*/ bool &changed,
                         /*out*/ std::string &old_env_value);
 
+    // Shares `quota` with the other replicas of the app on this node. Stops sharing if `quota`
+    // is nullptr.
+    void set_quota(std::shared_ptr<throttling_quota> quota);
+
+    // Sets whether the replica is a primary, only the primaries count in the shared quota.
+    void set_primary(bool is_primary);
+
     // reset to no throttling.
     void reset(/*out*/ bool &changed, /*out*/ std::string &old_env_value);
 
@@ -67,13 +99,25 @@ public:
     const std::string &env_value() const { return _env_value; }
 
     // do throttling control, return throttling type.
-    // 'delay_ms' is set when the return type is not PASS.
+    // 'delay_ms' is set when the return type is not PASS. If the quota is shared, the delay
+    // is the estimated time for the app to regain the units of the request.
     throttling_type
     control(const int64_t client_timeout_ms, int32_t request_units, /*out*/ int64_t &delay_ms);
 
 private:
     friend class throttling_controller_test;
 
+    // returns whether the request could pass the limit of `total_units` per second of the app,
+    // whose share of this partition is `partition_units`. The request is charged to `bucket`
+    // of the shared quota if it passes.
+    bool consume(folly::DynamicTokenBucket &bucket,
+                 int64_t total_units,
+                 int64_t partition_units,
+                 int32_t request_units);
+
+    // rate and burst of the shared quota
+    double quota_rate(int64_t total_units) const;
+
     bool _enabled;
     std::string _env_value;
     int32_t _partition_count;
@@ -81,8 +125,13 @@ private:
     int64_t _delay_ms;        // should >= 0
     int64_t _reject_units;    // should >= 0
     int64_t _reject_delay_ms; // should >= 0
+    int64_t _delay_total_units;
+    int64_t _reject_total_units;
     int64_t _last_request_time;
     int64_t _cur_units;
+
+    std::shared_ptr<throttling_quota> _quota;
+    bool _is_primary;
 };
 
 } // namespace replication
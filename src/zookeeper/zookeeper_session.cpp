@@ -33,6 +33,7 @@
  */
 
 #include <zookeeper/zookeeper.h>
+#include <dsn/utility/flags.h>
 
 #include "zookeeper_session.h"
 #include "zookeeper_session_mgr.h"
@@ -40,6 +41,12 @@
 namespace dsn {
 namespace dist {
 
+DSN_DEFINE_uint32("zookeeper",
+                  zookeeper_max_outstanding_requests,
+                  1024,
+                  "the max count of requests pipelined to zookeeper in one session, the others "
+                  "are queued until some complete, 0 means unlimited");
+
 zookeeper_session::zoo_atomic_packet::zoo_atomic_packet(unsigned int size)
 {
     _capacity = size;
@@ -132,7 +139,8 @@ const char *zookeeper_session::string_zoo_state(int zoo_state)
 
 zookeeper_session::~zookeeper_session() {}
 
-zookeeper_session::zookeeper_session(const service_app_info &node) : _handle(nullptr)
+zookeeper_session::zookeeper_session(const service_app_info &node)
+    : _handle(nullptr), _outstanding_count(0)
 {
     _srv_node = node;
 }
@@ -192,12 +200,47 @@ void zookeeper_session::dispatch_event(int type, int zstate, const char *path)
 void zookeeper_session::visit(zoo_opcontext *ctx)
 {
     ctx->_priv_session_ref = this;
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_pending_lock);
+        if (FLAGS_zookeeper_max_outstanding_requests > 0 &&
+            _outstanding_count >= FLAGS_zookeeper_max_outstanding_requests) {
+            _pending_requests.push_back(ctx);
+            return;
+        }
+        ++_outstanding_count;
+    }
+    if (!dispatch(ctx)) {
+        on_request_completed();
+    }
+}
+
+void zookeeper_session::on_request_completed()
+{
+    // the requests completed without being sent are handled in a loop rather than recursively
+    for (;;) {
+        zoo_opcontext *next;
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_pending_lock);
+            if (_pending_requests.empty()) {
+                --_outstanding_count;
+                return;
+            }
+            next = _pending_requests.front();
+            _pending_requests.pop_front();
+        }
+        if (dispatch(next)) {
+            return;
+        }
+    }
+}
 
+bool zookeeper_session::dispatch(zoo_opcontext *ctx)
+{
     if (zoo_state(_handle) != ZOO_CONNECTED_STATE) {
         ctx->_output.error = ZINVALIDSTATE;
         ctx->_callback_function(ctx);
         release_ref(ctx);
-        return;
+        return false;
     }
 
     auto add_watch_object = [this, ctx]() {
@@ -255,9 +298,9 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
         break;
     case ZOO_TRANSACTION:
         ec = zoo_amulti(_handle,
-                        input._pkt->_count,
-                        input._pkt->_ops,
-                        input._pkt->_results,
+                        input._pkt_count,
+                        input._pkt->_ops + input._pkt_offset,
+                        input._pkt->_results + input._pkt_offset,
                         global_void_completion,
                         (const void *)ctx);
         break;
@@ -269,7 +312,9 @@ void zookeeper_session::visit(zoo_opcontext *ctx)
         ctx->_output.error = ec;
         ctx->_callback_function(ctx);
         release_ref(ctx);
+        return false;
     }
+    return true;
 }
 
 void zookeeper_session::init_non_dsn_thread()
@@ -298,6 +343,15 @@ void zookeeper_session::global_watcher(
     zoo_session->dispatch_event(type, state, type == ZOO_SESSION_EVENT ? "" : path);
 }
 
+/* static */
+void zookeeper_session::complete(zoo_opcontext *op_ctx)
+{
+    zookeeper_session *session = op_ctx->_priv_session_ref;
+    op_ctx->_callback_function(op_ctx);
+    release_ref(op_ctx);
+    session->on_request_completed();
+}
+
 #define COMPLETION_INIT(rc, data)                                                                  \
     zoo_opcontext *op_ctx = (zoo_opcontext *)data;                                                 \
     op_ctx->_priv_session_ref->init_non_dsn_thread();                                              \
@@ -311,8 +365,7 @@ void zookeeper_session::global_string_completion(int rc, const char *name, const
     if (ZOK == rc && name != nullptr)
         dinfo("created path:%s", name);
     output.create_op._created_path = name;
-    op_ctx->_callback_function(op_ctx);
-    release_ref(op_ctx);
+    complete(op_ctx);
 }
 /* static */
 void zookeeper_session::global_data_completion(
@@ -322,8 +375,7 @@ void zookeeper_session::global_data_completion(
     dinfo("rc(%s), input path(%s)", zerror(rc), op_ctx->_input._path.c_str());
     output.get_op.value_length = value_length;
     output.get_op.value = value;
-    op_ctx->_callback_function(op_ctx);
-    release_ref(op_ctx);
+    complete(op_ctx);
 }
 /* static */
 void zookeeper_session::global_state_completion(int rc, const Stat *stat, const void *data)
@@ -332,12 +384,10 @@ void zookeeper_session::global_state_completion(int rc, const Stat *stat, const
     dinfo("rc(%s), input path(%s)", zerror(rc), op_ctx->_input._path.c_str());
     if (op_ctx->_optype == ZOO_EXISTS) {
         output.exists_op._node_stat = stat;
-        op_ctx->_callback_function(op_ctx);
     } else {
         output.set_op._node_stat = stat;
-        op_ctx->_callback_function(op_ctx);
     }
-    release_ref(op_ctx);
+    complete(op_ctx);
 }
 /* static */
 void zookeeper_session::global_strings_completion(int rc,
@@ -349,8 +399,7 @@ void zookeeper_session::global_strings_completion(int rc,
     if (rc == ZOK && strings != nullptr)
         dinfo("child count: %d", strings->count);
     output.getchildren_op.strings = strings;
-    op_ctx->_callback_function(op_ctx);
-    release_ref(op_ctx);
+    complete(op_ctx);
 }
 /* static */
 void zookeeper_session::global_void_completion(int rc, const void *data)
@@ -360,8 +409,7 @@ void zookeeper_session::global_void_completion(int rc, const void *data)
         dinfo("rc(%s), input path( %s )", zerror(rc), op_ctx->_input._path.c_str());
     else
         dinfo("rc(%s)", zerror(rc));
-    op_ctx->_callback_function(op_ctx);
-    release_ref(op_ctx);
+    complete(op_ctx);
 }
 }
 }
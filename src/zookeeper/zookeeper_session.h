@@ -36,6 +36,7 @@
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 
+#include <deque>
 #include <thread>
 #include <zookeeper/zookeeper.h>
 #include "zookeeper_session_mgr.h"
@@ -93,8 +94,10 @@ public:
         void *_owner;
         std::function<void(int)> _watcher_callback;
 
-        /* for multi-op transaction */
+        /* for multi-op transaction, the ops in [_pkt_offset, _pkt_offset + _pkt_count) */
         std::shared_ptr<zoo_atomic_packet> _pkt;
+        unsigned int _pkt_offset;
+        unsigned int _pkt_count;
     };
 
     struct zoo_output
@@ -145,6 +148,8 @@ public:
         result->_input._is_set_watch = false;
         result->_input._owner = nullptr;
         result->_input._watcher_callback = nullptr;
+        result->_input._pkt_offset = 0;
+        result->_input._pkt_count = 0;
 
         memset(&(result->_output), 0, sizeof(zoo_output));
 
@@ -170,6 +175,9 @@ public:
     void detach(void *callback_owner);
 
     int session_state() const { return zoo_state(_handle); }
+
+    // Sends the request asynchronously. At most `zookeeper_max_outstanding_requests` requests
+    // are pipelined to zookeeper, the others wait in FIFO order until some complete.
     void visit(zoo_opcontext *op_context);
     void init_non_dsn_thread();
 
@@ -185,6 +193,16 @@ private:
     service_app_info _srv_node;
     zhandle_t *_handle;
 
+    utils::ex_lock_nr _pending_lock;
+    std::deque<zoo_opcontext *> _pending_requests;
+    uint32_t _outstanding_count;
+
+    // returns false if the request is completed without being sent
+    bool dispatch(zoo_opcontext *op_context);
+    // hands over the slot of the completed request to the next pending one
+    void on_request_completed();
+    static void complete(zoo_opcontext *op_context);
+
     void dispatch_event(int type, int zstate, const char *path);
     static void global_watcher(zhandle_t *handle, int type, int state, const char *path, void *ctx);
     static void global_string_completion(int rc, const char *name, const void *data);